@@ -0,0 +1,238 @@
+/*----- bench_astar.c --------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+/* micro benchmark: the sorted list A* (the previous t3d_astar.c, with the
+   row stride fixed) against the binary heap A* on synthetic maps with
+   random blocked cells. the list search is only run on the small map, it
+   is quadratic in the expanded cells. the path lengths must match */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <t3d_math.h>
+#include <t3d_patchmap.h>
+#include <t3d_astar.h>
+
+
+#define N_SEARCHES  200     /* at most, a map runs fewer if it is large */
+#define BLOCKED     20      /* percent of the cells */
+#define WALK_COST   10
+
+
+/* the reference search, an OPEN list sorted on (f, g) and linear lookups */
+typedef struct __refnode {
+  int x, y;
+  int f, g, h;
+  struct __refnode *next;
+  struct __refnode *father;
+} refnode;
+
+static void
+ref_insert( refnode **list, refnode *node )
+{
+  refnode *trav = *list;
+
+  if(trav == NULL || trav->f > node->f) {
+    node->next = trav;
+    *list = node;
+    return;
+  }
+  while(trav->next != NULL) {
+    if(trav->next->f > node->f || (trav->next->f == node->f && trav->next->g >= node->g))
+      break;
+    trav = trav->next;
+  }
+  node->next = trav->next;
+  trav->next = node;
+}
+
+static refnode *
+ref_get( refnode *list, const int x, const int y )
+{
+  for(; list; list = list->next)
+    if(list->x == x && list->y == y)  return list;
+  return NULL;
+}
+
+static void
+ref_unlink( refnode **list, refnode *node )
+{
+  refnode **p = list;
+  while(*p != node)  p = &(*p)->next;
+  *p = node->next;
+}
+
+static void
+ref_del_list( refnode *list )
+{
+  while(list) {
+    refnode *next = list->next;
+    free(list);
+    list = next;
+  }
+}
+
+static int
+ref_search( const ivec2 *start, const ivec2 *end, const patchmap *pm )
+{
+  static const int dx[4] = { -1, 0, 1, 0 };
+  static const int dy[4] = { 0, 1, 0, -1 };
+  int w = pm->w_cells;
+  int i;
+
+  if(!pm->cells[start->y*w + start->x].status || !pm->cells[end->y*w + end->x].status ||
+     (start->x == end->x && start->y == end->y))
+    return 0;
+
+  refnode *open = (refnode *)calloc(1, sizeof(refnode));
+  refnode *closed = NULL;
+  refnode *found = NULL;
+  open->x = start->x;
+  open->y = start->y;
+
+  while(!found && open) {
+    refnode *cur = open;
+    open = open->next;
+    cur->next = closed;
+    closed = cur;
+
+    for(i = 0; i < 4; i++) {
+      int x = cur->x + dx[i];
+      int y = cur->y + dy[i];
+      if(x < 0 || y < 0 || x >= w || y >= pm->h_cells)  continue;
+      if(!pm->cells[y*w + x].status || ref_get(closed, x, y))  continue;
+
+      int g = cur->g + WALK_COST;
+      refnode *n = ref_get(open, x, y);
+      if(!n) {
+        n = (refnode *)malloc(sizeof(refnode));
+        n->x = x;
+        n->y = y;
+        n->g = g;
+        n->h = WALK_COST*(abs(x - end->x) + abs(y - end->y));
+        n->f = n->g + n->h;
+        n->father = cur;
+        ref_insert(&open, n);
+        if(!n->h) {
+          found = n;
+          break;
+        }
+      }
+      else if(n->g > g) {
+        n->g = g;
+        n->f = g + n->h;
+        n->father = cur;
+        ref_unlink(&open, n);
+        ref_insert(&open, n);
+      }
+    }
+  }
+
+  int len = found ? found->g/WALK_COST + 1 : 0;
+  ref_del_list(open);
+  ref_del_list(closed);
+  return len;
+}
+
+/* a map of w x h cells, BLOCKED percent of them not walkable */
+static patchmap *
+make_map( const int w, const int h, unsigned int seed )
+{
+  patchmap *pm = (patchmap *)calloc(1, sizeof(patchmap));
+  int i;
+
+  pm->w_cells = w;
+  pm->h_cells = h;
+  pm->n_total_cells = w*h;
+  pm->cells = (cell *)calloc(pm->n_total_cells, sizeof(cell));
+
+  srand(seed);
+  for(i = 0; i < pm->n_total_cells; i++)
+    pm->cells[i].status = rand()%100 < BLOCKED ? ASTAR_UNAVAIL : ASTAR_AVAIL;
+
+  return pm;
+}
+
+static void
+del_map( patchmap *pm )
+{
+  free(pm->cells);
+  free(pm);
+}
+
+/* random walkable start and end cells */
+static void
+make_queries( ivec2 *starts, ivec2 *ends, const int n, const patchmap *pm )
+{
+  int i;
+  for(i = 0; i < n; i++) {
+    do {
+      starts[i].x = rand()%pm->w_cells;
+      starts[i].y = rand()%pm->h_cells;
+    } while(!pm->cells[starts[i].y*pm->w_cells + starts[i].x].status);
+    do {
+      ends[i].x = rand()%pm->w_cells;
+      ends[i].y = rand()%pm->h_cells;
+    } while(!pm->cells[ends[i].y*pm->w_cells + ends[i].x].status);
+  }
+}
+
+/* run n heap searches on a map, return the path lengths not matching the list search */
+static int
+run_map( const int w, const int h, const int n, const int with_ref )
+{
+  static ivec2 starts[N_SEARCHES], ends[N_SEARCHES];
+  static int ref_lens[N_SEARCHES];
+  patchmap *pm = make_map(w, h, 7);
+  astarctx *ctx = astar_ctx_new();
+  long expanded = 0;
+  int i, found = 0, bad = 0;
+
+  make_queries(starts, ends, n, pm);
+
+  double ref_ms = 0.0;
+  if(with_ref) {
+    clock_t t0 = clock();
+    for(i = 0; i < n; i++)
+      ref_lens[i] = ref_search(&starts[i], &ends[i], pm);
+    ref_ms = 1000.0*(double)(clock() - t0)/CLOCKS_PER_SEC;
+  }
+
+  clock_t t0 = clock();
+  for(i = 0; i < n; i++) {
+    ivec2 *path = NULL;
+    int len = astar_search_ctx(ctx, &path, &starts[i], &ends[i], pm);
+
+    if(len)  found++;
+    if(with_ref && len != ref_lens[i])  bad++;
+    expanded += ctx->n_expanded;
+    free(path);
+  }
+  double heap_ms = 1000.0*(double)(clock() - t0)/CLOCKS_PER_SEC;
+
+  printf("map %4d x %4d, %d searches, %d found, %ld cells expanded\n",
+         w, h, n, found, expanded);
+  if(with_ref)
+    printf("  sorted list: %10.2f ms\n", ref_ms);
+  printf("  binary heap: %10.2f ms  (%.3f ms a search)\n", heap_ms, heap_ms/n);
+  if(with_ref && heap_ms > 0.0)
+    printf("  speedup:     %10.2fx, %d path lengths differ\n", ref_ms/heap_ms, bad);
+
+  astar_ctx_del(ctx);
+  del_map(pm);
+  return bad;
+}
+
+int
+main( int argc, char **argv )
+{
+  int bad = 0;
+
+  bad += run_map(128, 128, N_SEARCHES, 1);
+  bad += run_map(1024, 1024, N_SEARCHES/4, 0);
+  bad += run_map(2048, 2048, N_SEARCHES/10, 0);
+
+  return bad ? 1 : 0;
+}
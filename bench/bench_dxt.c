@@ -0,0 +1,254 @@
+/*----- bench_dxt.c ----------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+/* micro benchmark: scalar against SIMD DXT compression and 2x2 downsampling
+   over the demo textures, run from the demo directory (or pass a list file).
+   without -ffast-math the SIMD blocks are bit identical, with it a rounding
+   tie may go the other way: an endpoint one 565 step away, or with the
+   same endpoints an index one palette step away. the downsampled
+   mips must be bit identical. the speed mode is reported as its RMSE next
+   to the quality mode */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <stb_image.h>
+#include <t3d_dxt.h>
+
+
+#define N_LOOPS  3
+
+
+/* the 4 colors of a DXT color block */
+static void
+decode_palette( int pal[4][3], const unsigned char *blk )
+{
+  int c0 = blk[0] | (blk[1] << 8);
+  int c1 = blk[2] | (blk[3] << 8);
+  int k;
+
+  pal[0][0] = ((c0 >> 11) & 31)*255/31;
+  pal[0][1] = ((c0 >> 5) & 63)*255/63;
+  pal[0][2] = (c0 & 31)*255/31;
+  pal[1][0] = ((c1 >> 11) & 31)*255/31;
+  pal[1][1] = ((c1 >> 5) & 63)*255/63;
+  pal[1][2] = (c1 & 31)*255/31;
+
+  for(k = 0; k < 3; k++) {
+    if(c0 > c1) {
+      pal[2][k] = (2*pal[0][k] + pal[1][k])/3;
+      pal[3][k] = (pal[0][k] + 2*pal[1][k])/3;
+    }
+    else {
+      pal[2][k] = (pal[0][k] + pal[1][k])/2;
+      pal[3][k] = 0;
+    }
+  }
+}
+
+/* squared color error of a compressed image against its source */
+static double
+color_error( const unsigned char *dxt, const unsigned char *img,
+             const int w, const int h, const int channels )
+{
+  int block_size = (channels & 1) ? 8 : 16;
+  int color_ofs = block_size - 8;
+  int step = channels < 3 ? 0 : 1;
+  double err = 0.0;
+  int i, j, x, y, k;
+
+  for(j = 0; j < h; j += 4) {
+    for(i = 0; i < w; i += 4) {
+      const unsigned char *blk = dxt + color_ofs;
+      unsigned int bits = blk[4] | (blk[5] << 8) | (blk[6] << 16) | ((unsigned int)blk[7] << 24);
+      int pal[4][3];
+      decode_palette(pal, blk);
+
+      for(y = 0; y < 4 && j + y < h; y++) {
+        for(x = 0; x < 4 && i + x < w; x++) {
+          const unsigned char *p = &img[((j + y)*w + i + x)*channels];
+          const int *c = pal[(bits >> (2*(4*y + x))) & 3];
+          for(k = 0; k < 3; k++) {
+            double d = (double)c[k] - p[k*step];
+            err += d*d;
+          }
+        }
+      }
+      dxt += block_size;
+    }
+  }
+
+  return err;
+}
+
+/* one 565 step per channel at most */
+static int
+endpoint_close( const int a, const int b )
+{
+  return abs(((a >> 11) & 31) - ((b >> 11) & 31)) <= 1 &&
+         abs(((a >> 5) & 63) - ((b >> 5) & 63)) <= 1 &&
+         abs((a & 31) - (b & 31)) <= 1;
+}
+
+/* blocks of b not bit identical to a, -1 if one is beyond the error bound */
+static int
+compare_blocks( const unsigned char *a, const unsigned char *b, const int size, const int channels )
+{
+  /* the position on the color line of a 2 bits code */
+  static const int line_pos[4] = {0, 3, 1, 2};
+  int block_size = (channels & 1) ? 8 : 16;
+  int color_ofs = block_size - 8;
+  int i, k, n = 0;
+
+  for(i = 0; i < size; i += block_size) {
+    const unsigned char *ca = &a[i + color_ofs];
+    const unsigned char *cb = &b[i + color_ofs];
+    if(memcmp(&a[i], &b[i], block_size) == 0)  continue;
+    n++;
+
+    /* alpha is computed the same way on both paths */
+    if(memcmp(&a[i], &b[i], color_ofs) != 0)  return -1;
+
+    /* a rounding tie moved an endpoint, the indices follow it */
+    if(memcmp(ca, cb, 4) != 0) {
+      if(!endpoint_close(ca[0] | (ca[1] << 8), cb[0] | (cb[1] << 8)) ||
+         !endpoint_close(ca[2] | (ca[3] << 8), cb[2] | (cb[3] << 8)))  return -1;
+      continue;
+    }
+
+    for(k = 0; k < 16; k++) {
+      int pa = line_pos[(ca[4 + k/4] >> (2*(k & 3))) & 3];
+      int pb = line_pos[(cb[4 + k/4] >> (2*(k & 3))) & 3];
+      if(abs(pa - pb) > 1)  return -1;
+    }
+  }
+
+  return n;
+}
+
+static double
+now_ms( void )
+{
+  return 1000.0*(double)clock()/CLOCKS_PER_SEC;
+}
+
+/* ms per run of one mode over an image, the output of the last run */
+static double
+time_compress( unsigned char **out, int *size, const int mode,
+               const unsigned char *img, const int w, const int h, const int channels )
+{
+  int i;
+  double t0 = now_ms();
+
+  dxt_set_mode(mode);
+  for(i = 0; i < N_LOOPS; i++) {
+    if(i)  free(*out);
+    *out = dxt_compress(img, w, h, channels, size);
+  }
+
+  return (now_ms() - t0)/N_LOOPS;
+}
+
+int
+main( int argc, char **argv )
+{
+  const char *listfile = argc > 1 ? argv[1] : "texture_list.txt";
+  char path[256];
+  int s3tc;
+  int n_images = 0, n_blocks = 0, n_mismatch = 0, n_beyond = 0, n_mip_mismatch = 0;
+  long long n_pixels = 0;
+  double t_scalar = 0.0, t_simd = 0.0, t_speed = 0.0, t_speed_scalar = 0.0;
+  double t_mip_scalar = 0.0, t_mip_simd = 0.0;
+  double err_quality = 0.0, err_speed = 0.0, err_simd = 0.0;
+
+  FILE *fp = fopen(listfile, "r");
+  if(!fp) {
+    fprintf(stderr, "Can not open %s\n", listfile);
+    return 1;
+  }
+
+  while(fscanf(fp, "%255s %d", path, &s3tc) == 2) {
+    int w, h, channels, i;
+    unsigned char *img = stbi_load(path, &w, &h, &channels, 0);
+    if(!img)  continue;
+
+    unsigned char *ref, *simd, *speed, *speed_ref;
+    int ref_size, simd_size, speed_size, speed_ref_size;
+
+    t_scalar += time_compress(&ref, &ref_size, DXT_QUALITY|DXT_NO_SIMD, img, w, h, channels);
+    t_simd += time_compress(&simd, &simd_size, DXT_QUALITY, img, w, h, channels);
+    t_speed_scalar += time_compress(&speed_ref, &speed_ref_size, DXT_SPEED|DXT_NO_SIMD, img, w, h, channels);
+    t_speed += time_compress(&speed, &speed_size, DXT_SPEED, img, w, h, channels);
+
+    int da = compare_blocks(ref, simd, ref_size, channels);
+    int db = compare_blocks(speed_ref, speed, speed_size, channels);
+    if(ref_size != simd_size || speed_ref_size != speed_size || da < 0 || db < 0)  n_beyond++;
+    else  n_mismatch += da + db;
+    n_blocks += ref_size/((channels & 1) ? 8 : 16)*2;
+
+    err_quality += color_error(ref, img, w, h, channels);
+    err_speed += color_error(speed, img, w, h, channels);
+    err_simd += color_error(simd, img, w, h, channels);
+
+    /* the whole mip chain, both paths */
+    int mip_w = w, mip_h = h;
+    unsigned char *src = img;
+    while(mip_w > 1 || mip_h > 1) {
+      int next_w = mip_w > 1 ? mip_w/2 : 1;
+      int next_h = mip_h > 1 ? mip_h/2 : 1;
+      unsigned char *a = (unsigned char *)malloc(channels*next_w*next_h);
+      unsigned char *b = (unsigned char *)malloc(channels*next_w*next_h);
+
+      double t0 = now_ms();
+      dxt_set_mode(DXT_NO_SIMD);
+      for(i = 0; i < N_LOOPS; i++)  dxt_downsample(a, src, mip_w, mip_h, channels);
+      double t1 = now_ms();
+      dxt_set_mode(DXT_QUALITY);
+      for(i = 0; i < N_LOOPS; i++)  dxt_downsample(b, src, mip_w, mip_h, channels);
+      double t2 = now_ms();
+      t_mip_scalar += (t1 - t0)/N_LOOPS;
+      t_mip_simd += (t2 - t1)/N_LOOPS;
+
+      if(memcmp(a, b, channels*next_w*next_h) != 0)  n_mip_mismatch++;
+
+      free(b);
+      if(src != img)  free(src);
+      src = a;
+      mip_w = next_w;
+      mip_h = next_h;
+    }
+    if(src != img)  free(src);
+
+    n_pixels += (long long)w*h;
+    n_images++;
+
+    free(ref);
+    free(simd);
+    free(speed);
+    free(speed_ref);
+    stbi_image_free(img);
+  }
+  fclose(fp);
+
+  printf("images: %d, pixels: %lld, loops: %d\n", n_images, n_pixels, N_LOOPS);
+  printf("quality scalar: %8.2f ms\n", t_scalar);
+  printf("quality simd:   %8.2f ms  (%.2fx)\n", t_simd, t_simd > 0.0 ? t_scalar/t_simd : 0.0);
+  printf("speed scalar:   %8.2f ms\n", t_speed_scalar);
+  printf("speed simd:     %8.2f ms  (%.2fx over quality scalar)\n", t_speed,
+         t_speed > 0.0 ? t_scalar/t_speed : 0.0);
+  printf("mips scalar:    %8.2f ms\n", t_mip_scalar);
+  printf("mips simd:      %8.2f ms  (%.2fx)\n", t_mip_simd, t_mip_simd > 0.0 ? t_mip_scalar/t_mip_simd : 0.0);
+  if(n_pixels) {
+    printf("rmse quality:   %8.3f\n", sqrt(err_quality/(3.0*n_pixels)));
+    printf("rmse quality simd: %5.3f\n", sqrt(err_simd/(3.0*n_pixels)));
+    printf("rmse speed:     %8.3f\n", sqrt(err_speed/(3.0*n_pixels)));
+  }
+  printf("simd blocks not bit identical: %d of %d\n", n_mismatch, n_blocks);
+  printf("simd images beyond the bound: %d, mip levels not identical: %d\n", n_beyond, n_mip_mismatch);
+
+  return (n_beyond || n_mip_mismatch) ? 1 : 0;
+}
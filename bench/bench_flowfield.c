@@ -0,0 +1,185 @@
+/*----- bench_flowfield.c ----------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+/* micro benchmark: the flow field of a goal built alone and on a thread pool,
+   on synthetic maps with random blocked cells, the best of N_ROUNDS builds
+   each, taken in turns. both builds must give the same field. the cost of a cell must be the
+   A* path length to the goal in walk costs (FF_UNREACHED where A* finds none),
+   and stepping along the directions (corners cut between walkable cells) must
+   reach the goal from every cell tried */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <t3d_math.h>
+#include <t3d_timer.h>
+#include <t3d_util.h>
+#include <t3d_thpool.h>
+#include <t3d_patchmap.h>
+#include <t3d_astar.h>
+#include <t3d_flowfield.h>
+
+
+#define N_ROUNDS    5
+#define N_SEARCHES  300     /* cells checked against A* on each map */
+#define BLOCKED     20      /* percent of the cells */
+#define WALK_COST   10
+
+
+/* a map of w x h cells in patches of pch_cells, BLOCKED percent of them not walkable */
+static patchmap *
+make_map( const int w, const int h, const int pch_cells, unsigned int seed )
+{
+  patchmap *pm = (patchmap *)calloc(1, sizeof(patchmap));
+  int i;
+
+  pm->w_cells = w;
+  pm->h_cells = h;
+  pm->n_total_cells = w*h;
+  pm->w_pch_cells = pch_cells;
+  pm->h_pch_cells = pch_cells;
+  pm->cells = (cell *)calloc(pm->n_total_cells, sizeof(cell));
+
+  srand(seed);
+  for(i = 0; i < pm->n_total_cells; i++)
+    pm->cells[i].status = rand()%100 < BLOCKED ? ASTAR_UNAVAIL : ASTAR_AVAIL;
+
+  return pm;
+}
+
+static void
+del_map( patchmap *pm )
+{
+  free(pm->cells);
+  free(pm);
+}
+
+/* a random walkable cell */
+static void
+random_cell( ivec2 *c, const patchmap *pm )
+{
+  do {
+    c->x = rand()%pm->w_cells;
+    c->y = rand()%pm->h_cells;
+  } while(!pm->cells[c->y*pm->w_cells + c->x].status);
+}
+
+/* step from a cell along the directions, return 1 if the goal is reached over
+   walkable cells with the cost going down each step. a corner step needs both
+   cells beside it walkable */
+static int
+walk_field( flowfield *ff, const ivec2 *from, const patchmap *pm )
+{
+  int w = ff->w_cells;
+  int steps = 0;
+  ivec2 cur, next;
+
+  ivec2_cpy(&cur, from);
+  while(ff_step(ff, &next, &cur)) {
+    int dx = abs(next.x - cur.x);
+    int dy = abs(next.y - cur.y);
+
+    if(dx > 1 || dy > 1 || !pm->cells[next.y*w + next.x].status)  return 0;
+    if(dx && dy && (!pm->cells[cur.y*w + next.x].status || !pm->cells[next.y*w + cur.x].status))
+      return 0;
+    if(ff->costs[next.y*w + next.x] >= ff->costs[cur.y*w + cur.x])  return 0;
+    if(++steps > ff->w_cells*ff->h_cells)  return 0;
+    ivec2_cpy(&cur, &next);
+  }
+
+  return ivec2_eq(&cur, &ff->goal);
+}
+
+/* build the field again, keep the best time */
+static void
+build_field( flowfield **ff, double *best, const patchmap *pm, const ivec2 *goal, thpool *pool )
+{
+  ff_release(*ff);
+
+  double t0 = tmr_getmsecs();
+  *ff = ff_new(pm, goal, pool);
+  /* the pool has a worker a core, this thread polling often takes time from one */
+  while(!ff_ready(*ff))
+    usleep(1000);
+  double ms = tmr_getmsecs() - t0;
+
+  if(*best == 0.0 || ms < *best)  *best = ms;
+}
+
+/* build the field of a random goal and check it, return the cells found wrong */
+static int
+run_map( const int w, const int h, const int pch_cells, thpool *pool, const int n_workers )
+{
+  patchmap *pm = make_map(w, h, pch_cells, 13);
+  astarctx *ctx = astar_ctx_new();
+  int i, reached = 0, bad_costs = 0, bad_walks = 0, bad_pool = 0;
+  flowfield *ff = NULL, *pooled = NULL;
+  double build_ms = 0.0, pool_ms = 0.0;
+  ivec2 goal;
+
+  random_cell(&goal, pm);
+
+  /* in turns, the machine drifts less between the two */
+  for(i = 0; i < N_ROUNDS; i++) {
+    build_field(&ff, &build_ms, pm, &goal, NULL);
+    if(pool)  build_field(&pooled, &pool_ms, pm, &goal, pool);
+  }
+  if(pool) {
+    bad_pool = memcmp(ff->costs, pooled->costs, sizeof(int)*w*h) != 0 ||
+               memcmp(ff->dirs, pooled->dirs, w*h) != 0;
+  }
+
+  for(i = 0; i < N_SEARCHES; i++) {
+    ivec2 start;
+    random_cell(&start, pm);
+    if(ivec2_eq(&start, &goal))  continue;
+
+    ivec2 *path = NULL;
+    int len = astar_search_ctx(ctx, &path, &start, &goal, pm);
+    free(path);
+
+    int cost = ff->costs[start.y*w + start.x];
+    if(len) {
+      reached++;
+      if(cost != WALK_COST*(len - 1))  bad_costs++;
+      if(!walk_field(ff, &start, pm))  bad_walks++;
+    }
+    else if(cost != FF_UNREACHED) {
+      bad_costs++;
+    }
+  }
+
+  printf("map %4d x %4d, tiles of %d, %d tiles in %d turns\n",
+         w, h, pch_cells, ff->w_tiles*ff->h_tiles, ff->n_turns);
+  printf("  one thread:  %8.2f ms\n", build_ms);
+  if(pooled)
+    printf("  thread pool: %8.2f ms  (%.2fx, %d workers, %d runs)%s\n",
+           pool_ms, build_ms/pool_ms, n_workers, pooled->n_runs,
+           bad_pool ? ", not the same field" : "");
+  printf("  %d cells checked, %d reach the goal, %d costs and %d walks wrong\n",
+         N_SEARCHES, reached, bad_costs, bad_walks);
+
+  ff_release(pooled);
+  ff_release(ff);
+  astar_ctx_del(ctx);
+  del_map(pm);
+  return bad_costs + bad_walks + bad_pool;
+}
+
+int
+main( int argc, char **argv )
+{
+  int bad = 0;
+  int n_workers = util_cpu_count();
+  thpool *pool = thpool_new(n_workers, 4096);
+
+  bad += run_map(128, 128, 16, NULL, 0);
+  bad += run_map(300, 263, 23, pool, n_workers);
+  bad += run_map(1000, 963, 25, pool, n_workers);
+
+  if(pool)  thpool_del(pool, THPOOL_GRACEFUL);
+  return bad ? 1 : 0;
+}
@@ -0,0 +1,225 @@
+/*----- bench_hpa.c ----------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+/* micro benchmark: hpa_search plus the first refined leg, what a unit waits
+   for before it moves, against astar_search on synthetic maps with random
+   blocked cells, some cells flipped between the searches. the graph build and
+   the rebuilds after the flips are timed on their own. both searches must
+   agree on which goals are reachable, the HPA* path must be a walk from the
+   start to the end no shorter than the A* one. at the end the graph updated
+   cell by cell must equal one built fresh on the map */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <t3d_math.h>
+#include <t3d_patchmap.h>
+#include <t3d_astar.h>
+#include <t3d_hpa.h>
+
+
+#define N_SEARCHES  300     /* at most, a map runs fewer if it is large */
+#define FLIP_EVERY  10      /* searches between 2 flipped cells */
+#define BLOCKED     20      /* percent of the cells */
+
+
+/* a map of w x h cells in patches of pch_cells, BLOCKED percent of them not walkable */
+static patchmap *
+make_map( const int w, const int h, const int pch_cells, unsigned int seed )
+{
+  patchmap *pm = (patchmap *)calloc(1, sizeof(patchmap));
+  int i;
+
+  pm->w_cells = w;
+  pm->h_cells = h;
+  pm->n_total_cells = w*h;
+  pm->w_pch_cells = pch_cells;
+  pm->h_pch_cells = pch_cells;
+  pm->cells = (cell *)calloc(pm->n_total_cells, sizeof(cell));
+  pthread_mutex_init(&pm->lock, NULL);
+
+  srand(seed);
+  for(i = 0; i < pm->n_total_cells; i++)
+    pm->cells[i].status = rand()%100 < BLOCKED ? ASTAR_UNAVAIL : ASTAR_AVAIL;
+
+  return pm;
+}
+
+static void
+del_map( patchmap *pm )
+{
+  pthread_mutex_destroy(&pm->lock);
+  free(pm->cells);
+  free(pm);
+}
+
+/* a random walkable cell */
+static void
+random_cell( ivec2 *c, const patchmap *pm )
+{
+  do {
+    c->x = rand()%pm->w_cells;
+    c->y = rand()%pm->h_cells;
+  } while(!pm->cells[c->y*pm->w_cells + c->x].status);
+}
+
+static double
+ms_since( const clock_t t0 )
+{
+  return 1000.0*(double)(clock() - t0)/CLOCKS_PER_SEC;
+}
+
+/* refine every leg of the waypoints, return the steps of the whole walk,
+   -1 if a leg is blocked or the legs do not make a walk from start to end */
+static int
+walk_waypoints( hpa *g, const ivec2 *wps, const int n_wps, const patchmap *pm )
+{
+  int w = pm->w_cells;
+  int i, k, steps = 0;
+  ivec2 last = wps[0];
+
+  for(i = 0; i + 1 < n_wps; i++) {
+    ivec2 *leg = NULL;
+    int n = hpa_refine(g, &leg, &wps[i], &wps[i + 1], pm);
+    int ok = n > 0 && leg[0].x == last.x && leg[0].y == last.y;
+
+    for(k = 1; ok && k < n; k++) {
+      ok = abs(leg[k].x - leg[k - 1].x) + abs(leg[k].y - leg[k - 1].y) == 1 &&
+           pm->cells[leg[k].y*w + leg[k].x].status;
+    }
+    if(ok) {
+      steps += n - 1;
+      last = leg[n - 1];
+    }
+    free(leg);
+
+    if(!ok)  return -1;
+  }
+
+  return (last.x == wps[n_wps - 1].x && last.y == wps[n_wps - 1].y) ? steps : -1;
+}
+
+/* the patches of 2 graphs differ, return the patches with other portals or costs */
+static int
+compare_graphs( const hpa *a, const hpa *b )
+{
+  int i, k, bad = 0;
+
+  if(a->w_pchs != b->w_pchs || a->h_pchs != b->h_pchs || a->n_portals != b->n_portals)
+    return 1;
+
+  for(i = 0; i < a->w_pchs*a->h_pchs; i++) {
+    const hpapatch *pa = &a->pchs[i];
+    const hpapatch *pb = &b->pchs[i];
+    int same = pa->n_portals == pb->n_portals;
+
+    for(k = 0; same && k < pa->n_portals; k++) {
+      same = pa->portals[k].cell == pb->portals[k].cell &&
+             pa->portals[k].partner == pb->portals[k].partner;
+    }
+    for(k = 0; same && k < pa->n_portals*pa->n_portals; k++)
+      same = pa->costs[k] == pb->costs[k];
+
+    if(!same)  bad++;
+  }
+
+  return bad;
+}
+
+/* run n searches on a map, return the searches and patches found wrong */
+static int
+run_map( const int w, const int h, const int pch_cells, const int n )
+{
+  patchmap *pm = make_map(w, h, pch_cells, 11);
+  astarctx *ctx = astar_ctx_new();
+  long astar_steps = 0, hpa_steps = 0;
+  double astar_ms = 0.0, hpa_ms = 0.0, flip_ms = 0.0;
+  int i, n_flips = 0, found = 0, bad = 0;
+
+  clock_t t0 = clock();
+  hpa *g = hpa_new(pm);
+  hpa_update(g, pm);
+  double build_ms = ms_since(t0);
+
+  for(i = 0; i < n; i++) {
+    ivec2 start, end;
+
+    if(i%FLIP_EVERY == 0) {
+      int x = rand()%w;
+      int y = rand()%h;
+      t0 = clock();
+      hpa_set_status(g, pm, x, y, pm->cells[y*w + x].status ? ASTAR_UNAVAIL : ASTAR_AVAIL);
+      hpa_update(g, pm);
+      flip_ms += ms_since(t0);
+      n_flips++;
+    }
+
+    random_cell(&start, pm);
+    random_cell(&end, pm);
+    if(start.x == end.x && start.y == end.y)  continue;
+
+    ivec2 *path = NULL;
+    t0 = clock();
+    int len = astar_search_ctx(ctx, &path, &start, &end, pm);
+    astar_ms += ms_since(t0);
+    free(path);
+
+    /* the unit moves along the first leg while the others are refined */
+    ivec2 *wps = NULL, *leg = NULL;
+    t0 = clock();
+    int n_wps = hpa_search(g, &wps, &start, &end, pm);
+    if(n_wps > 1)  hpa_refine(g, &leg, &wps[0], &wps[1], pm);
+    hpa_ms += ms_since(t0);
+    free(leg);
+
+    int steps = n_wps ? walk_waypoints(g, wps, n_wps, pm) : 0;
+    free(wps);
+
+    /* the same goals reached, by a walk no shorter than the optimal one */
+    if((len > 0) != (n_wps > 0) || steps < 0 || (len && steps < len - 1)) {
+      bad++;
+    }
+    else if(len) {
+      found++;
+      astar_steps += len - 1;
+      hpa_steps += steps;
+    }
+  }
+
+  /* the patches rebuilt one by one as the cells flipped, and all at once */
+  hpa_update(g, pm);
+  hpa *fresh = hpa_new(pm);
+  hpa_update(fresh, pm);
+  int bad_pchs = compare_graphs(g, fresh);
+
+  printf("map %4d x %4d, patches of %d, %d searches, %d found, %d portals\n",
+         w, h, pch_cells, n, found, g->n_portals);
+  printf("  graph built in %.2f ms, %d flips rebuilt in %.2f ms\n", build_ms, n_flips, flip_ms);
+  printf("  A*:   %10.2f ms  (%.3f ms a search)\n", astar_ms, astar_ms/n);
+  printf("  HPA*: %10.2f ms  (%.3f ms a search and first leg, %.1fx)\n",
+         hpa_ms, hpa_ms/n, hpa_ms > 0.0 ? astar_ms/hpa_ms : 0.0);
+  if(astar_steps > 0)
+    printf("  path length %.3f of the optimal\n", (double)hpa_steps/astar_steps);
+  printf("  %d searches wrong, %d patches differ from a fresh graph\n", bad, bad_pchs);
+
+  hpa_del(fresh);
+  hpa_del(g);
+  astar_ctx_del(ctx);
+  del_map(pm);
+  return bad + bad_pchs;
+}
+
+int
+main( int argc, char **argv )
+{
+  int bad = 0;
+
+  bad += run_map(128, 128, 16, N_SEARCHES);
+  bad += run_map(333, 301, 25, N_SEARCHES);
+  bad += run_map(1024, 1024, 64, N_SEARCHES/3);
+
+  return bad ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+/*----- bench_hsr.c ----------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+/* micro benchmark: scalar unit_calc_faces + unit_calc_cam/lit_hsr
+   against the fused hsr_classify_faces + hsr_compact pass, and the table
+   compaction alone against a scalar one on the same masks */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <t3d_math.h>
+#include <t3d_geomath.h>
+#include <t3d_hsr.h>
+
+
+#define N_SLICES  64
+#define N_STACKS  32
+#define N_LOOPS   2000
+#define N_ROUNDS  5         /* the fastest round is kept, the others had the noise */
+
+
+/* the reference path, same loops as t3d_unit.c */
+static void
+ref_calc_faces( vec4 *faces, const vec3 *vcoords, const unsigned short *indices, const int n_faces )
+{
+  int j;
+  for(j = 0; j < n_faces; j++) {
+    const unsigned short *tri = &indices[3*j];
+    gmth_plane_set_by_3points(&faces[j], &vcoords[tri[0]], &vcoords[tri[1]], &vcoords[tri[2]]);
+  }
+}
+
+static int
+ref_calc_hsr( unsigned short *o_indices, const vec4 *faces, const unsigned short *indices,
+              const int n_faces, const vec3 *point, const int flag )
+{
+  int j;
+  int count = 0;
+  for(j = 0; j < n_faces; j++) {
+    if(gmth_plane_classify_point(&faces[j], point) == flag) {
+      const unsigned short *tri = &indices[3*j];
+      o_indices[count++] = tri[0];
+      o_indices[count++] = tri[1];
+      o_indices[count++] = tri[2];
+    }
+  }
+  return count;
+}
+
+/* the scalar compaction, a lowest bit scan over the mask */
+static int
+ref_compact( unsigned short *o_indices, const unsigned int *mask,
+             const unsigned short *indices, const int n_faces )
+{
+  int j;
+  int count = 0;
+  for(j = 0; j < n_faces; j++) {
+    if(mask[j >> 5] & (1u << (j & 31))) {
+      const unsigned short *tri = &indices[3*j];
+      o_indices[count++] = tri[0];
+      o_indices[count++] = tri[1];
+      o_indices[count++] = tri[2];
+    }
+  }
+  return count;
+}
+
+/* milliseconds since t0 */
+static double
+ms_since( clock_t t0 )
+{
+  return 1000.0*(double)(clock() - t0)/CLOCKS_PER_SEC;
+}
+
+/* count the indices that differ from the reference, print the first one */
+static int
+compare_indices( const char *name, const unsigned short *ref, const unsigned short *got, const int n )
+{
+  int i, bad = 0;
+  for(i = 0; i < n; i++) {
+    if(ref[i] != got[i]) {
+      if(!bad)
+        printf("%s: index %d is %d, the reference has %d\n", name, i, got[i], ref[i]);
+      bad++;
+    }
+  }
+  return bad;
+}
+
+/* a uv sphere, indexed like a welded ms3d mesh */
+static int
+make_sphere( vec3 **vcoords, unsigned short **indices )
+{
+  int i, j, n = 0;
+  int n_vertices = (N_SLICES + 1)*(N_STACKS + 1);
+  int n_faces = N_SLICES*N_STACKS*2;
+
+  *vcoords = (vec3 *)malloc(sizeof(vec3)*n_vertices);
+  *indices = (unsigned short *)malloc(sizeof(unsigned short)*n_faces*3);
+
+  for(i = 0; i <= N_STACKS; i++) {
+    float phi = M_PI*(float)i/N_STACKS;
+    for(j = 0; j <= N_SLICES; j++) {
+      float theta = 2.0*M_PI*(float)j/N_SLICES;
+      vec3 *v = &(*vcoords)[i*(N_SLICES + 1) + j];
+      v->x = sinf(phi)*cosf(theta);
+      v->y = cosf(phi);
+      v->z = sinf(phi)*sinf(theta);
+    }
+  }
+
+  for(i = 0; i < N_STACKS; i++) {
+    for(j = 0; j < N_SLICES; j++) {
+      unsigned short a = i*(N_SLICES + 1) + j;
+      unsigned short b = a + N_SLICES + 1;
+      (*indices)[n++] = a;  (*indices)[n++] = b;  (*indices)[n++] = a + 1;
+      (*indices)[n++] = a + 1;  (*indices)[n++] = b;  (*indices)[n++] = b + 1;
+    }
+  }
+
+  return n_faces;
+}
+
+int
+main( int argc, char **argv )
+{
+  vec3 *vcoords;
+  unsigned short *indices;
+  int n_faces = make_sphere(&vcoords, &indices);
+  int i, ref_cam = 0, ref_lit = 0, new_cam = 0, new_lit = 0;
+
+  vec4 *faces = (vec4 *)malloc(sizeof(vec4)*n_faces);
+  unsigned short *ref_cam_indices = (unsigned short *)malloc(sizeof(unsigned short)*n_faces*3);
+  unsigned short *ref_lit_indices = (unsigned short *)malloc(sizeof(unsigned short)*n_faces*3);
+  unsigned short *cam_indices = (unsigned short *)malloc(sizeof(unsigned short)*n_faces*3);
+  unsigned short *lit_indices = (unsigned short *)malloc(sizeof(unsigned short)*n_faces*3);
+  unsigned short *scratch = (unsigned short *)malloc(sizeof(unsigned short)*n_faces*3);
+  unsigned int *cam_mask = (unsigned int *)malloc(sizeof(unsigned int)*HSR_MASK_WORDS(n_faces));
+  unsigned int *lit_mask = (unsigned int *)malloc(sizeof(unsigned int)*HSR_MASK_WORDS(n_faces));
+
+  vec3 cam = {{ 3.0, 2.0, 5.0 }};
+  vec3 lit = {{ -20.0, 40.0, 10.0 }};
+
+  double ref_ms = 0.0, new_ms = 0.0, scalar_ms = 0.0, compact_ms = 0.0;
+  int r;
+
+  for(r = 0; r < N_ROUNDS; r++) {
+    clock_t t0 = clock();
+    for(i = 0; i < N_LOOPS; i++) {
+      ref_calc_faces(faces, vcoords, indices, n_faces);
+      ref_lit = ref_calc_hsr(ref_lit_indices, faces, indices, n_faces, &lit, PLANE_BACK);
+      ref_cam = ref_calc_hsr(ref_cam_indices, faces, indices, n_faces, &cam, PLANE_FRONT);
+    }
+    double ms = ms_since(t0);
+    if(r == 0 || ms < ref_ms)  ref_ms = ms;
+
+    t0 = clock();
+    for(i = 0; i < N_LOOPS; i++) {
+      hsr_classify_faces(faces, cam_mask, lit_mask, vcoords, indices, n_faces,
+                         &cam, PLANE_FRONT, &lit, PLANE_BACK);
+      new_cam = hsr_compact(cam_indices, cam_mask, indices, n_faces);
+      new_lit = hsr_compact(lit_indices, lit_mask, indices, n_faces);
+    }
+    ms = ms_since(t0);
+    if(r == 0 || ms < new_ms)  new_ms = ms;
+
+    /* the compaction alone, on the masks of the last pass */
+    t0 = clock();
+    for(i = 0; i < N_LOOPS; i++) {
+      ref_compact(scratch, cam_mask, indices, n_faces);
+      ref_compact(scratch, lit_mask, indices, n_faces);
+    }
+    ms = ms_since(t0);
+    if(r == 0 || ms < scalar_ms)  scalar_ms = ms;
+
+    t0 = clock();
+    for(i = 0; i < N_LOOPS; i++) {
+      hsr_compact(scratch, cam_mask, indices, n_faces);
+      hsr_compact(scratch, lit_mask, indices, n_faces);
+    }
+    ms = ms_since(t0);
+    if(r == 0 || ms < compact_ms)  compact_ms = ms;
+  }
+
+  /* both keep the triangles in mesh order, the lists must be the same */
+  int bad = (ref_cam != new_cam) + (ref_lit != new_lit);
+  bad += compare_indices("cam", ref_cam_indices, cam_indices, ref_cam < new_cam ? ref_cam : new_cam);
+  bad += compare_indices("lit", ref_lit_indices, lit_indices, ref_lit < new_lit ? ref_lit : new_lit);
+
+  printf("faces: %d, loops: %d\n", n_faces, N_LOOPS);
+  printf("reference: %8.2f ms  (cam %d, lit %d indices)\n", ref_ms, ref_cam, ref_lit);
+  printf("fused:     %8.2f ms  (cam %d, lit %d indices)\n", new_ms, new_cam, new_lit);
+  if(new_ms > 0.0)
+    printf("speedup:   %8.2fx\n", ref_ms/new_ms);
+  printf("compact, scalar: %8.2f ms, table: %8.2f ms", scalar_ms, compact_ms);
+  if(compact_ms > 0.0)
+    printf("  (%.2fx)", scalar_ms/compact_ms);
+  printf("\n");
+  printf("mismatches: %d\n", bad);
+
+  free(faces);
+  free(ref_cam_indices);
+  free(ref_lit_indices);
+  free(cam_indices);
+  free(lit_indices);
+  free(scratch);
+  free(cam_mask);
+  free(lit_mask);
+  free(vcoords);
+  free(indices);
+
+  return bad ? 1 : 0;
+}
@@ -13,6 +13,8 @@
 #include <AL/alc.h>
 #include <stb_vorbis.h>
 #include <t3d_ogl.h>
+#include <t3d_util.h>
+#include <t3d_pack.h>
 #include <t3d_math.h>
 #include <t3d_shader.h>
 #include <t3d_timer.h>
@@ -25,9 +27,12 @@
 #include <t3d_patchmap.h>
 #include <t3d_minimap.h>
 #include <t3d_sys.h>
+#include <t3d_overlay.h>
 #include <t3d_font.h>
 #include <t3d_thpool.h>
+#include <t3d_texstream.h>
 #include <t3d_scene.h>
+#include <t3d_pathsvc.h>
 
 
 int
@@ -68,6 +73,11 @@ main( int argc, char* argv[] )
 
   glfwMakeContextCurrent(window);
 
+  /* the assets are read from the pack when there is one (see tools/t3dpak),
+     else from the loose files */
+  pak *assets = pak_open("demo.t3dpak");
+  util_mount_pack(assets);
+
 
   /* OpenAL context */
   const ALCchar *default_device_name = alcGetString(NULL, ALC_DEFAULT_DEVICE_SPECIFIER);
@@ -85,7 +95,10 @@ main( int argc, char* argv[] )
 
   int n_channels, datasize, frequency, format;
   short *pcm;
-  datasize = stb_vorbis_decode_filename("music/12mornings.ogg", &n_channels, &frequency, &pcm);
+  size_t ogg_size;
+  const char *ogg = util_file_view("music/12mornings.ogg", &ogg_size);
+  datasize = stb_vorbis_decode_memory((unsigned char *)ogg, (int)ogg_size, &n_channels, &frequency, &pcm);
+  util_file_release(ogg);
 
   if(n_channels == 2)
     format = AL_FORMAT_STEREO16;
@@ -126,14 +139,22 @@ main( int argc, char* argv[] )
     exit(EXIT_FAILURE);
   }
 
+  /* transient upload ring buffer for the per frame dynamic data */
+  ogl_stream_init(8*1024*1024);
+
   /* create a new t3d system */
   t3dsys *sys = sys_new();
 
   /* create minimap */
-  minimap *mmap = minimap_new("terrain.png", screen_w, screen_h, sys->texdb);
+  minimap *mmap = minimap_new("terrain.png", sys->texdb);
+  /* the minimap is drawn at a fixed size, no distance to stream by */
+  tex_stream_pin(sys->texstm, *mmap->tex_id);
 
   /* create font */
-  font *fnt = fnt_new("fonts/FreeSans.ttf", 20, 512, 512, 32, 96, screen_w, screen_h);
+  font *fnt = fnt_new("fonts/FreeSans.ttf", 20, 512, 512);
+
+  /* 2d overlay, text + pickbox + minimap in a few draws */
+  overlay *ovl = ovl_new(screen_w, screen_h);
 
   vec3 lookat;
   vec3 cam_pos;
@@ -155,85 +176,146 @@ main( int argc, char* argv[] )
   /* hook the control struct here */
   glfwSetWindowUserPointer(window, ctrl);
   /* create the pick box */
-  pickbox *pickb = pick_new(screen_w, screen_h);
+  pickbox *pickb = pick_new();
 
   /* create shaders */
   shader *glsl = shd_new();
   glsl->prog_normal_pass = shd_load("shaders/normal_pass.vs", "shaders/normal_pass.fs");
   glsl->prog_light_pass = shd_load("shaders/light_pass.vs", "shaders/light_pass.fs");
-  glsl->prog_font = shd_load("shaders/font.vs", "shaders/font.fs");
-  glsl->prog_box2d = shd_load("shaders/box2d.vs", "shaders/box2d.fs");
   glsl->prog_aamesh = shd_load("shaders/aamesh.vs", "shaders/aamesh.fs");
-  glsl->prog_minimap = shd_load("shaders/minimap.vs", "shaders/minimap.fs");
+  glsl->prog_overlay = shd_load("shaders/overlay.vs", "shaders/overlay.fs");
+  if(ogl_has_instancing()) {
+    glsl->prog_normal_inst = shd_load("shaders/normal_pass_inst.vs", "shaders/normal_pass.fs");
+    glsl->prog_light_inst = shd_load("shaders/light_pass_inst.vs", "shaders/light_pass.fs");
+  }
+  /* the unit skins are in texture arrays when supported (see SYS_SKIN_ARRAYS) */
+  if(ogl_has_texture_arrays()) {
+    glsl->prog_normal_array = shd_load("shaders/normal_pass_array.vs", "shaders/normal_pass_array.fs");
+    if(ogl_has_instancing())
+      glsl->prog_normal_inst_array = shd_load("shaders/normal_pass_inst_array.vs", "shaders/normal_pass_array.fs");
+  }
 
 
   scene *scn = scn_new(sys, cam_3d, lit0, ctrl, pickb);
   thpool *th_pool= thpool_new(4, 5000);
 
+  /* glyphs missing from the atlas are rasterized by the workers */
+  fnt_set_thpool(fnt, th_pool);
+  /* so are the finer texture levels paged in, and the models and textures
+     requested at run time */
+  sys_set_thpool(sys, th_pool);
+
+  /* the static texts, built once */
+  struct {
+    const wchar_t *text;
+    float x, y;
+    int color;
+  } static_lines[] = {
+    { L"Cross System Support (Linux/Windows)", 30.0, 230.0, CLR_GREEN },
+    { L"OpenGL GLSL Rendering", 30.0, 250.0, CLR_GREEN },
+    { L"Task Based Multithread Support", 30.0, 270.0, CLR_GREEN },
+    { L"Scalable Shadowmapping", 30.0, 290.0, CLR_GREEN },
+    { L"Normalmaping", 30.0, 310.0, CLR_GREEN },
+    { L"Heightmap Based Patchmap", 30.0, 330.0, CLR_GREEN },
+    { L"Unicode Font support", 30.0, 350.0, CLR_GREEN },
+    { L"Raycast Picking", 30.0, 370.0, CLR_GREEN },
+    { L"Central Texture Management", 30.0, 390.0, CLR_GREEN },
+    { L"Central Model Management", 30.0, 410.0, CLR_GREEN },
+    { L"Skeletal Animation", 30.0, 430.0, CLR_GREEN },
+    { L"Simple Mesh Decal", 30.0, 450.0, CLR_GREEN },
+    { L"OpenAL 3D Sound Support", 30.0, 470.0, CLR_GREEN },
+    { L"Vorbis Format Support", 30.0, 490.0, CLR_GREEN },
+    { L"[ Zoom ] - Mouse wheel", 30.0, 520.0, CLR_WHITE },
+    { L"[ Move Around ] - Mouse to the borders, or A, D, W, S", 30.0, 540.0, CLR_WHITE }
+  };
+  int n_static_lines = sizeof(static_lines)/sizeof(static_lines[0]);
+  fnttext *static_texts[sizeof(static_lines)/sizeof(static_lines[0])];
+  fnttext *fps_text = fnt_text_new();
+  fnttext *gl_text = fnt_text_new();
+  fnttext *title_text = fnt_text_new();
+  fnttext *demo_text = fnt_text_new();
+  int line;
+
+  for(line = 0; line < n_static_lines; line++) {
+    static_texts[line] = fnt_text_new();
+    fnt_text_set(fnt, static_texts[line], static_lines[line].text,
+                 static_lines[line].x, static_lines[line].y,
+                 &sys->colors[static_lines[line].color]);
+  }
+  fnt_text_set(fnt, title_text, L"Thunder3D Engine",
+               (float)cam_3d->screen_w - 162.0, (float)cam_3d->screen_h - 42.0,
+               &sys->colors[CLR_CYAN]);
+  fnt_text_set(fnt, demo_text, L"Technology Demo",
+               (float)cam_3d->screen_w - 162.0, (float)cam_3d->screen_h - 62.0,
+               &sys->colors[CLR_RED]);
+
   while(!glfwWindowShouldClose(window)) {
     if(scn->batch_count == 3) {
       scn->batch_count = 0;
       /* draw scene */
-      glEnable(GL_DEPTH_TEST);
-      glEnable(GL_CULL_FACE);
-      scn_update_vbo_ibo(sys);
-      scn_light_pass(sys, lit0, glsl);
-      scn_camera_pass(sys, cam_3d, lit0, glsl);
+      ogl_enable(GL_DEPTH_TEST);
+      ogl_enable(GL_CULL_FACE);
+      ogl_stream_begin_frame();
+      ogl_state_begin_frame();
+      tex_stream_update(sys->texstm);
+      scn_update_vbo_ibo(scn);
+      scn_light_pass(scn, glsl);
+      scn_camera_pass(scn, glsl);
 
       /* draw GUI text */
-      glDisable(GL_CULL_FACE);
-      glDisable(GL_DEPTH_TEST);
-      glDepthMask(GL_FALSE);
-      glEnable(GL_BLEND);
-      glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      ogl_disable(GL_CULL_FACE);
+      ogl_disable(GL_DEPTH_TEST);
+      ogl_depth_mask(GL_FALSE);
+      ogl_enable(GL_BLEND);
+      ogl_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
       if(pickb->status == PICK_PICKING)
-        pick_draw_box2d(pickb, &pickb->v0, &pickb->v1, &sys->colors[CLR_GREEN], glsl);
+        pick_draw_box2d(pickb, &sys->colors[CLR_GREEN], ovl);
 
       pick_check_left_picked(pickb, sys->units, cam_3d);
-      pick_check_right_picked(pickb, sys->pchmap, sys->units, cam_3d);
+      pick_check_right_picked(pickb, sys->pchmap, sys->units, cam_3d, sys->pathsvc);
 
       /* system timer, should be placed in main thread */
       sys->time_passed = tmr_time_passed(&sys->timer);
       cam_3d->time = sys->time_passed;
       lit0->time = sys->time_passed;
 
+      fnt_update(fnt);
+
       wchar_t str[32];
       swprintf(str, 32, L"FPS: %.2f", 1000.0/sys->time_passed);  /* FPS */
-      fnt_print(fnt, str,
-                (float)cam_3d->screen_w - 162.0, (float)cam_3d->screen_h - 102.0,
-                &sys->colors[CLR_YELLOW], glsl);
-
-      fnt_print(fnt, L"Thunder3D Engine",
-                (float)cam_3d->screen_w - 162.0, (float)cam_3d->screen_h - 42.0,
-                &sys->colors[CLR_CYAN], glsl);
-      fnt_print(fnt, L"Technology Demo",
-                (float)cam_3d->screen_w - 162.0, (float)cam_3d->screen_h - 62.0,
-                &sys->colors[CLR_RED], glsl);
-
-      fnt_print(fnt, L"Cross System Support (Linux/Windows)", 30.0, 230.0, &sys->colors[CLR_GREEN], glsl);
-      fnt_print(fnt, L"OpenGL GLSL Rendering", 30.0, 250.0, &sys->colors[CLR_GREEN], glsl);
-      fnt_print(fnt, L"Task Based Multithread Support", 30.0, 270.0, &sys->colors[CLR_GREEN], glsl);
-      fnt_print(fnt, L"Scalable Shadowmapping", 30.0, 290.0, &sys->colors[CLR_GREEN], glsl);
-      fnt_print(fnt, L"Normalmaping", 30.0, 310.0, &sys->colors[CLR_GREEN], glsl);
-      fnt_print(fnt, L"Heightmap Based Patchmap", 30.0, 330.0, &sys->colors[CLR_GREEN], glsl);
-      fnt_print(fnt, L"Unicode Font support", 30.0, 350.0, &sys->colors[CLR_GREEN], glsl);
-      fnt_print(fnt, L"Raycast Picking", 30.0, 370.0, &sys->colors[CLR_GREEN], glsl);
-      fnt_print(fnt, L"Central Texture Management", 30.0, 390.0, &sys->colors[CLR_GREEN], glsl);
-      fnt_print(fnt, L"Central Model Management", 30.0, 410.0, &sys->colors[CLR_GREEN], glsl);
-      fnt_print(fnt, L"Skeletal Animation", 30.0, 430.0, &sys->colors[CLR_GREEN], glsl);
-      fnt_print(fnt, L"Simple Mesh Decal", 30.0, 450.0, &sys->colors[CLR_GREEN], glsl);
-      fnt_print(fnt, L"OpenAL 3D Sound Support", 30.0, 470.0, &sys->colors[CLR_GREEN], glsl);
-      fnt_print(fnt, L"Vorbis Format Support", 30.0, 490.0, &sys->colors[CLR_GREEN], glsl);
-
-      fnt_print(fnt, L"[ Zoom ] - Mouse wheel", 30.0, 520.0, &sys->colors[CLR_WHITE], glsl);
-      fnt_print(fnt, L"[ Move Around ] - Mouse to the borders, or A, D, W, S", 30.0, 540.0, &sys->colors[CLR_WHITE], glsl);
+      fnt_text_set(fnt, fps_text, str,
+                   (float)cam_3d->screen_w - 162.0, (float)cam_3d->screen_h - 102.0,
+                   &sys->colors[CLR_YELLOW]);
+      fnt_text_draw(fnt, fps_text, ovl);
+
+      /* GL state calls of the last frame, issued / skipped by the state cache */
+      unsigned int gl_issued, gl_skipped;
+      ogl_state_stats(&gl_issued, &gl_skipped);
+      swprintf(str, 32, L"GL: %u / %u", gl_issued, gl_skipped);
+      fnt_text_set(fnt, gl_text, str,
+                   (float)cam_3d->screen_w - 162.0, (float)cam_3d->screen_h - 122.0,
+                   &sys->colors[CLR_YELLOW]);
+      fnt_text_draw(fnt, gl_text, ovl);
+
+      fnt_text_draw(fnt, title_text, ovl);
+      fnt_text_draw(fnt, demo_text, ovl);
+      for(line = 0; line < n_static_lines; line++)
+        fnt_text_draw(fnt, static_texts[line], ovl);
 
       /* draw the minimap at lower-left corner */
-      minimap_draw(mmap, glsl);
+      minimap_draw(mmap, ovl);
+
+      /* all the 2d of the frame */
+      ovl_flush(ovl, glsl);
 
-      glDisable(GL_BLEND);
-      glDepthMask(GL_TRUE);
+      /* the runtime loads, the units swapped in are skinned by the next batch */
+      sys_update_loads(sys);
+      /* the paths found by the last batch, the units walk them from the next */
+      psv_update(sys->pathsvc);
+
+      ogl_disable(GL_BLEND);
+      ogl_depth_mask(GL_TRUE);
 
       /* display and process events through callbacks */
       glfwSwapBuffers(window);
@@ -258,12 +340,20 @@ main( int argc, char* argv[] )
   thpool_del(th_pool, THPOOL_GRACEFUL);
   cam_del(cam_3d);
   lit_del(lit0);
+  for(line = 0; line < n_static_lines; line++)
+    fnt_text_del(static_texts[line]);
+  fnt_text_del(fps_text);
+  fnt_text_del(gl_text);
+  fnt_text_del(title_text);
+  fnt_text_del(demo_text);
+  ovl_del(ovl);
   fnt_del(fnt);
   minimap_del(mmap);
   sys_del(sys);
   ctrl_del(ctrl);
   pick_del(pickb);
   shd_del(glsl);
+  ogl_stream_del();
 
   scn_del(scn);
 
@@ -276,6 +366,9 @@ main( int argc, char* argv[] )
   alcCloseDevice(device);
 
 
+  util_mount_pack(NULL);
+  pak_close(assets);
+
   glfwDestroyWindow(window);
   glfwTerminate();
   exit(EXIT_SUCCESS);
@@ -1,8 +0,0 @@
-#version 120
-
-uniform vec4 onecolor;
-
-void main()
-{
-  gl_FragColor = onecolor;
-}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 120
+
+attribute vec3 v_coord;
+
+attribute mat4 i_m;           /* per instance model matrix */
+
+uniform mat4 lvp;
+
+
+void main() {
+	gl_Position = lvp*i_m*vec4(v_coord, 1.0);
+}
@@ -0,0 +1,33 @@
+#version 120
+
+attribute vec3 v_coord;
+attribute vec3 v_normal;
+attribute vec3 v_tangent;
+attribute vec2 v_texcoord;
+
+attribute mat4 i_m;           /* per instance model matrix */
+
+uniform mat4 vp;
+
+uniform mat4 bias_lvp;
+
+varying vec4 shadowcoord_ws;  /* shadowmap coordinate - world space */
+
+varying vec4 pos_ws;          /* vertex coordinate - world space */
+varying vec2 texcoord;     /* texutre coordinate - always in object space */
+varying mat3 TBN_ws;          /* mapping from local surface coordinates to world coordinates */
+
+
+void main()
+{
+  pos_ws = i_m*vec4(v_coord, 1.0);
+
+  /* no non-uniform scaling in unit model matrices, the upper 3x3 is the normal matrix */
+  TBN_ws[0] = normalize(vec3(i_m*vec4(v_tangent, 0.0)));
+  TBN_ws[2] = normalize(vec3(i_m*vec4(v_normal, 0.0)));
+  TBN_ws[1] = normalize(cross(TBN_ws[2], TBN_ws[0]));
+
+  texcoord = v_texcoord;
+  shadowcoord_ws = bias_lvp*pos_ws;
+  gl_Position = vp*pos_ws;
+}
@@ -0,0 +1,18 @@
+#version 120
+
+uniform sampler2D diffmap;
+uniform int mode;         // 0 - color only, 1 - texture red is alpha (font), 2 - texture rgb
+
+varying vec2 texcoord;
+varying vec4 color;
+
+
+void main()
+{
+  if(mode == 1)
+    gl_FragColor = vec4(1.0, 1.0, 1.0, texture2D(diffmap, texcoord).r)*color;
+  else if(mode == 2)
+    gl_FragColor = vec4(texture2D(diffmap, texcoord).rgb, 1.0)*color;
+  else
+    gl_FragColor = color;
+}
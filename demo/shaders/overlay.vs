@@ -1,13 +1,16 @@
 #version 120
 
-attribute vec4 v_coord;   // attributes - minimap vertex + texture coordinates (vec2vec2)
+attribute vec4 v_coord;   // attributes - overlay vertex + texture coordinates (vec2vec2)
+attribute vec4 v_color;   // attributes - vertex color
 uniform mat4 mvp;
 
 varying vec2 texcoord;
+varying vec4 color;
 
 
 void main()
 {
   texcoord = v_coord.zw;
+  color = v_color;
   gl_Position = mvp*vec4(v_coord.xy, 0.0, 1.0);
-}
\ No newline at end of file
+}
@@ -6,6 +6,7 @@
 #ifndef _t3d_aamesh_h_
 #define _t3d_aamesh_h_
 
+#include <stddef.h>
 #include <t3d_type.h>
 
 
@@ -17,7 +18,7 @@ struct __aamesh {
 
   const GLuint *tex_id;
 
-  GLuint vbo_coord;        /* VBO - aamesh vertices */
+  GLintptr stm_coord;      /* stream offset - aamesh vertices */
 
   mat4 mat_model;          /* model matrix */
 };
@@ -25,7 +26,11 @@ struct __aamesh {
 
 /* create a decal target mesh in memory */
 aamesh *aamesh_new( const decal *d );
-/* delete a decal from memory */
+/* bytes of a decal target mesh with its vertices in one block */
+size_t aamesh_size( const decal *d );
+/* lay a decal target mesh out in a block of aamesh_size bytes */
+aamesh *aamesh_init( void *block, const decal *d );
+/* delete a decal from memory, one made by aamesh_new */
 void aamesh_del( aamesh *aamsh );
 /* set the axis aligned decal texture */
 void aamesh_set_tex( aamesh *aamsh, const hashtable *texdb );
@@ -41,8 +46,8 @@ void aamesh_tex_offset( aamesh *aamsh,
                         const float x,    /* unit's 2d postion x on patchmap */
                         const float y,    /* unit's 2d postion y on patchmap */
                         const float htmap_step );
-/* update vbo */
-void aamesh_update_vbo( const aamesh *aamsh );
+/* update vbo (stream the vertices), 0 if the stream is full */
+int aamesh_update_vbo( aamesh *aamsh );
 /* draw the aamesh */
 void aamesh_draw( aamesh *aamsh,
                   const decal *d,
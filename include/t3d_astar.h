@@ -15,21 +15,45 @@ enum {
 };
 
 
+/* the search state of a cell, valid only if gen is the search generation */
 struct __anode {
-  int x;
-	int y;
-
-  int f;
-  int g;
-  int h;
+  unsigned int gen;             /* search that last touched the cell */
+  int g;                        /* cost from the start */
+  int f;                        /* g + heuristic */
+  int father;                   /* cell index the path came from, -1 at the start */
+  int heap_pos;                 /* position in the open heap, -1 if not in it */
+};
 
-  struct __anode *next;
-  struct __anode *father;
+/* the memory of the searches, sized to the cells of a map and reused. a
+   context is used by one search at a time */
+struct __astarctx {
+  anode *nodes;                 /* by cell index */
+  int *heap;                    /* open cell indices, a binary heap on f, then g */
+  unsigned int *closed;         /* a bit per cell */
+  int n_cells;
+  int n_heap;
+
+  unsigned int gen;             /* current search, 0 is never used */
+  int n_expanded;               /* cells closed by the last search */
 };
 
 
-/* calculates a pathfind from start to end cells using A* algorithm */
+/* create a search context in memory */
+astarctx *astar_ctx_new( void );
+/* delete a search context from memory */
+void astar_ctx_del( astarctx *ctx );
+/* the search context of the calling thread, made on its first search */
+astarctx *astar_thread_ctx( void );
+/* calculates a pathfind from start to end cells with a given context */
+int astar_search_ctx( astarctx *ctx, ivec2 **path, const ivec2 *start, const ivec2 *end,
+                      const patchmap *pm );
+/* calculates a pathfind from start to end cells that stays in a rectangle of
+   cells (e.g. a patch), start and end must be in it */
+int astar_search_rect( astarctx *ctx, ivec2 **path, const ivec2 *start, const ivec2 *end,
+                       const patchmap *pm, const ivec2 *rect_min, const ivec2 *rect_max );
+/* calculates a pathfind from start to end cells using A* algorithm, with the
+   calling thread's context */
 int astar_search( ivec2 **path, const ivec2 *start, const ivec2 *end, const patchmap *pm );
 
 
-#endif   /* _t3d_astar_h_ */
\ No newline at end of file
+#endif   /* _t3d_astar_h_ */
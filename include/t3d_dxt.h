@@ -0,0 +1,38 @@
+/*----- t3d_dxt.h ------------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#ifndef _t3d_dxt_h_
+#define _t3d_dxt_h_
+
+
+/*---------------------------------------------------------------------------+
+  modes, or'ed:
+    DXT_QUALITY  - least squares color line fit (default)
+    DXT_SPEED    - bounding box fit, a few times faster, a little more error
+    DXT_NO_SIMD  - force the scalar path, the SIMD path gives the same bits
+ +---------------------------------------------------------------------------*/
+enum {
+  DXT_QUALITY = 0,
+  DXT_SPEED = 1,
+  DXT_NO_SIMD = 2
+};
+
+
+/* choose the endpoint fit and the code path, before any compression starts */
+void dxt_set_mode( const int mode );
+/* the current mode */
+int dxt_get_mode( void );
+/* compress an image, DXT1 (8 bytes per 4x4 block) for 1 or 3 channels,
+   DXT5 (16 bytes per block) for 2 or 4 channels */
+unsigned char *dxt_compress( const unsigned char *const uncompressed,
+                             const int width, const int height, const int channels,
+                             int *out_size );
+/* halve an image with a 2x2 box filter, a side of 1 stays 1 */
+void dxt_downsample( unsigned char *resampled,
+                     const unsigned char *const orig,
+                     const int width, const int height, const int channels );
+
+
+#endif   /* _t3d_dxt_h_ */
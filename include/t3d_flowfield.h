@@ -0,0 +1,95 @@
+/*----- t3d_flowfield.h ------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#ifndef _t3d_flowfield_h_
+#define _t3d_flowfield_h_
+
+#include <pthread.h>
+#include <t3d_type.h>
+
+
+/*---------------- flow field -------------------------------------------------+
+
+   the walk cost of every cell to a goal (the integration field), then the
+   neighbor each cell steps to (the direction field). any number of units
+   going to the goal look their next cell up.
+
+       +---+---+---+         the cells are split in tiles, the geopatches.
+       | R | B | R |         a tile is relaxed alone from the costs over its
+       +---+---+---+         border, the red tiles and the black tiles take
+       | B | R | B |         turns on the workers. the tiles of a color share
+       +---+---+---+         no border, the ones a lowered border reaches are
+                             relaxed in the next turn, until none is left.
+                             a worker takes a run of the tiles of a turn, a
+                             job a tile costs more than a small tile does.
+
+ +----------------------------------------------------------------------------*/
+
+#define FF_UNREACHED  0x7fffffff    /* the cost of the cells the goal can not be walked to from */
+
+/* a tile of cells, relaxed by one worker at a time */
+struct __fftile {
+  int x0, y0, x1, y1;           /* its cells, (x0, y0) - (x1, y1) */
+  int color;                    /* (x + y)%2 of its place in the tiles */
+  int dirty;                    /* a border cost it reads was lowered */
+  int sides;                    /* lowered by its last relax, marked dirty at the end of the run */
+
+  int *heap;                    /* (cost, cell) pairs, the stale ones are skipped */
+  int n_heap;
+  int heap_capacity;
+
+  flowfield *ff;
+};
+
+/* the tiles of a turn one worker relaxes or directs */
+struct __ffrun {
+  int first;                    /* in the turn */
+  int n;
+  flowfield *ff;
+};
+
+struct __flowfield {
+  int *costs;                   /* walk cost of each cell to the goal, or FF_UNREACHED */
+  signed char *dirs;            /* the neighbor each cell steps to, -1 at the goal or unreached */
+  int w_cells;
+  int h_cells;
+  ivec2 goal;
+
+  fftile *tiles;
+  int w_tiles;
+  int h_tiles;
+
+  int *turn;                    /* the tiles of the running turn */
+  ffrun *runs;                  /* the turn split for the workers */
+  int max_runs;                 /* a run a worker */
+  int color;                    /* of the tiles of the running turn */
+  int directing;                /* 1 once the costs are done, the directions are set */
+  int n_left;                   /* runs of the turn not done */
+  int n_turns;                  /* statistics */
+  int n_runs;
+  int ready;                    /* the units can follow it */
+  int refs;                     /* the units following it and the build not done */
+
+  const patchmap *pm;
+  thpool *pool;                 /* runs the tiles, NULL to build when created */
+
+  pthread_mutex_t lock;
+};
+
+
+/* create the flow field to a goal cell and start to build it on a thread pool (or NULL),
+   the caller holds a reference */
+flowfield *ff_new( const patchmap *pm, const ivec2 *goal, thpool *pool );
+/* take a reference to a flow field */
+flowfield *ff_ref( flowfield *ff );
+/* drop a reference, the last one deletes the flow field from memory */
+void ff_release( flowfield *ff );
+/* 1 once the flow field can be followed */
+int ff_ready( flowfield *ff );
+/* the cell to step to from a cell, return 0 at the goal, if it is unreached or not ready */
+int ff_step( flowfield *ff, ivec2 *next, const ivec2 *from );
+
+
+#endif   /* _t3d_flowfield_h_ */
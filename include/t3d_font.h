@@ -6,30 +6,58 @@
 #ifndef _t3d_font_h_
 #define _t3d_font_h_
 
+#include <pthread.h>
 #include <GL/glcorearb.h>
 #include <t3d_type.h>
 
 
-typedef struct __bakedchar bakedchar;
+typedef struct __glyph glyph;
+typedef struct __fntshelf fntshelf;
 
-/* structure to create a TTF font texture in video memory */
+/* glyph atlas of a TTF font in video memory, glyphs are rasterized on first
+   use, packed in shelves and the least recently used shelf is evicted when
+   the atlas is full */
 struct __font {
   char name[256];               /* internal name to use for the font */
 
-  bakedchar *cdata;             /* the TTF font character data, contains UVs and offsets */
-  float size;                   /* the font size used at creation time */
+  const unsigned char *ttf;     /* the TTF font file, a util_file_view */
+  void *info;                   /* stbtt_fontinfo of ttf */
+  float size;                   /* the font size (pixel height) */
+  float scale;                  /* TTF units to pixels */
 
   int tex_w;                    /* recommended to use a value that is a power of 2 */
   int tex_h;                    /* recommended to use a value that is a power of 2 */
+  GLuint tex_id;
 
-  int first_char;               /* the first character (in ASCII value) to use as the start character */
-  int count;                    /* how many ASCII should be generated from the first_char ASCII */
+  glyph *glyphs;                /* glyph slots */
+  int *free_glyphs;             /* stack of unused slots */
+  int n_free_glyphs;
+  unsigned short *lookup;       /* code point (BMP) -> glyph slot + 1, 0 if not in the atlas */
 
-  GLuint tex_id;
+  fntshelf *shelves;            /* atlas rows */
+  int n_shelves;
+  int shelf_bottom;             /* first atlas row not in a shelf */
+
+  unsigned int frame;           /* LRU clock, see fnt_update */
+  unsigned int generation;      /* changes when atlas coordinates change, see fnttext */
+
+  thpool *pool;                 /* if not NULL, new glyphs are rasterized on it */
+  pthread_mutex_t lock;         /* glyph states shared with the workers */
+  int n_rastered;               /* glyphs rasterized and waiting for upload */
+};
+
+/* a string kept as prebuilt overlay vertices, rebuilt only when it changes */
+struct __fnttext {
+  wchar_t *text;                /* the text the vertices were built for */
+  int text_capacity;
+  float x, y;
+  vec4 color;
 
-  GLuint vbo_coord;             /* VBO - font vertex coordinate + texture coordinate */
+  ovlvertex *vertices;          /* 6 per character (2 triangles) */
+  int n_vertices;
+  int vertices_capacity;
 
-  mat4 mat_proj;                /* projection (otho) matrix */
+  unsigned int generation;      /* font generation the vertices were built for */
 };
 
 
@@ -37,18 +65,29 @@ struct __font {
 font *fnt_new( const char *fontname,
                const float size,
                const int tex_w,
-               const int tex_h,
-               const int first_char,
-               const int count,
-               const int screen_w,
-               const int screen_h );
+               const int tex_h );
 /* delete font struct from memory */
 void fnt_del( font *f );
-/* print the text */
-void fnt_print( font *f, const wchar_t *text,
-                float x, float y,
-                const vec4 *color,
-                shader *glsl );
+/* rasterize new glyphs on the thread pool, NULL to rasterize them in place */
+void fnt_set_thpool( font *f, thpool *pool );
+/* once a frame before any text, upload the glyphs rasterized by the workers */
+void fnt_update( font *f );
+/* add the text to the overlay */
+void fnt_print( font *f, overlay *ovl,
+                const wchar_t *text,
+                const float x, const float y,
+                const vec4 *color );
+/* create a cached text in memory */
+fnttext *fnt_text_new( void );
+/* delete a cached text from memory */
+void fnt_text_del( fnttext *ft );
+/* set a cached text, its vertices are rebuilt only if anything changed */
+void fnt_text_set( font *f, fnttext *ft,
+                   const wchar_t *text,
+                   const float x, const float y,
+                   const vec4 *color );
+/* add a cached text to the overlay, rebuilt if its glyphs moved in the atlas */
+void fnt_text_draw( font *f, fnttext *ft, overlay *ovl );
 
 
 #endif  /* _t3d_font_h_ */
\ No newline at end of file
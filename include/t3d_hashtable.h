@@ -9,11 +9,29 @@
 #include <t3d_type.h>
 
 
+#define HASH_NONE  0         /* the handle of no key */
+
 struct __hashentry;
+struct __hashpage;
+
+/* a slot of the open addressing table, (0, 0) is empty */
+typedef struct __hashslot {
+  unsigned int hash;          /* hash of the key */
+  unsigned int handle;        /* entry of the key */
+} hashslot;
 
+/* Robin Hood hashing, the slots refer to the entries by handle. entries and
+   values never move, so the handles and the pointers hash_get returns stay
+   valid while the table grows */
 struct __hashtable {
-  unsigned int nchains;
-  struct __hashentry **chain;
+  hashslot *slots;
+  unsigned int mask;          /* slot count - 1, a power of 2 */
+
+  struct __hashentry *entries;  /* by handle - 1 */
+  unsigned int n_entries;
+  unsigned int entries_capacity;
+
+  struct __hashpage *pages;   /* keys and values */
 };
 
 
@@ -44,14 +62,24 @@ static inline unsigned int hash_string_fnv( const char *datum, unsigned int *len
   return z;
 }
 
-/* create a new hash table, and return a context for it */
-hashtable *hash_new( const unsigned int chains );
+/* create a new hash table for about n entries, and return a context for it */
+hashtable *hash_new( const unsigned int n );
 /* destroys a hash table, freeing all memory associated with it */
 void hash_del( hashtable *ht );
-/* adds a key/value pair to a hash table */
-int hash_add( hashtable *ht, const char *key, const void *value, const int v_len );
+/* adds a key/value pair to a hash table, return the key handle or HASH_NONE */
+unsigned int hash_add( hashtable *ht, const char *key, const void *value, const int v_len );
 /* looks up a the value associated with with a key from a specific hash table */
 const void  *hash_get( const hashtable *ht, const char *key );
+/* the handle of a key, HASH_NONE if it is not in the table */
+unsigned int hash_find( const hashtable *ht, const char *key );
+/* the handle of a key, the key is added with no value if it is new */
+unsigned int hash_intern( hashtable *ht, const char *key );
+/* the value of a handle, NULL if it has none */
+const void *hash_at( const hashtable *ht, const unsigned int handle );
+/* the key of a handle */
+const char *hash_key( const hashtable *ht, const unsigned int handle );
+/* number of keys, their handles are 1 to hash_count */
+unsigned int hash_count( const hashtable *ht );
 /* iterate through all available hash keys */
 const char *hash_iterate( const hashtable *ht, unsigned int *c1, unsigned int **c2 );
 
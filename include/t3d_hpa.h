@@ -0,0 +1,108 @@
+/*----- t3d_hpa.h -----------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +---------------------------------------------------------------------------*/
+
+#ifndef _t3d_hpa_h_
+#define _t3d_hpa_h_
+
+#include <t3d_type.h>
+
+
+/*---------------- hierarchical path finding (HPA*) --------------------------+
+
+   the cells are grouped by the geopatches of the patchmap. where the cells
+   on both sides of a patch border are walkable, a run of them is an
+   entrance, crossed at its middle cell (or at both ends if it is wide).
+
+       +-------+-------+         a portal is a cell of a patch with its
+       |       |       |         partner across the border. the portals of
+       |   A   o-o  B  |         a patch are linked by the walk costs
+       |       |       |         inside the patch.
+       +---o---+-------+
+           o                     a path is planned over the portals, then
+       |   C   |                 each leg is refined in its patch while the
+                                 unit walks it.
+
+ +---------------------------------------------------------------------------*/
+
+#define HPA_WIDE  6       /* an entrance this wide is crossed at both ends */
+
+/* a border crossing - a cell of the patch and the cell across the border */
+struct __hpaportal {
+  int cell;
+  int partner;
+};
+
+struct __hpapatch {
+  hpaportal *portals;
+  int n_portals;
+  int capacity;
+
+  int *costs;             /* n_portals x n_portals walk costs inside the patch, -1 if none */
+  int first;              /* id of the first portal in the abstract graph */
+  int dirty;              /* rebuilt before the next search */
+};
+
+/* the search state of a portal, valid only if gen is the search generation */
+struct __hpanode {
+  unsigned int gen;
+  int g;
+  int father;
+  int closed;
+};
+
+/* the abstract graph of a patchmap, one search at a time */
+struct __hpa {
+  hpapatch *pchs;
+  int w_pchs;
+  int h_pchs;
+  int w_pch_cells;        /* cells of a patch row, the last patch takes the rest */
+  int h_pch_cells;
+  int w_cells;
+  int h_cells;
+
+  int n_dirty;            /* patches to rebuild */
+  int n_portals;          /* portals of all patches */
+  int *owners;            /* patch of each portal id */
+
+  /* the abstract search, by portal id, then the start and the end */
+  hpanode *nodes;
+  int nodes_capacity;
+  unsigned int gen;
+  int *heap;              /* (f, id) pairs, the stale ones are skipped */
+  int n_heap;
+  int heap_capacity;
+
+  /* walk costs from a cell inside its patch */
+  int *bfs_costs;
+  int *bfs_queue;
+  int *start_costs;       /* start to the portals of its patch */
+  int *end_costs;         /* end to the portals of its patch */
+  int max_portals;
+  int n_expanded;         /* cells and portals expanded by the last search */
+};
+
+
+/* create the abstract graph of a patchmap in memory, built by the first hpa_update */
+hpa *hpa_new( const patchmap *pm );
+/* delete an abstract graph from memory */
+void hpa_del( hpa *g );
+/* the patch of a cell */
+int hpa_patch( const hpa *g, const int x, const int y );
+/* a cell status changed, its patch (and the one across the border) is rebuilt later */
+void hpa_cell_changed( hpa *g, const int x, const int y );
+/* set the status of a cell and mark its patches */
+void hpa_set_status( hpa *g, patchmap *pm, const int x, const int y, const int status );
+/* rebuild the patches marked since the last update */
+void hpa_update( hpa *g, const patchmap *pm );
+/* plan a path over the portals, the waypoints go from start to end and each
+   leg stays in a patch or crosses one border. return the waypoints, 0 if there is no path */
+int hpa_search( hpa *g, ivec2 **waypoints, const ivec2 *start, const ivec2 *end,
+                const patchmap *pm );
+/* the cells of a leg between 2 waypoints, start and end included, 0 if it is blocked.
+   it searches with the calling thread's context, legs can be refined on any thread */
+int hpa_refine( hpa *g, ivec2 **path, const ivec2 *from, const ivec2 *to, const patchmap *pm );
+
+
+#endif   /* _t3d_hpa_h_ */
@@ -0,0 +1,35 @@
+/*----- t3d_hsr.h ------------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#ifndef _t3d_hsr_h_
+#define _t3d_hsr_h_
+
+#include <t3d_type.h>
+
+
+/* number of 32 bits mask words needed for n_faces triangles */
+#define HSR_MASK_WORDS(n_faces)  (((n_faces) + 31) >> 5)
+
+
+/* compute the plane of every indexed triangle and classify it against the
+   camera and light points (object space) in one pass.
+   bit j of cam_mask/lit_mask is set when triangle j classifies as cam_flag/lit_flag
+   (PLANE_FRONT or PLANE_BACK, see gmth_plane_classify_point) */
+void hsr_classify_faces( vec4 *faces,
+                         unsigned int *cam_mask,
+                         unsigned int *lit_mask,
+                         const vec3 *vcoords,
+                         const unsigned short *indices,
+                         const int n_faces,
+                         const vec3 *cam, const int cam_flag,
+                         const vec3 *lit, const int lit_flag );
+/* copy the 3 indices of every triangle whose mask bit is set, return the index count */
+int hsr_compact( unsigned short *o_indices,
+                 const unsigned int *mask,
+                 const unsigned short *indices,
+                 const int n_faces );
+
+
+#endif  /* _t3d_hsr_h_ */
@@ -0,0 +1,76 @@
+/*----- t3d_loader.h ---------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#ifndef _t3d_loader_h_
+#define _t3d_loader_h_
+
+#include <pthread.h>
+#include <GL/glcorearb.h>
+#include <t3d_type.h>
+
+
+#define LDR_BUDGET  2.0     /* milliseconds of GL uploads a frame */
+
+enum {
+  LDR_TEXTURE = 0,
+  LDR_MODEL = 1
+};
+
+/* called on the GL thread once a job is uploaded, or failed */
+typedef void (*ldr_callback)( ldrjob *job );
+
+/* an asset on its way, decoded by a worker and uploaded on the GL thread */
+struct __ldrjob {
+  int type;
+  char path[256];
+
+  int s3tc_compressed;          /* texture: compress to DXT */
+  GLuint tex_id;                /* texture: shows the placeholder until uploaded */
+  teximage *img;                /* texture: decoded by the worker */
+
+  ms3d *model;                  /* model: loaded by the worker, NULL if it failed.
+                                   uploaded before ready, which takes it */
+
+  ldr_callback ready;           /* or NULL */
+  void *data;                   /* for ready */
+  int key;                      /* for ready (e.g. a model id) */
+
+  int done;                     /* set by the worker */
+  loader *ldr;
+};
+
+/* runtime loads, nothing waits for them */
+struct __loader {
+  ldrjob **jobs;                /* in request order */
+  int n_jobs;
+  int capacity;
+
+  int n_working;                /* jobs not finished by the workers */
+  float budget;                 /* milliseconds of uploads a frame, at least one is done */
+
+  thpool *pool;                 /* decodes the jobs, NULL to decode when asked */
+  texstream *texstm;            /* streams the textures, or NULL */
+
+  pthread_mutex_t lock;         /* the job states shared with the workers */
+  pthread_cond_t notify;
+};
+
+
+/* create a loader in memory */
+loader *ldr_new( texstream *texstm );
+/* delete a loader from memory, waits for the jobs the workers hold */
+void ldr_del( loader *ldr );
+/* decode the jobs on a thread pool */
+void ldr_set_thpool( loader *ldr, thpool *pool );
+/* a texture showing the rgba placeholder until the image is loaded */
+GLuint ldr_texture( loader *ldr, const char *path, const int s3tc_compressed, const unsigned char *rgba );
+/* load a model, ready gets it on the GL thread */
+void ldr_model( loader *ldr, const char *path, ldr_callback ready, void *data, const int key );
+/* once a frame on the GL thread - upload what the workers finished within the budget,
+   return the jobs still pending */
+int ldr_update( loader *ldr );
+
+
+#endif   /* _t3d_loader_h_ */
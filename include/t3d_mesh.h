@@ -6,6 +6,8 @@
 #ifndef _t3d_mesh_h_
 #define _t3d_mesh_h_
 
+#include <stddef.h>
+#include <GL/glcorearb.h>
 #include <t3d_type.h>
 
 
@@ -14,8 +16,12 @@ struct __mesh {
   vec3 *normals;                       /* vertex normals */
   vec3 *tangents;                      /* vertex tangents */
   vec4 *faces;                         /* triangle planes */
-  unsigned short *hsr_cam_v_indices;   /* visible vertex indices to camera */
-  unsigned short *hsr_lit_v_indices;   /* visible vertex indices to light */
+  unsigned short *hsr_cam_v_indices;   /* visible (welded) vertex indices to camera */
+  unsigned short *hsr_lit_v_indices;   /* visible (welded) vertex indices to light */
+  unsigned int *hsr_cam_mask;          /* per face visibility bits to camera */
+  unsigned int *hsr_lit_mask;          /* per face visibility bits to light */
+  unsigned int *skin_stamps;           /* per vertex, == skin_stamp when skinned this update */
+  unsigned int skin_stamp;             /* current fused update stamp */
 
   int cam_hsr_count;                   /* runtime count for cam hsr */
   int lit_hsr_count;                   /* runtime count for light hsr */
@@ -24,11 +30,12 @@ struct __mesh {
   /* vertex coordinates, normals, tangents have the same data size*/
   int v_data_size;                     /* num_vertices*sizeof(vec3) */
 
-  unsigned int vbo_coords;             /* mesh specific - VBO vertex coordinates */
-  unsigned int vbo_normals;            /* mesh specific - VBO vertex normals */
-  unsigned int vbo_tangents;           /* mesh specific - VBO vertex tangents */
-  unsigned int ibo_hsr_cam_elements;   /* mesh specific - IBO hsr camera element index */
-  unsigned int ibo_hsr_lit_elements;   /* mesh specific - IBO hsr light element index */
+  /* offsets into the stream buffer (ogl_stream_buffer), valid for this frame */
+  GLintptr stm_coords;                 /* vertex coordinates */
+  GLintptr stm_normals;                /* vertex normals */
+  GLintptr stm_tangents;               /* vertex tangents */
+  GLintptr stm_hsr_cam_elements;       /* hsr camera element index */
+  GLintptr stm_hsr_lit_elements;       /* hsr light element index */
 
   const unsigned int *tex_diffuse;
   const unsigned int *tex_normalmap;
@@ -36,9 +43,13 @@ struct __mesh {
 };
 
 
+/* bytes of a mesh with its arrays in one block */
+size_t mesh_size( const int n_vertices, const int n_faces );
+/* lay a mesh out in a block of mesh_size bytes, the arrays follow the struct */
+mesh *mesh_init( void *block, const int n_vertices, const int n_faces );
 /* create a mesh struct in memory */
-mesh *mesh_new( const int n_vertices );
-/* delete a mesh struct form memory */
+mesh *mesh_new( const int n_vertices, const int n_faces );
+/* delete a mesh struct form memory, one made by mesh_new */
 void mesh_del( mesh *msh );
 
 
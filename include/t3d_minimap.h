@@ -12,21 +12,15 @@
 
 struct __minimap {
   const GLuint *tex_id;
-
-  GLuint vbo_coord;        /* VBO - vertex coordinate + texture coordinate */
-  mat4 mat_proj;           /* projection (otho) matrix */
 };
 
 
 /* create minimap struct in memory */
-minimap *minimap_new( const char *mapname,
-                      const int screen_w,
-                      const int screen_h,
-                      const hashtable *texdb );
+minimap *minimap_new( const char *mapname, const hashtable *texdb );
 /* delete minimap struct from memory */
 void minimap_del( minimap *mm );
-/* draw the minimap */
-void minimap_draw( minimap *mm, shader *glsl );
+/* add the minimap to the overlay */
+void minimap_draw( const minimap *mm, overlay *ovl );
 
 
 
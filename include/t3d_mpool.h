@@ -0,0 +1,44 @@
+/*----- t3d_mpool.h ----------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#ifndef _t3d_mpool_h_
+#define _t3d_mpool_h_
+
+#include <stddef.h>
+#include <t3d_type.h>
+
+
+#define MPOOL_ALIGN  16     /* every object starts on it (e.g. mat4 for SSE) */
+
+/* objects of one size, carved from slabs and kept on a free list. a slab is
+   only given back when the pool is deleted. not thread safe, one thread
+   allocates and frees */
+struct __mpool {
+  size_t obj_size;              /* rounded up to MPOOL_ALIGN */
+  int objs_per_slab;
+
+  void *free_list;              /* the next free object is in its first bytes */
+  struct __mpslab *slabs;
+
+  int n_used;                   /* objects allocated and not freed */
+};
+
+
+/* create a pool of obj_size objects in memory */
+mpool *mpool_new( const size_t obj_size, const int objs_per_slab );
+/* delete a pool and all of its objects from memory */
+void mpool_del( mpool *mp );
+/* an object of the pool, not cleared */
+void *mpool_alloc( mpool *mp );
+/* give an object back to its pool */
+void mpool_free( mpool *mp, void *obj );
+/* round a size up to MPOOL_ALIGN, to lay out several arrays in one object */
+static inline size_t mpool_align( const size_t size )
+{
+  return (size + MPOOL_ALIGN - 1) & ~(size_t)(MPOOL_ALIGN - 1);
+}
+
+
+#endif   /* _t3d_mpool_h_ */
@@ -41,6 +41,17 @@ struct __ms3d {
   float radius;                 /* AABBox diagonal length */
 
   decal *o_aamsh;               /* the mesh that the model is sitting on */
+
+  /* the skin variants packed into GL_TEXTURE_2D_ARRAYs, a unit picks a layer */
+  unsigned int *skin_arrays;    /* diffuse, normalmap, specular array of each mesh, or NULL */
+  int skin_stride;              /* materials of one skin variant */
+  int n_skin_layers;            /* skin variants */
+
+  /* a cooked model (.t3dm) keeps its arrays, skins and commands in the file */
+  const void *mapping;          /* the cooked file, NULL if the model was parsed */
+  size_t mapping_size;          /* 0 if the file is borrowed (e.g. from the asset pack) */
+
+  mpool *unit_pool;             /* the per unit blocks of the model's units, or NULL */
 };
 
 struct __ms3dcmd {
@@ -60,13 +71,35 @@ struct __ms3danim {              /* <---- Used by unit */
 };
 
 
+/* parse a ms3d file in memory, no GL work (e.g. in the cook tool) */
+ms3d *ms3d_parse( const unsigned char *buf );
+/* store texture coordinates and triangle indices in graphic card buffers, main thread only */
+void ms3d_upload( ms3d *m );
 /* load static ms3d model vertices */
 ms3d *ms3d_new( const unsigned char *buf, const hashtable *texdb );
+/* write a parsed model with its commands to <file>.t3dm, return 0 on failure */
+int ms3d_cook( const ms3d *m, const char *file );
+/* load <file>.t3dm in place with no GL work, NULL if there is none or its sources changed */
+ms3d *ms3d_cooked_load( const char *file );
+/* load <file>.t3dm in place, NULL if there is none or it is older than the ms3d file */
+ms3d *ms3d_cooked_new( const char *file );
+/* 1 if <file>.t3dm holds the model and commands as they are now */
+int ms3d_cooked_is_current( const char *file );
+/* load a model with its commands, cooked or parsed, no GL work (e.g. on a worker) */
+ms3d *ms3d_load( const char *file );
+/* a box in place of a model still loading, one mesh with the 3 given skins
+   (diffuse, normalmap, specular), no joints and a single 'N' command */
+ms3d *ms3d_proxy_new( const vec3 *aabb_min, const vec3 *aabb_max,
+                      const char *diffuse, const char *normalmap, const char *specular );
 /* delete ms3d from memory */
 void ms3d_del( ms3d *m );
 /* create the ms3d animation struct in memory */
 ms3danim *ms3d_anim_new( const ms3d *model );
-/* delete the ms3d animationf struct from memory */
+/* bytes of an animation struct with its key cursors in one block */
+size_t ms3d_anim_size( const ms3d *model );
+/* lay an animation struct out in a block of ms3d_anim_size bytes */
+ms3danim *ms3d_anim_init( void *block, const ms3d *model );
+/* delete the ms3d animationf struct from memory, one made by ms3d_anim_new */
 void ms3d_anim_del( ms3danim *ani );
 /* restart the animation */
 void ms3d_reset_anim( ms3danim *ani, const unsigned short n_joints );
@@ -15,17 +15,21 @@ struct __ms3dmesh {
   vec3 *o_tangents;              /* original vertex tangents */
   vec2 *o_texcoords;             /* original texture coordinates */
   short *o_jnt_indices;          /* original joint indices */
+  unsigned short *o_indices;     /* welded vertex indices, 3 per triangle */
 
-  int n_vertices;
+  int n_vertices;                /* number of unique (welded) vertices */
+  int n_faces;                   /* number of triangles */
 
   unsigned int vbo_o_texcoords;  /* mesh specific - VBO vertex texture coordinates */
+  unsigned int ibo_o_elements;   /* mesh specific - IBO all triangles, for instanced draws */
 
   char material_index;           /* switch among the materials in ms3d model */
+  char mapped;                   /* the arrays point into a cooked model file */
 };
 
 
 /* create a ms3dmesh struct in memory */
-ms3dmesh *ms3dmesh_new( const int n_vertices );
+ms3dmesh *ms3dmesh_new( const int n_vertices, const int n_faces );
 /* delete a ms3dmesh struct form memory */
 void ms3dmesh_del( ms3dmesh *o_msh );
 
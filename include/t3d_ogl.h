@@ -32,6 +32,8 @@ PFNGLCOMPRESSEDTEXIMAGE2DPROC glCompressedTexImage2D;
 PFNGLDELETETEXTURESPROC       glDeleteTextures;
 PFNGLGENTEXTURESPROC          glGenTextures;
 PFNGLTEXIMAGE2DPROC           glTexImage2D;
+PFNGLTEXSUBIMAGE2DPROC        glTexSubImage2D;
+PFNGLPIXELSTOREIPROC          glPixelStorei;
 PFNGLTEXPARAMETERFPROC        glTexParameterf;
 PFNGLTEXPARAMETERIPROC        glTexParameteri;
 /* VAO, VBO functions */
@@ -39,12 +41,14 @@ PFNGLDISABLEVERTEXATTRIBARRAYPROC glDisableVertexAttribArray;
 PFNGLENABLEVERTEXATTRIBARRAYPROC  glEnableVertexAttribArray;
 PFNGLBINDBUFFERPROC               glBindBuffer;
 PFNGLBUFFERDATAPROC               glBufferData;
+PFNGLBUFFERSUBDATAPROC            glBufferSubData;
 PFNGLDELETEBUFFERSPROC            glDeleteBuffers;
 PFNGLGENBUFFERSPROC               glGenBuffers;
 PFNGLGETBUFFERPARAMETERIVPROC     glGetBufferParameteriv;
 PFNGLMAPBUFFERPROC                glMapBuffer;
 PFNGLUNMAPBUFFERPROC              glUnmapBuffer;
 PFNGLVERTEXATTRIBPOINTERPROC      glVertexAttribPointer;
+PFNGLVERTEXATTRIB1FPROC           glVertexAttrib1f;
 /* GLSL */
 /* program functions */
 PFNGLCREATEPROGRAMPROC     glCreateProgram;
@@ -83,10 +87,91 @@ PFNGLDRAWBUFFERPROC glDrawBuffer;
 PFNGLGENFRAMEBUFFERSPROC glGenFramebuffers;
 PFNGLFRAMEBUFFERTEXTURE2DPROC glFramebufferTexture2D;
 PFNGLREADBUFFERPROC glReadBuffer;
+/* optional - GL 3.0/3.2 or ARB_map_buffer_range/ARB_sync, NULL if not supported */
+PFNGLMAPBUFFERRANGEPROC  glMapBufferRange;
+PFNGLFENCESYNCPROC       glFenceSync;
+PFNGLCLIENTWAITSYNCPROC  glClientWaitSync;
+PFNGLDELETESYNCPROC      glDeleteSync;
+/* optional - GL 3.1/3.3 or ARB_draw_instanced/ARB_instanced_arrays, NULL if not supported */
+PFNGLDRAWELEMENTSINSTANCEDPROC  glDrawElementsInstanced;
+PFNGLVERTEXATTRIBDIVISORPROC    glVertexAttribDivisor;
+/* optional - GL 3.0 or EXT_texture_array, NULL if not supported */
+PFNGLTEXIMAGE3DPROC              glTexImage3D;
+PFNGLTEXSUBIMAGE3DPROC           glTexSubImage3D;
+PFNGLCOMPRESSEDTEXIMAGE3DPROC    glCompressedTexImage3D;
+PFNGLCOMPRESSEDTEXSUBIMAGE3DPROC glCompressedTexSubImage3D;
+
+
+/* the stream ring buffer is split into this many frame regions */
+#define OGL_STREAM_FRAMES 3
+
+/* texture units and vertex attributes shadowed by the state cache */
+#define OGL_MAX_TEX_UNITS 8
+#define OGL_MAX_ATTRIBS   16
+/* attribute bit for ogl_attrib_arrays */
+#define OGL_ATTRIB(index) (1u << (index))
 
 
 /* resolve the opengl functions */
 GLboolean ogl_init( void );
+/* 1 if instanced drawing (glDrawElementsInstanced + glVertexAttribDivisor) is supported */
+int ogl_has_instancing( void );
+/* 1 if GL_TEXTURE_2D_ARRAY textures (glTexImage3D and friends) are supported */
+int ogl_has_texture_arrays( void );
+
+/* create the stream (transient upload) ring buffer, frame_size bytes per frame */
+void ogl_stream_init( const GLsizeiptr frame_size );
+/* delete the stream ring buffer */
+void ogl_stream_del( void );
+/* move to the next frame region, waits only if the GPU still reads from it */
+void ogl_stream_begin_frame( void );
+/* reserve size bytes of this frame, return where to write them (NULL if the
+   frame region is full) and the offset to draw from */
+void *ogl_stream_map( const GLsizeiptr size, GLintptr *offset );
+/* finish the write started by ogl_stream_map */
+void ogl_stream_unmap( void );
+/* copy data to the stream, return the offset to draw from, -1 if the frame region is full */
+GLintptr ogl_stream_upload( const void *data, const GLsizeiptr size );
+/* the stream buffer object, bind it as array or element buffer with the offsets */
+GLuint ogl_stream_buffer( void );
+
+/* state cache - the calls below shadow the GL state and skip the ones that
+   would not change it, all engine code must go through them */
+/* forget the shadowed state, the next calls are issued unconditionally */
+void ogl_state_reset( void );
+/* start counting the calls of a new frame */
+void ogl_state_begin_frame( void );
+/* calls issued and skipped during the last finished frame */
+void ogl_state_stats( unsigned int *issued, unsigned int *skipped );
+/* glUseProgram */
+void ogl_use_program( const GLuint program );
+/* glDeleteProgram */
+void ogl_delete_program( const GLuint program );
+/* glBindBuffer, array and element array buffers are shadowed */
+void ogl_bind_buffer( const GLenum target, const GLuint buffer );
+/* glDeleteBuffers */
+void ogl_delete_buffers( const GLsizei n, const GLuint *buffers );
+/* glActiveTexture + glBindTexture(GL_TEXTURE_2D) */
+void ogl_bind_texture( const GLuint unit, const GLuint tex );
+/* glActiveTexture + glBindTexture, e.g. GL_TEXTURE_2D_ARRAY, texture names are
+   never shared between targets so one cache entry per unit is enough */
+void ogl_bind_texture_target( const GLuint unit, const GLenum target, const GLuint tex );
+/* bind a texture on unit 0 and make unit 0 active, for the calls that upload
+   to or set up the bound texture. a cached bind leaves another unit active */
+void ogl_bind_texture_for_upload( const GLenum target, const GLuint tex );
+/* glDeleteTextures */
+void ogl_delete_textures( const GLsizei n, const GLuint *textures );
+/* enable exactly the vertex attribute arrays in mask (OGL_ATTRIB bits) */
+void ogl_attrib_arrays( const unsigned int mask );
+/* glEnable/glDisable, GL_BLEND, GL_DEPTH_TEST and GL_CULL_FACE are shadowed */
+void ogl_enable( const GLenum cap );
+void ogl_disable( const GLenum cap );
+/* glBlendFunc */
+void ogl_blend_func( const GLenum sfactor, const GLenum dfactor );
+/* glDepthMask */
+void ogl_depth_mask( const GLboolean flag );
+/* glCullFace */
+void ogl_cull_face( const GLenum mode );
 
 
 #endif	/* _t3d_ogl_h_ */
\ No newline at end of file
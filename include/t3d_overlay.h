@@ -0,0 +1,69 @@
+/*----- t3d_overlay.h --------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#ifndef _t3d_overlay_h_
+#define _t3d_overlay_h_
+
+#include <GL/glcorearb.h>
+#include <t3d_type.h>
+
+
+/* how a batch uses its texture, the "mode" uniform of the overlay shader */
+enum {
+  OVL_SOLID = 0,                /* color only, no texture */
+  OVL_ALPHA = 1,                /* texture red channel is the alpha (font) */
+  OVL_TEXTURE = 2               /* texture rgb, color alpha */
+};
+
+
+/* one overlay vertex, in screen pixels from the bottom-left corner */
+struct __ovlvertex {
+  float x, y;
+  float s, t;
+  GLubyte color[4];
+};
+
+/* consecutive vertices drawn with the same texture and mode */
+struct __ovlbatch {
+  GLuint tex_id;
+  int mode;
+  int first;
+  int count;
+};
+
+/* all the 2d quads (text, pickbox, minimap ...) of a frame, drawn in the
+   order they were added with one draw per texture/mode change */
+struct __overlay {
+  ovlvertex *vertices;
+  int n_vertices;
+  int vertices_capacity;
+
+  ovlbatch *batches;
+  int n_batches;
+  int batches_capacity;
+
+  mat4 mat_proj;                /* projection (otho) matrix */
+};
+
+
+/* create an overlay in memory */
+overlay *ovl_new( const int screen_w, const int screen_h );
+/* delete an overlay from memory */
+void ovl_del( overlay *ovl );
+/* pack a color into vertex bytes */
+void ovl_color( GLubyte *o, const vec4 *color );
+/* reserve n vertices (triangles) with a texture and a mode, return where to write them */
+ovlvertex *ovl_add( overlay *ovl, const int n, const GLuint tex_id, const int mode );
+/* add a rectangle */
+void ovl_quad( overlay *ovl,
+               const float x0, const float y0, const float x1, const float y1,
+               const float s0, const float t0, const float s1, const float t1,
+               const GLuint tex_id, const int mode,
+               const vec4 *color );
+/* draw everything added since the last flush */
+void ovl_flush( overlay *ovl, shader *glsl );
+
+
+#endif   /* _t3d_overlay_h_ */
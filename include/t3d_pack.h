@@ -0,0 +1,59 @@
+/*----- t3d_pack.h -----------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#ifndef _t3d_pack_h_
+#define _t3d_pack_h_
+
+#include <stddef.h>
+#include <t3d_type.h>
+
+
+#define PAK_VERSION  1
+#define PAK_ALIGN    64       /* blob alignment, a cache line */
+
+
+/* on disk: the header, the index sorted by name hash, the name table,
+   then the blobs, each followed by a 0 byte so text can be used in place */
+struct __pakheader {
+  char magic[4];              /* "T3DP" */
+  unsigned int version;
+  unsigned int n_entries;
+  unsigned int names_size;    /* bytes of the name table */
+};
+
+struct __pakentry {
+  unsigned long long hash;    /* pak_hash of the name */
+  unsigned long long offset;  /* of the blob in the pack, PAK_ALIGN aligned */
+  unsigned long long size;    /* bytes of the blob, without the 0 byte */
+  unsigned int name;          /* offset of the name in the name table */
+  unsigned int pad;
+};
+
+/* a mapped asset pack */
+struct __pak {
+  const unsigned char *data;
+  size_t size;
+
+  const pakheader *header;
+  const pakentry *entries;
+  const char *names;
+};
+
+
+/* map an asset pack, NULL if it can not be opened or is not valid */
+pak *pak_open( const char *file );
+/* unmap an asset pack, the views into it become invalid */
+void pak_close( pak *p );
+/* the entry name of a path, '/' separated without a leading "./" */
+void pak_name( char *name, const size_t name_sz, const char *path );
+/* hash of an entry name */
+unsigned long long pak_hash( const char *name );
+/* zero-copy view of a packed file, NULL if the pack does not have it */
+const void *pak_find( const pak *p, const char *path, size_t *size );
+/* 1 if data points into the pack */
+int pak_contains( const pak *p, const void *data );
+
+
+#endif   /* _t3d_pack_h_ */
@@ -126,6 +126,8 @@ void pchmap_del( patchmap *pm );
 void pchmap_update_visi( patchmap *pm, const camera *cam, const light *lit );*/
 /* draw the patchmap with normalmap */
 void pchmap_normalmap_draw( const patchmap *pm, const light *lit, const shader *glsl );
+/* draw patch i with normalmap, its textures must be bound */
+void pchmap_patch_normalmap_draw( const patchmap *pm, const int i, const shader *glsl );
 /* draw the patchmap with one vertex coordinates */
 void pchmap_vertex_draw( const patchmap *pm, const shader *glsl );
 
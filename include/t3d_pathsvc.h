@@ -0,0 +1,100 @@
+/*----- t3d_pathsvc.h --------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#ifndef _t3d_pathsvc_h_
+#define _t3d_pathsvc_h_
+
+#include <pthread.h>
+#include <t3d_type.h>
+
+
+#define PSV_BUDGET      1.0     /* milliseconds of searches a frame, 0 for no limit */
+#define PSV_EXPANSIONS  0       /* cells and portals expanded a frame, 0 for no limit */
+#define PSV_CACHE_SIZE  32      /* (region, goal) results kept */
+#define PSV_FLOW_UNITS  2       /* units ordered to a goal together share a flow field */
+
+/* the higher is searched first, the older first at a tie */
+enum {
+  PSV_LOW = 0,
+  PSV_NORMAL = 1,
+  PSV_HIGH = 2
+};
+
+
+/* a path wanted by a unit */
+struct __psvreq {
+  unit *u;
+  unsigned int ticket;          /* the unit only takes the result of its last request */
+  ivec2 start;
+  ivec2 goal;
+  int priority;
+
+  ivec2 *waypoints;             /* the result, NULL if there is no path */
+  int n_waypoints;
+  ivec2 *path;                  /* the cells of the first leg */
+  int n_steps;
+};
+
+/* a path found from a region (the patch of the start) to a goal cell */
+struct __psventry {
+  int region;
+  int goal;
+  ivec2 *waypoints;
+  int n_waypoints;
+  unsigned int last_used;       /* 0 if the entry is free */
+};
+
+/* path requests, searched by a worker within a budget a frame */
+struct __pathsvc {
+  psvreq *queue;                /* the requests not searched yet */
+  int n_queue;
+  int queue_capacity;
+
+  psvreq *results;              /* searched, not delivered yet */
+  int n_results;
+  int results_capacity;
+
+  psventry cache[PSV_CACHE_SIZE];
+  unsigned int cache_clock;
+  int n_hits;                   /* statistics */
+  int n_misses;
+
+  float budget;                 /* milliseconds of searches a frame, at least one is done */
+  int max_expanded;             /* cells and portals expanded a frame, 0 for no limit */
+
+  unsigned int ticket;
+  int searching;                /* a batch is on a worker */
+
+  flowfield *flow;              /* of the last group order, the next one to its goal shares it */
+
+  hpa *g;
+  patchmap *pm;
+  thpool *pool;                 /* runs the batches, NULL to search when updated */
+
+  pthread_mutex_t lock;         /* the queue and the results, shared with the worker */
+  pthread_mutex_t graph_lock;   /* the graph and the cache, held by the searches */
+  pthread_cond_t notify;
+};
+
+
+/* create a path service over the abstract graph of a patchmap in memory */
+pathsvc *psv_new( hpa *g, patchmap *pm );
+/* delete a path service from memory, waits for the batch a worker holds */
+void psv_del( pathsvc *svc );
+/* search on a thread pool */
+void psv_set_thpool( pathsvc *svc, thpool *pool );
+/* post a path request of a unit, it replaces the one still queued */
+void psv_request( pathsvc *svc, unit *u, const ivec2 *start, const ivec2 *goal, const int priority );
+/* the flow field to a goal, built on the thread pool if the last one went elsewhere.
+   the caller holds a reference */
+flowfield *psv_flow( pathsvc *svc, const ivec2 *goal );
+/* set the status of a cell, the graph, the cache and the flow field follow */
+void psv_set_status( pathsvc *svc, const int x, const int y, const int status );
+/* once a frame on the GL thread, not while the units update - deliver the
+   paths found and start the next batch, return the requests still pending */
+int psv_update( pathsvc *svc );
+
+
+#endif   /* _t3d_pathsvc_h_ */
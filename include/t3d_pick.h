@@ -31,14 +31,11 @@ struct __pickbox {
 
   int status;                /* is picking is progress? picked? */
   int type;                  /* single pick or multi pick */
-
-  GLuint vbo_coord;          /* VBO - font vertex coordinate */
-  mat4 mat_proj;             /* projection (otho) matrix */
 };
 
 
 /* create a pickbox in memory */
-pickbox *pick_new( const int screen_w, const int screen_h );
+pickbox *pick_new( void );
 /* delelte pickbox from memory */
 void pick_del( pickbox *pb );
 /* calculate the ray direction vector */
@@ -58,12 +55,10 @@ int pick_is_ray_x_obb( float *x_dist,           /* distance between ray_start an
 /* check picked status */
 void pick_check_left_picked( pickbox *pb, const list *units, const camera *cam );
 /* check right picked */
-void pick_check_right_picked( pickbox *pb, const patchmap *pm, const list *units, const camera *cam );
-/* draw the pickbox */
-void pick_draw_box2d( const pickbox *pb,
-                      const vec2 *v0, const vec2 *v1,
-                      const vec4 *color,
-                      shader *glsl );
+void pick_check_right_picked( pickbox *pb, const patchmap *pm, const list *units, const camera *cam,
+                              pathsvc *svc );
+/* add the pickbox frame to the overlay */
+void pick_draw_box2d( const pickbox *pb, const vec4 *color, overlay *ovl );
 
 
 #endif   /* _t3d_pick_h_ */
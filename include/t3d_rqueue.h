@@ -0,0 +1,68 @@
+/*----- t3d_rqueue.h ---------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#ifndef _t3d_rqueue_h_
+#define _t3d_rqueue_h_
+
+#include <GL/glcorearb.h>
+#include <t3d_type.h>
+
+
+/*---------------------------------------------------------------------------+
+  64 bits sort key, most significant field first:
+    pass     4 bits  - opaque before blended ...
+    program  4 bits  - glsl program of the draw
+    texset  24 bits  - texture set (diffuse, normalmap, specular)
+    depth   32 bits  - camera distance, front to back
+ +---------------------------------------------------------------------------*/
+#define RQ_KEY_PASS(key)     ((unsigned int)((key) >> 60) & 0xf)
+#define RQ_KEY_PROGRAM(key)  ((unsigned int)((key) >> 56) & 0xf)
+#define RQ_KEY_TEXSET(key)   ((unsigned int)((key) >> 32) & 0xffffff)
+#define RQ_KEY_DEPTH(key)    ((unsigned int)(key))
+
+#define RQ_NO_TEXSET  0xffffff   /* the draw binds its own textures, if any */
+
+
+/* one draw */
+struct __rqpacket {
+  unsigned long long key;
+  int kind;                 /* what to draw, up to the submitter */
+  int sub;                  /* e.g. mesh index of a unit */
+  const void *obj;          /* e.g. a unit or a geopatch */
+};
+
+struct __rqueue {
+  rqpacket *packets;
+  rqpacket *sorted;         /* radix sort scratch */
+  int n_packets;
+  int capacity;
+
+  GLuint (*texsets)[3];     /* distinct texture sets of the frame, key texset indexes it */
+  int n_texsets;
+  int texsets_capacity;
+};
+
+
+/* create a render queue in memory */
+rqueue *rq_new( const int capacity );
+/* delete a render queue from memory */
+void rq_del( rqueue *rq );
+/* empty the queue and forget the texture sets, ids are only good for a frame */
+void rq_clear( rqueue *rq );
+/* id of a texture set in this frame, registered on first use */
+unsigned int rq_texset( rqueue *rq, const GLuint diffuse, const GLuint normalmap, const GLuint specular );
+/* build a sort key, a blended pass should pass back_to_front */
+unsigned long long rq_key( const unsigned int pass,
+                           const unsigned int program,
+                           const unsigned int texset,
+                           const float distsq,
+                           const int back_to_front );
+/* add a draw */
+void rq_push( rqueue *rq, const unsigned long long key, const int kind, const void *obj, const int sub );
+/* sort the draws by key */
+void rq_sort( rqueue *rq );
+
+
+#endif   /* _t3d_rqueue_h_ */
@@ -10,6 +10,15 @@
 #include <t3d_type.h>
 
 
+/* a visible unit with its instance group key */
+struct __scninst {
+  unit *u;
+  const ms3d *model;
+  int cmd;                      /* animation command */
+  int pose;                     /* animation time bucket */
+  int skin;                     /* skin set, -1 for any skin of the model skin arrays */
+};
+
 struct __scene {
   t3dsys *sys;
   camera *cam;
@@ -21,6 +30,22 @@ struct __scene {
   int unit_count;
 
   unsigned int batch_count;
+  unsigned int frame_count;     /* frames updated, staggers the unit update LOD */
+
+  /* unit update LOD bands, camera distance in model radii (squared) */
+  float lod_near_distsq;        /* closer units are updated every frame */
+  float lod_far_distsq;         /* further units are updated every 4th frame */
+
+  int unit_fused;               /* 1: fused skin/face/HSR kernel, 0: separate reference passes */
+
+  rqueue *rq;                   /* camera pass draws, sorted by state */
+
+  /* units of the same model, pose bucket and skin (any skin with skin arrays)
+     are drawn with one instanced call */
+  int unit_instanced;           /* 1 if instancing is on (needs ogl_has_instancing) */
+  float inst_pose_rate;         /* pose buckets per second of animation, lower shares more */
+  scninst *insts;               /* grouping scratch, one per unit */
+  int n_insts_capacity;
 };
 
 
@@ -28,18 +53,20 @@ struct __scene {
 scene *scn_new( t3dsys *sys, camera *cam, light *lit, control *ctrl, pickbox *pickb );
 /* delete scene from memory */
 void scn_del( scene *scn );
+/* set the unit update LOD bands, camera distances in model radii */
+void scn_set_unit_lod( scene *scn, const float near_dist, const float far_dist );
 /* update camera and light */
 void scn_update_cam_lit( void *arg_scn );
 /* update geopatch visibility */
 void scn_update_geopatch( void *arg_scn );
 /* update units */
 void scn_update_unit( void *scn );
-/* update vbo, ibos in the scene */
-void scn_update_vbo_ibo( const t3dsys *sys );
+/* group the instanced units, update vbo, ibos in the scene */
+void scn_update_vbo_ibo( scene *scn );
 /* the light pass */
-void scn_light_pass( const t3dsys *sys, const light *lit, shader *glsl );
-/* the lit pass */
-void scn_camera_pass( const t3dsys *sys, const camera *cam, const light *lit, shader *glsl );
+void scn_light_pass( const scene *scn, shader *glsl );
+/* the lit pass, draws go through the render queue */
+void scn_camera_pass( scene *scn, shader *glsl );
 
 
 #endif  /* _t3d_scene_h_ */
\ No newline at end of file
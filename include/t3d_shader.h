@@ -10,43 +10,58 @@
 #include <t3d_type.h>
 
 
+/* uniforms known to the engine, index of shdprog locations/values */
+enum {
+  SHD_VP = 0,                     /* vs - proj*view matrix */
+  SHD_M,                          /* vs - model matrix */
+  SHD_M3X3_INV_TRANSP,            /* vs - inverse transposed model matrix */
+  SHD_LVP,                        /* vs - light proj*view matrix */
+  SHD_BIAS_LVP,                   /* vs - light bias*proj*view matrix */
+  SHD_MVP,                        /* vs - proj*view*model matrix */
+  SHD_TEX_OFFSET,                 /* vs - texture coordinate offset for aamesh */
+  SHD_V_INV,                      /* fs - inversed view matrix */
+  SHD_DIFFMAP,                    /* fs - diffuse */
+  SHD_NORMMAP,                    /* fs - normalmap */
+  SHD_SPECMAP,                    /* fs - specular */
+  SHD_SHADMAP,                    /* fs - shadowmap */
+  SHD_LIGHT_COORD,                /* fs - light postion */
+  SHD_ONECOLOR,                   /* fs - onecolor */
+  SHD_MODE,                       /* fs - overlay texture mode (OVL_*) */
+  SHD_N_UNIFORMS
+};
+
+
+/* a linked glsl program, uniform locations are resolved once at load time */
+struct __shdprog {
+  GLuint handle;
+
+  GLint locations[SHD_N_UNIFORMS];        /* -1 if the program does not use it */
+  GLfloat values[SHD_N_UNIFORMS][16];     /* last uploaded values */
+  unsigned char known[SHD_N_UNIFORMS];    /* 1 if values holds what the program has */
+};
+
 struct __shader {
   /*----------------------- glsl programs -----------------------------------*/
-  GLuint prog_normal_pass;
-  GLuint prog_light_pass;
-  GLuint prog_font;
-  GLuint prog_box2d;
-  GLuint prog_aamesh;
-  GLuint prog_minimap;
+  shdprog *prog_normal_pass;
+  shdprog *prog_light_pass;
+  shdprog *prog_aamesh;
+  shdprog *prog_overlay;          /* 2d text, pickbox, minimap */
+  shdprog *prog_normal_inst;      /* instanced variants, NULL without instancing */
+  shdprog *prog_light_inst;
+  shdprog *prog_normal_array;     /* unit skins in texture arrays, NULL without texture arrays */
+  shdprog *prog_normal_inst_array;
+
+  shdprog *current;               /* program in use, see shd_set */
 
   /*----------------------- vertex shader -----------------------------------*/
+  /* attributes are bound to these fixed locations before linking */
   GLint attri_v_coord;            /* attributes - vertex coordinates */
   GLint attri_v_normal;           /* attributes - vertex normals */
   GLint attri_v_texcoord;         /* attributes - vertex texture coordinates */
   GLint attri_v_tangent;          /* attributes - vertex tangents */
-
-  GLint uniform_vp;               /* uniform - proj*view matrix */
-  GLint uniform_v;                /* uniform - view matrix */
-  GLint uniform_m;                /* uniform - model matrix */
-  GLint uniform_m3x3_inv_transp;  /* uniform - inverse transposed model matrix */
-
-  GLint uniform_lvp;              /* uniform - light proj*view matrix */
-  GLint uniform_bias_lvp;         /* uniform - light bias*proj*view matrix */
-
-  GLint uniform_mvp;              /* uniform - proj*view*model matrix */
-
-  GLint uniform_tex_offset;       /* uniform - texture coordinate offset for aamesh */
-
-  /*----------------------- fragment shader ----------------------------------*/
-  GLint uniform_v_inv;            /* uniform - inversed view matrix */
-
-  GLint uniform_diffmap;          /* uniform - diffuse */
-  GLint uniform_normmap;          /* uniform - normalmap */
-  GLint uniform_specmap;          /* uniform - specular */
-  GLint uniform_shadmap;          /* uniform - shadowmap */
-
-  GLint uniform_light_coord;      /* uniform - light postion */
-  GLint uniform_onecolor;         /* uniform - onecolor */
+  GLint attri_i_model;            /* attributes - per instance model matrix, 4 locations */
+  GLint attri_v_color;            /* attributes - overlay vertex colors */
+  GLint attri_i_layer;            /* attributes - skin array layer, per instance or constant */
 };
 
 
@@ -54,10 +69,17 @@ struct __shader {
 shader *shd_new( void );
 /* delete a shader from memory */
 void shd_del( shader *s );
-/* load the vertex and fragment shaders */
-GLuint shd_load( const char *vert_file, const char *frag_file );
-/* map to glsl attributes, uniforms for normalmap shader */
-void shd_set( shader *s, const GLuint program );
+/* load the vertex and fragment shaders, link and resolve the uniform locations */
+shdprog *shd_load( const char *vert_file, const char *frag_file );
+/* make program current, the shd_uniform_* calls go to it */
+void shd_set( shader *s, shdprog *prog );
+/* set uniforms of the current program, unchanged values are not uploaded */
+void shd_uniform_1i( shader *s, const int uniform, const GLint v );
+void shd_uniform_2f( shader *s, const int uniform, const GLfloat x, const GLfloat y );
+void shd_uniform_4f( shader *s, const int uniform,
+                     const GLfloat x, const GLfloat y, const GLfloat z, const GLfloat w );
+void shd_uniform_matrix3( shader *s, const int uniform, const GLfloat *m );
+void shd_uniform_matrix4( shader *s, const int uniform, const GLfloat *m );
 
 
 
@@ -6,9 +6,24 @@
 #ifndef _t3d_system_h_
 #define _t3d_system_h_
 
+#include <GL/glcorearb.h>
 #include <t3d_type.h>
 
 
+/* video memory for the texture levels, the finer levels are streamed in
+   as the textures are drawn closer. 0 loads every level up front */
+#define SYS_TEX_BUDGET  (24*1024*1024)
+
+/* pack the skin variants of a model into texture arrays, units with any
+   of its skins are then drawn together. 0 keeps a texture set per skin */
+#define SYS_SKIN_ARRAYS  1
+#define SYS_MAX_SKIN_LAYERS  16
+
+/* the texture names of the boxes standing in for the models still loading */
+#define SYS_PROXY_DIFFUSE    "<proxy>"
+#define SYS_PROXY_NORMALMAP  "<proxy_n>"
+#define SYS_PROXY_SPECULAR   "<proxy_s>"
+
 enum {
   CLR_RED = 0,
   CLR_GREEN = 1,
@@ -21,15 +36,32 @@ enum {
 };
 
 
+/* a unit drawn as a box until its model is loaded */
+typedef struct __sysspawn {
+  unit *u;
+  unsigned int model_id;
+  int skin_index;
+  int skin_stride;
+} sysspawn;
+
 struct __t3dsys {
   list *units;                    /* a list of units */
   ms3d **models;                  /* ms3d modes */
+  unsigned char *model_loading;   /* 1 while the model is a box standing in */
   unsigned int n_models;
 
+  loader *ldr;                    /* runtime model and texture loads */
+  sysspawn *spawns;               /* the units waiting for their models */
+  int n_spawns;
+  int spawns_capacity;
+
   hashtable *texdb;               /* texture ( name, id ) database */
+  texstream *texstm;              /* mip streaming of the texdb textures, or NULL */
   hashtable *modeldb;             /* model ( name, id ) information database */
 
   patchmap *pchmap;               /* patchmap */
+  hpa *pathgraph;                 /* the patch level path finding graph of the patchmap */
+  pathsvc *pathsvc;               /* the path requests of the units */
 
   float time_passed;
   vec2 timer;                     /* system timer (start --- end) */
@@ -42,6 +74,22 @@ struct __t3dsys {
 t3dsys *sys_new( void );
 /* delete ogl from memory */
 void sys_del( t3dsys *sys );
+/* decode the runtime loads, stream the textures and search the paths on a thread pool */
+void sys_set_thpool( t3dsys *sys, thpool *pool );
+/* the id of a texture, loaded in the background if it is new, a placeholder shows till then */
+GLuint sys_request_texture( t3dsys *sys, const char *path, const int s3tc_compressed );
+/* the id of a model, loaded in the background if it is new, a box of its AABBox
+   stands in till then. its skins follow the model list layout (diffuse,
+   normalmap, specular of each material) and are looked for in textures/ */
+unsigned int sys_request_model( t3dsys *sys, const char *path,
+                                const vec3 *aabb_min, const vec3 *aabb_max );
+/* add a unit of a model on the map, a model still loading swaps in when it is ready */
+unit *sys_spawn_unit( t3dsys *sys, const unsigned int model_id,
+                      const int skin_index, const int skin_stride, const int color,
+                      const vec3 *pos, const vec3 *lookat, const float move_speed );
+/* once a frame on the GL thread, not while the units update - upload the
+   runtime loads within the loader budget */
+void sys_update_loads( t3dsys *sys );
 
 
 #endif   /* _t3d_system_h_ */
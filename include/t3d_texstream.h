@@ -0,0 +1,79 @@
+/*----- t3d_texstream.h ------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#ifndef _t3d_texstream_h_
+#define _t3d_texstream_h_
+
+#include <stddef.h>
+#include <pthread.h>
+#include <GL/glcorearb.h>
+#include <t3d_type.h>
+#include <t3d_texture.h>
+
+
+#define TEX_STREAM_RESIDENT  64   /* levels this size and smaller are always resident */
+
+/* a streamed texture, the GL id never changes, only its resident levels */
+struct __streamtex {
+  GLuint tex_id;
+  teximage *img;                /* every level, mapped from the cache or in memory */
+
+  int base;                     /* finest level resident (GL_TEXTURE_BASE_LEVEL) */
+  int coarse_base;              /* the always resident levels start here */
+  int want;                     /* finest level asked for in the frame */
+  unsigned int last_used;       /* frame of the last request */
+  int pinned;                   /* every level, never evicted */
+
+  /* one fetch at a time, levels [fetch_base, base) */
+  int fetching;
+  int fetch_base;
+  int fetch_done;               /* set by the worker */
+  unsigned char *staged[TEX_MAX_LEVELS];   /* worker copies of mapped levels */
+  texstream *ts;
+};
+
+/* mip streaming of the textures under a video memory budget */
+struct __texstream {
+  streamtex **textures;
+  int n_textures;
+  int capacity;
+
+  int *slots;                   /* GL id -> index + 1 */
+  int n_slots;
+
+  size_t budget;                /* bytes of levels resident at most */
+  size_t resident;              /* bytes of levels resident */
+  size_t reserved;              /* bytes being fetched */
+
+  unsigned int frame;
+  int max_uploads;              /* levels uploaded per update */
+
+  thpool *pool;                 /* fetches from the mapped files, NULL to fetch inline */
+  pthread_mutex_t lock;         /* fetch_done shared with the workers */
+};
+
+
+/* create a texture stream in memory */
+texstream *tex_stream_new( const size_t budget );
+/* delete a texture stream and its images from memory, not the GL textures */
+void tex_stream_del( texstream *ts );
+/* fetch the higher levels on a thread pool */
+void tex_stream_set_thpool( texstream *ts, thpool *pool );
+/* stream an image into a texture made before (e.g. a placeholder), only
+   its coarse levels are uploaded. the stream owns the image */
+GLuint tex_stream_attach( texstream *ts, const GLuint tex_id, teximage *img );
+/* create a GL texture with the coarse levels of an image, the stream owns the image */
+GLuint tex_stream_add( texstream *ts, teximage *img );
+/* the draw code shows a texture screen_px pixels wide this frame */
+void tex_stream_request( texstream *ts, const GLuint tex_id, const float screen_px );
+/* keep every level of a texture resident (e.g. 2d overlays) */
+void tex_stream_pin( texstream *ts, const GLuint tex_id );
+/* the image of a streamed texture, every level (mapped or in memory), NULL if it is not streamed */
+const teximage *tex_stream_image( const texstream *ts, const GLuint tex_id );
+/* once a frame on the GL thread - upload fetched levels, evict, start fetches */
+void tex_stream_update( texstream *ts );
+
+
+#endif   /* _t3d_texstream_h_ */
@@ -6,6 +6,7 @@
 #ifndef _t3d_texture_h_
 #define _t3d_texture_h_
 
+#include <stddef.h>
 #include <GL/glcorearb.h>
 #include <t3d_type.h>
 
@@ -20,13 +21,55 @@ enum {
   TEX_TO_BORDER = 64
 };
 
+#define TEX_MAX_LEVELS  16
+
+
+/* one mip level, raw texels or DXT blocks */
+struct __texlevel {
+  int w, h;
+  int size;                 /* bytes of data */
+  unsigned char *data;
+};
+
+/* a decoded texture waiting for its GL upload, made without a GL context */
+struct __teximage {
+  int channels;
+  int s3tc_compressed;
+  int n_levels;
+  texlevel levels[TEX_MAX_LEVELS];
+
+  const void *mapping;      /* the levels point into a mapped cache file */
+  size_t mapping_size;      /* 0 if the mapping is borrowed (the asset pack) */
+};
+
 
 /* set texture flags */
 void tex_set_flags( const GLuint tex_id, const GLuint flags );
+/* set texture array flags */
+void tex_set_array_flags( const GLuint tex_id, const GLuint flags );
+/* decode, resample, mip and compress an image file, safe to call from any thread.
+   a compressed chain is cached in <file>.t3dtex and reused while the image is unchanged */
+teximage *tex_decode( const char *file, const int s3tc_compressed );
+/* 1 if <file>.t3dtex holds the chain of the image as it is now */
+int tex_cache_is_current( const char *file );
+/* delete a decoded image from memory */
+void tex_image_del( teximage *img );
+/* upload one level of a decoded image to the bound texture, data overrides
+   the level texels (e.g. a copy made by a worker) when not NULL */
+void tex_upload_level( const teximage *img, const int level, const unsigned char *data );
+/* replace the levels of a texture with a decoded image (e.g. a placeholder's), main thread only */
+void tex_upload_to( const GLuint tex_id, const teximage *img );
+/* create an OpenGL texture from a decoded image, main thread only */
+GLuint tex_upload( const teximage *img );
+/* create a GL_TEXTURE_2D_ARRAY with one layer per image, the images must have
+   the same size, channels and compression, 0 if they do not */
+GLuint tex_array_upload( const teximage **imgs, const int n_layers );
 /* Loads an image from disk into an OpenGL texture */
 GLuint tex_load( const char *file, const int s3tc_compressed );
 /* generate an empty GL_RED texture */
 GLuint tex_gen_red_tex( const unsigned char *texels, const int tex_w, const int tex_h );
+/* generate a 1 x 1 RGBA texture of one color (e.g. a placeholder) */
+GLuint tex_gen_solid( const unsigned char *rgba );
 
 
 #endif	/* _t3d_texture_h_ */
\ No newline at end of file
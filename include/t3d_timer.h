@@ -13,6 +13,8 @@
 unsigned int tmr_gettime( void );
 /* calculate the time passed, in milliseconds */
 float tmr_time_passed( vec2 *timer );
+/* a fine clock in milliseconds, to time short spans (e.g. a frame budget) */
+double tmr_getmsecs( void );
 
 
 #endif   /* _t3d_timer_h_ */
\ No newline at end of file
@@ -75,12 +75,34 @@ typedef struct __aamesh aamesh;
 
 /* t3d astar cell & node struct - path finding */
 typedef struct __anode anode;
+typedef struct __astarctx astarctx;
+
+/* t3d hierarchical path finding struct */
+typedef struct __hpa hpa;
+typedef struct __hpapatch hpapatch;
+typedef struct __hpaportal hpaportal;
+typedef struct __hpanode hpanode;
+
+/* t3d texture image struct */
+typedef struct __teximage teximage;
+typedef struct __texlevel texlevel;
+
+/* t3d texture streaming struct */
+typedef struct __texstream texstream;
+typedef struct __streamtex streamtex;
 
 /* t3d font struct */
 typedef struct __font font;
+typedef struct __fnttext fnttext;
+
+/* t3d 2d overlay struct */
+typedef struct __overlay overlay;
+typedef struct __ovlvertex ovlvertex;
+typedef struct __ovlbatch ovlbatch;
 
 /* t3d shader struct */
 typedef struct __shader shader;
+typedef struct __shdprog shdprog;
 
 /* t3d system struct */
 typedef struct __t3dsys t3dsys;
@@ -93,6 +115,33 @@ typedef struct __audiostream audiostream;
 
 /* t3d scene struct */
 typedef struct __scene scene;
+typedef struct __scninst scninst;
+
+/* t3d render queue struct */
+typedef struct __rqueue rqueue;
+typedef struct __rqpacket rqpacket;
+
+/* t3d asset pack struct */
+typedef struct __pak pak;
+typedef struct __pakheader pakheader;
+typedef struct __pakentry pakentry;
+
+/* t3d asynchronous asset loader struct */
+typedef struct __loader loader;
+typedef struct __ldrjob ldrjob;
+
+/* t3d object pool struct */
+typedef struct __mpool mpool;
+
+/* t3d path request service struct */
+typedef struct __pathsvc pathsvc;
+typedef struct __psvreq psvreq;
+typedef struct __psventry psventry;
+
+/* t3d flow field struct */
+typedef struct __flowfield flowfield;
+typedef struct __fftile fftile;
+typedef struct __ffrun ffrun;
 
 
 #endif   /* _t3d_type_h_ */
@@ -6,21 +6,30 @@
 #ifndef _t3d_unit_h_
 #define _t3d_unit_h_
 
+#include <GL/glcorearb.h>
 #include <t3d_type.h>
 
 
+#define UNIT_POOL_SLAB  16      /* units a pool slab holds */
+
 struct __unit {
   ms3d *model;                  /* pointer to model */
+  void *block;                  /* from the model's unit pool, holds the arrays below */
 
   mesh **mshs;                  /* meshes */
   ms3danim *ani;                /* ms3d animation */
   mat4 *mat_joint_finals;       /* finalized matrices of model joints, for animation */
 
   int color;                    /* unit color index, friend/enemy/NPC */
+  int skin_set;                 /* first material of the skin, units sharing it look the same */
+  int skin_layer;               /* layer of the model skin arrays, -1 if drawn with mesh textures */
 
   int visible;                  /* if visible to camera */
   int picked;                   /* if picked by mouse */
 
+  int lod_interval;             /* update LOD - animate/skin every n-th frame (1, 2, 4) */
+  float lod_time;               /* animation time accumulated between LOD updates */
+
   vec3 center_ws;               /* need to be transformed by mat_model */
   vec3 center;                  /* AABBox center */
   float half_x_len;             /* AABBox half size in x direction */
@@ -45,14 +54,27 @@ struct __unit {
   ivec2 ipos;                   /* unit's 2d position on heightmap */
   ivec2 itarget;                /* 2d target cell */
 
-  ivec2 *path;                  /* found path */
-  int chk_path;                 /* if calculate the path or not */
-  int n_steps;                  /* number of steps in the path */
+  ivec2 *waypoints;             /* the path planned over the patches */
+  int n_waypoints;
+  int waypoint;                 /* the waypoint the current leg goes to */
+  ivec2 *path;                  /* the cells of the current leg */
+  int n_steps;                  /* number of steps in the leg, 0 if not walking */
+  int step;                     /* the cell walked to */
+  unsigned int path_ticket;     /* the path request waited for, 0 if none */
+  flowfield *flow;              /* the flow field of a group order, followed instead of a path */
+  int new_path;                 /* a path (or a flow field) was given, start walking it */
   vec3 last_waypoint;           /* the last waypoint of the path */
   vec3 target_f;                /* target direction */
 
   mat4 mat_model;               /* model matrix */
   mat3 mat_m3x3;                /* model rotation 3x3 matrix */
+
+  /* instanced drawing, regrouped every frame by scn_update_vbo_ibo */
+  int inst_count;               /* leader: units drawn with its meshes, 0 if drawn alone */
+  const unit *inst_leader;      /* follower: the unit drawing it, NULL otherwise */
+  int skin_stale;               /* not skinned while it followed, skinned once it is drawn itself */
+  GLintptr stm_inst_models;     /* leader: model matrices of the group in the stream buffer */
+  GLintptr stm_inst_layers;     /* leader: skin layers of the group, with skin arrays */
 };
 
 
@@ -60,6 +82,9 @@ struct __unit {
 unit *unit_new( ms3d **models, const unsigned int model_id );
 /* destroy unit struct */
 void unit_del( unit *u );
+/* switch the unit to another model (e.g. the loaded one after its stand-in),
+   the skin and the decal mesh must be set again */
+void unit_set_model( unit *u, ms3d **models, const unsigned int model_id );
 /* set unit's position */
 void unit_set_pos( unit *u, const vec3 *pos, patchmap *pm );
 /* set the unit's direction */
@@ -74,6 +99,9 @@ void unit_calc_faces( unit *u );
 void unit_calc_cam_hsr( unit *u, const vec3 *object_space_unit_to_cam, const int flag );
 /* calculate HSR for light */
 void unit_calc_lit_hsr( unit *u, const vec3 *object_space_unit_to_lit, const int flag );
+/* skin, calculate the faces and both HSR lists in one fused pass per mesh */
+void unit_update_fused( unit *u, const vec3 *object_space_unit_to_cam, const int cam_flag,
+                                 const vec3 *object_space_unit_to_lit, const int lit_flag );
 /* update VBO */
 void unit_update_vbo( const unit *u );
 /* update the camera hsr ibo */
@@ -82,8 +110,14 @@ void unit_update_hsr_cam_ibo( const unit *u );
 void unit_update_hsr_lit_ibo( const unit *u );
 /* draw the unit model with normalmap */
 void unit_normalmap_draw( const unit *u, const light *lit, const shader *glsl );
+/* draw mesh i of the unit with normalmap, its textures must be bound */
+void unit_mesh_normalmap_draw( const unit *u, const int i, const shader *glsl );
 /* draw the unit model with only vertex coordinates */
 void unit_vertex_draw( const unit *u, const shader *glsl );
+/* draw mesh i of an instance group leader for the whole group, its textures must be bound */
+void unit_mesh_normalmap_draw_inst( const unit *u, const int i, const shader *glsl );
+/* draw an instance group leader for the whole group with only vertex coordinates */
+void unit_vertex_draw_inst( const unit *u, const shader *glsl );
 
 
 #endif  /* _t3d_unit_h_ */
\ No newline at end of file
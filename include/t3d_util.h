@@ -6,17 +6,37 @@
 #ifndef _t3d_util_h_
 #define _t3d_util_h_
 
+#include <stddef.h>
 #include <t3d_type.h>
 
+#define UTIL_FNV1A_SEED  0xcbf29ce484222325ULL
+
 
 /* read file to a buffer in memory */
 char *util_file_to_mem( const char *filename );
 /* get the filename, strip off the path */
 void util_get_fname( char *fname, const char *path );
+/* serve the file views from an asset pack, NULL for loose files only */
+void util_mount_pack( const pak *p );
+/* zero-copy view of a file in the mounted pack, NULL if it is not packed */
+const void *util_pack_find( const char *filename, size_t *size );
+/* view a whole file, in place from the mounted pack or read from disk,
+   0 terminated, NULL if it can not be read. release it with util_file_release */
+const char *util_file_view( const char *filename, size_t *size );
+/* release a view of util_file_view */
+void util_file_release( const char *data );
 /* read list of strings into a vector */
 void util_file_to_vector( vector *v, const char *fname );
 /* add file basename(strip off the directory name) to a hashtable paired with a value */
 void util_add_basename_to_hash( hashtable *ht, const char *str, const void *value, const int value_sz );
+/* number of online processors, at least 1 */
+int util_cpu_count( void );
+/* map a whole file read only, NULL if it can not be opened or is empty */
+const void *util_map_file( const char *filename, size_t *size );
+/* unmap a file mapped by util_map_file */
+void util_unmap_file( const void *data, const size_t size );
+/* 64 bits FNV-1a hash of a buffer, chain calls by passing the last hash as seed */
+unsigned long long util_fnv1a( const void *data, const size_t size, unsigned long long seed );
 
 
 #endif   /* _t3d_util_h_ */
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <t3d_ogl.h>
 #include <t3d_math.h>
+#include <t3d_mpool.h>
 #include <t3d_shader.h>
 #include <t3d_vector.h>
 #include <t3d_hashtable.h>
@@ -17,26 +18,34 @@
 #include <t3d_aamesh.h>
 
 
-/* store vertices in graphic card buffers */
-static void
-aamesh_upload( const aamesh *aamsh )
+/* create a axis aligned decal target mesh in memory */
+aamesh *
+aamesh_new( const decal *d )
 {
-  glBindBuffer(GL_ARRAY_BUFFER, aamsh->vbo_coord);
-  glBufferData(GL_ARRAY_BUFFER, aamsh->v_data_size, NULL, GL_DYNAMIC_DRAW);
+  void *block = malloc(aamesh_size(d));
+  if(!block)  return NULL;
+
+  return aamesh_init(block, d);
 }
 
-/* create a axis aligned decal target mesh in memory */
+/* bytes of a decal target mesh with its vertices in one block */
+size_t
+aamesh_size( const decal *d )
+{
+  return mpool_align(sizeof(aamesh)) + mpool_align(d->n_total_vertices*sizeof(vec3));
+}
+
+/* lay a decal target mesh out in a block of aamesh_size bytes */
 aamesh *
-aamesh_new( const decal *d )
+aamesh_init( void *block, const decal *d )
 {
-  aamesh *aamsh = (aamesh *)malloc(sizeof(aamesh));
+  aamesh *aamsh = (aamesh *)block;
 
   aamsh->v_data_size = d->n_total_vertices*sizeof(vec3);
-  aamsh->vcoords = (vec3 *)malloc(aamsh->v_data_size);
+  aamsh->vcoords = (vec3 *)((char *)block + mpool_align(sizeof(aamesh)));
 
-  /* create the vertex buffer object for decal mesh */
-  glGenBuffers(1, &aamsh->vbo_coord);
-  aamesh_upload(aamsh);
+  /* the vertices are streamed every frame, see aamesh_update_vbo */
+  aamsh->stm_coord = 0;
 
   mat4_identity(&aamsh->mat_model);
 
@@ -47,10 +56,6 @@ aamesh_new( const decal *d )
 void
 aamesh_del( aamesh *aamsh )
 {
-  if(!aamsh) return;
-
-  glDeleteBuffers(1, &aamsh->vbo_coord);
-  free(aamsh->vcoords);
   free(aamsh);
 }
 
@@ -100,14 +105,12 @@ aamesh_tex_offset( aamesh *aamsh,
   aamsh->tex_offset.y = (0.5*htmap_step - mod_y)/((float)d->w_cells*htmap_step);
 }
 
-/* update vbo */
-void
-aamesh_update_vbo( const aamesh *aamsh )
+/* update vbo (stream the vertices), 0 if the stream is full */
+int
+aamesh_update_vbo( aamesh *aamsh )
 {
-  glBindBuffer(GL_ARRAY_BUFFER, aamsh->vbo_coord);
-  void *aa_data = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-  memcpy(aa_data, aamsh->vcoords, aamsh->v_data_size);
-  glUnmapBuffer(GL_ARRAY_BUFFER);
+  aamsh->stm_coord = ogl_stream_upload(aamsh->vcoords, aamsh->v_data_size);
+  return aamsh->stm_coord >= 0;
 }
 
 
@@ -119,27 +122,25 @@ aamesh_draw( aamesh *aamsh,
              const vec4 *color,
              shader *glsl )
 {
-  glUniformMatrix4fv(glsl->uniform_vp, 1, GL_FALSE, cam->mat_vp.m);
-  glUniformMatrix4fv(glsl->uniform_m, 1, GL_FALSE, aamsh->mat_model.m);
-  glUniform2f(glsl->uniform_tex_offset, aamsh->tex_offset.x, aamsh->tex_offset.y);
-  glUniform1i(glsl->uniform_diffmap, /*GL_TEXTURE*/0);
-  glUniform4f(glsl->uniform_onecolor, color->r, color->g, color->b, color->a);
+  shd_uniform_matrix4(glsl, SHD_VP, cam->mat_vp.m);
+  shd_uniform_matrix4(glsl, SHD_M, aamsh->mat_model.m);
+  shd_uniform_2f(glsl, SHD_TEX_OFFSET, aamsh->tex_offset.x, aamsh->tex_offset.y);
+  shd_uniform_1i(glsl, SHD_DIFFMAP, /*GL_TEXTURE*/0);
+  shd_uniform_4f(glsl, SHD_ONECOLOR, color->r, color->g, color->b, color->a);
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, *aamsh->tex_id);
+  ogl_bind_texture(0, *aamsh->tex_id);
 
-  glEnableVertexAttribArray(glsl->attri_v_coord);
-  glEnableVertexAttribArray(glsl->attri_v_texcoord);
+  ogl_attrib_arrays(OGL_ATTRIB(glsl->attri_v_coord)|OGL_ATTRIB(glsl->attri_v_texcoord));
 
-  glBindBuffer(GL_ARRAY_BUFFER, aamsh->vbo_coord);
+  ogl_bind_buffer(GL_ARRAY_BUFFER, ogl_stream_buffer());
   glVertexAttribPointer(glsl->attri_v_coord,   /* attribute */
                         3,                     /* (x, y, z) */
                         GL_FLOAT,
                         GL_FALSE,
                         0,
-                        0);
+                        (void *)aamsh->stm_coord);
 
-  glBindBuffer(GL_ARRAY_BUFFER, d->vbo_o_texcoords);
+  ogl_bind_buffer(GL_ARRAY_BUFFER, d->vbo_o_texcoords);
   glVertexAttribPointer(glsl->attri_v_texcoord,  /* attribute */
                         2,                       /* (x, y) */
                         GL_FLOAT,
@@ -148,9 +149,6 @@ aamesh_draw( aamesh *aamsh,
                         0);
 
   /* push each element to the vertex shader */
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, d->ibo_o_elements);
+  ogl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, d->ibo_o_elements);
   glDrawElements(GL_TRIANGLE_STRIP, d->n_total_indices, GL_UNSIGNED_INT, 0);
-
-  glDisableVertexAttribArray(glsl->attri_v_texcoord);
-  glDisableVertexAttribArray(glsl->attri_v_coord);
 }
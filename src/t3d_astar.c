@@ -3,312 +3,335 @@
     Revised date: 18th Jan, 2014
  +---------------------------------------------------------------------------*/
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 #include <t3d_math.h>
 #include <t3d_patchmap.h>
 #include <t3d_astar.h>
 
 
-#define ASTAR_MAX_GEN_NODES 4
 #define ASTAR_WALK_COST 10
 
 
+/* the context of each searching thread, freed when the thread exits */
+static pthread_key_t astar_key;
+static pthread_once_t astar_key_once = PTHREAD_ONCE_INIT;
+
+
 /* calculates the "manhattan distance" between two cells */
-static int
-astar_manhattan( const ivec2 *n, const ivec2 *dest )
+static inline int
+astar_manhattan( const int x, const int y, const ivec2 *dest )
 {
-  return ASTAR_WALK_COST*(abs(n->x - dest->x) + abs(n->y - dest->y));
+  return ASTAR_WALK_COST*(abs(x - dest->x) + abs(y - dest->y));
 }
 
-/* expands nodes from a initial one */
-static int
-astar_gen_nodes( ivec2 **gen, const ivec2 *center, const patchmap *pm )
+/* create a search context in memory */
+astarctx *
+astar_ctx_new( void )
 {
-  int n_nodes = ASTAR_MAX_GEN_NODES;
-  int c = 0;
-	
-  *gen = (ivec2 *)malloc(sizeof(ivec2)*n_nodes);
-	
-  /* initial node is on first or last row */
-  if(!center->x || center->x == pm->w_cells)  n_nodes--;
-  /* initial node is on first or last col */
-  if(!center->y || center->y == pm->h_cells)  n_nodes--;
-
-  /* x > 0 (left) */
-  if(center->x) {
-    (*gen)[c].x = center->x - 1;
-    (*gen)[c].y = center->y; 
-    c++;
-  }
+  astarctx *ctx = (astarctx *)calloc(1, sizeof(astarctx));
 
-  /* y < pm->h_cells - 1 (bottom) */
-  if(center->y < pm->h_cells - 1) {
-    (*gen)[c].x = center->x;
-    (*gen)[c].y = center->y + 1; 
-    c++;
-  }
-	
-  /* x < pm->w_cells - 1 (right) */
-  if(center->x < pm->w_cells - 1) {
-    (*gen)[c].x = center->x + 1;
-    (*gen)[c].y = center->y; 
-    c++;
-  }
-
-  /* y > 0 (up) */
-  if(center->y) {
-    (*gen)[c].x = center->x;
-    (*gen)[c].y = center->y - 1; 
-    c++;
+  if(!ctx) {
+    fprintf(stderr, "line %d: Can not allocate memory\n", __LINE__);
+    exit(EXIT_FAILURE);
   }
 
-  return c;
+  return ctx;
 }
 
-/* inserts node into a list of anode ordered by f, then by g values */
-static void
-astar_insert_node( anode **list, anode *node )
+/* delete a search context from memory */
+void
+astar_ctx_del( astarctx *ctx )
 {
-  /* travel node */
-  anode *trav = *list;
-
-  /* new first node */
-  if(trav == NULL || trav->f > node->f) {
-    node->next = trav;
-    *list = node;
-    return ;
-  }
+  if(!ctx)  return;
 
-  while(trav->next != NULL) {
-    /* middle insertion */
-    if(trav->next->f >= node->f) {
-      /* move on for equal f value */
-      while(trav->next->f == node->f && trav->next->g < node->g) {
-        trav = trav->next;
-        if(trav->next == NULL) break;
-      }
+  free(ctx->nodes);
+  free(ctx->heap);
+  free(ctx->closed);
+  free(ctx);
+}
 
-      node->next = trav->next;
-      trav->next = node;
-      return;
-    }
-    trav = trav->next;
+/* grow a context to the cells of a map, the node generations start over */
+static void
+astar_ctx_reserve( astarctx *ctx, const int n_cells )
+{
+  if(n_cells <= ctx->n_cells)  return;
+
+  free(ctx->nodes);
+  free(ctx->heap);
+  free(ctx->closed);
+  ctx->nodes = (anode *)calloc(n_cells, sizeof(anode));
+  ctx->heap = (int *)malloc(sizeof(int)*n_cells);
+  ctx->closed = (unsigned int *)malloc(sizeof(unsigned int)*((n_cells + 31) >> 5));
+
+  if(!ctx->nodes || !ctx->heap || !ctx->closed) {
+    fprintf(stderr, "line %d: Can not allocate memory\n", __LINE__);
+    exit(EXIT_FAILURE);
   }
 
-  /* new last node */
-  node->next = NULL;
-  trav->next = node;
+  ctx->n_cells = n_cells;
+  ctx->gen = 0;
 }
 
-/* insert a node as head of a list of anode */
-static void
-astar_insert_head_node( anode **list, anode *node )
+/* the open order - lowest f value, then the highest g value, the cells
+   closer to the end go first among the equally good ones */
+static inline int
+astar_before( const anode *a, const anode *b )
 {
-  /* new first node */
-  node->next = *list;
-  *list = node;
+  return a->f < b->f || (a->f == b->f && a->g > b->g);
 }
 
-/* looks for a node into a list */
-static anode *
-astar_get_node( anode *list, const ivec2 *n )
+/* move a heap entry up to its place */
+static void
+astar_heap_up( astarctx *ctx, int pos )
 {
-  /* empty list */
-  if(list == NULL)  return NULL;
+  int *heap = ctx->heap;
+  anode *nodes = ctx->nodes;
+  int index = heap[pos];
 
-  /* moving on! */
-  while(list->next != NULL) {
-    if(list->x == n->x && list->y == n->y)
-      return list;
+  while(pos > 0) {
+    int parent = (pos - 1) >> 1;
+    if(!astar_before(&nodes[index], &nodes[heap[parent]]))  break;
 
-    list = list->next;
+    heap[pos] = heap[parent];
+    nodes[heap[pos]].heap_pos = pos;
+    pos = parent;
   }
 
-  return NULL;
+  heap[pos] = index;
+  nodes[index].heap_pos = pos;
 }
 
-/* extract the first node from a list */
-static anode *
-astar_extract_head( anode **list )
+/* move a heap entry down to its place */
+static void
+astar_heap_down( astarctx *ctx, int pos )
 {
-  anode *head = *list;
-
-  /* empty list */
-  if(list == NULL)  return NULL;
-
-  *list = (*list)->next;
+  int *heap = ctx->heap;
+  anode *nodes = ctx->nodes;
+  int index = heap[pos];
+
+  for(;;) {
+    int child = 2*pos + 1;
+    if(child >= ctx->n_heap)  break;
+    if(child + 1 < ctx->n_heap && astar_before(&nodes[heap[child + 1]], &nodes[heap[child]]))
+      child++;
+    if(!astar_before(&nodes[heap[child]], &nodes[index]))  break;
+
+    heap[pos] = heap[child];
+    nodes[heap[pos]].heap_pos = pos;
+    pos = child;
+  }
 
-  return head;
+  heap[pos] = index;
+  nodes[index].heap_pos = pos;
 }
 
-/* sort a node into a list according f and then g values */
+/* add a cell to OPEN */
 static void
-astar_sort_node( anode **list, anode *node )
+astar_heap_push( astarctx *ctx, const int index )
 {
-  anode *trav = *list;
-	
-  /* look for the predecessor of node */
-  while(trav->next != node && trav->next != NULL) {
-    trav = trav->next;
-  }
-  /* connect previous and next nodes */
-  trav->next = node->next;
-
-  /* reinsert the node to obtain the right order */
-  astar_insert_node(list, node);
+  ctx->heap[ctx->n_heap] = index;
+  astar_heap_up(ctx, ctx->n_heap++);
 }
 
-/* deallocate all elements of a list of l_node */
-static void
-astar_del_list( anode **list )
+/* extract the cell with the lowest f value from OPEN */
+static int
+astar_heap_pop( astarctx *ctx )
 {
-  anode *trav;
+  int index = ctx->heap[0];
+  ctx->nodes[index].heap_pos = -1;
 
-  /* move along list and free elements */
-  while(*list) {
-    trav = *list;
-    *list = (*list)->next;
-    free(trav);
+  ctx->n_heap--;
+  if(ctx->n_heap > 0) {
+    ctx->heap[0] = ctx->heap[ctx->n_heap];
+    astar_heap_down(ctx, 0);
   }
+
+  return index;
 }
 
-/* calculates a pathfind from start to end cells using A* algorithm */
-int
-astar_search( ivec2 **path, const ivec2 *start, const ivec2 *end, const patchmap *pm )
+/* calculates a pathfind from start to end cells, through the cells of the
+   rectangle (x0, y0) - (x1, y1) only */
+static int
+astar_run( astarctx *ctx, ivec2 **path, const ivec2 *start, const ivec2 *end,
+           const patchmap *pm, const int x0, const int y0, const int x1, const int y1 )
 {
+  int w = pm->w_cells;
+
   /* start or end not walkable or start == end */
-  int start_index = start->y*pm->step + start->x;
-  int end_index = end->y*pm->step + end->x;
+  int start_index = start->y*w + start->x;
+  int end_index = end->y*w + end->x;
   if(!pm->cells[start_index].status || !pm->cells[end_index].status ||
      (start->x == end->x && start->y == end->y))
     return 0;
 
+  astar_ctx_reserve(ctx, pm->n_total_cells);
 
-  /* A* lists */
-  anode *open = NULL;
-  anode *closed = NULL;
-  /* current node */
-  anode *cur = NULL;
-  /* generated node */
-  anode *gen = NULL;
-  /* node already present into OPEN list */
-  anode *already_ins = NULL;
-  /* travel node */
-  anode *trav = NULL;
-
-  /* node extracted from OPEN */
-  ivec2 cur_cell;
-  /* expanded nodes */
-  ivec2 *exp_cells;
-  /* management ivec2 */
-  ivec2 *cell;
-	
-  /* init first node */
-  anode *first = (anode *)malloc(sizeof(anode));
-  first->x = start->x; 
-  first->y = start->y;
-  first->f = 0;
-  first->g = 0;
-  first->h = 0;
-  first->next = NULL;
-  first->father = NULL;
-
-  /* add first node to OPEN */
-  astar_insert_node(&open, first);
-
-  /* local counter */
-  int i;
-  /* nodes expanded at every cycle */
-  int n_exp_nodes = 0;
+  /* a new generation makes every node of the last searches stale */
+  if(++ctx->gen == 0) {
+    int i;
+    for(i = 0; i < ctx->n_cells; i++)
+      ctx->nodes[i].gen = 0;
+    ctx->gen = 1;
+  }
 
-  /* found a path - 0 (FALSE) */
-  int found = 0;
+  /* only the closed bits of the rectangle rows are read */
+  if(x0 == 0 && x1 == w - 1) {
+    int first = (y0*w) >> 5;
+    int last = (y1*w + x1) >> 5;
+    memset(&ctx->closed[first], 0, sizeof(unsigned int)*(last - first + 1));
+  }
+  else {
+    int y;
+    for(y = y0; y <= y1; y++) {
+      int first = (y*w + x0) >> 5;
+      int last = (y*w + x1) >> 5;
+      memset(&ctx->closed[first], 0, sizeof(unsigned int)*(last - first + 1));
+    }
+  }
+  ctx->n_heap = 0;
+  ctx->n_expanded = 0;
 
-  /* go on until found a path or open is empty */
-  while(!found && open) {
-    /* extract the node with lowest f value */
-    cur = astar_extract_head(&open);
-    cur_cell.x = cur->x;
-    cur_cell.y = cur->y;
+  anode *nodes = ctx->nodes;
+  unsigned int *closed = ctx->closed;
 
-    /* expand nodes from the current obtaining cell indexes */
-    n_exp_nodes = astar_gen_nodes(&exp_cells, &cur_cell, pm);
+  /* init first node and add it to OPEN */
+  anode *first = &nodes[start_index];
+  first->gen = ctx->gen;
+  first->g = 0;
+  first->f = 0;
+  first->father = -1;
+  astar_heap_push(ctx, start_index);
 
-    /* insert current into CLOSED list */
-    astar_insert_head_node(&closed, cur);
+  /* the end cell once it is generated */
+  int found = -1;
 
-    /* manage expanded nodes */
-    for(i = 0; i < n_exp_nodes; i++) {
-      cell = &exp_cells[i];
+  /* go on until found a path or open is empty */
+  while(found < 0 && ctx->n_heap > 0) {
+    int cur = astar_heap_pop(ctx);
+    closed[cur >> 5] |= 1u << (cur & 31);
+    ctx->n_expanded++;
+
+    int cx = cur%w;
+    int cy = cur/w;
+    int g = nodes[cur].g + ASTAR_WALK_COST;
+
+    /* left, bottom, right, up */
+    int i;
+    for(i = 0; i < 4; i++) {
+      int x = cx, y = cy;
+      switch(i) {
+        case 0:  if(cx <= x0)  continue;  x--;  break;
+        case 1:  if(cy >= y1)  continue;  y++;  break;
+        case 2:  if(cx >= x1)  continue;  x++;  break;
+        default: if(cy <= y0)  continue;  y--;  break;
+      }
 
       /* walkable node & not yet into CLOSED (not yet analized) */
-      int index = cell->y*pm->step + cell->x;
-      if(pm->cells[index].status && astar_get_node(closed, cell) == NULL) {
-        /* check if exp_cell is already into OPEN */
-        already_ins = astar_get_node(open, cell);
-
-        /* generated node is not yet into OPEN */
-        if(already_ins == NULL) {
-          gen = (anode *)malloc(sizeof(anode));
-          gen->x = cell->x;
-          gen->y = cell->y;
-          gen->g = cur->g + ASTAR_WALK_COST; 
-          gen->h = astar_manhattan(cell, end);
-          gen->f = gen->g + gen->h;
-          gen->father = cur;
-
-          /* insert generated node into OPEN */
-          astar_insert_node(&open, gen);
-
-          /* h(n)= 0 ==> END NODE!!! get out! */
-          if(!gen->h) {
-            found = 1;
-            break;
-          }
-        }
-        /* found a better path */
-        else if(already_ins->g > (cur->g + ASTAR_WALK_COST)) {
-          /* recalculate node fields */
-          already_ins->x = cell->x;
-          already_ins->y = cell->y;
-          already_ins->g = cur->g + ASTAR_WALK_COST;
-          already_ins->h = astar_manhattan(cell, end);
-          already_ins->f = already_ins->g + already_ins->h;
-          /* resort updated node */
-          astar_sort_node(&open, already_ins);
+      int index = y*w + x;
+      if(!pm->cells[index].status || (closed[index >> 5] & (1u << (index & 31))))
+        continue;
+
+      anode *node = &nodes[index];
+      int h = astar_manhattan(x, y, end);
+
+      /* generated node is not yet into OPEN */
+      if(node->gen != ctx->gen) {
+        node->gen = ctx->gen;
+        node->g = g;
+        node->f = g + h;
+        node->father = cur;
+        astar_heap_push(ctx, index);
+
+        /* h(n)= 0 ==> END NODE!!! get out! */
+        if(!h) {
+          found = index;
+          break;
         }
       }
+      /* found a better path */
+      else if(node->g > g) {
+        node->g = g;
+        node->f = g + h;
+        node->father = cur;
+        astar_heap_up(ctx, node->heap_pos);
+      }
     }
-    free(exp_cells);
   }
 
   /* no path found... it's a defeat :( */
-  if(!found) {
-    /* free open & closed lists */
-    astar_del_list(&open);
-    astar_del_list(&closed);
-    return 0;
-  }
+  if(found < 0)  return 0;
 
   /* calculate path length */
-  int len_path = gen->g/ASTAR_WALK_COST + 1;
+  int len_path = nodes[found].g/ASTAR_WALK_COST + 1;
   int len_bk = len_path;
 
-  /* allocate memory for path */
+  /* the path is the only allocation, the caller frees it */
   *path = (ivec2 *)malloc(sizeof(ivec2)*len_path);
 
   /* fill path array with data from nodes */
-  trav = gen;
-  while(trav != NULL) {
+  int trav = found;
+  while(trav >= 0 && len_path > 0) {
     len_path--;
-    (*path)[len_path].x = trav->x;
-    (*path)[len_path].y = trav->y;
-    trav = trav->father;
+    (*path)[len_path].x = trav%w;
+    (*path)[len_path].y = trav/w;
+    trav = nodes[trav].father;
   }
 
-  /* free open & closed lists */
-  astar_del_list(&open);
-  astar_del_list(&closed);
-
   return len_bk;
-}
\ No newline at end of file
+}
+
+/* calculates a pathfind from start to end cells with a given context */
+int
+astar_search_ctx( astarctx *ctx, ivec2 **path, const ivec2 *start, const ivec2 *end,
+                  const patchmap *pm )
+{
+  return astar_run(ctx, path, start, end, pm, 0, 0, pm->w_cells - 1, pm->h_cells - 1);
+}
+
+/* calculates a pathfind from start to end cells that stays in a rectangle of
+   cells (e.g. a patch), start and end must be in it */
+int
+astar_search_rect( astarctx *ctx, ivec2 **path, const ivec2 *start, const ivec2 *end,
+                   const patchmap *pm, const ivec2 *rect_min, const ivec2 *rect_max )
+{
+  return astar_run(ctx, path, start, end, pm, rect_min->x, rect_min->y, rect_max->x, rect_max->y);
+}
+
+/* free the context of an exiting thread */
+static void
+astar_ctx_release( void *ctx )
+{
+  astar_ctx_del((astarctx *)ctx);
+}
+
+static void
+astar_key_new( void )
+{
+  pthread_key_create(&astar_key, astar_ctx_release);
+}
+
+/* the search context of the calling thread, made on its first search */
+astarctx *
+astar_thread_ctx( void )
+{
+  pthread_once(&astar_key_once, astar_key_new);
+
+  astarctx *ctx = (astarctx *)pthread_getspecific(astar_key);
+  if(!ctx) {
+    ctx = astar_ctx_new();
+    pthread_setspecific(astar_key, ctx);
+  }
+
+  return ctx;
+}
+
+/* calculates a pathfind from start to end cells using A* algorithm, with the
+   calling thread's context */
+int
+astar_search( ivec2 **path, const ivec2 *start, const ivec2 *end, const patchmap *pm )
+{
+  return astar_search_ctx(astar_thread_ctx(), path, start, end, pm);
+}
@@ -15,13 +15,13 @@
 static void
 decal_upload( const decal *d )
 {
-  glBindBuffer(GL_ARRAY_BUFFER, d->vbo_o_texcoords);
+  ogl_bind_buffer(GL_ARRAY_BUFFER, d->vbo_o_texcoords);
   glBufferData(GL_ARRAY_BUFFER,
                d->n_total_vertices*sizeof(vec2),
                d->o_texcoords,
                GL_STATIC_DRAW);
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, d->ibo_o_elements);
+  ogl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, d->ibo_o_elements);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER,
                d->n_total_indices*sizeof(unsigned int),
                d->o_indices,
@@ -70,8 +70,8 @@ decal_del( decal *d )
 {
   if(!d) return;
 
-  glDeleteBuffers(1, &d->vbo_o_texcoords);
-  glDeleteBuffers(1, &d->ibo_o_elements);
+  ogl_delete_buffers(1, &d->vbo_o_texcoords);
+  ogl_delete_buffers(1, &d->ibo_o_elements);
   free(d->o_indices);
   free(d->o_texcoords);
   free(d);
@@ -0,0 +1,776 @@
+/*----- t3d_dxt.c ------------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <t3d_dxt.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define DXT_USE_SSE2
+#endif
+
+
+static int dxt_mode = DXT_QUALITY;
+
+
+/* choose the endpoint fit and the code path, before any compression starts */
+void
+dxt_set_mode( const int mode )
+{
+  dxt_mode = mode;
+}
+
+/* the current mode */
+int
+dxt_get_mode( void )
+{
+  return dxt_mode;
+}
+
+/*---------------------------------------------------------------------------+
+  scalar reference path
+ +---------------------------------------------------------------------------*/
+static int
+convert_bit_range( const int c, const int from_bits, const int to_bits )
+{
+  int b = (1 << (from_bits - 1)) + c*((1 << to_bits) - 1);
+  return (b + (b >> from_bits)) >> from_bits;
+}
+
+static int
+rgb_to_565( const int r, const int g, const int b )
+{
+  return (convert_bit_range(r, 8, 5) << 11) |
+         (convert_bit_range(g, 8, 6) << 05) |
+         (convert_bit_range(b, 8, 5) << 00);
+}
+
+static void rgb_888_from_565( const unsigned int c, int *r, int *g, int *b )
+{
+	*r = convert_bit_range((c >> 11) & 31, 5, 8);
+	*g = convert_bit_range((c >> 05) & 63, 6, 8);
+	*b = convert_bit_range((c >> 00) & 31, 5, 8);
+}
+
+static void
+compute_color_line_STDEV( const unsigned char *const uncompressed,
+                          const int channels,
+                          float point[3], float direction[3] )
+{
+  const float inv_16 = 1.0/16.0;
+  int i;
+  float sum_r  = 0.0, sum_g  = 0.0, sum_b  = 0.0;
+  float sum_rr = 0.0, sum_gg = 0.0, sum_bb = 0.0;
+  float sum_rg = 0.0, sum_rb = 0.0, sum_gb = 0.0;
+  /* calculate all data needed for the covariance matrix (to compare with _rygdxt code) */
+  for(i = 0; i < 16*channels; i += channels) {
+    sum_r  += uncompressed[i + 0];
+    sum_rr += uncompressed[i + 0]*uncompressed[i + 0];
+    sum_g  += uncompressed[i + 1];
+    sum_gg += uncompressed[i + 1]*uncompressed[i + 1];
+    sum_b  += uncompressed[i + 2];
+    sum_bb += uncompressed[i + 2]*uncompressed[i + 2];
+    sum_rg += uncompressed[i + 0]*uncompressed[i + 1];
+    sum_rb += uncompressed[i + 0]*uncompressed[i + 2];
+    sum_gb += uncompressed[i + 1]*uncompressed[i + 2];
+  }
+  /* convert the sums to averages */
+  sum_r *= inv_16;
+  sum_g *= inv_16;
+  sum_b *= inv_16;
+  /* and convert the squares to the squares of the value - avg_value	*/
+  sum_rr -= 16.0*sum_r*sum_r;
+  sum_gg -= 16.0*sum_g*sum_g;
+  sum_bb -= 16.0*sum_b*sum_b;
+  sum_rg -= 16.0*sum_r*sum_g;
+  sum_rb -= 16.0*sum_r*sum_b;
+  sum_gb -= 16.0*sum_g*sum_b;
+  /* the point on the color line is the average */
+  point[0] = sum_r;
+  point[1] = sum_g;
+  point[2] = sum_b;
+  #if USE_COV_MAT
+  /*
+    The following idea was from ryg.
+    (https://mollyrocket.com/forums/viewtopic.php?t=392)
+    The method worked great (less RMSE than mine) most of
+    the time, but had some issues handling some simple
+    boundary cases, like full green next to full red,
+    which would generate a covariance matrix like this:
+
+    |  1  -1  0 |
+    | -1   1  0 |
+    |  0   0  0 |
+
+    For a given starting vector, the power method can
+    generate all zeros!  So no starting with {1,1,1}
+    as I was doing!  This kind of error is still a
+    slight posibillity, but will be very rare.
+  */
+  /* use the covariance matrix directly (1st iteration, don't use all 1.0 values!) */
+  sum_r = 1.0;
+  sum_g = 2.718281828;
+  sum_b = 3.141592654;
+  direction[0] = sum_r*sum_rr + sum_g*sum_rg + sum_b*sum_rb;
+  direction[1] = sum_r*sum_rg + sum_g*sum_gg + sum_b*sum_gb;
+  direction[2] = sum_r*sum_rb + sum_g*sum_gb + sum_b*sum_bb;
+  /* 2nd iteration, use results from the 1st guy */
+  sum_r = direction[0];
+  sum_g = direction[1];
+  sum_b = direction[2];
+  direction[0] = sum_r*sum_rr + sum_g*sum_rg + sum_b*sum_rb;
+  direction[1] = sum_r*sum_rg + sum_g*sum_gg + sum_b*sum_gb;
+  direction[2] = sum_r*sum_rb + sum_g*sum_gb + sum_b*sum_bb;
+  /* 3rd iteration, use results from the 2nd guy */
+  sum_r = direction[0];
+  sum_g = direction[1];
+  sum_b = direction[2];
+  direction[0] = sum_r*sum_rr + sum_g*sum_rg + sum_b*sum_rb;
+  direction[1] = sum_r*sum_rg + sum_g*sum_gg + sum_b*sum_gb;
+  direction[2] = sum_r*sum_rb + sum_g*sum_gb + sum_b*sum_bb;
+	#else
+  /* use my standard deviation method (very robust, a tiny bit slower and less accurate) */
+  direction[0] = sqrtf(sum_rr);
+  direction[1] = sqrtf(sum_gg);
+  direction[2] = sqrtf(sum_bb);
+  /* which has a greater component */
+  if(sum_gg > sum_rr) {
+    /* green has greater component, so base the other signs off of green */
+    if(sum_rg < 0.0)  direction[0] = -direction[0];
+    if(sum_gb < 0.0)  direction[2] = -direction[2];
+  }
+  else {
+    /* red has a greater component */
+    if(sum_rg < 0.0)  direction[1] = -direction[1];
+		if(sum_rb < 0.0)  direction[2] = -direction[2];
+  }
+  #endif
+}
+
+static void
+LSE_master_colors_max_min( int *cmax, int *cmin,
+                           const int channels,
+                           const unsigned char *const uncompressed )
+{
+  int i, j;
+  /* the master colors */
+  int c0[3], c1[3];
+  /* used for fitting the line */
+  float sum_x[] = {0.0, 0.0, 0.0};
+  float sum_x2[] = {0.0, 0.0, 0.0};
+  float dot_max = 1.0, dot_min = -1.0;
+  float vec_len2 = 0.0;
+  float dot;
+  /* error check */
+  if((channels < 3) || (channels > 4))
+    return;
+
+  compute_color_line_STDEV(uncompressed, channels, sum_x, sum_x2);
+  vec_len2 = 1.0/(0.00001 + sum_x2[0]*sum_x2[0] + sum_x2[1]*sum_x2[1] + sum_x2[2]*sum_x2[2]);
+  /* finding the max and min vector values */
+  dot_max = sum_x2[0]*uncompressed[0] +
+            sum_x2[1]*uncompressed[1] +
+            sum_x2[2]*uncompressed[2];
+  dot_min = dot_max;
+  for(i = 1; i < 16; ++i) {
+    dot = sum_x2[0]*uncompressed[i*channels + 0] +
+          sum_x2[1]*uncompressed[i*channels + 1] +
+          sum_x2[2]*uncompressed[i*channels + 2];
+    if(dot < dot_min) {
+      dot_min = dot;
+    }
+    else if(dot > dot_max) {
+      dot_max = dot;
+    }
+  }
+  /* and the offset (from the average location) */
+  dot = sum_x2[0]*sum_x[0] + sum_x2[1]*sum_x[1] + sum_x2[2]*sum_x[2];
+  dot_min -= dot;
+  dot_max -= dot;
+  /* post multiply by the scaling factor */
+  dot_min *= vec_len2;
+  dot_max *= vec_len2;
+  /* OK, build the master colors */
+  for(i = 0; i < 3; ++i) {
+    /* color 0 */
+    c0[i] = (int)(0.5 + sum_x[i] + dot_max*sum_x2[i]);
+    if(c0[i] < 0) {
+      c0[i] = 0;
+    }
+    else if(c0[i] > 255) {
+      c0[i] = 255;
+    }
+    /* color 1 */
+    c1[i] = (int)(0.5 + sum_x[i] + dot_min*sum_x2[i]);
+    if(c1[i] < 0) {
+      c1[i] = 0;
+    }
+    else if(c1[i] > 255) {
+      c1[i] = 255;
+    }
+  }
+  /* down_sample (with rounding?) */
+  i = rgb_to_565(c0[0], c0[1], c0[2]);
+  j = rgb_to_565(c1[0], c1[1], c1[2]);
+  if(i > j) {
+    *cmax = i;
+    *cmin = j;
+  }
+  else {
+    *cmax = j;
+    *cmin = i;
+  }
+}
+
+/* the speed mode fit: the bounding box of the colors, inset by 1/16 of its size */
+static void
+bbox_master_colors_max_min( int *cmax, int *cmin,
+                            const int channels,
+                            const unsigned char *const uncompressed )
+{
+  int i, c;
+  int c0[3], c1[3];
+
+  for(c = 0; c < 3; c++) {
+    c0[c] = uncompressed[c];
+    c1[c] = uncompressed[c];
+  }
+  for(i = 1; i < 16; i++) {
+    for(c = 0; c < 3; c++) {
+      int v = uncompressed[i*channels + c];
+      if(v > c0[c])  c0[c] = v;
+      if(v < c1[c])  c1[c] = v;
+    }
+  }
+  for(c = 0; c < 3; c++) {
+    int inset = (c0[c] - c1[c]) >> 4;
+    c0[c] -= inset;
+    c1[c] += inset;
+  }
+
+  /* 565 keeps the order of the channels, c0 is never below c1 */
+  *cmax = rgb_to_565(c0[0], c0[1], c0[2]);
+  *cmin = rgb_to_565(c1[0], c1[1], c1[2]);
+}
+
+static void
+compress_DDS_color_block( const int channels,
+                          const int speed,
+                          const unsigned char *const uncompressed,
+                          unsigned char compressed[8] )
+{
+  /* variables */
+  int i;
+  int next_bit;
+  int enc_c0 = 0, enc_c1 = 0;
+  int c0[4], c1[4];
+  float color_line[] = {0.0, 0.0, 0.0, 0.0};
+  float vec_len2 = 0.0, dot_offset = 0.0;
+  /* stupid order */
+  int swizzle4[] = {0, 2, 3, 1};
+  /* get the master colors */
+  if(speed)
+    bbox_master_colors_max_min(&enc_c0, &enc_c1, channels, uncompressed);
+  else
+    LSE_master_colors_max_min(&enc_c0, &enc_c1, channels, uncompressed);
+  /* store the 565 color 0 and color 1 */
+  compressed[0] = (enc_c0 >> 0) & 255;
+  compressed[1] = (enc_c0 >> 8) & 255;
+  compressed[2] = (enc_c1 >> 0) & 255;
+  compressed[3] = (enc_c1 >> 8) & 255;
+  /* zero out the compressed data */
+  compressed[4] = 0;
+  compressed[5] = 0;
+  compressed[6] = 0;
+  compressed[7] = 0;
+  /* reconstitute the master color vectors */
+  rgb_888_from_565(enc_c0, &c0[0], &c0[1], &c0[2]);
+  rgb_888_from_565(enc_c1, &c1[0], &c1[1], &c1[2]);
+  /* the new vector */
+  vec_len2 = 0.0;
+  for(i = 0; i < 3; ++i) {
+    color_line[i] = (float)(c1[i] - c0[i]);
+    vec_len2 += color_line[i] * color_line[i];
+  }
+	if(vec_len2 > 0.0) {
+    vec_len2 = 1.0/vec_len2;
+  }
+  /* pre-proform the scaling */
+  color_line[0] *= vec_len2;
+  color_line[1] *= vec_len2;
+  color_line[2] *= vec_len2;
+  /* compute the offset (constant) portion of the dot product	*/
+  dot_offset = color_line[0]*c0[0] + color_line[1]*c0[1] + color_line[2]*c0[2];
+  /* store the rest of the bits	*/
+  next_bit = 8*4;
+  for(i = 0; i < 16; ++i) {
+    /* find the dot product of this color, place it on the line (should be [-1,1])	*/
+    int next_value = 0;
+    float dot_product = color_line[0]*uncompressed[i*channels + 0] +
+                        color_line[1]*uncompressed[i*channels + 1] +
+                        color_line[2]*uncompressed[i*channels + 2] - dot_offset;
+    /* map to [0,3] */
+    next_value = (int)(dot_product*3.0 + 0.5);
+    if(next_value > 3) {
+      next_value = 3;
+    }
+    else if(next_value < 0) {
+      next_value = 0;
+    }
+    /* OK, store this value */
+    compressed[next_bit >> 3] |= swizzle4[next_value] << (next_bit & 7);
+    next_bit += 2;
+  }
+}
+
+static void
+compress_DDS_alpha_block( const unsigned char *const uncompressed,
+                          unsigned char compressed[8] )
+{
+  /* variables */
+  int i;
+  int next_bit;
+  int a0, a1;
+  float scale_me;
+  /* stupid order */
+  int swizzle8[] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+  /* get the alpha limits (a0 > a1) */
+  a0 = a1 = uncompressed[3];
+  for(i = 4+3; i < 16*4; i += 4) {
+    if(uncompressed[i] > a0) {
+      a0 = uncompressed[i];
+    }
+    else if(uncompressed[i] < a1) {
+      a1 = uncompressed[i];
+    }
+  }
+  /* store those limits, and zero the rest of the compressed dataset */
+  compressed[0] = a0;
+  compressed[1] = a1;
+  /* zero out the compressed data */
+  compressed[2] = 0;
+  compressed[3] = 0;
+  compressed[4] = 0;
+  compressed[5] = 0;
+  compressed[6] = 0;
+  compressed[7] = 0;
+  /* store the all of the alpha values */
+  next_bit = 8*2;
+  scale_me = 7.9999/(a0 - a1);
+  for(i = 3; i < 16*4; i += 4) {
+    /* convert this alpha value to a 3 bit number */
+    int svalue;
+    int value = (int)((uncompressed[i] - a1)*scale_me);
+    svalue = swizzle8[value&7];
+    /* OK, store this value, start with the 1st byte */
+    compressed[next_bit >> 3] |= svalue << (next_bit & 7);
+    if((next_bit & 7) > 5) {
+      /* spans 2 bytes, fill in the start of the 2nd byte */
+      compressed[1 + (next_bit >> 3)] |= svalue >> (8 - (next_bit & 7));
+    }
+    next_bit += 3;
+  }
+}
+
+#ifdef DXT_USE_SSE2
+/*---------------------------------------------------------------------------+
+  SSE2 path, a block is 16 RGBA pixels in 4 registers.
+  the sums are integer and the dot products use the same float (and double)
+  operations in the same order as the scalar path, so the blocks come out
+  bit identical.
+ +---------------------------------------------------------------------------*/
+
+/* sum of the 4 int lanes */
+static int
+dxt_sse_hsum( __m128i v )
+{
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(v);
+}
+
+/* the r, g and b of 4 pixels, one 32 bits lane each */
+static void
+dxt_sse_split( const __m128i px, __m128i *r, __m128i *g, __m128i *b )
+{
+  const __m128i mask = _mm_set1_epi32(0xff);
+  *r = _mm_and_si128(px, mask);
+  *g = _mm_and_si128(_mm_srli_epi32(px, 8), mask);
+  *b = _mm_and_si128(_mm_srli_epi32(px, 16), mask);
+}
+
+/* d0*r + d1*g + d2*b of 4 pixels, scalar order */
+static __m128
+dxt_sse_dot( const __m128i px, const float d0, const float d1, const float d2 )
+{
+  __m128i r, g, b;
+  dxt_sse_split(px, &r, &g, &b);
+
+  return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(d0), _mm_cvtepi32_ps(r)),
+                               _mm_mul_ps(_mm_set1_ps(d1), _mm_cvtepi32_ps(g))),
+                    _mm_mul_ps(_mm_set1_ps(d2), _mm_cvtepi32_ps(b)));
+}
+
+/* same as compute_color_line_STDEV, the sums taken 4 pixels at a time */
+static void
+dxt_sse_color_line( const __m128i px[4], float point[3], float direction[3] )
+{
+  const float inv_16 = 1.0/16.0;
+  __m128i s_r = _mm_setzero_si128(), s_g = s_r, s_b = s_r;
+  __m128i s_rr = s_r, s_gg = s_r, s_bb = s_r;
+  __m128i s_rg = s_r, s_rb = s_r, s_gb = s_r;
+  int i;
+
+  for(i = 0; i < 4; i++) {
+    __m128i r, g, b;
+    dxt_sse_split(px[i], &r, &g, &b);
+
+    s_r = _mm_add_epi32(s_r, r);
+    s_g = _mm_add_epi32(s_g, g);
+    s_b = _mm_add_epi32(s_b, b);
+    /* the high 16 bits of a lane are 0, madd is a 32 bits multiply */
+    s_rr = _mm_add_epi32(s_rr, _mm_madd_epi16(r, r));
+    s_gg = _mm_add_epi32(s_gg, _mm_madd_epi16(g, g));
+    s_bb = _mm_add_epi32(s_bb, _mm_madd_epi16(b, b));
+    s_rg = _mm_add_epi32(s_rg, _mm_madd_epi16(r, g));
+    s_rb = _mm_add_epi32(s_rb, _mm_madd_epi16(r, b));
+    s_gb = _mm_add_epi32(s_gb, _mm_madd_epi16(g, b));
+  }
+
+  /* exact below 2^24, as the float sums of the scalar path */
+  float sum_r = (float)dxt_sse_hsum(s_r);
+  float sum_g = (float)dxt_sse_hsum(s_g);
+  float sum_b = (float)dxt_sse_hsum(s_b);
+  float sum_rr = (float)dxt_sse_hsum(s_rr);
+  float sum_gg = (float)dxt_sse_hsum(s_gg);
+  float sum_bb = (float)dxt_sse_hsum(s_bb);
+  float sum_rg = (float)dxt_sse_hsum(s_rg);
+  float sum_rb = (float)dxt_sse_hsum(s_rb);
+  float sum_gb = (float)dxt_sse_hsum(s_gb);
+
+  sum_r *= inv_16;
+  sum_g *= inv_16;
+  sum_b *= inv_16;
+  sum_rr -= 16.0*sum_r*sum_r;
+  sum_gg -= 16.0*sum_g*sum_g;
+  sum_bb -= 16.0*sum_b*sum_b;
+  sum_rg -= 16.0*sum_r*sum_g;
+  sum_rb -= 16.0*sum_r*sum_b;
+  sum_gb -= 16.0*sum_g*sum_b;
+  point[0] = sum_r;
+  point[1] = sum_g;
+  point[2] = sum_b;
+
+  direction[0] = sqrtf(sum_rr);
+  direction[1] = sqrtf(sum_gg);
+  direction[2] = sqrtf(sum_bb);
+  if(sum_gg > sum_rr) {
+    if(sum_rg < 0.0)  direction[0] = -direction[0];
+    if(sum_gb < 0.0)  direction[2] = -direction[2];
+  }
+  else {
+    if(sum_rg < 0.0)  direction[1] = -direction[1];
+    if(sum_rb < 0.0)  direction[2] = -direction[2];
+  }
+}
+
+/* same as LSE_master_colors_max_min */
+static void
+dxt_sse_fit( const __m128i px[4], int *cmax, int *cmin )
+{
+  int i, j;
+  int c0[3], c1[3];
+  float sum_x[3], sum_x2[3];
+  float dot_max, dot_min, dot, vec_len2;
+  float lanes[4];
+
+  dxt_sse_color_line(px, sum_x, sum_x2);
+  vec_len2 = 1.0/(0.00001 + sum_x2[0]*sum_x2[0] + sum_x2[1]*sum_x2[1] + sum_x2[2]*sum_x2[2]);
+
+  __m128 d = dxt_sse_dot(px[0], sum_x2[0], sum_x2[1], sum_x2[2]);
+  __m128 d_max = d, d_min = d;
+  for(i = 1; i < 4; i++) {
+    d = dxt_sse_dot(px[i], sum_x2[0], sum_x2[1], sum_x2[2]);
+    d_max = _mm_max_ps(d_max, d);
+    d_min = _mm_min_ps(d_min, d);
+  }
+  _mm_storeu_ps(lanes, d_max);
+  dot_max = lanes[0];
+  for(i = 1; i < 4; i++)
+    if(lanes[i] > dot_max)  dot_max = lanes[i];
+  _mm_storeu_ps(lanes, d_min);
+  dot_min = lanes[0];
+  for(i = 1; i < 4; i++)
+    if(lanes[i] < dot_min)  dot_min = lanes[i];
+
+  dot = sum_x2[0]*sum_x[0] + sum_x2[1]*sum_x[1] + sum_x2[2]*sum_x[2];
+  dot_min -= dot;
+  dot_max -= dot;
+  dot_min *= vec_len2;
+  dot_max *= vec_len2;
+  for(i = 0; i < 3; ++i) {
+    c0[i] = (int)(0.5 + sum_x[i] + dot_max*sum_x2[i]);
+    if(c0[i] < 0)  c0[i] = 0;
+    else if(c0[i] > 255)  c0[i] = 255;
+    c1[i] = (int)(0.5 + sum_x[i] + dot_min*sum_x2[i]);
+    if(c1[i] < 0)  c1[i] = 0;
+    else if(c1[i] > 255)  c1[i] = 255;
+  }
+  i = rgb_to_565(c0[0], c0[1], c0[2]);
+  j = rgb_to_565(c1[0], c1[1], c1[2]);
+  if(i > j) {
+    *cmax = i;
+    *cmin = j;
+  }
+  else {
+    *cmax = j;
+    *cmin = i;
+  }
+}
+
+/* same as bbox_master_colors_max_min, the min and max of all 16 pixels at once */
+static void
+dxt_sse_bbox( const __m128i px[4], int *cmax, int *cmin )
+{
+  __m128i hi = _mm_max_epu8(_mm_max_epu8(px[0], px[1]), _mm_max_epu8(px[2], px[3]));
+  __m128i lo = _mm_min_epu8(_mm_min_epu8(px[0], px[1]), _mm_min_epu8(px[2], px[3]));
+  hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(1, 0, 3, 2)));
+  lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+  hi = _mm_max_epu8(hi, _mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 3, 0, 1)));
+  lo = _mm_min_epu8(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+
+  unsigned int h = (unsigned int)_mm_cvtsi128_si32(hi);
+  unsigned int l = (unsigned int)_mm_cvtsi128_si32(lo);
+  int c0[3], c1[3], c;
+
+  for(c = 0; c < 3; c++) {
+    c0[c] = (h >> (8*c)) & 0xff;
+    c1[c] = (l >> (8*c)) & 0xff;
+    int inset = (c0[c] - c1[c]) >> 4;
+    c0[c] -= inset;
+    c1[c] += inset;
+  }
+
+  *cmax = rgb_to_565(c0[0], c0[1], c0[2]);
+  *cmin = rgb_to_565(c1[0], c1[1], c1[2]);
+}
+
+/* same as compress_DDS_color_block on an RGBA block */
+static void
+dxt_sse_color_block( const int speed,
+                     const unsigned char *const uncompressed,
+                     unsigned char compressed[8] )
+{
+  static const int swizzle4[] = {0, 2, 3, 1};
+  int i;
+  int enc_c0 = 0, enc_c1 = 0;
+  int c0[3], c1[3];
+  float color_line[3];
+  float vec_len2 = 0.0, dot_offset;
+  short values[16];
+  __m128i px[4];
+
+  for(i = 0; i < 4; i++)
+    px[i] = _mm_loadu_si128((const __m128i *)&uncompressed[16*i]);
+
+  if(speed)
+    dxt_sse_bbox(px, &enc_c0, &enc_c1);
+  else
+    dxt_sse_fit(px, &enc_c0, &enc_c1);
+
+  compressed[0] = (enc_c0 >> 0) & 255;
+  compressed[1] = (enc_c0 >> 8) & 255;
+  compressed[2] = (enc_c1 >> 0) & 255;
+  compressed[3] = (enc_c1 >> 8) & 255;
+
+  rgb_888_from_565(enc_c0, &c0[0], &c0[1], &c0[2]);
+  rgb_888_from_565(enc_c1, &c1[0], &c1[1], &c1[2]);
+  for(i = 0; i < 3; ++i) {
+    color_line[i] = (float)(c1[i] - c0[i]);
+    vec_len2 += color_line[i] * color_line[i];
+  }
+  if(vec_len2 > 0.0)  vec_len2 = 1.0/vec_len2;
+  color_line[0] *= vec_len2;
+  color_line[1] *= vec_len2;
+  color_line[2] *= vec_len2;
+  dot_offset = color_line[0]*c0[0] + color_line[1]*c0[1] + color_line[2]*c0[2];
+
+  /* (int)(dot*3.0 + 0.5) is computed in double, 2 lanes at a time */
+  const __m128d three = _mm_set1_pd(3.0);
+  const __m128d half = _mm_set1_pd(0.5);
+  const __m128 offset = _mm_set1_ps(dot_offset);
+  for(i = 0; i < 4; i++) {
+    __m128 d = _mm_sub_ps(dxt_sse_dot(px[i], color_line[0], color_line[1], color_line[2]), offset);
+    __m128i v_lo = _mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(_mm_cvtps_pd(d), three), half));
+    __m128i v_hi = _mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(d, d)), three), half));
+    __m128i v = _mm_packs_epi32(_mm_unpacklo_epi64(v_lo, v_hi), _mm_setzero_si128());
+    v = _mm_min_epi16(_mm_max_epi16(v, _mm_setzero_si128()), _mm_set1_epi16(3));
+    _mm_storel_epi64((__m128i *)&values[4*i], v);
+  }
+
+  unsigned int bits = 0;
+  for(i = 0; i < 16; i++)
+    bits |= (unsigned int)swizzle4[values[i]] << (2*i);
+  compressed[4] = bits & 255;
+  compressed[5] = (bits >> 8) & 255;
+  compressed[6] = (bits >> 16) & 255;
+  compressed[7] = (bits >> 24) & 255;
+}
+#endif
+
+/* copy a 4x4 block (clipped at the image border) into 16 RGBA pixels,
+   missing pixels repeat the first one */
+static void
+dxt_gather_block( unsigned char ublock[64],
+                  const unsigned char *const uncompressed,
+                  const int width, const int height, const int channels,
+                  const int i, const int j )
+{
+  int x, y;
+  int idx = 0;
+  int mx = 4, my = 4;
+  /* for channels == 1 or 2, I do not step forward for R,G,B values */
+  int chan_step = channels < 3 ? 0 : 1;
+  /* # channels = 1 or 3 have no alpha, 2 & 4 do have alpha */
+  int has_alpha = 1 - (channels & 1);
+
+  if(j + 4 >= height)  my = height - j;
+  if(i + 4 >= width)   mx = width - i;
+
+  for(y = 0; y < my; ++y) {
+    const unsigned char *row = &uncompressed[((j + y)*width + i)*channels];
+
+    /* the common case, a whole RGBA row is one copy */
+    if(mx == 4 && channels == 4) {
+      memcpy(&ublock[idx], row, 16);
+      idx += 16;
+      continue;
+    }
+
+    for(x = 0; x < mx; ++x) {
+      const unsigned char *p = &row[x*channels];
+      ublock[idx++] = p[0];
+      ublock[idx++] = p[chan_step];
+      ublock[idx++] = p[chan_step + chan_step];
+      ublock[idx++] = has_alpha ? p[channels - 1] : 255;
+    }
+    for(x = mx; x < 4; ++x) {
+      memcpy(&ublock[idx], ublock, 4);
+      idx += 4;
+    }
+  }
+  for(y = my; y < 4; ++y) {
+    for(x = 0; x < 4; ++x) {
+      memcpy(&ublock[idx], ublock, 4);
+      idx += 4;
+    }
+  }
+}
+
+/* compress an image, DXT1 (8 bytes per 4x4 block) for 1 or 3 channels,
+   DXT5 (16 bytes per block) for 2 or 4 channels */
+unsigned char *
+dxt_compress( const unsigned char *const uncompressed,
+              const int width, const int height, const int channels,
+              int *out_size )
+{
+  unsigned char *compressed;
+  unsigned char ublock[16*4];
+  int i, j;
+  int speed = dxt_mode & DXT_SPEED;
+  int alpha = (channels & 1) == 0;
+  int block_size = alpha ? 16 : 8;
+
+  /* error check */
+  *out_size = 0;
+  if((width < 1) || (height < 1) || (NULL == uncompressed) ||
+     (channels < 1) || (channels > 4)) {
+    return NULL;
+  }
+
+  *out_size = ((width + 3) >> 2)*((height + 3) >> 2)*block_size;
+  compressed = (unsigned char *)malloc(*out_size);
+  unsigned char *out = compressed;
+
+  for(j = 0; j < height; j += 4) {
+    for(i = 0; i < width; i += 4) {
+      dxt_gather_block(ublock, uncompressed, width, height, channels, i, j);
+
+      if(alpha) {
+        compress_DDS_alpha_block(ublock, out);
+        out += 8;
+      }
+
+#ifdef DXT_USE_SSE2
+      if(!(dxt_mode & DXT_NO_SIMD))
+        dxt_sse_color_block(speed, ublock, out);
+      else
+#endif
+        compress_DDS_color_block(4, speed, ublock, out);
+      out += 8;
+    }
+  }
+
+  return compressed;
+}
+
+/* halve an image with a 2x2 box filter, a side of 1 stays 1 */
+void
+dxt_downsample( unsigned char *resampled,
+                const unsigned char *const orig,
+                const int width, const int height, const int channels )
+{
+  int mip_w = width > 1 ? width/2 : 1;
+  int mip_h = height > 1 ? height/2 : 1;
+  /* a side of 1 samples its pixel twice, the box is always 4 samples */
+  int step_x = width > 1 ? channels : 0;
+  int step_y = height > 1 ? width*channels : 0;
+  int i, j, x, c;
+
+  for(j = 0; j < mip_h; j++) {
+    const unsigned char *r0 = &orig[2*j*step_y];
+    const unsigned char *r1 = r0 + step_y;
+    unsigned char *o = &resampled[j*mip_w*channels];
+    i = 0;
+
+#ifdef DXT_USE_SSE2
+    /* RGBA, 4 output pixels from 2 x 8 input pixels */
+    if(!(dxt_mode & DXT_NO_SIMD) && channels == 4 && step_x) {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i rnd = _mm_set1_epi16(2);
+      for(; i + 4 <= mip_w; i += 4) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)&r0[8*i]);
+        __m128i a1 = _mm_loadu_si128((const __m128i *)&r0[8*i + 16]);
+        __m128i b0 = _mm_loadu_si128((const __m128i *)&r1[8*i]);
+        __m128i b1 = _mm_loadu_si128((const __m128i *)&r1[8*i + 16]);
+
+        /* rows summed in 16 bits, then the pixel pairs */
+        __m128i s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+        __m128i s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+        __m128i s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+        __m128i s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+        s0 = _mm_add_epi16(s0, _mm_srli_si128(s0, 8));
+        s1 = _mm_add_epi16(s1, _mm_srli_si128(s1, 8));
+        s2 = _mm_add_epi16(s2, _mm_srli_si128(s2, 8));
+        s3 = _mm_add_epi16(s3, _mm_srli_si128(s3, 8));
+
+        __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s0, s1), rnd), 2);
+        __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(s2, s3), rnd), 2);
+        _mm_storeu_si128((__m128i *)&o[4*i], _mm_packus_epi16(lo, hi));
+      }
+    }
+#endif
+
+    /* any channel count, the rest of the row */
+    for(x = i; x < mip_w; x++) {
+      const unsigned char *a = &r0[2*x*step_x];
+      const unsigned char *b = &r1[2*x*step_x];
+      for(c = 0; c < channels; c++)
+        o[x*channels + c] = (a[c] + a[c + step_x] + b[c] + b[c + step_x] + 2) >> 2;
+    }
+  }
+}
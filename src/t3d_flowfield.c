@@ -0,0 +1,446 @@
+/*----- t3d_flowfield.c ------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <t3d_math.h>
+#include <t3d_util.h>
+#include <t3d_thpool.h>
+#include <t3d_patchmap.h>
+#include <t3d_flowfield.h>
+
+
+#define FF_WALK_COST  10
+
+/* the costs go over the sides, the steps over the corners too */
+static const int ff_dx[8] = { -1, 0, 1, 0, -1, 1, 1, -1 };
+static const int ff_dy[8] = { 0, 1, 0, -1, 1, 1, -1, -1 };
+
+/* the sides of a tile a lowered border cell is read from */
+enum {
+  FF_LEFT = 1,
+  FF_UP = 2,
+  FF_RIGHT = 4,
+  FF_DOWN = 8
+};
+
+
+static void
+ff_del( flowfield *ff )
+{
+  int i;
+
+  for(i = 0; i < ff->w_tiles*ff->h_tiles; i++)
+    free(ff->tiles[i].heap);
+
+  pthread_mutex_destroy(&ff->lock);
+  free(ff->tiles);
+  free(ff->turn);
+  free(ff->runs);
+  free(ff->costs);
+  free(ff->dirs);
+  free(ff);
+}
+
+static inline int
+ff_walkable( const patchmap *pm, const int x, const int y )
+{
+  return x >= 0 && y >= 0 && x < pm->w_cells && y < pm->h_cells &&
+         pm->cells[y*pm->w_cells + x].status;
+}
+
+static void
+ff_heap_push( fftile *t, const int cost, const int cell )
+{
+  int pos;
+
+  if(t->n_heap == t->heap_capacity) {
+    t->heap_capacity = t->heap_capacity ? t->heap_capacity*2 : 256;
+    t->heap = (int *)realloc(t->heap, sizeof(int)*2*t->heap_capacity);
+  }
+
+  for(pos = t->n_heap++; pos > 0; ) {
+    int parent = (pos - 1) >> 1;
+    if(t->heap[2*parent] <= cost)  break;
+
+    t->heap[2*pos] = t->heap[2*parent];
+    t->heap[2*pos + 1] = t->heap[2*parent + 1];
+    pos = parent;
+  }
+  t->heap[2*pos] = cost;
+  t->heap[2*pos + 1] = cell;
+}
+
+static int
+ff_heap_pop( fftile *t, int *cost )
+{
+  int cell = t->heap[1];
+  int f = t->heap[2*(--t->n_heap)];
+  int last = t->heap[2*t->n_heap + 1];
+  int pos = 0;
+
+  *cost = t->heap[0];
+  for(;;) {
+    int child = 2*pos + 1;
+    if(child >= t->n_heap)  break;
+    if(child + 1 < t->n_heap && t->heap[2*(child + 1)] < t->heap[2*child])  child++;
+    if(t->heap[2*child] >= f)  break;
+
+    t->heap[2*pos] = t->heap[2*child];
+    t->heap[2*pos + 1] = t->heap[2*child + 1];
+    pos = child;
+  }
+  t->heap[2*pos] = f;
+  t->heap[2*pos + 1] = last;
+
+  return cell;
+}
+
+/* a cell of the tile is reached with cost, the sides of the tiles reading
+   it are added to sides if it is lowered */
+static void
+ff_lower( fftile *t, const int x, const int y, const int cost, int *sides )
+{
+  flowfield *ff = t->ff;
+  int cell = y*ff->w_cells + x;
+
+  if(cost >= ff->costs[cell])  return;
+
+  ff->costs[cell] = cost;
+  ff_heap_push(t, cost, cell);
+
+  if(x == t->x0 && x > 0)  *sides |= FF_LEFT;
+  if(x == t->x1 && x < ff->w_cells - 1)  *sides |= FF_RIGHT;
+  if(y == t->y0 && y > 0)  *sides |= FF_DOWN;
+  if(y == t->y1 && y < ff->h_cells - 1)  *sides |= FF_UP;
+}
+
+/* the costs over the border of a tile, from a cell outside it */
+static void
+ff_seed( fftile *t, const int x, const int y, const int ox, const int oy, int *sides )
+{
+  flowfield *ff = t->ff;
+  int cost = ff->costs[oy*ff->w_cells + ox];
+
+  if(cost != FF_UNREACHED && ff_walkable(ff->pm, x, y) && ff_walkable(ff->pm, ox, oy))
+    ff_lower(t, x, y, cost + FF_WALK_COST, sides);
+}
+
+/* relax the costs of a tile from the goal and the costs over its border,
+   the tiles around it are not written. return the sides lowered */
+static int
+ff_relax_tile( fftile *t )
+{
+  flowfield *ff = t->ff;
+  const patchmap *pm = ff->pm;
+  int w = ff->w_cells;
+  int sides = 0;
+  int x, y, i;
+
+  t->n_heap = 0;
+
+  if(ff->goal.x >= t->x0 && ff->goal.x <= t->x1 && ff->goal.y >= t->y0 && ff->goal.y <= t->y1 &&
+     ff_walkable(pm, ff->goal.x, ff->goal.y))
+    ff_lower(t, ff->goal.x, ff->goal.y, 0, &sides);
+
+  for(x = t->x0; x <= t->x1; x++) {
+    if(t->y0 > 0)  ff_seed(t, x, t->y0, x, t->y0 - 1, &sides);
+    if(t->y1 < ff->h_cells - 1)  ff_seed(t, x, t->y1, x, t->y1 + 1, &sides);
+  }
+  for(y = t->y0; y <= t->y1; y++) {
+    if(t->x0 > 0)  ff_seed(t, t->x0, y, t->x0 - 1, y, &sides);
+    if(t->x1 < ff->w_cells - 1)  ff_seed(t, t->x1, y, t->x1 + 1, y, &sides);
+  }
+
+  /* every step costs the same, the lowered cells spread in cost order */
+  while(t->n_heap > 0) {
+    int cost;
+    int cell = ff_heap_pop(t, &cost);
+    if(cost > ff->costs[cell])  continue;
+
+    int cx = cell%w;
+    int cy = cell/w;
+    for(i = 0; i < 4; i++) {
+      x = cx + ff_dx[i];
+      y = cy + ff_dy[i];
+      if(x < t->x0 || y < t->y0 || x > t->x1 || y > t->y1 || !ff_walkable(pm, x, y))  continue;
+
+      ff_lower(t, x, y, cost + FF_WALK_COST, &sides);
+    }
+  }
+
+  return sides;
+}
+
+/* the neighbor of the lowest cost each cell of a tile steps to, corners
+   are cut only between walkable cells */
+static void
+ff_direct_tile( fftile *t )
+{
+  flowfield *ff = t->ff;
+  const patchmap *pm = ff->pm;
+  int w = ff->w_cells;
+  int x, y, i;
+
+  for(y = t->y0; y <= t->y1; y++) {
+    for(x = t->x0; x <= t->x1; x++) {
+      int cell = y*w + x;
+      int best = -1;
+      int best_cost = ff->costs[cell];
+
+      if(best_cost != FF_UNREACHED && best_cost > 0) {
+        for(i = 0; i < 8; i++) {
+          int nx = x + ff_dx[i];
+          int ny = y + ff_dy[i];
+          if(!ff_walkable(pm, nx, ny))  continue;
+          if(i >= 4 && (!ff_walkable(pm, nx, y) || !ff_walkable(pm, x, ny)))  continue;
+
+          if(ff->costs[ny*w + nx] < best_cost) {
+            best_cost = ff->costs[ny*w + nx];
+            best = i;
+          }
+        }
+      }
+      ff->dirs[cell] = (signed char)best;
+    }
+  }
+}
+
+/* pick the tiles of the next turn and split them in runs, return the runs.
+   0 once the build is done */
+static int
+ff_start_turn( flowfield *ff )
+{
+  int n_tiles = ff->w_tiles*ff->h_tiles;
+  int i, n = 0;
+
+  pthread_mutex_lock(&ff->lock);
+
+  /* the other color, only its tiles were reached by the last turn */
+  if(!ff->directing) {
+    ff->color ^= 1;
+    for(i = 0; i < n_tiles; i++) {
+      fftile *t = &ff->tiles[i];
+      if(t->dirty && t->color == ff->color) {
+        t->dirty = 0;
+        ff->turn[n++] = i;
+      }
+    }
+    if(!n)  ff->directing = 1;
+  }
+  /* the costs are done, all the directions in one turn */
+  else if(!ff->ready) {
+    ff->ready = 1;
+    ff->refs--;
+  }
+
+  if(ff->directing && !ff->ready) {
+    for(i = 0; i < n_tiles; i++)
+      ff->turn[n++] = i;
+  }
+
+  /* the turn lists the tiles in order, a run is a block of rows */
+  int n_runs = n < ff->max_runs ? n : ff->max_runs;
+  for(i = 0; i < n_runs; i++) {
+    ff->runs[i].first = i*n/n_runs;
+    ff->runs[i].n = (i + 1)*n/n_runs - ff->runs[i].first;
+  }
+
+  ff->n_left = n_runs;
+  ff->n_turns += n_runs > 0;
+  ff->n_runs += n_runs;
+  int refs = ff->refs;
+
+  pthread_mutex_unlock(&ff->lock);
+
+  if(!refs)  ff_del(ff);
+
+  return n_runs;
+}
+
+/* relax or direct the tiles of a run, return 1 if it was the last of the turn */
+static int
+ff_run_tiles( ffrun *r )
+{
+  flowfield *ff = r->ff;
+  const int *ids = &ff->turn[r->first];
+  int i;
+
+  for(i = 0; i < r->n; i++) {
+    fftile *t = &ff->tiles[ids[i]];
+
+    if(ff->directing)
+      ff_direct_tile(t);
+    else
+      t->sides = ff_relax_tile(t);
+  }
+
+  /* one lock a run, the directing turn marks nothing */
+  pthread_mutex_lock(&ff->lock);
+  for(i = 0; i < r->n && !ff->directing; i++) {
+    int id = ids[i];
+    int sides = ff->tiles[id].sides;
+    if(sides & FF_LEFT)   ff->tiles[id - 1].dirty = 1;
+    if(sides & FF_RIGHT)  ff->tiles[id + 1].dirty = 1;
+    if(sides & FF_DOWN)   ff->tiles[id - ff->w_tiles].dirty = 1;
+    if(sides & FF_UP)     ff->tiles[id + ff->w_tiles].dirty = 1;
+  }
+  int last = --ff->n_left == 0;
+  pthread_mutex_unlock(&ff->lock);
+
+  return last;
+}
+
+static void ff_run_job( void *arg );
+
+/* run the turns, a turn ending on a worker goes on there */
+static void
+ff_run( flowfield *ff )
+{
+  int i, n;
+
+  while((n = ff_start_turn(ff)) > 0) {
+    int last = 0;
+
+    /* the turn can not end before its last run is handed out */
+    for(i = 0; i < n; i++) {
+      ffrun *r = &ff->runs[i];
+      if(!ff->pool || thpool_add_job(ff->pool, &ff_run_job, r, 0) != 0)
+        last |= ff_run_tiles(r);
+    }
+    if(!last)  return;
+  }
+}
+
+/* worker - a run of the turn */
+static void
+ff_run_job( void *arg )
+{
+  ffrun *r = (ffrun *)arg;
+
+  if(ff_run_tiles(r))  ff_run(r->ff);
+}
+
+/* create the flow field to a goal cell and start to build it on a thread pool (or NULL),
+   the caller holds a reference */
+flowfield *
+ff_new( const patchmap *pm, const ivec2 *goal, thpool *pool )
+{
+  flowfield *ff = (flowfield *)calloc(1, sizeof(flowfield));
+  int i, tx, ty;
+
+  ff->w_cells = pm->w_cells;
+  ff->h_cells = pm->h_cells;
+  ivec2_cpy(&ff->goal, goal);
+  ff->costs = (int *)malloc(sizeof(int)*ff->w_cells*ff->h_cells);
+  ff->dirs = (signed char *)malloc(sizeof(signed char)*ff->w_cells*ff->h_cells);
+
+  /* the tiles are the geopatches, the last of a row or column takes the rest */
+  int w_tile = pm->w_pch_cells > 0 ? pm->w_pch_cells : pm->w_cells;
+  int h_tile = pm->h_pch_cells > 0 ? pm->h_pch_cells : pm->h_cells;
+  ff->w_tiles = ff->w_cells/w_tile;
+  ff->h_tiles = ff->h_cells/h_tile;
+  if(ff->w_tiles < 1)  ff->w_tiles = 1;
+  if(ff->h_tiles < 1)  ff->h_tiles = 1;
+  ff->tiles = (fftile *)calloc(ff->w_tiles*ff->h_tiles, sizeof(fftile));
+  ff->turn = (int *)malloc(sizeof(int)*ff->w_tiles*ff->h_tiles);
+  /* the pools are made a thread a core */
+  ff->max_runs = pool ? util_cpu_count() : 1;
+  if(ff->max_runs < 1)  ff->max_runs = 1;
+  ff->runs = (ffrun *)malloc(sizeof(ffrun)*ff->max_runs);
+
+  if(!ff->costs || !ff->dirs || !ff->tiles || !ff->turn || !ff->runs) {
+    fprintf(stderr, "line %d: Can not allocate memory\n", __LINE__);
+    exit(EXIT_FAILURE);
+  }
+
+  for(i = 0; i < ff->w_cells*ff->h_cells; i++)
+    ff->costs[i] = FF_UNREACHED;
+
+  for(ty = 0; ty < ff->h_tiles; ty++) {
+    for(tx = 0; tx < ff->w_tiles; tx++) {
+      fftile *t = &ff->tiles[ty*ff->w_tiles + tx];
+      t->x0 = tx*w_tile;
+      t->y0 = ty*h_tile;
+      t->x1 = tx == ff->w_tiles - 1 ? ff->w_cells - 1 : t->x0 + w_tile - 1;
+      t->y1 = ty == ff->h_tiles - 1 ? ff->h_cells - 1 : t->y0 + h_tile - 1;
+      t->color = (tx + ty)%2;
+      t->ff = ff;
+    }
+  }
+  for(i = 0; i < ff->max_runs; i++)
+    ff->runs[i].ff = ff;
+
+  /* the build starts from the tile of the goal */
+  int gx = goal->x/w_tile;
+  int gy = goal->y/h_tile;
+  if(gx >= ff->w_tiles)  gx = ff->w_tiles - 1;
+  if(gy >= ff->h_tiles)  gy = ff->h_tiles - 1;
+  ff->tiles[gy*ff->w_tiles + gx].dirty = 1;
+  ff->color = ff->tiles[gy*ff->w_tiles + gx].color ^ 1;
+
+  ff->pm = pm;
+  ff->pool = pool;
+  /* the caller and the build */
+  ff->refs = 2;
+  pthread_mutex_init(&ff->lock, NULL);
+
+  ff_run(ff);
+
+  return ff;
+}
+
+/* take a reference to a flow field */
+flowfield *
+ff_ref( flowfield *ff )
+{
+  if(!ff)  return NULL;
+
+  pthread_mutex_lock(&ff->lock);
+  ff->refs++;
+  pthread_mutex_unlock(&ff->lock);
+
+  return ff;
+}
+
+/* drop a reference, the last one deletes the flow field from memory */
+void
+ff_release( flowfield *ff )
+{
+  if(!ff)  return;
+
+  pthread_mutex_lock(&ff->lock);
+  int refs = --ff->refs;
+  pthread_mutex_unlock(&ff->lock);
+
+  if(!refs)  ff_del(ff);
+}
+
+/* 1 once the flow field can be followed */
+int
+ff_ready( flowfield *ff )
+{
+  pthread_mutex_lock(&ff->lock);
+  int ready = ff->ready;
+  pthread_mutex_unlock(&ff->lock);
+
+  return ready;
+}
+
+/* the cell to step to from a cell, return 0 at the goal, if it is unreached or not ready */
+int
+ff_step( flowfield *ff, ivec2 *next, const ivec2 *from )
+{
+  if(!ff_ready(ff))  return 0;
+  if(from->x < 0 || from->y < 0 || from->x >= ff->w_cells || from->y >= ff->h_cells)  return 0;
+
+  int dir = ff->dirs[from->y*ff->w_cells + from->x];
+  if(dir < 0)  return 0;
+
+  next->x = from->x + ff_dx[dir];
+  next->y = from->y + ff_dy[dir];
+  return 1;
+}
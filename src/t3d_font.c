@@ -4,6 +4,8 @@
  +----------------------------------------------------------------------------*/
 
 #include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
 #define STB_TRUETYPE_IMPLEMENTATION
 #include <stb_truetype.h>
 #include <t3d_ogl.h>
@@ -11,62 +13,88 @@
 #include <t3d_util.h>
 #include <t3d_texture.h>
 #include <t3d_shader.h>
-#include <t3d_camera.h>
+#include <t3d_thpool.h>
+#include <t3d_overlay.h>
 #include <t3d_font.h>
 
 
-struct __bakedchar {
-  unsigned short x0, y0, x1, y1; /*coordinates of bbox in bitmap */
-  float xoff, yoff, xadvance;   
+#define FNT_MAX_GLYPHS   4096
+#define FNT_MAX_CODE     0xffff  /* lookup covers the BMP */
+#define FNT_PADDING      1       /* empty texels around glyphs, no bleeding */
+
+enum {
+  GLYPH_FREE = 0,               /* slot not used */
+  GLYPH_PENDING = 1,            /* placed, a worker is rasterizing it */
+  GLYPH_RASTERED = 2,           /* bitmap ready, waiting for upload */
+  GLYPH_READY = 3               /* in the atlas texture */
+};
+
+struct __glyph {
+  font *f;
+  int code;
+  int shelf;                    /* -1 for glyphs without texels (space) */
+  int state;
+
+  int x, y, w, h;               /* texels in the atlas */
+  float xoff, yoff, xadvance;
+
+  unsigned char *bitmap;        /* rasterized by a worker */
+};
+
+struct __fntshelf {
+  int y, h;                     /* atlas rows of the shelf */
+  int x;                        /* first free column */
+  int n_glyphs;
+  int n_pending;                /* glyphs not uploaded yet, the shelf can not be evicted */
+  unsigned int last_used;       /* frame the shelf was last drawn from */
 };
 
-/* store vertices in graphic card buffers */
-static void
-fnt_upload( const font *f )
-{
-  glBindBuffer(GL_ARRAY_BUFFER, f->vbo_coord);
-  /* 4 vertices (vec4 = vec2vec2) of a box, check fnt_print */
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vec4)*4, NULL, GL_DYNAMIC_DRAW);
-}
 
 /* create font struct in memory */
 font *
 fnt_new( const char *fontname,
          const float size,
          const int tex_w,
-         const int tex_h,
-         const int first_char,
-         const int count,
-         const int screen_w,
-         const int screen_h )
+         const int tex_h )
 {
   font *f = (font *)malloc(sizeof(font));
+  int i;
 
-  f->cdata = (bakedchar *)malloc(sizeof(bakedchar)*count);
   f->size = size;
   f->tex_w = tex_w;
   f->tex_h = tex_h;
-  f->first_char = first_char;
-  f->count = count;
 
-  unsigned char *buf = (unsigned char *)util_file_to_mem(fontname);
-  unsigned char *texels = (unsigned char *)malloc(sizeof(unsigned char)*tex_w*tex_h);
-  stbtt_BakeFontBitmap(buf, 0, size,
-                       texels, tex_w, tex_h,
-                       first_char, count,
-                       (stbtt_bakedchar *)f->cdata);
-  free(buf);
+  f->ttf = (const unsigned char *)util_file_view(fontname, NULL);
+  f->info = malloc(sizeof(stbtt_fontinfo));
+  stbtt_InitFont((stbtt_fontinfo *)f->info, f->ttf, stbtt_GetFontOffsetForIndex(f->ttf, 0));
+  f->scale = stbtt_ScaleForPixelHeight((stbtt_fontinfo *)f->info, size);
 
-  f->tex_id = tex_gen_red_tex(texels, tex_w, tex_h);
-  tex_set_flags(f->tex_id, TEX_USE_LINEAR|TEX_TO_BORDER);
+  f->glyphs = (glyph *)malloc(sizeof(glyph)*FNT_MAX_GLYPHS);
+  f->free_glyphs = (int *)malloc(sizeof(int)*FNT_MAX_GLYPHS);
+  for(i = 0; i < FNT_MAX_GLYPHS; i++) {
+    f->glyphs[i].state = GLYPH_FREE;
+    f->glyphs[i].bitmap = NULL;
+    f->free_glyphs[i] = FNT_MAX_GLYPHS - 1 - i;
+  }
+  f->n_free_glyphs = FNT_MAX_GLYPHS;
+  f->lookup = (unsigned short *)calloc(FNT_MAX_CODE + 1, sizeof(unsigned short));
 
-  free(texels);
+  f->shelves = (fntshelf *)malloc(sizeof(fntshelf)*tex_h);
+  f->n_shelves = 0;
+  f->shelf_bottom = 0;
 
-  /* create the vertex buffer object for font */
-  glGenBuffers(1, &f->vbo_coord);
-  fnt_upload(f);
+  f->frame = 0;
+  f->generation = 0;
 
-  mat4_set_ortho(&f->mat_proj, 0.0, (float)screen_w, 0.0, (float)screen_h, 0.0, 10.0);
+  f->pool = NULL;
+  pthread_mutex_init(&f->lock, NULL);
+  f->n_rastered = 0;
+
+  /* an empty atlas */
+  unsigned char *texels = (unsigned char *)calloc(tex_w*tex_h, sizeof(unsigned char));
+  f->tex_id = tex_gen_red_tex(texels, tex_w, tex_h);
+  tex_set_flags(f->tex_id, TEX_USE_LINEAR|TEX_TO_BORDER);
+  free(texels);
 
   return f;
 }
@@ -75,83 +103,377 @@ fnt_new( const char *fontname,
 void
 fnt_del( font *f )
 {
+  int i;
+
   if(!f)  return;
 
-  glDeleteBuffers(1, &f->vbo_coord);
-  glDeleteTextures(1, &f->tex_id);
-  free(f->cdata);
+  for(i = 0; i < FNT_MAX_GLYPHS; i++)
+    free(f->glyphs[i].bitmap);
+
+  ogl_delete_textures(1, &f->tex_id);
+  pthread_mutex_destroy(&f->lock);
+  free(f->glyphs);
+  free(f->free_glyphs);
+  free(f->lookup);
+  free(f->shelves);
+  free(f->info);
+  util_file_release((const char *)f->ttf);
   free(f);
 }
 
-/* print the text */
+/* rasterize new glyphs on the thread pool, NULL to rasterize them in place */
+void
+fnt_set_thpool( font *f, thpool *pool )
+{
+  f->pool = pool;
+}
+
+/* copy a glyph bitmap into the atlas texture */
+static void
+fnt_upload_glyph( font *f, glyph *g )
+{
+  ogl_bind_texture_for_upload(GL_TEXTURE_2D, f->tex_id);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, g->x, g->y, g->w, g->h, GL_RED, GL_UNSIGNED_BYTE, g->bitmap);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  free(g->bitmap);
+  g->bitmap = NULL;
+  g->state = GLYPH_READY;
+  f->shelves[g->shelf].n_pending--;
+  f->generation++;
+}
+
+/* worker - rasterize a glyph, stbtt only reads the font info */
+static void
+fnt_raster_job( void *arg )
+{
+  glyph *g = (glyph *)arg;
+  font *f = g->f;
+  unsigned char *bitmap = (unsigned char *)malloc(g->w*g->h);
+
+  stbtt_MakeCodepointBitmap((stbtt_fontinfo *)f->info, bitmap, g->w, g->h, g->w,
+                            f->scale, f->scale, g->code);
+
+  pthread_mutex_lock(&f->lock);
+  g->bitmap = bitmap;
+  g->state = GLYPH_RASTERED;
+  f->n_rastered++;
+  pthread_mutex_unlock(&f->lock);
+}
+
+/* once a frame before any text, upload the glyphs rasterized by the workers */
+void
+fnt_update( font *f )
+{
+  int i;
+
+  f->frame++;
+
+  pthread_mutex_lock(&f->lock);
+  for(i = 0; i < FNT_MAX_GLYPHS && f->n_rastered; i++) {
+    glyph *g = &f->glyphs[i];
+    if(g->state == GLYPH_RASTERED) {
+      fnt_upload_glyph(f, g);
+      f->n_rastered--;
+    }
+  }
+  pthread_mutex_unlock(&f->lock);
+}
+
+/* drop every glyph of a shelf, it is reused from its left side */
+static void
+fnt_evict_shelf( font *f, const int s )
+{
+  int i;
+
+  for(i = 0; i < FNT_MAX_GLYPHS; i++) {
+    glyph *g = &f->glyphs[i];
+    if(g->state != GLYPH_FREE && g->shelf == s) {
+      f->lookup[g->code] = 0;
+      g->state = GLYPH_FREE;
+      f->free_glyphs[f->n_free_glyphs++] = i;
+    }
+  }
+
+  f->shelves[s].x = 0;
+  f->shelves[s].n_glyphs = 0;
+  f->generation++;
+}
+
+/* find room for a w x h glyph, return its shelf or -1 if the atlas is full */
+static int
+fnt_pack( font *f, const int w, const int h, int *x, int *y )
+{
+  int i;
+  int best = -1;
+
+  /* the lowest shelf with room, so tall shelves stay for tall glyphs */
+  for(i = 0; i < f->n_shelves; i++) {
+    fntshelf *sh = &f->shelves[i];
+    if(sh->h >= h && sh->x + w <= f->tex_w &&
+       (best < 0 || sh->h < f->shelves[best].h))  best = i;
+  }
+
+  /* a new shelf */
+  if(best < 0 && f->shelf_bottom + h <= f->tex_h && w <= f->tex_w) {
+    best = f->n_shelves++;
+    f->shelves[best].y = f->shelf_bottom;
+    f->shelves[best].h = h;
+    f->shelves[best].x = 0;
+    f->shelves[best].n_glyphs = 0;
+    f->shelves[best].n_pending = 0;
+    f->shelves[best].last_used = f->frame;
+    f->shelf_bottom += h;
+  }
+
+  /* evict the least recently used shelf that is tall enough and not
+     drawn from this frame */
+  if(best < 0) {
+    for(i = 0; i < f->n_shelves; i++) {
+      fntshelf *sh = &f->shelves[i];
+      if(sh->h >= h && w <= f->tex_w && sh->n_pending == 0 && sh->last_used != f->frame &&
+         (best < 0 || sh->last_used < f->shelves[best].last_used))  best = i;
+    }
+    if(best < 0)  return -1;
+    fnt_evict_shelf(f, best);
+  }
+
+  fntshelf *sh = &f->shelves[best];
+  *x = sh->x;
+  *y = sh->y;
+  sh->x += w;
+  sh->n_glyphs++;
+
+  return best;
+}
+
+/* the glyph of a code point, rasterized on first use, NULL if it does not fit */
+static glyph *
+fnt_glyph( font *f, int code )
+{
+  stbtt_fontinfo *info = (stbtt_fontinfo *)f->info;
+  glyph *g;
+
+  if(code < 0 || code > FNT_MAX_CODE)  code = '?';
+
+  if(f->lookup[code]) {
+    g = &f->glyphs[f->lookup[code] - 1];
+    if(g->shelf >= 0)  f->shelves[g->shelf].last_used = f->frame;
+    return g;
+  }
+
+  if(f->n_free_glyphs == 0)  return NULL;
+
+  int x0, y0, x1, y1, advance, lsb;
+  stbtt_GetCodepointBitmapBox(info, code, f->scale, f->scale, &x0, &y0, &x1, &y1);
+  stbtt_GetCodepointHMetrics(info, code, &advance, &lsb);
+
+  /* taken before packing, an eviction pushes more free slots */
+  int slot = f->free_glyphs[--f->n_free_glyphs];
+  g = &f->glyphs[slot];
+  g->f = f;
+  g->code = code;
+  g->w = x1 - x0;
+  g->h = y1 - y0;
+  g->xoff = (float)x0;
+  g->yoff = (float)y0;
+  g->xadvance = f->scale*advance;
+  g->bitmap = NULL;
+
+  if(g->w <= 0 || g->h <= 0) {
+    /* nothing to draw, only the advance */
+    g->w = 0;
+    g->h = 0;
+    g->shelf = -1;
+    g->state = GLYPH_READY;
+  }
+  else {
+    g->shelf = fnt_pack(f, g->w + FNT_PADDING, g->h + FNT_PADDING, &g->x, &g->y);
+    if(g->shelf < 0) {
+      f->free_glyphs[f->n_free_glyphs++] = slot;
+      return NULL;
+    }
+
+    f->shelves[g->shelf].last_used = f->frame;
+    f->shelves[g->shelf].n_pending++;
+    g->state = GLYPH_PENDING;
+
+    if(!f->pool || thpool_add_job(f->pool, &fnt_raster_job, g, 0) != 0) {
+      g->bitmap = (unsigned char *)malloc(g->w*g->h);
+      stbtt_MakeCodepointBitmap(info, g->bitmap, g->w, g->h, g->w, f->scale, f->scale, code);
+      fnt_upload_glyph(f, g);
+    }
+  }
+
+  f->lookup[code] = slot + 1;
+
+  return g;
+}
+
+/* build 6 vertices (2 triangles) per character of text, characters
+   not in the atlas (yet) are degenerate triangles */
+static void
+fnt_build( font *f, ovlvertex *v,
+           const wchar_t *text,
+           float x, const float y,
+           const GLubyte *color )
+{
+  const wchar_t *p;
+
+  for(p = text; *p; p++) {
+    const glyph *g = fnt_glyph(f, (int)*p);
+    int c;
+
+    if(!g) {
+      /* the atlas is full, skip an average width */
+      memset(v, 0, sizeof(ovlvertex)*6);
+      x += 0.5*f->size;
+      v += 6;
+      continue;
+    }
+
+    int round_x = (int)floor(x + g->xoff);
+    int round_y = (int)floor(y - g->yoff);
+
+    float x0 = (float)round_x;
+    float y0 = (float)round_y;
+    float x1 = (float)round_x + g->w;
+    float y1 = (float)round_y - g->h;
+
+    float s0 = g->x/(float)f->tex_w;
+    float t0 = g->y/(float)f->tex_h;
+    float s1 = (g->x + g->w)/(float)f->tex_w;
+    float t1 = (g->y + g->h)/(float)f->tex_h;
+
+    x += g->xadvance;
+
+    if(g->state != GLYPH_READY || g->w == 0)  x1 = x0, y1 = y0;
+
+    v[0].x = x1;  v[0].y = y0;  v[0].s = s1;  v[0].t = t0;
+    v[1].x = x0;  v[1].y = y0;  v[1].s = s0;  v[1].t = t0;
+    v[2].x = x1;  v[2].y = y1;  v[2].s = s1;  v[2].t = t1;
+    v[3].x = x0;  v[3].y = y1;  v[3].s = s0;  v[3].t = t1;
+    for(c = 0; c < 4; c++)
+      memcpy(v[c].color, color, 4);
+
+    /* the strip (0, 1, 2, 3) as 2 separate triangles */
+    v[4] = v[2];
+    v[5] = v[1];
+
+    v += 6;
+  }
+}
+
+/* add the text to the overlay */
+void
+fnt_print( font *f, overlay *ovl,
+           const wchar_t *text,
+           const float x, const float y,
+           const vec4 *color )
+{
+  int n_chars = wcslen(text);
+  if(n_chars == 0)  return;
+
+  GLubyte c[4];
+  ovl_color(c, color);
+
+  fnt_build(f, ovl_add(ovl, 6*n_chars, f->tex_id, OVL_ALPHA), text, x, y, c);
+}
+
+/* create a cached text in memory */
+fnttext *
+fnt_text_new( void )
+{
+  fnttext *ft = (fnttext *)malloc(sizeof(fnttext));
+
+  ft->text_capacity = 32;
+  ft->text = (wchar_t *)malloc(sizeof(wchar_t)*ft->text_capacity);
+  ft->text[0] = 0;
+  ft->x = 0.0;
+  ft->y = 0.0;
+  vec4_set(&ft->color, 1.0, 1.0, 1.0, 1.0);
+
+  ft->vertices_capacity = 6*ft->text_capacity;
+  ft->vertices = (ovlvertex *)malloc(sizeof(ovlvertex)*ft->vertices_capacity);
+  ft->n_vertices = 0;
+  ft->generation = 0;
+
+  return ft;
+}
+
+/* delete a cached text from memory */
 void
-fnt_print( font *f, const wchar_t *text,
-           float x, float y,
-           const vec4 *color,
-           shader *glsl )
+fnt_text_del( fnttext *ft )
 {
-  glUseProgram(glsl->prog_font);
-  shd_set(glsl, glsl->prog_font);
+  if(!ft)  return;
+
+  free(ft->text);
+  free(ft->vertices);
+  free(ft);
+}
 
-  glUniformMatrix4fv(glsl->uniform_mvp, 1, GL_FALSE, f->mat_proj.m);
-  glUniform1i(glsl->uniform_diffmap, /*GL_TEXTURE*/0);
-  glUniform4f(glsl->uniform_onecolor, color->r, color->g, color->b, color->a);
+/* (re)build the vertices of a cached text */
+static void
+fnt_text_build( font *f, fnttext *ft )
+{
+  GLubyte c[4];
+  ovl_color(c, &ft->color);
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, f->tex_id);
+  fnt_build(f, ft->vertices, ft->text, ft->x, ft->y, c);
 
-  glEnableVertexAttribArray(glsl->attri_v_coord);
-  glBindBuffer(GL_ARRAY_BUFFER, f->vbo_coord);
+  /* after the build, it may have placed glyphs itself, glyphs still being
+     rasterized change the generation again when uploaded */
+  ft->generation = f->generation;
+}
 
-  /* Loop through all characters */
+/* set a cached text, its vertices are rebuilt only if anything changed */
+void
+fnt_text_set( font *f, fnttext *ft,
+              const wchar_t *text,
+              const float x, const float y,
+              const vec4 *color )
+{
+  if(ft->x == x && ft->y == y &&
+     memcmp(&ft->color, color, sizeof(vec4)) == 0 &&
+     wcscmp(ft->text, text) == 0)  return;
+
+  int n_chars = wcslen(text);
+
+  if(n_chars + 1 > ft->text_capacity) {
+    ft->text_capacity = n_chars + 1;
+    ft->text = (wchar_t *)realloc(ft->text, sizeof(wchar_t)*ft->text_capacity);
+  }
+  if(6*n_chars > ft->vertices_capacity) {
+    ft->vertices_capacity = 6*n_chars;
+    ft->vertices = (ovlvertex *)realloc(ft->vertices, sizeof(ovlvertex)*ft->vertices_capacity);
+  }
+
+  wcscpy(ft->text, text);
+  ft->x = x;
+  ft->y = y;
+  vec4_cpy(&ft->color, color);
+  ft->n_vertices = 6*n_chars;
+
+  fnt_text_build(f, ft);
+}
+
+/* add a cached text to the overlay, rebuilt if its glyphs moved in the atlas */
+void
+fnt_text_draw( font *f, fnttext *ft, overlay *ovl )
+{
   const wchar_t *p;
-	for(p = text; *p; p++) {
-    stbtt_aligned_quad quad;
-    bakedchar *bchar = f->cdata + (*p - f->first_char);
-
-    int round_x = (int)floor(x + bchar->xoff);
-    int round_y = (int)floor(y - bchar->yoff);
-
-    quad.x0 = (float)round_x;
-    quad.y0 = (float)round_y;
-    quad.x1 = (float)round_x + bchar->x1 - bchar->x0;
-    quad.y1 = (float)round_y - bchar->y1 + bchar->y0;
-
-    quad.s0 = bchar->x0/(float)f->tex_w;
-    quad.t0 = bchar->y0/(float)f->tex_w;
-    quad.s1 = bchar->x1/(float)f->tex_h;
-    quad.t1 = bchar->y1/(float)f->tex_h;
-			
-    x += bchar->xadvance;
-
-    void *f_data = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-    vec4 *box = (vec4 *)f_data;
-
-    box[0].x = quad.x1;
-    box[0].y = quad.y0;
-    box[0].z = quad.s1;
-    box[0].w = quad.t0;
-
-    box[1].x = quad.x0;
-    box[1].y = quad.y0;
-    box[1].z = quad.s0;
-    box[1].w = quad.t0;
-
-    box[2].x = quad.x1;
-    box[2].y = quad.y1;
-    box[2].z = quad.s1;
-    box[2].w = quad.t1;
-
-    box[3].x = quad.x0;
-    box[3].y = quad.y1;
-    box[3].z = quad.s0;
-    box[3].w = quad.t1;
-
-    glUnmapBuffer(GL_ARRAY_BUFFER);
-
-    glVertexAttribPointer(glsl->attri_v_coord, 4, GL_FLOAT, GL_FALSE, 0, 0);
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+  if(ft->n_vertices == 0)  return;
+
+  if(ft->generation != f->generation)
+    fnt_text_build(f, ft);
+  else {
+    /* keep its glyphs from being evicted */
+    for(p = ft->text; *p; p++)
+      fnt_glyph(f, (int)*p);
   }
 
-  glDisableVertexAttribArray(glsl->attri_v_coord);
-}
\ No newline at end of file
+  memcpy(ovl_add(ovl, ft->n_vertices, f->tex_id, OVL_ALPHA),
+         ft->vertices, sizeof(ovlvertex)*ft->n_vertices);
+}
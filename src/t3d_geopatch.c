@@ -29,9 +29,9 @@ geopch_del( geopatch *pch )
 {
   if(!pch) return;
 
-  glDeleteBuffers(1, &pch->vbo_coords);
-  glDeleteBuffers(1, &pch->vbo_normals);
-  glDeleteBuffers(1, &pch->vbo_tangents);
+  ogl_delete_buffers(1, &pch->vbo_coords);
+  ogl_delete_buffers(1, &pch->vbo_normals);
+  ogl_delete_buffers(1, &pch->vbo_tangents);
 
   free(pch);
 }
@@ -44,12 +44,12 @@ geopch_upload( const geopatch *pch,
                const vec3 *tangents,
                const unsigned int v_data_size )
 {
-  glBindBuffer(GL_ARRAY_BUFFER, pch->vbo_coords);
+  ogl_bind_buffer(GL_ARRAY_BUFFER, pch->vbo_coords);
   glBufferData(GL_ARRAY_BUFFER, v_data_size, vcoords, GL_STATIC_DRAW);
 
-  glBindBuffer(GL_ARRAY_BUFFER, pch->vbo_normals);
+  ogl_bind_buffer(GL_ARRAY_BUFFER, pch->vbo_normals);
   glBufferData(GL_ARRAY_BUFFER, v_data_size, normals, GL_STATIC_DRAW);
 
-  glBindBuffer(GL_ARRAY_BUFFER, pch->vbo_tangents);
+  ogl_bind_buffer(GL_ARRAY_BUFFER, pch->vbo_tangents);
   glBufferData(GL_ARRAY_BUFFER, v_data_size, tangents, GL_STATIC_DRAW);
 }
\ No newline at end of file
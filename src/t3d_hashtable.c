@@ -9,33 +9,139 @@
 
 
 struct __hashentry {
-  char *pairing;             /* block containing 'key\0value' */
+  const char *key;           /* 'key\0' in a page */
   unsigned int key_length;   /* length of key */
-  struct __hashentry *next;  /* next entry */
+  unsigned int hash;         /* hash of key */
+  const void *value;         /* in a page, NULL if the key has no value */
 };
 
+/* keys and values are bump allocated in pages that are freed together */
+struct __hashpage {
+  struct __hashpage *next;
+  size_t size;
+  size_t used;
+  char data[];
+};
+
+#define HASH_PAGE_SIZE  4096
+
+
+/* a slot hash is never 0, 0 marks an empty slot */
+static inline unsigned int
+hash_slot_hash( const unsigned int h )
+{
+  return h ? h : 1;
+}
+
+/* how far a slot is from the slot its hash wants */
+static inline unsigned int
+hash_probe_length( const hashtable *ht, const unsigned int slot, const unsigned int h )
+{
+  return (slot - h) & ht->mask;
+}
+
+/* copy n bytes into the pages, NULL if out of memory */
+static void *
+hash_page_copy( hashtable *ht, const void *data, const size_t n )
+{
+  /* values of any type are aligned */
+  size_t need = (n + 7) & ~(size_t)7;
+  struct __hashpage *pg = ht->pages;
+
+  if(!pg || pg->used + need > pg->size) {
+    size_t size = need > HASH_PAGE_SIZE ? need : HASH_PAGE_SIZE;
+    pg = (struct __hashpage *)malloc(sizeof(struct __hashpage) + size);
+    if(pg == NULL)  return NULL;
+
+    pg->size = size;
+    pg->used = 0;
+    pg->next = ht->pages;
+    ht->pages = pg;
+  }
+
+  void *r = pg->data + pg->used;
+  memcpy(r, data, n);
+  pg->used += need;
+
+  return r;
+}
+
+/* put a handle in the slots, the richer slots give way to the poorer */
+static void
+hash_slot_insert( hashtable *ht, unsigned int h, unsigned int handle )
+{
+  unsigned int slot = h & ht->mask;
+  unsigned int dist = 0;
+
+  while(ht->slots[slot].handle != HASH_NONE) {
+    unsigned int d = hash_probe_length(ht, slot, ht->slots[slot].hash);
+    if(d < dist) {
+      hashslot t = ht->slots[slot];
+      ht->slots[slot].hash = h;
+      ht->slots[slot].handle = handle;
+      h = t.hash;
+      handle = t.handle;
+      dist = d;
+    }
+    slot = (slot + 1) & ht->mask;
+    dist++;
+  }
+
+  ht->slots[slot].hash = h;
+  ht->slots[slot].handle = handle;
+}
+
+/* double the slots and put the handles in again, 0 if out of memory */
+static int
+hash_grow( hashtable *ht )
+{
+  unsigned int n_slots = (ht->mask + 1)*2;
+  hashslot *slots = (hashslot *)calloc(n_slots, sizeof(hashslot));
+  if(slots == NULL)  return 0;
+
+  free(ht->slots);
+  ht->slots = slots;
+  ht->mask = n_slots - 1;
+
+  /* the entries hold the hashes, no key is hashed again */
+  unsigned int i;
+  for(i = 0; i < ht->n_entries; i++)
+    hash_slot_insert(ht, ht->entries[i].hash, i + 1);
+
+  return 1;
+}
 
 /*---------------------------------------------------------------------------+
-  create a new hash table, and return a context for it. The memory consumption
-  of a hash table is approximately 8 + (nchains * 12) bytes if it is empty.
+  create a new hash table, and return a context for it. The table grows past
+  n entries, n only saves the first rehashes.
 
-  chains -  number of chains/buckets this hash table will have. This
-            should be a prime number, and ideally a prime number just
-            over a power of two, for best performance and distribution.
+  n -  number of entries expected, may be 0.
   return hashtable - containing the context of this hash table or NULL
-            if there is insufficent memory to create it and its chains.
+            if there is insufficent memory to create it and its slots.
  +---------------------------------------------------------------------------*/
 hashtable *
-hash_new( const unsigned int chains )
+hash_new( const unsigned int n )
 {
   hashtable *r = (hashtable *)malloc(sizeof(hashtable));
 
   if(r == NULL)  return NULL;
 
-  r->nchains = chains;
-  r->chain = calloc(chains, sizeof(struct __hashentry *));
+  /* at most 7/8 of the slots are used */
+  unsigned int n_slots = 16;
+  while(n_slots - n_slots/8 < n)  n_slots *= 2;
+
+  r->slots = (hashslot *)calloc(n_slots, sizeof(hashslot));
+  r->mask = n_slots - 1;
+
+  r->entries_capacity = n > 8 ? n : 8;
+  r->entries = (struct __hashentry *)malloc(sizeof(struct __hashentry)*r->entries_capacity);
+  r->n_entries = 0;
 
-  if(r->chain == NULL) {
+  r->pages = NULL;
+
+  if(r->slots == NULL || r->entries == NULL) {
+    free(r->slots);
+    free(r->entries);
     free(r);
     return NULL;
   }
@@ -49,97 +155,192 @@ hash_new( const unsigned int chains )
 void
 hash_del( hashtable *ht )
 {
-  unsigned int i;
-
   if(ht == NULL)  return;
 
-  for(i = 0; i < ht->nchains; i++) {
-    if(ht->chain[i] != NULL) {
-      struct __hashentry *e = ht->chain[i];
-      while(e) {
-        struct __hashentry *n = e->next;
-        free(e->pairing);
-        free(e);
-        e = n;
-      }
-    }
+  struct __hashpage *pg = ht->pages;
+  while(pg) {
+    struct __hashpage *n = pg->next;
+    free(pg);
+    pg = n;
   }
 
-  free(ht->chain);
+  free(ht->entries);
+  free(ht->slots);
   free(ht);
 }
 
+/* the handle of a hashed key, HASH_NONE if it is not in the table */
+static unsigned int
+hash_lookup( const hashtable *ht, const char *key, const unsigned int key_length,
+             const unsigned int h )
+{
+  unsigned int slot = h & ht->mask;
+  unsigned int dist = 0;
+
+  for(;;) {
+    const hashslot *s = &ht->slots[slot];
+
+    /* a key is never further from its slot than a poorer one */
+    if(s->handle == HASH_NONE || hash_probe_length(ht, slot, s->hash) < dist)
+      return HASH_NONE;
+
+    if(s->hash == h) {
+      const struct __hashentry *e = &ht->entries[s->handle - 1];
+      if(e->key_length == key_length && memcmp(e->key, key, key_length) == 0)
+        return s->handle;
+    }
+
+    slot = (slot + 1) & ht->mask;
+    dist++;
+  }
+}
+
+/* add a new key with no value, return its handle or HASH_NONE */
+static unsigned int
+hash_insert( hashtable *ht, const char *key, const unsigned int key_length,
+             const unsigned int h )
+{
+  unsigned int n_slots = ht->mask + 1;
+  if(ht->n_entries + 1 > n_slots - n_slots/8 && !hash_grow(ht))
+    return HASH_NONE;
+
+  if(ht->n_entries == ht->entries_capacity) {
+    unsigned int capacity = ht->entries_capacity*2;
+    struct __hashentry *entries;
+    entries = (struct __hashentry *)realloc(ht->entries, sizeof(struct __hashentry)*capacity);
+    if(entries == NULL)  return HASH_NONE;
+
+    ht->entries = entries;
+    ht->entries_capacity = capacity;
+  }
+
+  const char *k = (const char *)hash_page_copy(ht, key, key_length + 1);
+  if(k == NULL)  return HASH_NONE;
+
+  struct __hashentry *e = &ht->entries[ht->n_entries++];
+  e->key = k;
+  e->key_length = key_length;
+  e->hash = h;
+  e->value = NULL;
+
+  hash_slot_insert(ht, h, ht->n_entries);
+
+  return ht->n_entries;
+}
+
 /*---------------------------------------------------------------------------+
   adds a key/value pair to a hash table.  if the key you're adding is already
-  in the hash table, it does not replace it, but it does take precedent over
-  it.  the old key/value pair will be inaccessable but still in memory until
-  hash_destroy() is called on the hash table.
+  in the hash table, its new value replaces the old one in lookups.  the old
+  value stays in memory until hash_del() is called on the hash table, so the
+  pointers to it are still valid.
 
   param  ht     the hash table context to add the key/value pair to.
   param  key    the key to associate the value with.  a copy is made.
   param  value  the value to associate the key with.  a copy is made.
-  param  v_len  the length of the value item. if value is a string, v_len should
-                be strlen(value) + 1.
-  return true if the add succeeded, false (0) otherwise.
+  param  v_len  the size of the value in bytes.
+  return the handle of the key, or HASH_NONE (0) if the add failed.
  +---------------------------------------------------------------------------*/
-int
+unsigned int
 hash_add( hashtable *ht, const char *key, const void *value, const int v_len )
 {
-  unsigned int h, c;
-  struct __hashentry *e;
-
   if(ht == NULL || key == NULL || value == NULL)
-    return 0;
-
-  e = (struct __hashentry *)malloc(sizeof(struct __hashentry));
-  if(e == NULL)  return 0;
+    return HASH_NONE;
 
-  h = hash_string_fnv(key, &(e->key_length));
-  c = h%ht->nchains;
+  unsigned int handle = hash_intern(ht, key);
+  if(handle == HASH_NONE)  return HASH_NONE;
 
-	e->pairing = malloc(v_len + e->key_length + 1);
-  if(e->pairing == NULL) {
-    free(e);
-    return 0;
-  }
-  memcpy(e->pairing, key, e->key_length + 1);
-  memcpy(e->pairing + e->key_length + 1, value, v_len);
+  const void *v = hash_page_copy(ht, value, (size_t)v_len);
+  if(v == NULL)  return HASH_NONE;
 
-  e->next = ht->chain[c];
-  ht->chain[c] = e;
+  ht->entries[handle - 1].value = v;
 
-  return 1;
+  return handle;
 }
 
 /*---------------------------------------------------------------------------+
   looks up a the value associated with with a key from a specific hash table.
  
-  param  ht    the hash table context to look up the key in.
-  param  key   the key to search for.
+  param  ht   the hash table context to search in.
+  param  key  the key to search for.
   return the value associated with the key, or NULL if it was not found.
  +---------------------------------------------------------------------------*/
 const void *
 hash_get( const hashtable *ht, const char *key )
 {
-  unsigned int h, c, key_length;
-  struct __hashentry *e;
+  return hash_at(ht, hash_find(ht, key));
+}
+
+/*---------------------------------------------------------------------------+
+  looks up the handle of a key. the handle stays the same for the life of the
+  table, hot code finds it once and uses hash_at() afterwards.
+
+  param  ht   the hash table context to search in.
+  param  key  the key to search for.
+  return the handle of the key, or HASH_NONE (0) if it was not found.
+ +---------------------------------------------------------------------------*/
+unsigned int
+hash_find( const hashtable *ht, const char *key )
+{
+  unsigned int key_length;
 
   if(ht == NULL || key == NULL)
+    return HASH_NONE;
+
+  unsigned int h = hash_slot_hash(hash_string_fnv(key, &key_length));
+  return hash_lookup(ht, key, key_length, h);
+}
+
+/*---------------------------------------------------------------------------+
+  interns a key. the key is added with no value if it is not in the table.
+
+  param  ht   the hash table context.
+  param  key  the key to intern.  a copy is made.
+  return the handle of the key, or HASH_NONE (0) if the add failed.
+ +---------------------------------------------------------------------------*/
+unsigned int
+hash_intern( hashtable *ht, const char *key )
+{
+  unsigned int key_length;
+
+  if(ht == NULL || key == NULL)
+    return HASH_NONE;
+
+  unsigned int h = hash_slot_hash(hash_string_fnv(key, &key_length));
+  unsigned int handle = hash_lookup(ht, key, key_length, h);
+  if(handle != HASH_NONE)  return handle;
+
+  return hash_insert(ht, key, key_length, h);
+}
+
+/* the value of a handle, NULL if it has none */
+const void *
+hash_at( const hashtable *ht, const unsigned int handle )
+{
+  if(ht == NULL || handle == HASH_NONE || handle > ht->n_entries)
     return NULL;
 
-  h = hash_string_fnv(key, &key_length);
-  c = h%ht->nchains;
+  return ht->entries[handle - 1].value;
+}
 
-  for(e = ht->chain[c]; e; e = e->next) {
-    if((key_length == e->key_length) && (memcmp(key, e->pairing, key_length) == 0))
-      return e->pairing + key_length + 1;
-  }
+/* the key of a handle */
+const char *
+hash_key( const hashtable *ht, const unsigned int handle )
+{
+  if(ht == NULL || handle == HASH_NONE || handle > ht->n_entries)
+    return NULL;
 
-  return NULL;
+  return ht->entries[handle - 1].key;
+}
+
+/* number of keys, their handles are 1 to hash_count */
+unsigned int
+hash_count( const hashtable *ht )
+{
+  return ht ? ht->n_entries : 0;
 }
 
 /*---------------------------------------------------------------------------+
-  iterate through all available hash keys.
+  iterate through all available hash keys, in the order they were added.
 
   param  ht  the hash table context to iterate.
   param  c1  pointer to first context
@@ -149,23 +350,13 @@ hash_get( const hashtable *ht, const char *key )
 const char *
 hash_iterate( const hashtable *ht, unsigned int *c1, unsigned int **c2 )
 {
-  struct __hashentry **he = (struct __hashentry **)c2;
-
   if(ht == NULL)  return NULL;
 
-  if(!*he)
-    *c1 = -1;
-  else
-    *he = (*he)->next;
-
-  if(*he)
-    return (*he)->pairing;
-
-  while(!*he) {
-    (*c1)++;
-    if(*c1 >= ht->nchains)
-      return NULL;
-    *he = ht->chain[*c1];
+  if(!*c2) {
+    *c1 = HASH_NONE;
+    *c2 = c1;
   }
-  return (*he)->pairing;
-}
\ No newline at end of file
+
+  (*c1)++;
+  return hash_key(ht, *c1);
+}
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <stb_image.h>
 #include <t3d_math.h>
+#include <t3d_util.h>
 #include <t3d_geomath.h>
 #include <t3d_astar.h>
 #include <t3d_patchmap.h>
@@ -20,7 +21,10 @@ htmap_from_file( const char *file, int *w, int *h, int *n_vertices )
   int channels;
   int i;
 
-  img = stbi_load(file, w, h, &channels, 0);
+  size_t size;
+  const char *view = util_file_view(file, &size);
+  img = stbi_load_from_memory((const unsigned char *)view, (int)size, w, h, &channels, 0);
+  util_file_release(view);
   *n_vertices = (*w)*(*h);
   unsigned char *data = (unsigned char *)malloc(sizeof(unsigned char)*(*n_vertices));
 
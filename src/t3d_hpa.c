@@ -0,0 +1,554 @@
+/*----- t3d_hpa.c -----------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <t3d_math.h>
+#include <t3d_patchmap.h>
+#include <t3d_astar.h>
+#include <t3d_hpa.h>
+
+
+#define HPA_WALK_COST  10
+
+
+/* the cells of a patch, (x0, y0) - (x1, y1) */
+static void
+hpa_patch_rect( const hpa *g, const int p, int *x0, int *y0, int *x1, int *y1 )
+{
+  int px = p%g->w_pchs;
+  int py = p/g->w_pchs;
+
+  *x0 = px*g->w_pch_cells;
+  *y0 = py*g->h_pch_cells;
+  *x1 = px == g->w_pchs - 1 ? g->w_cells - 1 : *x0 + g->w_pch_cells - 1;
+  *y1 = py == g->h_pchs - 1 ? g->h_cells - 1 : *y0 + g->h_pch_cells - 1;
+}
+
+/* the patch of a cell */
+static int
+hpa_patch_of( const hpa *g, const int x, const int y )
+{
+  int px = x/g->w_pch_cells;
+  int py = y/g->h_pch_cells;
+  if(px >= g->w_pchs)  px = g->w_pchs - 1;
+  if(py >= g->h_pchs)  py = g->h_pchs - 1;
+
+  return py*g->w_pchs + px;
+}
+
+static void
+hpa_mark( hpa *g, const int p )
+{
+  if(!g->pchs[p].dirty) {
+    g->pchs[p].dirty = 1;
+    g->n_dirty++;
+  }
+}
+
+/* create the abstract graph of a patchmap in memory, built by the first hpa_update */
+hpa *
+hpa_new( const patchmap *pm )
+{
+  hpa *g = (hpa *)calloc(1, sizeof(hpa));
+
+  g->w_cells = pm->w_cells;
+  g->h_cells = pm->h_cells;
+  g->w_pch_cells = pm->w_pch_cells > 0 ? pm->w_pch_cells : pm->w_cells;
+  g->h_pch_cells = pm->h_pch_cells > 0 ? pm->h_pch_cells : pm->h_cells;
+  g->w_pchs = g->w_cells/g->w_pch_cells;
+  g->h_pchs = g->h_cells/g->h_pch_cells;
+  if(g->w_pchs < 1)  g->w_pchs = 1;
+  if(g->h_pchs < 1)  g->h_pchs = 1;
+
+  g->pchs = (hpapatch *)calloc(g->w_pchs*g->h_pchs, sizeof(hpapatch));
+
+  /* the last patch of a row or column is the largest */
+  int x0, y0, x1, y1;
+  hpa_patch_rect(g, g->w_pchs*g->h_pchs - 1, &x0, &y0, &x1, &y1);
+  int n_bfs = (x1 - x0 + 1)*(y1 - y0 + 1);
+  g->bfs_costs = (int *)malloc(sizeof(int)*n_bfs);
+  g->bfs_queue = (int *)malloc(sizeof(int)*n_bfs);
+
+  if(!g->pchs || !g->bfs_costs || !g->bfs_queue) {
+    fprintf(stderr, "line %d: Can not allocate memory\n", __LINE__);
+    exit(EXIT_FAILURE);
+  }
+
+  /* everything is built by the first update, the owner runs it at creation
+     so that no search pays for the whole map */
+  int p;
+  for(p = 0; p < g->w_pchs*g->h_pchs; p++)
+    hpa_mark(g, p);
+
+  return g;
+}
+
+/* delete an abstract graph from memory */
+void
+hpa_del( hpa *g )
+{
+  int p;
+
+  if(!g)  return;
+
+  for(p = 0; p < g->w_pchs*g->h_pchs; p++) {
+    free(g->pchs[p].portals);
+    free(g->pchs[p].costs);
+  }
+  free(g->pchs);
+  free(g->owners);
+  free(g->nodes);
+  free(g->heap);
+  free(g->bfs_costs);
+  free(g->bfs_queue);
+  free(g->start_costs);
+  free(g->end_costs);
+  free(g);
+}
+
+/* the patch of a cell */
+int
+hpa_patch( const hpa *g, const int x, const int y )
+{
+  return hpa_patch_of(g, x, y);
+}
+
+/* a cell status changed, its patch (and the one across the border) is rebuilt later */
+void
+hpa_cell_changed( hpa *g, const int x, const int y )
+{
+  int x0, y0, x1, y1;
+  int p = hpa_patch_of(g, x, y);
+
+  hpa_mark(g, p);
+
+  /* the entrances of a border cell belong to both sides */
+  hpa_patch_rect(g, p, &x0, &y0, &x1, &y1);
+  if(x == x0 && x > 0)                 hpa_mark(g, p - 1);
+  if(x == x1 && x < g->w_cells - 1)    hpa_mark(g, p + 1);
+  if(y == y0 && y > 0)                 hpa_mark(g, p - g->w_pchs);
+  if(y == y1 && y < g->h_cells - 1)    hpa_mark(g, p + g->w_pchs);
+}
+
+/* set the status of a cell and mark its patches */
+void
+hpa_set_status( hpa *g, patchmap *pm, const int x, const int y, const int status )
+{
+  pthread_mutex_lock(&pm->lock);
+  pm->cells[y*pm->w_cells + x].status = status;
+  pthread_mutex_unlock(&pm->lock);
+
+  hpa_cell_changed(g, x, y);
+}
+
+static void
+hpa_add_portal( hpapatch *pch, const int cell, const int partner )
+{
+  if(pch->n_portals == pch->capacity) {
+    pch->capacity = pch->capacity ? pch->capacity*2 : 8;
+    pch->portals = (hpaportal *)realloc(pch->portals, sizeof(hpaportal)*pch->capacity);
+  }
+
+  pch->portals[pch->n_portals].cell = cell;
+  pch->portals[pch->n_portals].partner = partner;
+  pch->n_portals++;
+}
+
+/* the entrances of one border, the cells own + k*step inside and other + k*step
+   across, for k in [0, n). both sides find the same ones */
+static void
+hpa_border( hpapatch *pch, const patchmap *pm,
+            const int own, const int other, const int step, const int n )
+{
+  int k = 0;
+
+  while(k < n) {
+    /* a run of crossable cells */
+    while(k < n && !(pm->cells[own + k*step].status && pm->cells[other + k*step].status))
+      k++;
+    if(k == n)  break;
+
+    int start = k;
+    while(k < n && pm->cells[own + k*step].status && pm->cells[other + k*step].status)
+      k++;
+    int end = k - 1;
+
+    if(end - start + 1 < HPA_WIDE) {
+      int mid = (start + end)/2;
+      hpa_add_portal(pch, own + mid*step, other + mid*step);
+    }
+    else {
+      hpa_add_portal(pch, own + start*step, other + start*step);
+      hpa_add_portal(pch, own + end*step, other + end*step);
+    }
+  }
+}
+
+/* walk costs from a cell to the cells of its patch, -1 where it can not go.
+   return the cells reached */
+static int
+hpa_bfs( hpa *g, const patchmap *pm, const int x0, const int y0, const int x1, const int y1,
+         const int src )
+{
+  int rw = x1 - x0 + 1;
+  int rh = y1 - y0 + 1;
+  int w = pm->w_cells;
+  int head = 0, tail = 0;
+  int i;
+
+  for(i = 0; i < rw*rh; i++)
+    g->bfs_costs[i] = -1;
+  if(!pm->cells[src].status)  return 0;
+
+  int local = (src/w - y0)*rw + src%w - x0;
+  g->bfs_costs[local] = 0;
+  g->bfs_queue[tail++] = local;
+
+  /* every step costs the same, breadth first is exact */
+  while(head < tail) {
+    int cur = g->bfs_queue[head++];
+    int cx = cur%rw;
+    int cy = cur/rw;
+    int cost = g->bfs_costs[cur] + HPA_WALK_COST;
+
+    for(i = 0; i < 4; i++) {
+      int x = cx, y = cy;
+      switch(i) {
+        case 0:  if(x == 0)  continue;       x--;  break;
+        case 1:  if(y == rh - 1)  continue;  y++;  break;
+        case 2:  if(x == rw - 1)  continue;  x++;  break;
+        default: if(y == 0)  continue;       y--;  break;
+      }
+
+      int n = y*rw + x;
+      if(g->bfs_costs[n] >= 0 || !pm->cells[(y + y0)*w + x + x0].status)  continue;
+
+      g->bfs_costs[n] = cost;
+      g->bfs_queue[tail++] = n;
+    }
+  }
+
+  return tail;
+}
+
+/* the cost of a cell from the last hpa_bfs */
+static int
+hpa_bfs_cost( const hpa *g, const int w, const int x0, const int y0, const int x1, const int cell )
+{
+  return g->bfs_costs[(cell/w - y0)*(x1 - x0 + 1) + cell%w - x0];
+}
+
+/* find the portals of a patch and the walk costs between them */
+static void
+hpa_build_patch( hpa *g, const patchmap *pm, const int p )
+{
+  hpapatch *pch = &g->pchs[p];
+  int w = pm->w_cells;
+  int x0, y0, x1, y1;
+  int i, j;
+
+  hpa_patch_rect(g, p, &x0, &y0, &x1, &y1);
+  pch->n_portals = 0;
+
+  /* left, right, up, down */
+  if(x0 > 0)
+    hpa_border(pch, pm, y0*w + x0, y0*w + x0 - 1, w, y1 - y0 + 1);
+  if(x1 < w - 1)
+    hpa_border(pch, pm, y0*w + x1, y0*w + x1 + 1, w, y1 - y0 + 1);
+  if(y0 > 0)
+    hpa_border(pch, pm, y0*w + x0, (y0 - 1)*w + x0, 1, x1 - x0 + 1);
+  if(y1 < pm->h_cells - 1)
+    hpa_border(pch, pm, y1*w + x0, (y1 + 1)*w + x0, 1, x1 - x0 + 1);
+
+  int n = pch->n_portals;
+  free(pch->costs);
+  pch->costs = (int *)malloc(sizeof(int)*(n*n + 1));
+
+  for(i = 0; i < n; i++) {
+    hpa_bfs(g, pm, x0, y0, x1, y1, pch->portals[i].cell);
+    for(j = 0; j < n; j++)
+      pch->costs[i*n + j] = hpa_bfs_cost(g, w, x0, y0, x1, pch->portals[j].cell);
+  }
+
+  pch->dirty = 0;
+}
+
+/* rebuild the patches marked since the last update */
+void
+hpa_update( hpa *g, const patchmap *pm )
+{
+  int n_pchs = g->w_pchs*g->h_pchs;
+  int p, i;
+
+  if(g->n_dirty == 0)  return;
+
+  for(p = 0; p < n_pchs; p++)
+    if(g->pchs[p].dirty)  hpa_build_patch(g, pm, p);
+  g->n_dirty = 0;
+
+  /* number the portals again, the searches keep nothing between them */
+  g->n_portals = 0;
+  g->max_portals = 0;
+  for(p = 0; p < n_pchs; p++) {
+    g->pchs[p].first = g->n_portals;
+    g->n_portals += g->pchs[p].n_portals;
+    if(g->pchs[p].n_portals > g->max_portals)
+      g->max_portals = g->pchs[p].n_portals;
+  }
+
+  free(g->owners);
+  g->owners = (int *)malloc(sizeof(int)*(g->n_portals + 1));
+  for(p = 0; p < n_pchs; p++)
+    for(i = 0; i < g->pchs[p].n_portals; i++)
+      g->owners[g->pchs[p].first + i] = p;
+
+  if(g->n_portals + 2 > g->nodes_capacity) {
+    g->nodes_capacity = g->n_portals + 2;
+    free(g->nodes);
+    g->nodes = (hpanode *)calloc(g->nodes_capacity, sizeof(hpanode));
+    g->gen = 0;
+  }
+
+  free(g->start_costs);
+  free(g->end_costs);
+  g->start_costs = (int *)malloc(sizeof(int)*(g->max_portals + 1));
+  g->end_costs = (int *)malloc(sizeof(int)*(g->max_portals + 1));
+
+  if(!g->owners || !g->nodes || !g->start_costs || !g->end_costs) {
+    fprintf(stderr, "line %d: Can not allocate memory\n", __LINE__);
+    exit(EXIT_FAILURE);
+  }
+}
+
+/* the cell of an abstract node */
+static int
+hpa_node_cell( const hpa *g, const int id, const int start, const int end )
+{
+  if(id == g->n_portals)  return start;
+  if(id == g->n_portals + 1)  return end;
+
+  const hpapatch *pch = &g->pchs[g->owners[id]];
+  return pch->portals[id - pch->first].cell;
+}
+
+static void
+hpa_heap_push( hpa *g, const int f, const int id )
+{
+  int pos;
+
+  if(g->n_heap == g->heap_capacity) {
+    g->heap_capacity = g->heap_capacity ? g->heap_capacity*2 : 256;
+    g->heap = (int *)realloc(g->heap, sizeof(int)*2*g->heap_capacity);
+  }
+
+  for(pos = g->n_heap++; pos > 0; ) {
+    int parent = (pos - 1) >> 1;
+    if(g->heap[2*parent] <= f)  break;
+
+    g->heap[2*pos] = g->heap[2*parent];
+    g->heap[2*pos + 1] = g->heap[2*parent + 1];
+    pos = parent;
+  }
+  g->heap[2*pos] = f;
+  g->heap[2*pos + 1] = id;
+}
+
+static int
+hpa_heap_pop( hpa *g )
+{
+  int id = g->heap[1];
+  int f = g->heap[2*(--g->n_heap)];
+  int last = g->heap[2*g->n_heap + 1];
+  int pos = 0;
+
+  for(;;) {
+    int child = 2*pos + 1;
+    if(child >= g->n_heap)  break;
+    if(child + 1 < g->n_heap && g->heap[2*(child + 1)] < g->heap[2*child])  child++;
+    if(g->heap[2*child] >= f)  break;
+
+    g->heap[2*pos] = g->heap[2*child];
+    g->heap[2*pos + 1] = g->heap[2*child + 1];
+    pos = child;
+  }
+  g->heap[2*pos] = f;
+  g->heap[2*pos + 1] = last;
+
+  return id;
+}
+
+/* reach an abstract node with cost cost through father */
+static void
+hpa_relax( hpa *g, const int id, const int cost, const int father,
+           const int w, const ivec2 *end, const int end_cell )
+{
+  hpanode *node = &g->nodes[id];
+
+  if(node->gen == g->gen && (node->closed || node->g <= cost))  return;
+
+  node->gen = g->gen;
+  node->g = cost;
+  node->father = father;
+  node->closed = 0;
+
+  int cell = hpa_node_cell(g, id, -1, end_cell);
+  int h = HPA_WALK_COST*(abs(cell%w - end->x) + abs(cell/w - end->y));
+  hpa_heap_push(g, cost + h, id);
+}
+
+/* plan a path over the portals, the waypoints go from start to end and each
+   leg stays in a patch or crosses one border. return the waypoints, 0 if there is no path */
+int
+hpa_search( hpa *g, ivec2 **waypoints, const ivec2 *start, const ivec2 *end,
+            const patchmap *pm )
+{
+  int w = pm->w_cells;
+  int start_cell = start->y*w + start->x;
+  int end_cell = end->y*w + end->x;
+  int x0, y0, x1, y1;
+  int i;
+
+  g->n_expanded = 0;
+  if(!pm->cells[start_cell].status || !pm->cells[end_cell].status || start_cell == end_cell)
+    return 0;
+
+  /* only the patches changed since the last search */
+  hpa_update(g, pm);
+
+  int s = g->n_portals;
+  int e = g->n_portals + 1;
+  int sp = hpa_patch_of(g, start->x, start->y);
+  int ep = hpa_patch_of(g, end->x, end->y);
+  const hpapatch *spch = &g->pchs[sp];
+  const hpapatch *epch = &g->pchs[ep];
+
+  /* the start and the end join the graph for this search */
+  int direct = -1;
+  hpa_patch_rect(g, sp, &x0, &y0, &x1, &y1);
+  g->n_expanded = hpa_bfs(g, pm, x0, y0, x1, y1, start_cell);
+  for(i = 0; i < spch->n_portals; i++)
+    g->start_costs[i] = hpa_bfs_cost(g, w, x0, y0, x1, spch->portals[i].cell);
+  if(sp == ep)
+    direct = hpa_bfs_cost(g, w, x0, y0, x1, end_cell);
+
+  hpa_patch_rect(g, ep, &x0, &y0, &x1, &y1);
+  g->n_expanded += hpa_bfs(g, pm, x0, y0, x1, y1, end_cell);
+  for(i = 0; i < epch->n_portals; i++)
+    g->end_costs[i] = hpa_bfs_cost(g, w, x0, y0, x1, epch->portals[i].cell);
+
+  if(++g->gen == 0) {
+    for(i = 0; i < g->nodes_capacity; i++)
+      g->nodes[i].gen = 0;
+    g->gen = 1;
+  }
+  g->n_heap = 0;
+
+  g->nodes[s].gen = g->gen;
+  g->nodes[s].g = 0;
+  g->nodes[s].father = -1;
+  g->nodes[s].closed = 0;
+  hpa_heap_push(g, 0, s);
+
+  while(g->n_heap > 0) {
+    int id = hpa_heap_pop(g);
+    hpanode *node = &g->nodes[id];
+    if(node->closed)  continue;
+    node->closed = 1;
+    g->n_expanded++;
+
+    if(id == e)  break;
+
+    if(id == s) {
+      for(i = 0; i < spch->n_portals; i++)
+        if(g->start_costs[i] >= 0)
+          hpa_relax(g, spch->first + i, g->start_costs[i], s, w, end, end_cell);
+      if(direct >= 0)
+        hpa_relax(g, e, direct, s, w, end, end_cell);
+      continue;
+    }
+
+    int p = g->owners[id];
+    const hpapatch *pch = &g->pchs[p];
+    int local = id - pch->first;
+    const hpaportal *portal = &pch->portals[local];
+
+    /* across the border */
+    int q = hpa_patch_of(g, portal->partner%w, portal->partner/w);
+    const hpapatch *qch = &g->pchs[q];
+    for(i = 0; i < qch->n_portals; i++) {
+      if(qch->portals[i].cell == portal->partner && qch->portals[i].partner == portal->cell) {
+        hpa_relax(g, qch->first + i, node->g + HPA_WALK_COST, id, w, end, end_cell);
+        break;
+      }
+    }
+
+    /* inside the patch */
+    for(i = 0; i < pch->n_portals; i++) {
+      int cost = pch->costs[local*pch->n_portals + i];
+      if(i != local && cost >= 0)
+        hpa_relax(g, pch->first + i, node->g + cost, id, w, end, end_cell);
+    }
+
+    if(p == ep && g->end_costs[local] >= 0)
+      hpa_relax(g, e, node->g + g->end_costs[local], id, w, end, end_cell);
+  }
+
+  if(g->nodes[e].gen != g->gen || !g->nodes[e].closed)  return 0;
+
+  /* walk back from the end, the portals sharing a cell make one waypoint */
+  int n = 0;
+  int id;
+  for(id = e; id >= 0; id = g->nodes[id].father)
+    n++;
+
+  ivec2 *wps = (ivec2 *)malloc(sizeof(ivec2)*n);
+  int k = n;
+  int last_cell = -1;
+  for(id = e; id >= 0; id = g->nodes[id].father) {
+    int cell = hpa_node_cell(g, id, start_cell, end_cell);
+    if(cell == last_cell)  continue;
+
+    k--;
+    wps[k].x = cell%w;
+    wps[k].y = cell/w;
+    last_cell = cell;
+  }
+
+  /* the duplicates left room at the front */
+  if(k > 0)  memmove(wps, &wps[k], sizeof(ivec2)*(n - k));
+
+  *waypoints = wps;
+  return n - k;
+}
+
+/* the cells of a leg between 2 waypoints, start and end included, 0 if it is blocked */
+int
+hpa_refine( hpa *g, ivec2 **path, const ivec2 *from, const ivec2 *to, const patchmap *pm )
+{
+  int w = pm->w_cells;
+
+  /* a border crossing */
+  if(abs(from->x - to->x) + abs(from->y - to->y) == 1) {
+    if(!pm->cells[from->y*w + from->x].status || !pm->cells[to->y*w + to->x].status)
+      return 0;
+
+    *path = (ivec2 *)malloc(sizeof(ivec2)*2);
+    ivec2_cpy(&(*path)[0], from);
+    ivec2_cpy(&(*path)[1], to);
+    return 2;
+  }
+
+  /* a leg inside a patch only searches the patch */
+  int p = hpa_patch_of(g, from->x, from->y);
+  if(p == hpa_patch_of(g, to->x, to->y)) {
+    ivec2 rect_min, rect_max;
+    hpa_patch_rect(g, p, &rect_min.x, &rect_min.y, &rect_max.x, &rect_max.y);
+    return astar_search_rect(astar_thread_ctx(), path, from, to, pm, &rect_min, &rect_max);
+  }
+
+  return astar_search_ctx(astar_thread_ctx(), path, from, to, pm);
+}
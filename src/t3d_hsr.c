@@ -0,0 +1,254 @@
+/*----- t3d_hsr.c ------------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#include <string.h>
+#include <t3d_math.h>
+#include <t3d_geomath.h>
+#include <t3d_hsr.h>
+
+#if defined(__SSE__) || defined(_M_X64)
+#  include <xmmintrin.h>
+#  define HSR_USE_SSE
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define HSR_USE_SSE2
+#endif
+
+
+/* index of the lowest set bit, bits must not be 0 */
+static int
+hsr_lowest_bit( unsigned int bits )
+{
+#if defined(__GNUC__)
+  return __builtin_ctz(bits);
+#else
+  int n = 0;
+  while(!(bits & 1)) {
+    bits >>= 1;
+    n++;
+  }
+  return n;
+#endif
+}
+
+/* scalar plane + classification of one triangle, same as gmth_* */
+static void
+hsr_classify_one( vec4 *plane, int *cam_class, int *lit_class,
+                  const vec3 *vcoords, const unsigned short *tri,
+                  const vec3 *cam, const vec3 *lit )
+{
+  gmth_plane_set_by_3points(plane, &vcoords[tri[0]], &vcoords[tri[1]], &vcoords[tri[2]]);
+  *cam_class = gmth_plane_classify_point(plane, cam);
+  *lit_class = gmth_plane_classify_point(plane, lit);
+}
+
+#ifdef HSR_USE_SSE
+/* 4 bits mask of the lanes of dist classifying as flag */
+static unsigned int
+hsr_sse_flag_bits( __m128 dist, const int flag )
+{
+  const __m128 eps = _mm_set1_ps(EPSILON);
+  unsigned int front = (unsigned int)_mm_movemask_ps(_mm_cmpgt_ps(dist, eps));
+  unsigned int back = (unsigned int)_mm_movemask_ps(_mm_cmplt_ps(dist, _mm_sub_ps(_mm_setzero_ps(), eps)));
+
+  if(flag == PLANE_FRONT)  return front;
+  if(flag == PLANE_BACK)  return back;
+  return ~(front | back) & 0xf;
+}
+#endif
+
+/* compute the plane of every indexed triangle and classify it against the
+   camera and light points (object space) in one pass */
+void
+hsr_classify_faces( vec4 *faces,
+                    unsigned int *cam_mask,
+                    unsigned int *lit_mask,
+                    const vec3 *vcoords,
+                    const unsigned short *indices,
+                    const int n_faces,
+                    const vec3 *cam, const int cam_flag,
+                    const vec3 *lit, const int lit_flag )
+{
+  int j = 0;
+
+  memset(cam_mask, 0, sizeof(unsigned int)*HSR_MASK_WORDS(n_faces));
+  memset(lit_mask, 0, sizeof(unsigned int)*HSR_MASK_WORDS(n_faces));
+
+#ifdef HSR_USE_SSE
+  const __m128 epssq = _mm_set1_ps(EPSILON*EPSILON);
+  const __m128 one = _mm_set1_ps(1.0);
+  const __m128 half = _mm_set1_ps(0.5);
+  const __m128 three = _mm_set1_ps(3.0);
+  const __m128 cam_x = _mm_set1_ps(cam->x);
+  const __m128 cam_y = _mm_set1_ps(cam->y);
+  const __m128 cam_z = _mm_set1_ps(cam->z);
+  const __m128 lit_x = _mm_set1_ps(lit->x);
+  const __m128 lit_y = _mm_set1_ps(lit->y);
+  const __m128 lit_z = _mm_set1_ps(lit->z);
+
+  /* 4 triangles at a time, gathered into SoA form */
+  for(; j + 4 <= n_faces; j += 4) {
+    float ax[4], ay[4], az[4];
+    float bx[4], by[4], bz[4];
+    float cx[4], cy[4], cz[4];
+    int k;
+
+    for(k = 0; k < 4; k++) {
+      const unsigned short *tri = &indices[3*(j + k)];
+      const vec3 *a = &vcoords[tri[0]];
+      const vec3 *b = &vcoords[tri[1]];
+      const vec3 *c = &vcoords[tri[2]];
+      ax[k] = a->x;  ay[k] = a->y;  az[k] = a->z;
+      bx[k] = b->x;  by[k] = b->y;  bz[k] = b->z;
+      cx[k] = c->x;  cy[k] = c->y;  cz[k] = c->z;
+    }
+
+    __m128 vax = _mm_loadu_ps(ax), vay = _mm_loadu_ps(ay), vaz = _mm_loadu_ps(az);
+    __m128 e1x = _mm_sub_ps(_mm_loadu_ps(bx), vax);
+    __m128 e1y = _mm_sub_ps(_mm_loadu_ps(by), vay);
+    __m128 e1z = _mm_sub_ps(_mm_loadu_ps(bz), vaz);
+    __m128 e2x = _mm_sub_ps(_mm_loadu_ps(cx), vax);
+    __m128 e2y = _mm_sub_ps(_mm_loadu_ps(cy), vay);
+    __m128 e2z = _mm_sub_ps(_mm_loadu_ps(cz), vaz);
+
+    /* normal = e1 x e2 */
+    __m128 nx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y));
+    __m128 ny = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z));
+    __m128 nz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+
+    /* normalize, a too short normal is left as it is (like vec3_norm).
+       rsqrt estimate + one Newton step, ~22 bits which is plenty next to EPSILON */
+    __m128 lensq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx),
+                                         _mm_mul_ps(ny, ny)),
+                              _mm_mul_ps(nz, nz));
+    __m128 small = _mm_cmplt_ps(lensq, epssq);
+    lensq = _mm_or_ps(_mm_and_ps(small, one), _mm_andnot_ps(small, lensq));
+    __m128 ilen = _mm_rsqrt_ps(lensq);
+    ilen = _mm_mul_ps(_mm_mul_ps(half, ilen),
+                      _mm_sub_ps(three, _mm_mul_ps(_mm_mul_ps(lensq, ilen), ilen)));
+    nx = _mm_mul_ps(nx, ilen);
+    ny = _mm_mul_ps(ny, ilen);
+    nz = _mm_mul_ps(nz, ilen);
+
+    /* d = -(n . a) */
+    __m128 d = _mm_sub_ps(_mm_setzero_ps(),
+                          _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, vax),
+                                                _mm_mul_ps(ny, vay)),
+                                     _mm_mul_ps(nz, vaz)));
+
+    __m128 dist_cam = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cam_x),
+                                            _mm_mul_ps(ny, cam_y)),
+                                 _mm_add_ps(_mm_mul_ps(nz, cam_z), d));
+    __m128 dist_lit = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, lit_x),
+                                            _mm_mul_ps(ny, lit_y)),
+                                 _mm_add_ps(_mm_mul_ps(nz, lit_z), d));
+
+    cam_mask[j >> 5] |= hsr_sse_flag_bits(dist_cam, cam_flag) << (j & 31);
+    lit_mask[j >> 5] |= hsr_sse_flag_bits(dist_lit, lit_flag) << (j & 31);
+
+    /* back to AoS (A, B, C, D) planes */
+    _MM_TRANSPOSE4_PS(nx, ny, nz, d);
+    _mm_storeu_ps(faces[j].v, nx);
+    _mm_storeu_ps(faces[j + 1].v, ny);
+    _mm_storeu_ps(faces[j + 2].v, nz);
+    _mm_storeu_ps(faces[j + 3].v, d);
+  }
+#endif
+
+  /* the remaining triangles (or all of them without SSE) */
+  for(; j < n_faces; j++) {
+    int cam_class, lit_class;
+    hsr_classify_one(&faces[j], &cam_class, &lit_class, vcoords, &indices[3*j], cam, lit);
+
+    if(cam_class == cam_flag)  cam_mask[j >> 5] |= 1u << (j & 31);
+    if(lit_class == lit_flag)  lit_mask[j >> 5] |= 1u << (j & 31);
+  }
+}
+
+#ifdef HSR_USE_SSE2
+/* the triangles kept by 4 mask bits - how many, then which in order */
+static const unsigned char hsr_lut[16][5] = {
+  { 0, 0, 0, 0, 0 },
+  { 1, 0, 0, 0, 0 },
+  { 1, 1, 0, 0, 0 },
+  { 2, 0, 1, 0, 0 },
+  { 1, 2, 0, 0, 0 },
+  { 2, 0, 2, 0, 0 },
+  { 2, 1, 2, 0, 0 },
+  { 3, 0, 1, 2, 0 },
+  { 1, 3, 0, 0, 0 },
+  { 2, 0, 3, 0, 0 },
+  { 2, 1, 3, 0, 0 },
+  { 3, 0, 1, 3, 0 },
+  { 2, 2, 3, 0, 0 },
+  { 3, 0, 2, 3, 0 },
+  { 3, 1, 2, 3, 0 },
+  { 4, 0, 1, 2, 3 }
+};
+#endif
+
+/* copy the 3 indices of every triangle whose mask bit is set, return the index count */
+int
+hsr_compact( unsigned short *o_indices,
+             const unsigned int *mask,
+             const unsigned short *indices,
+             const int n_faces )
+{
+  int w = 0;
+  int count = 0;
+  int n_words = HSR_MASK_WORDS(n_faces);
+
+#ifdef HSR_USE_SSE2
+  /* 4 triangles at a time through the table, each copied by one 8 bytes move.
+     it writes and reads an index past the triangle, the last word is left to
+     the scalar loop so neither goes past the arrays */
+  for(; w < n_words - 1; w++) {
+    unsigned int bits = mask[w];
+    const unsigned short *src = &indices[96*w];
+    int q, k;
+
+    if(bits == 0)  continue;
+    if(bits == 0xffffffff) {
+      memcpy(&o_indices[count], src, sizeof(unsigned short)*96);
+      count += 96;
+      continue;
+    }
+
+    for(q = 0; q < 32; q += 4, src += 12) {
+      const unsigned char *e = hsr_lut[(bits >> q) & 0xf];
+      for(k = 0; k < e[0]; k++) {
+        _mm_storel_epi64((__m128i *)&o_indices[count],
+                         _mm_loadl_epi64((const __m128i *)&src[3*e[k + 1]]));
+        count += 3;
+      }
+    }
+  }
+#endif
+
+  for(; w < n_words; w++) {
+    unsigned int bits = mask[w];
+    const unsigned short *src = &indices[96*w];
+
+    /* a full word is one straight copy of 32 triangles */
+    if(bits == 0xffffffff) {
+      memcpy(&o_indices[count], src, sizeof(unsigned short)*96);
+      count += 96;
+      continue;
+    }
+
+    while(bits) {
+      const unsigned short *tri = &src[3*hsr_lowest_bit(bits)];
+      bits &= bits - 1;
+
+      o_indices[count] = tri[0];
+      o_indices[count + 1] = tri[1];
+      o_indices[count + 2] = tri[2];
+      count += 3;
+    }
+  }
+
+  return count;
+}
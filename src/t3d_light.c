@@ -19,7 +19,7 @@ lit_gen_depth_tex( const int shadow_size )
   GLuint tex_id;
 
   glGenTextures(1, &tex_id);
-  glBindTexture(GL_TEXTURE_2D, tex_id);
+  ogl_bind_texture_for_upload(GL_TEXTURE_2D, tex_id);
 
   glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT,
                shadow_size, shadow_size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
@@ -70,7 +70,7 @@ lit_del( light *lit )
   if(!lit) return;
 
   glDeleteFramebuffers(1, &lit->fbo_shadow);
-  glDeleteTextures(1, &lit->tex_shadow);
+  ogl_delete_textures(1, &lit->tex_shadow);
 
   free(lit);
 }
@@ -0,0 +1,223 @@
+/*----- t3d_loader.c ---------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <t3d_ogl.h>
+#include <t3d_timer.h>
+#include <t3d_math.h>
+#include <t3d_thpool.h>
+#include <t3d_texture.h>
+#include <t3d_texstream.h>
+#include <t3d_ms3d.h>
+#include <t3d_loader.h>
+
+
+/* create a loader in memory */
+loader *
+ldr_new( texstream *texstm )
+{
+  loader *ldr = (loader *)malloc(sizeof(loader));
+
+  ldr->capacity = 16;
+  ldr->jobs = (ldrjob **)malloc(sizeof(ldrjob *)*ldr->capacity);
+  ldr->n_jobs = 0;
+
+  if(!ldr->jobs) {
+    fprintf(stderr, "line %d: Can not allocate memory\n", __LINE__);
+    exit(EXIT_FAILURE);
+  }
+
+  ldr->n_working = 0;
+  ldr->budget = LDR_BUDGET;
+
+  ldr->pool = NULL;
+  ldr->texstm = texstm;
+
+  pthread_mutex_init(&ldr->lock, NULL);
+  pthread_cond_init(&ldr->notify, NULL);
+
+  return ldr;
+}
+
+/* delete a loader from memory, waits for the jobs the workers hold */
+void
+ldr_del( loader *ldr )
+{
+  int i;
+
+  if(!ldr)  return;
+
+  pthread_mutex_lock(&ldr->lock);
+  while(ldr->n_working > 0)
+    pthread_cond_wait(&ldr->notify, &ldr->lock);
+  pthread_mutex_unlock(&ldr->lock);
+
+  /* the textures keep their placeholders */
+  for(i = 0; i < ldr->n_jobs; i++) {
+    ldrjob *job = ldr->jobs[i];
+    tex_image_del(job->img);
+    ms3d_del(job->model);
+    free(job);
+  }
+
+  pthread_cond_destroy(&ldr->notify);
+  pthread_mutex_destroy(&ldr->lock);
+  free(ldr->jobs);
+  free(ldr);
+}
+
+/* decode the jobs on a thread pool */
+void
+ldr_set_thpool( loader *ldr, thpool *pool )
+{
+  if(ldr)  ldr->pool = pool;
+}
+
+/* worker - the CPU half of a load, no GL */
+static void
+ldr_job( void *arg )
+{
+  ldrjob *job = (ldrjob *)arg;
+  loader *ldr = job->ldr;
+
+  if(job->type == LDR_TEXTURE)
+    job->img = tex_decode(job->path, job->s3tc_compressed);
+  else
+    job->model = ms3d_load(job->path);
+
+  pthread_mutex_lock(&ldr->lock);
+  job->done = 1;
+  ldr->n_working--;
+  pthread_cond_signal(&ldr->notify);
+  pthread_mutex_unlock(&ldr->lock);
+}
+
+/* queue a job to the workers */
+static ldrjob *
+ldr_add( loader *ldr, const int type, const char *path )
+{
+  ldrjob *job = (ldrjob *)calloc(1, sizeof(ldrjob));
+
+  job->type = type;
+  strncpy(job->path, path, sizeof(job->path) - 1);
+  job->ldr = ldr;
+
+  if(ldr->n_jobs == ldr->capacity) {
+    ldr->capacity *= 2;
+    ldr->jobs = (ldrjob **)realloc(ldr->jobs, sizeof(ldrjob *)*ldr->capacity);
+  }
+  ldr->jobs[ldr->n_jobs++] = job;
+
+  return job;
+}
+
+/* hand a job to the workers, or decode it now without them */
+static void
+ldr_start( loader *ldr, ldrjob *job )
+{
+  pthread_mutex_lock(&ldr->lock);
+  ldr->n_working++;
+  pthread_mutex_unlock(&ldr->lock);
+
+  if(!ldr->pool || thpool_add_job(ldr->pool, &ldr_job, job, 0) != 0)
+    ldr_job(job);
+}
+
+/* a texture showing the rgba placeholder until the image is loaded */
+GLuint
+ldr_texture( loader *ldr, const char *path, const int s3tc_compressed, const unsigned char *rgba )
+{
+  static const unsigned char gray[4] = { 128, 128, 128, 255 };
+
+  ldrjob *job = ldr_add(ldr, LDR_TEXTURE, path);
+  job->s3tc_compressed = s3tc_compressed;
+  job->tex_id = tex_gen_solid(rgba ? rgba : gray);
+
+  /* the GL id is known before the job starts, it never changes */
+  GLuint tex_id = job->tex_id;
+  ldr_start(ldr, job);
+
+  return tex_id;
+}
+
+/* load a model, ready gets it on the GL thread */
+void
+ldr_model( loader *ldr, const char *path, ldr_callback ready, void *data, const int key )
+{
+  ldrjob *job = ldr_add(ldr, LDR_MODEL, path);
+  job->ready = ready;
+  job->data = data;
+  job->key = key;
+
+  ldr_start(ldr, job);
+}
+
+/* upload a finished job and tell its owner */
+static void
+ldr_finish( loader *ldr, ldrjob *job )
+{
+  if(job->type == LDR_TEXTURE) {
+    if(!job->img) {
+      fprintf(stderr, "Can not load texture %s\n", job->path);
+    }
+    else if(ldr->texstm) {
+      tex_stream_attach(ldr->texstm, job->tex_id, job->img);
+      job->img = NULL;
+    }
+    else {
+      tex_upload_to(job->tex_id, job->img);
+      tex_image_del(job->img);
+      job->img = NULL;
+    }
+  }
+  else {
+    if(job->model)
+      ms3d_upload(job->model);
+    else
+      fprintf(stderr, "Can not load model %s\n", job->path);
+  }
+
+  if(job->ready)  job->ready(job);
+
+  /* whatever ready did not take */
+  ms3d_del(job->model);
+  free(job);
+}
+
+/* once a frame on the GL thread - upload what the workers finished within the budget,
+   return the jobs still pending */
+int
+ldr_update( loader *ldr )
+{
+  int i, n = 0;
+
+  if(!ldr || ldr->n_jobs == 0)  return 0;
+
+  double start = tmr_getmsecs();
+  int finished = 0;
+
+  for(i = 0; i < ldr->n_jobs; i++) {
+    ldrjob *job = ldr->jobs[i];
+
+    pthread_mutex_lock(&ldr->lock);
+    int done = job->done;
+    pthread_mutex_unlock(&ldr->lock);
+
+    /* at least one a frame, the budget only spreads them */
+    int in_budget = finished == 0 || tmr_getmsecs() - start < ldr->budget;
+    if(done && in_budget) {
+      ldr_finish(ldr, job);
+      finished++;
+    }
+    else {
+      ldr->jobs[n++] = job;
+    }
+  }
+  ldr->n_jobs = n;
+
+  return n;
+}
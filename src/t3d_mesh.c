@@ -4,53 +4,79 @@
  +---------------------------------------------------------------------------*/
 
 #include <stdlib.h>
-#include <t3d_ogl.h>
+#include <string.h>
 #include <t3d_math.h>
+#include <t3d_mpool.h>
+#include <t3d_hsr.h>
 #include <t3d_mesh.h>
 
 
-/* create a mesh struct in memory */
+/* bytes of a mesh with its arrays in one block */
+size_t
+mesh_size( const int n_vertices, const int n_faces )
+{
+  return mpool_align(sizeof(mesh)) +
+         mpool_align(sizeof(vec3)*n_vertices)*3 +
+         mpool_align(sizeof(vec4)*n_faces) +
+         mpool_align(sizeof(unsigned short)*n_faces*3)*2 +
+         mpool_align(sizeof(unsigned int)*HSR_MASK_WORDS(n_faces))*2 +
+         mpool_align(sizeof(unsigned int)*n_vertices);
+}
+
+/* lay a mesh out in a block of mesh_size bytes, the arrays follow the struct */
 mesh *
-mesh_new( const int n_vertices )
+mesh_init( void *block, const int n_vertices, const int n_faces )
 {
-  mesh *msh = (mesh *)malloc(sizeof(mesh));
-
-  msh->n_faces = n_vertices/3;
-  msh->vcoords = (vec3 *)malloc(sizeof(vec3)*n_vertices);
-  msh->normals = (vec3 *)malloc(sizeof(vec3)*n_vertices);
-  msh->tangents = (vec3 *)malloc(sizeof(vec3)*n_vertices);
-  msh->faces = (vec4 *)malloc(sizeof(vec4)*msh->n_faces);
-  msh->hsr_cam_v_indices = (unsigned short *)malloc(sizeof(unsigned short)*n_vertices);
-  msh->hsr_lit_v_indices = (unsigned short *)malloc(sizeof(unsigned short)*n_vertices);
+  char *p = (char *)block;
+  mesh *msh = (mesh *)p;
+  p += mpool_align(sizeof(mesh));
+
+  msh->n_faces = n_faces;
+  msh->vcoords = (vec3 *)p;
+  p += mpool_align(sizeof(vec3)*n_vertices);
+  msh->normals = (vec3 *)p;
+  p += mpool_align(sizeof(vec3)*n_vertices);
+  msh->tangents = (vec3 *)p;
+  p += mpool_align(sizeof(vec3)*n_vertices);
+  msh->faces = (vec4 *)p;
+  p += mpool_align(sizeof(vec4)*n_faces);
+  msh->hsr_cam_v_indices = (unsigned short *)p;
+  p += mpool_align(sizeof(unsigned short)*n_faces*3);
+  msh->hsr_lit_v_indices = (unsigned short *)p;
+  p += mpool_align(sizeof(unsigned short)*n_faces*3);
+  msh->hsr_cam_mask = (unsigned int *)p;
+  p += mpool_align(sizeof(unsigned int)*HSR_MASK_WORDS(n_faces));
+  msh->hsr_lit_mask = (unsigned int *)p;
+  p += mpool_align(sizeof(unsigned int)*HSR_MASK_WORDS(n_faces));
+  msh->skin_stamps = (unsigned int *)p;
+  memset(msh->skin_stamps, 0, sizeof(unsigned int)*n_vertices);
+
+  msh->skin_stamp = 0;
   msh->cam_hsr_count = 0;
   msh->lit_hsr_count = 0;
 
-  glGenBuffers(1, &msh->vbo_coords);
-  glGenBuffers(1, &msh->vbo_normals);
-  glGenBuffers(1, &msh->vbo_tangents);
-  glGenBuffers(1, &msh->ibo_hsr_cam_elements);
-  glGenBuffers(1, &msh->ibo_hsr_lit_elements);
+  msh->stm_coords = 0;
+  msh->stm_normals = 0;
+  msh->stm_tangents = 0;
+  msh->stm_hsr_cam_elements = 0;
+  msh->stm_hsr_lit_elements = 0;
 
   return msh;
 }
 
-/* delete a mesh struct form memory */
+/* create a mesh struct in memory */
+mesh *
+mesh_new( const int n_vertices, const int n_faces )
+{
+  void *block = malloc(mesh_size(n_vertices, n_faces));
+  if(!block)  return NULL;
+
+  return mesh_init(block, n_vertices, n_faces);
+}
+
+/* delete a mesh struct form memory, one made by mesh_new */
 void
 mesh_del( mesh *msh )
 {
-  if(!msh) return;
-
-  glDeleteBuffers(1, &msh->vbo_coords);
-  glDeleteBuffers(1, &msh->vbo_normals);
-  glDeleteBuffers(1, &msh->vbo_tangents);
-  glDeleteBuffers(1, &msh->ibo_hsr_cam_elements);
-  glDeleteBuffers(1, &msh->ibo_hsr_lit_elements);
-  free(msh->vcoords);
-  free(msh->normals);
-  free(msh->tangents);
-  free(msh->faces);
-  free(msh->hsr_cam_v_indices);
-  free(msh->hsr_lit_v_indices);
-
   free(msh);
-}
\ No newline at end of file
+}
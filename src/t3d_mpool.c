@@ -0,0 +1,104 @@
+/*----- t3d_mpool.c ----------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <t3d_mpool.h>
+
+
+/* a block of objects, the header is padded so the objects stay aligned */
+struct __mpslab {
+  struct __mpslab *next;
+};
+
+#define MPOOL_SLAB_HEADER  mpool_align(sizeof(struct __mpslab))
+
+
+/* create a pool of obj_size objects in memory */
+mpool *
+mpool_new( const size_t obj_size, const int objs_per_slab )
+{
+  mpool *mp = (mpool *)malloc(sizeof(mpool));
+
+  if(!mp) {
+    fprintf(stderr, "line %d: Can not allocate memory\n", __LINE__);
+    exit(EXIT_FAILURE);
+  }
+
+  /* a free object holds the free list link */
+  mp->obj_size = mpool_align(obj_size > sizeof(void *) ? obj_size : sizeof(void *));
+  mp->objs_per_slab = objs_per_slab > 0 ? objs_per_slab : 1;
+
+  mp->free_list = NULL;
+  mp->slabs = NULL;
+  mp->n_used = 0;
+
+  return mp;
+}
+
+/* delete a pool and all of its objects from memory */
+void
+mpool_del( mpool *mp )
+{
+  if(!mp)  return;
+
+  struct __mpslab *slab = mp->slabs;
+  while(slab) {
+    struct __mpslab *next = slab->next;
+    free(slab);
+    slab = next;
+  }
+
+  free(mp);
+}
+
+/* carve a new slab into the free list */
+static void
+mpool_grow( mpool *mp )
+{
+  struct __mpslab *slab;
+  slab = (struct __mpslab *)malloc(MPOOL_SLAB_HEADER + mp->obj_size*mp->objs_per_slab);
+
+  if(!slab) {
+    fprintf(stderr, "line %d: Can not allocate memory\n", __LINE__);
+    exit(EXIT_FAILURE);
+  }
+
+  slab->next = mp->slabs;
+  mp->slabs = slab;
+
+  /* in address order, the first objects handed out are next to each other */
+  char *objs = (char *)slab + MPOOL_SLAB_HEADER;
+  int i;
+  for(i = mp->objs_per_slab - 1; i >= 0; i--) {
+    void *obj = objs + mp->obj_size*i;
+    *(void **)obj = mp->free_list;
+    mp->free_list = obj;
+  }
+}
+
+/* an object of the pool, not cleared */
+void *
+mpool_alloc( mpool *mp )
+{
+  if(!mp->free_list)  mpool_grow(mp);
+
+  void *obj = mp->free_list;
+  mp->free_list = *(void **)obj;
+  mp->n_used++;
+
+  return obj;
+}
+
+/* give an object back to its pool */
+void
+mpool_free( mpool *mp, void *obj )
+{
+  if(!obj)  return;
+
+  *(void **)obj = mp->free_list;
+  mp->free_list = obj;
+  mp->n_used--;
+}
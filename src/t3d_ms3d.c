@@ -5,6 +5,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <t3d_math.h>
 #include <t3d_ogl.h>
 #include <t3d_vector.h>
@@ -13,9 +15,15 @@
 #include <t3d_geomath.h>
 #include <t3d_ms3dmesh.h>
 #include <t3d_decal.h>
+#include <t3d_mpool.h>
 #include <t3d_ms3d.h>
 
 
+#define MS3D_COOKED_VERSION  2
+#define MS3D_COOKED_ALIGN    16
+#define MS3D_MAX_VERTICES    65535    /* welded vertices of a mesh, indexed by unsigned short */
+
+
 typedef struct __ms3dkey ms3dkey;
 
 struct __ms3dkey {
@@ -123,76 +131,241 @@ typedef struct __MS3DPACKED {
 #undef __MS3DPACKED
 
 
-/* load meshes into ms3d */
+/* the cooked model file (.t3dm), the offsets are from the start of the file */
+
+/* a mesh, its arrays are used in place */
+typedef struct __ms3dcooked_mesh {
+  int n_vertices;
+  int n_faces;
+  int material_index;
+  int vcoords;              /* vec3 */
+  int normals;              /* vec3 */
+  int tangents;             /* vec3 */
+  int texcoords;            /* vec2 */
+  int jnt_indices;          /* short */
+  int indices;              /* unsigned short, 3 per triangle */
+} ms3dcooked_mesh;
+
+/* a joint with its bind matrices, its keys are used in place */
+typedef struct __ms3dcooked_joint {
+  mat4 mat_abs;
+  mat4 mat_local;
+  int parent;
+  int n_rotkeys;
+  int n_transkeys;
+  int rotkeys;              /* ms3dkey */
+  int transkeys;            /* ms3dkey */
+} ms3dcooked_joint;
+
+/* head of a cooked file */
+typedef struct __ms3dcooked_header {
+  char magic[4];            /* "T3DM" */
+  int version;
+  long long src_mtime;      /* the ms3d file the model was cooked from */
+  long long src_size;
+  unsigned long long src_hash;
+  long long anim_mtime;     /* its command file */
+  long long anim_size;      /* -1 if there was none */
+  unsigned long long anim_hash;
+  int n_mshs;
+  int n_skins;
+  int n_joints;
+  int n_cmds;
+  float anim_fps;
+  float frametime;
+  float total_time;
+  int meshes;               /* ms3dcooked_mesh */
+  int skins;                /* ms3dskin, used in place */
+  int joints;               /* ms3dcooked_joint */
+  int cmds;                 /* ms3dcmd, used in place */
+} ms3dcooked_header;
+
+/* a cooked file being written */
+typedef struct __ms3dcooker {
+  unsigned char *data;
+  size_t size;
+  size_t capacity;
+} ms3dcooker;
+
+
+/* a fully expanded triangle corner, compared as a whole when welding */
+typedef struct __ms3dcorner {
+  vec3 pos;
+  vec3 normal;
+  vec3 tangent;
+  vec2 texcoord;
+  int bone_id;
+} ms3dcorner;
+
+/* FNV-1a over the raw bytes of a corner */
+static unsigned int
+ms3d_corner_hash( const ms3dcorner *c )
+{
+  const unsigned char *p = (const unsigned char *)c;
+  unsigned int h = 2166136261u;
+  unsigned int i;
+  for(i = 0; i < sizeof(ms3dcorner); i++) {
+    h ^= p[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/* weld the triangles of a mesh from the first one into a new ms3dmesh, until
+   the next triangle could take it past MS3D_MAX_VERTICES. return the triangles taken */
+static int
+ms3d_weld_part( ms3dmesh **part, const __ms3dmesh *o_mesh, const int first,
+                                 const __ms3dtriangle *o_triangles,
+                                 const __ms3dvertex *o_vertices,
+                                 const vec3 *o_tangents )
+{
+  int j, k;
+  int n_faces = (int)o_mesh->n_triangles - first;
+  int n_corners = n_faces*3;
+  int n_unique = 0;
+
+  /* open addressing table of unique corner ids, size is a power of 2 */
+  unsigned int n_slots = 16;
+  while(n_slots < (unsigned int)n_corners*2)  n_slots <<= 1;
+  int *slots = (int *)malloc(sizeof(int)*n_slots);
+  memset(slots, -1, sizeof(int)*n_slots);
+
+  ms3dcorner *uniques = (ms3dcorner *)malloc(sizeof(ms3dcorner)*(n_corners + 1));
+  unsigned short *indices = (unsigned short *)malloc(sizeof(unsigned short)*(n_corners + 1));
+
+  for(j = 0; j < n_faces; j++) {
+    /* a triangle adds 3 vertices at most */
+    if(n_unique + 3 > MS3D_MAX_VERTICES)  break;
+
+    const __ms3dtriangle *triangle = &o_triangles[(int)o_mesh->triangle_indices[first + j]];
+    /* loop thru 3 vertices of a triangle */
+    for(k = 0; k < 3; k++) {
+      int v_index = (int)triangle->vertex_indices[k];
+      const __ms3dvertex *o_vertex = &o_vertices[v_index];
+      ms3dcorner c;
+
+      memset(&c, 0, sizeof(ms3dcorner));
+      memcpy(&c.pos, &o_vertex->pos, sizeof(vec3));
+      memcpy(&c.normal, &triangle->vertex_normals[k], sizeof(vec3));
+      memcpy(&c.tangent, &o_tangents[v_index], sizeof(vec3));
+      vec2_set(&c.texcoord, triangle->s[k], triangle->t[k]);
+      c.bone_id = (int)o_vertex->bone_id;
+
+      unsigned int slot = ms3d_corner_hash(&c) & (n_slots - 1);
+      while(slots[slot] >= 0 &&
+            memcmp(&uniques[slots[slot]], &c, sizeof(ms3dcorner)) != 0) {
+        slot = (slot + 1) & (n_slots - 1);
+      }
+      if(slots[slot] < 0) {
+        slots[slot] = n_unique;
+        memcpy(&uniques[n_unique], &c, sizeof(ms3dcorner));
+        n_unique++;
+      }
+      indices[j*3 + k] = (unsigned short)slots[slot];
+    }
+  }
+  n_faces = j;
+
+  *part = ms3dmesh_new(n_unique, n_faces);
+  ms3dmesh *o_msh = *part;
+
+  o_msh->material_index = o_mesh->material_index;
+
+  for(j = 0; j < n_unique; j++) {
+    memcpy(&o_msh->o_vcoords[j], &uniques[j].pos, sizeof(vec3));
+    memcpy(&o_msh->o_normals[j], &uniques[j].normal, sizeof(vec3));
+    memcpy(&o_msh->o_tangents[j], &uniques[j].tangent, sizeof(vec3));
+    memcpy(&o_msh->o_texcoords[j], &uniques[j].texcoord, sizeof(vec2));
+    o_msh->o_jnt_indices[j] = (short)uniques[j].bone_id;
+  }
+  memcpy(o_msh->o_indices, indices, sizeof(unsigned short)*n_faces*3);
+
+  free(indices);
+  free(uniques);
+  free(slots);
+
+  return n_faces;
+}
+
+/* load meshes into ms3d, identical corners are welded into one vertex. a mesh
+   welding to more vertices than unsigned short indices reach is split in parts
+   of the same material */
 static void
-ms3d_load_meshes( ms3d *m, const __ms3dmesh *o_meshes,
+ms3d_load_meshes( ms3d *m, const int n_meshes,
+                           const __ms3dmesh *o_meshes,
                            const __ms3dtriangle *o_triangles,
                            const __ms3dvertex *o_vertices,
-                           const vec3 *o_tangents,
-                           const __ms3dmaterial *o_materials )
+                           const vec3 *o_tangents )
 {
-  int i, j, k, count;
-
-  for(i = 0; i < m->n_mshs; i++) {
-    m->o_mshs[i] = ms3dmesh_new((int)(o_meshes[i].n_triangles)*3);
-    ms3dmesh *o_msh = m->o_mshs[i];
-
-    o_msh->material_index = o_meshes[i].material_index;
+  int capacity = n_meshes;
+  int i;
 
-    count = 0;
+  m->n_mshs = 0;
+  m->o_mshs = (ms3dmesh **)malloc(sizeof(ms3dmesh *)*(capacity + 1));
 
-    for(j = 0; j < o_meshes[i].n_triangles; j++) {
-      const __ms3dtriangle *triangle = &o_triangles[(int)o_meshes[i].triangle_indices[j]];
-      /* loop thru 3 vertices of a triangle */
-      for(k = 0; k < 3; k++) {
-        int v_index = (int)triangle->vertex_indices[k];
-        const __ms3dvertex *o_vertex = &o_vertices[v_index];
-        vec2 o_texcoord;
-        vec2_set(&o_texcoord, triangle->s[k], triangle->t[k]);
-
-        memcpy(&o_msh->o_vcoords[count], &o_vertex->pos, sizeof(vec3));
-        memcpy(&o_msh->o_normals[count], &triangle->vertex_normals[k], sizeof(vec3));
-        memcpy(&o_msh->o_tangents[count], &o_tangents[v_index], sizeof(vec3));
-        memcpy(&o_msh->o_texcoords[count], &o_texcoord, sizeof(vec2));
-        o_msh->o_jnt_indices[count] = (short)o_vertex->bone_id;
-        count++;
+  for(i = 0; i < n_meshes; i++) {
+    int n_faces = (int)o_meshes[i].n_triangles;
+    int first = 0;
+    int n_parts = 0;
+
+    /* a mesh with no triangles still has its place */
+    do {
+      if(m->n_mshs == capacity) {
+        capacity *= 2;
+        m->o_mshs = (ms3dmesh **)realloc(m->o_mshs, sizeof(ms3dmesh *)*(capacity + 1));
       }
-    }
+      first += ms3d_weld_part(&m->o_mshs[m->n_mshs++], &o_meshes[i], first,
+                              o_triangles, o_vertices, o_tangents);
+      n_parts++;
+    } while(first < n_faces);
+
+    if(n_parts > 1)
+      fprintf(stderr, "Mesh %.*s has more than %d vertices, split in parts\n",
+              (int)sizeof(o_meshes[i].name), o_meshes[i].name, MS3D_MAX_VERTICES);
   }
 }
 
-/* store texture coordinates in graphic card buffers */
-static void
-ms3d_upload( const ms3d *m )
+/* store texture coordinates and triangle indices in graphic card buffers, main thread only */
+void
+ms3d_upload( ms3d *m )
 {
   int i;
   for(i = 0; i < m->n_mshs; i++) {
     ms3dmesh *o_msh = m->o_mshs[i];
 
-    glBindBuffer(GL_ARRAY_BUFFER, o_msh->vbo_o_texcoords);
+    glGenBuffers(1, &o_msh->vbo_o_texcoords);
+    glGenBuffers(1, &o_msh->ibo_o_elements);
+
+    ogl_bind_buffer(GL_ARRAY_BUFFER, o_msh->vbo_o_texcoords);
     glBufferData(GL_ARRAY_BUFFER,
                  o_msh->n_vertices*sizeof(vec2),
                  o_msh->o_texcoords,
                  GL_STATIC_DRAW);
+
+    ogl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, o_msh->ibo_o_elements);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 o_msh->n_faces*3*sizeof(unsigned short),
+                 o_msh->o_indices,
+                 GL_STATIC_DRAW);
   }
 }
 
-/* load static ms3d model vertices */
+/* parse a ms3d file in memory, no GL work (e.g. in the cook tool) */
 ms3d *
-ms3d_new( const unsigned char *buf, const hashtable *texdb )
+ms3d_parse( const unsigned char *buf )
 {
   int i, j;
   int chunk_size;
 
-  ms3d* m = (ms3d *)malloc(sizeof(ms3d));
-
   /* get the model header information */
   const unsigned char *ptr = buf;
   __ms3dheader *header = (__ms3dheader *)ptr;
   ptr += sizeof(__ms3dheader);
 
   /* not a valid Milkshape3D model file, return 0 NULL */
-  if(strncmp(header->id, "MS3D000000", 10) != 0)  return NULL;
+  if(!buf || strncmp(header->id, "MS3D000000", 10) != 0)  return NULL;
+
+  ms3d* m = (ms3d *)calloc(1, sizeof(ms3d));
 
   /* get the vertices information */
   unsigned short n_vertices = *(unsigned short *)ptr;
@@ -266,7 +439,8 @@ ms3d_new( const unsigned char *buf, const hashtable *texdb )
   unsigned short n_materials = *(unsigned short *)ptr;
   ptr += sizeof(unsigned short);
   __ms3dmaterial *o_materials = (__ms3dmaterial *)malloc(sizeof(__ms3dmaterial)*n_materials);
-  m->o_skins = (ms3dskin *)malloc(sizeof(ms3dskin)*n_materials);
+  /* zeroed, the cooked file gets no stray bytes after the names */
+  m->o_skins = (ms3dskin *)calloc(n_materials, sizeof(ms3dskin));
   for(i = 0; i < n_materials; i++) {
     memcpy(&o_materials[i], ptr, sizeof(__ms3dmaterial));
     vec4_cpy(&m->o_skins[i].ambient, &o_materials[i].ambient);
@@ -396,11 +570,12 @@ ms3d_new( const unsigned char *buf, const hashtable *texdb )
     }
   }
 
-  m->n_mshs = n_meshes;
   m->n_skins = n_materials;
+  m->skin_arrays = NULL;
+  m->skin_stride = 0;
+  m->n_skin_layers = 0;
   m->n_joints = n_joints;
-  m->o_mshs = (ms3dmesh **)malloc(sizeof(ms3dmesh *)*m->n_mshs);
-  ms3d_load_meshes(m, o_meshes, o_triangles, o_vertices, o_tangents, o_materials);
+  ms3d_load_meshes(m, n_meshes, o_meshes, o_triangles, o_vertices, o_tangents);
 
   free(o_meshes);
   free(o_triangles);
@@ -408,7 +583,405 @@ ms3d_new( const unsigned char *buf, const hashtable *texdb )
   free(o_tangents);
   free(o_materials);
 
-  ms3d_upload(m);
+  return m;
+}
+
+/* load static ms3d model vertices */
+ms3d *
+ms3d_new( const unsigned char *buf, const hashtable *texdb )
+{
+  ms3d *m = ms3d_parse(buf);
+  if(m)  ms3d_upload(m);
+
+  return m;
+}
+
+/* append a section to a cooked file, NULL data appends zeros. return its offset */
+static int
+ms3d_cook_put( ms3dcooker *ck, const void *data, const size_t size )
+{
+  size_t offset = (ck->size + MS3D_COOKED_ALIGN - 1) & ~(size_t)(MS3D_COOKED_ALIGN - 1);
+
+  if(offset + size > ck->capacity) {
+    while(offset + size > ck->capacity)
+      ck->capacity = ck->capacity ? ck->capacity*2 : 65536;
+    ck->data = (unsigned char *)realloc(ck->data, ck->capacity);
+  }
+
+  memset(ck->data + ck->size, 0, offset - ck->size);
+  if(data)
+    memcpy(ck->data + offset, data, size);
+  else
+    memset(ck->data + offset, 0, size);
+  ck->size = offset + size;
+
+  return (int)offset;
+}
+
+/* size of a source file, packed or loose, -1 if there is none.
+   mtime is -1 for a packed file */
+static long long
+ms3d_source_size( const char *file, long long *mtime )
+{
+  struct stat st;
+  size_t size;
+
+  if(mtime)  *mtime = -1;
+  if(util_pack_find(file, &size))  return (long long)size;
+  if(stat(file, &st) != 0)  return -1;
+
+  if(mtime)  *mtime = (long long)st.st_mtime;
+  return (long long)st.st_size;
+}
+
+/* FNV-1a hash of a whole source file, 0 if it can not be read */
+static unsigned long long
+ms3d_source_hash( const char *file )
+{
+  size_t size;
+  const void *data = util_map_file(file, &size);
+  if(!data)  return 0;
+
+  unsigned long long hash = util_fnv1a(data, size, UTIL_FNV1A_SEED);
+  util_unmap_file(data, size);
+
+  return hash;
+}
+
+/* write a parsed model with its commands to <file>.t3dm, return 0 on failure */
+int
+ms3d_cook( const ms3d *m, const char *file )
+{
+  char cookedfile[512], animfile[512], tmpfile[520];
+  ms3dcooked_header hdr;
+  ms3dcooker ck = { NULL, 0, 0 };
+  int i;
+
+  snprintf(cookedfile, sizeof(cookedfile), "%s.t3dm", file);
+  snprintf(animfile, sizeof(animfile), "%s.anim", file);
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, "T3DM", 4);
+  hdr.version = MS3D_COOKED_VERSION;
+  hdr.src_size = ms3d_source_size(file, &hdr.src_mtime);
+  hdr.src_hash = ms3d_source_hash(file);
+  hdr.anim_size = ms3d_source_size(animfile, &hdr.anim_mtime);
+  hdr.anim_hash = ms3d_source_hash(animfile);
+  hdr.n_mshs = m->n_mshs;
+  hdr.n_skins = m->n_skins;
+  hdr.n_joints = m->n_joints;
+  hdr.n_cmds = m->n_cmds;
+  hdr.anim_fps = m->anim_fps;
+  hdr.frametime = m->frametime;
+  hdr.total_time = m->total_time;
+
+  ms3d_cook_put(&ck, NULL, sizeof(hdr));
+
+  ms3dcooked_mesh *meshes = (ms3dcooked_mesh *)calloc(m->n_mshs + 1, sizeof(ms3dcooked_mesh));
+  for(i = 0; i < m->n_mshs; i++) {
+    const ms3dmesh *o_msh = m->o_mshs[i];
+    ms3dcooked_mesh *cm = &meshes[i];
+
+    cm->n_vertices = o_msh->n_vertices;
+    cm->n_faces = o_msh->n_faces;
+    cm->material_index = o_msh->material_index;
+    cm->vcoords = ms3d_cook_put(&ck, o_msh->o_vcoords, sizeof(vec3)*o_msh->n_vertices);
+    cm->normals = ms3d_cook_put(&ck, o_msh->o_normals, sizeof(vec3)*o_msh->n_vertices);
+    cm->tangents = ms3d_cook_put(&ck, o_msh->o_tangents, sizeof(vec3)*o_msh->n_vertices);
+    cm->texcoords = ms3d_cook_put(&ck, o_msh->o_texcoords, sizeof(vec2)*o_msh->n_vertices);
+    cm->jnt_indices = ms3d_cook_put(&ck, o_msh->o_jnt_indices, sizeof(short)*o_msh->n_vertices);
+    cm->indices = ms3d_cook_put(&ck, o_msh->o_indices, sizeof(unsigned short)*o_msh->n_faces*3);
+  }
+  hdr.meshes = ms3d_cook_put(&ck, meshes, sizeof(ms3dcooked_mesh)*m->n_mshs);
+  free(meshes);
+
+  hdr.skins = ms3d_cook_put(&ck, m->o_skins, sizeof(ms3dskin)*m->n_skins);
+
+  ms3dcooked_joint *joints = (ms3dcooked_joint *)calloc(m->n_joints + 1, sizeof(ms3dcooked_joint));
+  for(i = 0; i < m->n_joints; i++) {
+    const ms3djoint *jnt = &m->o_joints[i];
+    ms3dcooked_joint *cj = &joints[i];
+
+    mat4_cpy(&cj->mat_abs, &jnt->mat_abs);
+    mat4_cpy(&cj->mat_local, &jnt->mat_local);
+    cj->parent = jnt->parent;
+    cj->n_rotkeys = jnt->n_rotkeys;
+    cj->n_transkeys = jnt->n_transkeys;
+    cj->rotkeys = ms3d_cook_put(&ck, jnt->rotkeys, sizeof(ms3dkey)*jnt->n_rotkeys);
+    cj->transkeys = ms3d_cook_put(&ck, jnt->transkeys, sizeof(ms3dkey)*jnt->n_transkeys);
+  }
+  hdr.joints = ms3d_cook_put(&ck, joints, sizeof(ms3dcooked_joint)*m->n_joints);
+  free(joints);
+
+  hdr.cmds = ms3d_cook_put(&ck, m->anim_cmds, sizeof(ms3dcmd)*m->n_cmds);
+  memcpy(ck.data, &hdr, sizeof(hdr));
+
+  /* written aside then renamed, a reader never sees half a file */
+  snprintf(tmpfile, sizeof(tmpfile), "%s.tmp", cookedfile);
+  FILE *fp = fopen(tmpfile, "wb");
+  int ok = fp != NULL;
+  if(ok) {
+    ok = fwrite(ck.data, ck.size, 1, fp) == 1;
+    ok = (fclose(fp) == 0) && ok;
+  }
+  free(ck.data);
+
+#ifdef _WIN32
+  if(ok)  remove(cookedfile);
+#endif
+  if(!ok || rename(tmpfile, cookedfile) != 0) {
+    remove(tmpfile);
+    return 0;
+  }
+
+  return 1;
+}
+
+/* a section of a cooked file in memory, NULL if it is out of the file */
+static void *
+ms3d_cooked_at( const void *data, const size_t size,
+                const int offset, const int count, const size_t elem_size )
+{
+  if(offset < (int)sizeof(ms3dcooked_header) || offset % 4 != 0 || count < 0)  return NULL;
+  if((size_t)offset + elem_size*count > size)  return NULL;
+
+  return (unsigned char *)data + offset;
+}
+
+/* a model with its arrays in a cooked file in memory, NULL if it is truncated.
+   mapping_size 0 borrows the data (e.g. from the asset pack) */
+static ms3d *
+ms3d_cooked_model( const void *data, const size_t size, const size_t mapping_size )
+{
+  ms3dcooked_header hdr;
+  int i;
+
+  memcpy(&hdr, data, sizeof(hdr));
+  if(hdr.n_mshs < 0 || hdr.n_skins < 0 || hdr.n_joints < 0 || hdr.n_cmds < 0)  return NULL;
+
+  const ms3dcooked_mesh *meshes = ms3d_cooked_at(data, size, hdr.meshes, hdr.n_mshs, sizeof(ms3dcooked_mesh));
+  const ms3dcooked_joint *joints = ms3d_cooked_at(data, size, hdr.joints, hdr.n_joints, sizeof(ms3dcooked_joint));
+  ms3dskin *skins = ms3d_cooked_at(data, size, hdr.skins, hdr.n_skins, sizeof(ms3dskin));
+  ms3dcmd *cmds = ms3d_cooked_at(data, size, hdr.cmds, hdr.n_cmds, sizeof(ms3dcmd));
+  if(!meshes || !joints || !skins || !cmds)  return NULL;
+
+  ms3d *m = (ms3d *)calloc(1, sizeof(ms3d));
+  m->mapping = data;
+  m->mapping_size = mapping_size;
+  m->n_mshs = hdr.n_mshs;
+  m->n_skins = hdr.n_skins;
+  m->n_joints = hdr.n_joints;
+  m->n_cmds = hdr.n_cmds;
+  m->anim_fps = hdr.anim_fps;
+  m->frametime = hdr.frametime;
+  m->total_time = hdr.total_time;
+  m->o_skins = skins;
+  m->anim_cmds = cmds;
+
+  /* only the pointers are fixed up, the arrays stay in the file */
+  m->o_mshs = (ms3dmesh **)calloc(m->n_mshs + 1, sizeof(ms3dmesh *));
+  int ok = 1;
+  for(i = 0; ok && i < m->n_mshs; i++) {
+    const ms3dcooked_mesh *cm = &meshes[i];
+    ms3dmesh *o_msh = (ms3dmesh *)calloc(1, sizeof(ms3dmesh));
+    m->o_mshs[i] = o_msh;
+
+    o_msh->mapped = 1;
+    o_msh->n_vertices = cm->n_vertices;
+    o_msh->n_faces = cm->n_faces;
+    o_msh->material_index = (char)cm->material_index;
+    o_msh->o_vcoords = ms3d_cooked_at(data, size, cm->vcoords, cm->n_vertices, sizeof(vec3));
+    o_msh->o_normals = ms3d_cooked_at(data, size, cm->normals, cm->n_vertices, sizeof(vec3));
+    o_msh->o_tangents = ms3d_cooked_at(data, size, cm->tangents, cm->n_vertices, sizeof(vec3));
+    o_msh->o_texcoords = ms3d_cooked_at(data, size, cm->texcoords, cm->n_vertices, sizeof(vec2));
+    o_msh->o_jnt_indices = ms3d_cooked_at(data, size, cm->jnt_indices, cm->n_vertices, sizeof(short));
+    o_msh->o_indices = ms3d_cooked_at(data, size, cm->indices, cm->n_faces*3, sizeof(unsigned short));
+
+    ok = o_msh->o_vcoords && o_msh->o_normals && o_msh->o_tangents &&
+         o_msh->o_texcoords && o_msh->o_jnt_indices && o_msh->o_indices;
+  }
+
+  m->o_joints = (ms3djoint *)calloc(m->n_joints + 1, sizeof(ms3djoint));
+  for(i = 0; ok && i < m->n_joints; i++) {
+    const ms3dcooked_joint *cj = &joints[i];
+    ms3djoint *jnt = &m->o_joints[i];
+
+    mat4_cpy(&jnt->mat_abs, &cj->mat_abs);
+    mat4_cpy(&jnt->mat_local, &cj->mat_local);
+    jnt->parent = cj->parent;
+    jnt->n_rotkeys = cj->n_rotkeys;
+    jnt->n_transkeys = cj->n_transkeys;
+    jnt->rotkeys = ms3d_cooked_at(data, size, cj->rotkeys, cj->n_rotkeys, sizeof(ms3dkey));
+    jnt->transkeys = ms3d_cooked_at(data, size, cj->transkeys, cj->n_transkeys, sizeof(ms3dkey));
+
+    /* the parents come first, ms3d_animate relies on it */
+    ok = jnt->rotkeys && jnt->transkeys && cj->parent >= -1 && cj->parent < i;
+  }
+
+  if(!ok) {
+    /* the caller keeps the mapping */
+    m->mapping_size = 0;
+    ms3d_del(m);
+    return NULL;
+  }
+
+  return m;
+}
+
+/* load <file>.t3dm in place with no GL work, NULL if there is none or its sources changed */
+ms3d *
+ms3d_cooked_load( const char *file )
+{
+  char cookedfile[512], animfile[512];
+  ms3dcooked_header hdr;
+  size_t size, mapping_size = 0;
+  long long src_mtime, anim_mtime;
+
+  snprintf(cookedfile, sizeof(cookedfile), "%s.t3dm", file);
+  snprintf(animfile, sizeof(animfile), "%s.anim", file);
+
+  /* the pack builder only packs the cooked files that are up to date */
+  const void *data = util_pack_find(cookedfile, &size);
+  if(!data) {
+    data = util_map_file(cookedfile, &size);
+    mapping_size = size;
+  }
+  if(!data)  return NULL;
+
+  int ok = size >= sizeof(hdr);
+  if(ok) {
+    memcpy(&hdr, data, sizeof(hdr));
+    ok = memcmp(hdr.magic, "T3DM", 4) == 0 && hdr.version == MS3D_COOKED_VERSION &&
+         hdr.src_size == ms3d_source_size(file, &src_mtime) &&
+         hdr.anim_size == ms3d_source_size(animfile, &anim_mtime);
+  }
+
+  /* touched but maybe not changed, trust the content */
+  if(ok && src_mtime != -1 && src_mtime != hdr.src_mtime)
+    ok = ms3d_source_hash(file) == hdr.src_hash;
+  if(ok && anim_mtime != -1 && anim_mtime != hdr.anim_mtime)
+    ok = ms3d_source_hash(animfile) == hdr.anim_hash;
+
+  ms3d *m = ok ? ms3d_cooked_model(data, size, mapping_size) : NULL;
+  if(!m && mapping_size)  util_unmap_file(data, mapping_size);
+
+  return m;
+}
+
+/* load <file>.t3dm in place, NULL if there is none or it is older than the ms3d file */
+ms3d *
+ms3d_cooked_new( const char *file )
+{
+  ms3d *m = ms3d_cooked_load(file);
+  if(m)  ms3d_upload(m);
+
+  return m;
+}
+
+/* 1 if <file>.t3dm holds the model and commands as they are now */
+int
+ms3d_cooked_is_current( const char *file )
+{
+  ms3d *m = ms3d_cooked_load(file);
+  int current = m != NULL;
+  ms3d_del(m);
+
+  return current;
+}
+
+/* load a model with its commands, cooked or parsed, no GL work (e.g. on a worker) */
+ms3d *
+ms3d_load( const char *file )
+{
+  char line[512], animfile[512];
+
+  ms3d *m = ms3d_cooked_load(file);
+  if(m)  return m;
+
+  const unsigned char *buf = (const unsigned char *)util_file_view(file, NULL);
+  m = ms3d_parse(buf);
+  util_file_release((const char *)buf);
+  if(!m)  return NULL;
+
+  /* load ms3d animation */
+  snprintf(animfile, sizeof(animfile), "%s.anim", file);
+  vector *anicmd_strs = vector_new(sizeof(line));
+  util_file_to_vector(anicmd_strs, animfile);
+  m->anim_cmds = ms3d_animcmd_new(&m->n_cmds, anicmd_strs);
+  vector_del(anicmd_strs);
+
+  return m;
+}
+
+/* a box in place of a model still loading, one mesh with the 3 given skins
+   (diffuse, normalmap, specular), no joints and a single 'N' command */
+ms3d *
+ms3d_proxy_new( const vec3 *aabb_min, const vec3 *aabb_max,
+                const char *diffuse, const char *normalmap, const char *specular )
+{
+  /* the corners of each face, counter-clockwise seen from outside */
+  static const int corners[6][4] = {
+    { 1, 3, 7, 5 }, { 0, 4, 6, 2 },     /* +x, -x */
+    { 2, 6, 7, 3 }, { 0, 1, 5, 4 },     /* +y, -y */
+    { 4, 5, 7, 6 }, { 0, 2, 3, 1 }      /* +z, -z */
+  };
+  static const float normals[6][3] = {
+    { 1.0, 0.0, 0.0 }, { -1.0, 0.0, 0.0 },
+    { 0.0, 1.0, 0.0 }, { 0.0, -1.0, 0.0 },
+    { 0.0, 0.0, 1.0 }, { 0.0, 0.0, -1.0 }
+  };
+  static const float texcoords[4][2] = { { 0.0, 0.0 }, { 1.0, 0.0 }, { 1.0, 1.0 }, { 0.0, 1.0 } };
+  const char *skins[3] = { diffuse, normalmap, specular };
+  int i, j;
+
+  ms3d *m = (ms3d *)calloc(1, sizeof(ms3d));
+  m->n_mshs = 1;
+  m->o_mshs = (ms3dmesh **)malloc(sizeof(ms3dmesh *));
+  m->o_mshs[0] = ms3dmesh_new(24, 12);
+  ms3dmesh *o_msh = m->o_mshs[0];
+  o_msh->material_index = 0;
+
+  for(i = 0; i < 6; i++) {
+    for(j = 0; j < 4; j++) {
+      int c = corners[i][j];
+      int v = i*4 + j;
+
+      /* bit 0, 1, 2 of a corner pick the max x, y, z */
+      vec3_set(&o_msh->o_vcoords[v], (c & 1) ? aabb_max->x : aabb_min->x,
+                                     (c & 2) ? aabb_max->y : aabb_min->y,
+                                     (c & 4) ? aabb_max->z : aabb_min->z);
+      vec3_set(&o_msh->o_normals[v], normals[i][0], normals[i][1], normals[i][2]);
+      /* any unit vector across the normal will do for a flat normalmap */
+      vec3_set(&o_msh->o_tangents[v], normals[i][1] + normals[i][2], normals[i][0], 0.0);
+      vec2_set(&o_msh->o_texcoords[v], texcoords[j][0], texcoords[j][1]);
+      o_msh->o_jnt_indices[v] = -1;
+    }
+
+    o_msh->o_indices[i*6 + 0] = i*4 + 0;
+    o_msh->o_indices[i*6 + 1] = i*4 + 1;
+    o_msh->o_indices[i*6 + 2] = i*4 + 2;
+    o_msh->o_indices[i*6 + 3] = i*4 + 0;
+    o_msh->o_indices[i*6 + 4] = i*4 + 2;
+    o_msh->o_indices[i*6 + 5] = i*4 + 3;
+  }
+
+  m->n_skins = 3;
+  m->o_skins = (ms3dskin *)calloc(3, sizeof(ms3dskin));
+  for(i = 0; i < 3; i++) {
+    vec4_set(&m->o_skins[i].ambient, 0.2, 0.2, 0.2, 1.0);
+    vec4_set(&m->o_skins[i].diffuse, 0.8, 0.8, 0.8, 1.0);
+    strncpy(m->o_skins[i].texture, skins[i], sizeof(m->o_skins[i].texture) - 1);
+  }
+
+  m->anim_fps = 1.0;
+  m->frametime = 1000.0;
+  m->total_time = 0.0;
+  m->n_cmds = 1;
+  m->anim_cmds = (ms3dcmd *)calloc(1, sizeof(ms3dcmd));
+  m->anim_cmds[0].cmd = 'N';
+
+  vec3_cpy(&m->aabb_min, aabb_min);
+  vec3_cpy(&m->aabb_max, aabb_max);
 
   return m;
 }
@@ -425,10 +998,26 @@ ms3d_del( ms3d *m )
     ms3dmesh_del(o_msh);
   }
   free(m->o_mshs);
-  free(m->o_skins);
+  if(m->skin_arrays) {
+    ogl_delete_textures(m->n_mshs*3, m->skin_arrays);
+    free(m->skin_arrays);
+  }
+
+  /* a cooked model keeps the keys, skins and commands in its file */
+  if(!m->mapping) {
+    for(i = 0; i < m->n_joints; i++) {
+      free(m->o_joints[i].rotkeys);
+      free(m->o_joints[i].transkeys);
+    }
+    free(m->o_skins);
+    free(m->anim_cmds);
+  }
+  else if(m->mapping_size)
+    util_unmap_file(m->mapping, m->mapping_size);
+
   free(m->o_joints);
-  free(m->anim_cmds);
   decal_del(m->o_aamsh);
+  mpool_del(m->unit_pool);
 
   free(m);
 }
@@ -437,21 +1026,43 @@ ms3d_del( ms3d *m )
 ms3danim *
 ms3d_anim_new( const ms3d *model )
 {
-  ms3danim *ani = (ms3danim *)malloc(sizeof(ms3danim));
+  void *block = malloc(ms3d_anim_size(model));
+  if(!block)  return NULL;
+
+  return ms3d_anim_init(block, model);
+}
+
+/* bytes of an animation struct with its key cursors in one block */
+size_t
+ms3d_anim_size( const ms3d *model )
+{
+  return mpool_align(sizeof(ms3danim)) + mpool_align(sizeof(unsigned short)*model->n_joints)*2;
+}
+
+/* lay an animation struct out in a block of ms3d_anim_size bytes */
+ms3danim *
+ms3d_anim_init( void *block, const ms3d *model )
+{
+  char *p = (char *)block;
+  ms3danim *ani = (ms3danim *)p;
+  p += mpool_align(sizeof(ms3danim));
+
   ani->islooping = 1;
-  ani->cur_transkeys = (unsigned short *)malloc(sizeof(unsigned short)*model->n_joints);
-  ani->cur_rotkeys = (unsigned short *)malloc(sizeof(unsigned short)*model->n_joints);
+  /* no command yet, ms3d_set_anim sets the first */
+  ani->cur_cmd = 0;
+  ani->cur_time = 0.0;
+  vec2_set(&ani->ani_time, 0.0, 0.0);
+  ani->cur_transkeys = (unsigned short *)p;
+  p += mpool_align(sizeof(unsigned short)*model->n_joints);
+  ani->cur_rotkeys = (unsigned short *)p;
 
   return ani;
 }
 
-/* delete the ms3d animationf struct from memory */
+/* delete the ms3d animationf struct from memory, one made by ms3d_anim_new */
 void
 ms3d_anim_del( ms3danim *ani )
 {
-  if(!ani)  return;
-  free(ani->cur_transkeys);
-  free(ani->cur_rotkeys);
   free(ani);
 }
 
@@ -507,7 +1118,7 @@ ms3d_calc_anim_time( ms3danim *ani, const ms3d *m, const float time_passed )
 ms3dcmd *
 ms3d_animcmd_new( unsigned short *n_cmds, const vector *strlines )
 {
-  ms3dcmd *cmds = (ms3dcmd *)malloc(sizeof(ms3dcmd)*strlines->size);
+  ms3dcmd *cmds = (ms3dcmd *)calloc(strlines->size, sizeof(ms3dcmd));
 
   int i;
   for(i = 0; i < strlines->size; i++) {
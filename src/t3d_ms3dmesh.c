@@ -11,7 +11,7 @@
 
 /* create a ms3dmesh struct in memory */
 ms3dmesh *
-ms3dmesh_new( const int n_vertices )
+ms3dmesh_new( const int n_vertices, const int n_faces )
 {
   ms3dmesh *o_msh = (ms3dmesh *)malloc(sizeof(ms3dmesh));
 
@@ -20,9 +20,14 @@ ms3dmesh_new( const int n_vertices )
   o_msh->o_tangents = (vec3 *)malloc(sizeof(vec3)*n_vertices);
   o_msh->o_texcoords = (vec2 *)malloc(sizeof(vec2)*n_vertices);
   o_msh->o_jnt_indices = (short *)malloc(sizeof(short)*n_vertices);
+  o_msh->o_indices = (unsigned short *)malloc(sizeof(unsigned short)*n_faces*3);
   o_msh->n_vertices = n_vertices;
+  o_msh->n_faces = n_faces;
 
-  glGenBuffers(1, &o_msh->vbo_o_texcoords);
+  /* the buffers are made when the model is uploaded */
+  o_msh->vbo_o_texcoords = 0;
+  o_msh->ibo_o_elements = 0;
+  o_msh->mapped = 0;
 
   return o_msh;
 }
@@ -33,12 +38,21 @@ ms3dmesh_del( ms3dmesh *o_msh )
 {
   if(!o_msh) return;
 
-  glDeleteBuffers(1, &o_msh->vbo_o_texcoords);
+  /* never uploaded (e.g. by the cook tool), no GL to call */
+  if(o_msh->vbo_o_texcoords)  ogl_delete_buffers(1, &o_msh->vbo_o_texcoords);
+  if(o_msh->ibo_o_elements)  ogl_delete_buffers(1, &o_msh->ibo_o_elements);
+
+  if(o_msh->mapped) {
+    free(o_msh);
+    return;
+  }
+
   free(o_msh->o_vcoords);
   free(o_msh->o_normals);
   free(o_msh->o_tangents);
   free(o_msh->o_texcoords);
   free(o_msh->o_jnt_indices);
+  free(o_msh->o_indices);
 
   free(o_msh);
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
     Revised date: 18th Jan, 2014
  +----------------------------------------------------------------------------*/
 
+#include <stdlib.h>
+#include <string.h>
 #include <GL/glfw3.h>
 #include <t3d_ogl.h>
 
@@ -15,6 +17,66 @@
           }                                       \
         }
 
+/* macro to resolve optional OpenGL function pointers, NULL if not available */
+#define GET_GL_FN_OPT(type, var, name, version, ext)                  \
+        var = NULL;                                                   \
+        if(ogl_version_major() >= (version) || glfwExtensionSupported((ext))) \
+          var = (type)glfwGetProcAddress((name));
+
+
+/* the stream ring buffer, dynamic data of a frame goes into one region */
+typedef struct __oglstream {
+  GLuint buffer;
+  GLsizeiptr frame_size;                  /* bytes of one frame region */
+  GLintptr head;                          /* next free byte */
+  GLintptr end;                           /* end of the current region */
+  int region;                             /* current frame region */
+  int synced;                             /* 1: unsynchronized maps + fences, 0: orphan + sub data */
+  GLsync fences[OGL_STREAM_FRAMES];       /* GPU done with the region */
+  GLintptr map_offset;                    /* pending ogl_stream_map */
+  GLsizeiptr map_size;
+  char *staging;                          /* write target without map range */
+} oglstream;
+
+static oglstream ogl_stm;
+
+
+/* value of a shadowed state that is not known */
+#define OGL_UNKNOWN 0xffffffffu
+
+/* shadowed GL state */
+typedef struct __oglstate {
+  GLuint program;
+  GLuint array_buffer;
+  GLuint element_buffer;
+  GLuint active_unit;
+  GLuint textures[OGL_MAX_TEX_UNITS];
+  unsigned int attribs;                   /* enabled vertex attribute arrays */
+  int attribs_known;
+  GLuint blend;
+  GLuint depth_test;
+  GLuint cull_face;
+  GLuint blend_src;
+  GLuint blend_dst;
+  GLuint depth_mask;
+  GLuint cull_mode;
+
+  unsigned int issued;                    /* calls of the current frame */
+  unsigned int skipped;
+  unsigned int last_issued;               /* calls of the last finished frame */
+  unsigned int last_skipped;
+} oglstate;
+
+static oglstate ogl_st;
+
+
+/* major version of the current context */
+static int
+ogl_version_major( void )
+{
+  return glfwGetWindowAttrib(glfwGetCurrentContext(), GLFW_CONTEXT_VERSION_MAJOR);
+}
+
 
 /* resolve the opengl functions */
 GLboolean
@@ -43,18 +105,22 @@ ogl_init( void )
   GET_GL_FN(PFNGLDELETETEXTURESPROC, glDeleteTextures, "glDeleteTextures");
   GET_GL_FN(PFNGLGENTEXTURESPROC, glGenTextures, "glGenTextures");
   GET_GL_FN(PFNGLTEXIMAGE2DPROC, glTexImage2D, "glTexImage2D");
+  GET_GL_FN(PFNGLTEXSUBIMAGE2DPROC, glTexSubImage2D, "glTexSubImage2D");
+  GET_GL_FN(PFNGLPIXELSTOREIPROC, glPixelStorei, "glPixelStorei");
   GET_GL_FN(PFNGLTEXPARAMETERFPROC, glTexParameterf, "glTexParameterf");
   GET_GL_FN(PFNGLTEXPARAMETERIPROC, glTexParameteri, "glTexParameteri");
   GET_GL_FN(PFNGLDISABLEVERTEXATTRIBARRAYPROC, glDisableVertexAttribArray, "glDisableVertexAttribArray");
   GET_GL_FN(PFNGLENABLEVERTEXATTRIBARRAYPROC, glEnableVertexAttribArray, "glEnableVertexAttribArray");
   GET_GL_FN(PFNGLBINDBUFFERPROC, glBindBuffer, "glBindBuffer");
   GET_GL_FN(PFNGLBUFFERDATAPROC, glBufferData, "glBufferData");
+  GET_GL_FN(PFNGLBUFFERSUBDATAPROC, glBufferSubData, "glBufferSubData");
   GET_GL_FN(PFNGLDELETEBUFFERSPROC, glDeleteBuffers, "glDeleteBuffers");
   GET_GL_FN(PFNGLGENBUFFERSPROC, glGenBuffers, "glGenBuffers");
   GET_GL_FN(PFNGLGETBUFFERPARAMETERIVPROC, glGetBufferParameteriv, "glGetBufferParameteriv");
   GET_GL_FN(PFNGLMAPBUFFERPROC, glMapBuffer, "glMapBuffer");
   GET_GL_FN(PFNGLUNMAPBUFFERPROC, glUnmapBuffer, "glUnmapBuffer");
   GET_GL_FN(PFNGLVERTEXATTRIBPOINTERPROC, glVertexAttribPointer, "glVertexAttribPointer");
+  GET_GL_FN(PFNGLVERTEXATTRIB1FPROC, glVertexAttrib1f, "glVertexAttrib1f");
   GET_GL_FN(PFNGLCREATEPROGRAMPROC, glCreateProgram, "glCreateProgram");
   GET_GL_FN(PFNGLDELETEPROGRAMPROC, glDeleteProgram, "glDeleteProgram");
   GET_GL_FN(PFNGLGETPROGRAMIVPROC, glGetProgramiv, "glGetProgramiv");
@@ -88,5 +154,426 @@ ogl_init( void )
   GET_GL_FN(PFNGLGENFRAMEBUFFERSPROC, glGenFramebuffers, "glGenFramebuffers");
   GET_GL_FN(PFNGLREADBUFFERPROC, glReadBuffer, "glReadBuffer");
 
+  GET_GL_FN_OPT(PFNGLMAPBUFFERRANGEPROC, glMapBufferRange, "glMapBufferRange", 3, "GL_ARB_map_buffer_range");
+  GET_GL_FN_OPT(PFNGLFENCESYNCPROC, glFenceSync, "glFenceSync", 4, "GL_ARB_sync");
+  GET_GL_FN_OPT(PFNGLCLIENTWAITSYNCPROC, glClientWaitSync, "glClientWaitSync", 4, "GL_ARB_sync");
+  GET_GL_FN_OPT(PFNGLDELETESYNCPROC, glDeleteSync, "glDeleteSync", 4, "GL_ARB_sync");
+  GET_GL_FN_OPT(PFNGLDRAWELEMENTSINSTANCEDPROC, glDrawElementsInstanced, "glDrawElementsInstanced", 4, "GL_ARB_draw_instanced");
+  GET_GL_FN_OPT(PFNGLVERTEXATTRIBDIVISORPROC, glVertexAttribDivisor, "glVertexAttribDivisor", 4, "GL_ARB_instanced_arrays");
+  GET_GL_FN_OPT(PFNGLTEXIMAGE3DPROC, glTexImage3D, "glTexImage3D", 3, "GL_EXT_texture_array");
+  GET_GL_FN_OPT(PFNGLTEXSUBIMAGE3DPROC, glTexSubImage3D, "glTexSubImage3D", 3, "GL_EXT_texture_array");
+  GET_GL_FN_OPT(PFNGLCOMPRESSEDTEXIMAGE3DPROC, glCompressedTexImage3D, "glCompressedTexImage3D", 3, "GL_EXT_texture_array");
+  GET_GL_FN_OPT(PFNGLCOMPRESSEDTEXSUBIMAGE3DPROC, glCompressedTexSubImage3D, "glCompressedTexSubImage3D", 3, "GL_EXT_texture_array");
+
+  ogl_state_reset();
+  ogl_st.issued = 0;
+  ogl_st.skipped = 0;
+  ogl_st.last_issued = 0;
+  ogl_st.last_skipped = 0;
+
   return status;
+}
+
+/* 1 if instanced drawing (glDrawElementsInstanced + glVertexAttribDivisor) is supported */
+int
+ogl_has_instancing( void )
+{
+  return glDrawElementsInstanced != NULL && glVertexAttribDivisor != NULL;
+}
+
+/* 1 if GL_TEXTURE_2D_ARRAY textures (glTexImage3D and friends) are supported */
+int
+ogl_has_texture_arrays( void )
+{
+  return glTexImage3D != NULL && glTexSubImage3D != NULL &&
+         glCompressedTexImage3D != NULL && glCompressedTexSubImage3D != NULL;
+}
+
+/* create the stream (transient upload) ring buffer, frame_size bytes per frame */
+void
+ogl_stream_init( const GLsizeiptr frame_size )
+{
+  int i;
+
+  ogl_stm.frame_size = frame_size;
+  ogl_stm.synced = glMapBufferRange && glFenceSync && glClientWaitSync && glDeleteSync;
+  ogl_stm.region = OGL_STREAM_FRAMES - 1;
+  ogl_stm.head = 0;
+  ogl_stm.end = 0;
+  ogl_stm.staging = NULL;
+  for(i = 0; i < OGL_STREAM_FRAMES; i++)
+    ogl_stm.fences[i] = NULL;
+
+  glGenBuffers(1, &ogl_stm.buffer);
+  ogl_bind_buffer(GL_ARRAY_BUFFER, ogl_stm.buffer);
+
+  if(ogl_stm.synced) {
+    /* one buffer, a region per frame in flight */
+    glBufferData(GL_ARRAY_BUFFER, frame_size*OGL_STREAM_FRAMES, NULL, GL_STREAM_DRAW);
+  }
+  else {
+    /* orphaned every frame, the driver does the rotation */
+    glBufferData(GL_ARRAY_BUFFER, frame_size, NULL, GL_STREAM_DRAW);
+    ogl_stm.staging = (char *)malloc(frame_size);
+  }
+}
+
+/* delete the stream ring buffer */
+void
+ogl_stream_del( void )
+{
+  int i;
+  for(i = 0; i < OGL_STREAM_FRAMES; i++) {
+    if(ogl_stm.fences[i])  glDeleteSync(ogl_stm.fences[i]);
+    ogl_stm.fences[i] = NULL;
+  }
+
+  ogl_delete_buffers(1, &ogl_stm.buffer);
+  free(ogl_stm.staging);
+  ogl_stm.staging = NULL;
+}
+
+/* move to the next frame region, waits only if the GPU still reads from it */
+void
+ogl_stream_begin_frame( void )
+{
+  if(ogl_stm.synced) {
+    /* fence the commands using the region just finished */
+    ogl_stm.fences[ogl_stm.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    ogl_stm.region = (ogl_stm.region + 1) % OGL_STREAM_FRAMES;
+
+    GLsync fence = ogl_stm.fences[ogl_stm.region];
+    if(fence) {
+      while(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+      glDeleteSync(fence);
+      ogl_stm.fences[ogl_stm.region] = NULL;
+    }
+
+    ogl_stm.head = ogl_stm.region*ogl_stm.frame_size;
+    ogl_stm.end = ogl_stm.head + ogl_stm.frame_size;
+  }
+  else {
+    ogl_bind_buffer(GL_ARRAY_BUFFER, ogl_stm.buffer);
+    glBufferData(GL_ARRAY_BUFFER, ogl_stm.frame_size, NULL, GL_STREAM_DRAW);
+
+    ogl_stm.head = 0;
+    ogl_stm.end = ogl_stm.frame_size;
+  }
+}
+
+/* reserve size bytes of this frame, return where to write them (NULL if the
+   frame region is full) and the offset to draw from */
+void *
+ogl_stream_map( const GLsizeiptr size, GLintptr *offset )
+{
+  /* 16 bytes aligned, fine for any vertex attribute or index */
+  GLintptr start = (ogl_stm.head + 15) & ~(GLintptr)15;
+  if(start + size > ogl_stm.end)  return NULL;
+
+  ogl_stm.head = start + size;
+  ogl_stm.map_offset = start;
+  ogl_stm.map_size = size;
+  *offset = start;
+
+  if(ogl_stm.synced) {
+    ogl_bind_buffer(GL_ARRAY_BUFFER, ogl_stm.buffer);
+    return glMapBufferRange(GL_ARRAY_BUFFER, start, size,
+                            GL_MAP_WRITE_BIT|GL_MAP_INVALIDATE_RANGE_BIT|GL_MAP_UNSYNCHRONIZED_BIT);
+  }
+
+  return ogl_stm.staging + start;
+}
+
+/* finish the write started by ogl_stream_map */
+void
+ogl_stream_unmap( void )
+{
+  ogl_bind_buffer(GL_ARRAY_BUFFER, ogl_stm.buffer);
+
+  if(ogl_stm.synced)
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  else
+    glBufferSubData(GL_ARRAY_BUFFER, ogl_stm.map_offset, ogl_stm.map_size,
+                    ogl_stm.staging + ogl_stm.map_offset);
+}
+
+/* copy data to the stream, return the offset to draw from, -1 if the frame region is full */
+GLintptr
+ogl_stream_upload( const void *data, const GLsizeiptr size )
+{
+  GLintptr offset;
+
+  if(size <= 0)  return ogl_stm.head;
+
+  void *dst = ogl_stream_map(size, &offset);
+  if(!dst)  return -1;
+
+  memcpy(dst, data, size);
+  ogl_stream_unmap();
+
+  return offset;
+}
+
+/* the stream buffer object, bind it as array or element buffer with the offsets */
+GLuint
+ogl_stream_buffer( void )
+{
+  return ogl_stm.buffer;
+}
+
+/* count a call of the state cache, return 1 if it must be issued */
+static int
+ogl_state_changed( GLuint *cached, const GLuint value )
+{
+  if(*cached == value) {
+    ogl_st.skipped++;
+    return 0;
+  }
+
+  *cached = value;
+  ogl_st.issued++;
+  return 1;
+}
+
+/* the shadowed value of a capability */
+static GLuint *
+ogl_state_cap( const GLenum cap )
+{
+  switch(cap) {
+    case GL_BLEND:       return &ogl_st.blend;
+    case GL_DEPTH_TEST:  return &ogl_st.depth_test;
+    case GL_CULL_FACE:   return &ogl_st.cull_face;
+  }
+  return NULL;
+}
+
+/* forget the shadowed state, the next calls are issued unconditionally */
+void
+ogl_state_reset( void )
+{
+  int i;
+
+  ogl_st.program = OGL_UNKNOWN;
+  ogl_st.array_buffer = OGL_UNKNOWN;
+  ogl_st.element_buffer = OGL_UNKNOWN;
+  ogl_st.active_unit = OGL_UNKNOWN;
+  for(i = 0; i < OGL_MAX_TEX_UNITS; i++)
+    ogl_st.textures[i] = OGL_UNKNOWN;
+  ogl_st.attribs = 0;
+  ogl_st.attribs_known = 0;
+  ogl_st.blend = OGL_UNKNOWN;
+  ogl_st.depth_test = OGL_UNKNOWN;
+  ogl_st.cull_face = OGL_UNKNOWN;
+  ogl_st.blend_src = OGL_UNKNOWN;
+  ogl_st.blend_dst = OGL_UNKNOWN;
+  ogl_st.depth_mask = OGL_UNKNOWN;
+  ogl_st.cull_mode = OGL_UNKNOWN;
+}
+
+/* start counting the calls of a new frame */
+void
+ogl_state_begin_frame( void )
+{
+  ogl_st.last_issued = ogl_st.issued;
+  ogl_st.last_skipped = ogl_st.skipped;
+  ogl_st.issued = 0;
+  ogl_st.skipped = 0;
+}
+
+/* calls issued and skipped during the last finished frame */
+void
+ogl_state_stats( unsigned int *issued, unsigned int *skipped )
+{
+  *issued = ogl_st.last_issued;
+  *skipped = ogl_st.last_skipped;
+}
+
+/* glUseProgram */
+void
+ogl_use_program( const GLuint program )
+{
+  if(ogl_state_changed(&ogl_st.program, program))
+    glUseProgram(program);
+}
+
+/* glDeleteProgram */
+void
+ogl_delete_program( const GLuint program )
+{
+  /* a current program stays in use until it is replaced */
+  if(ogl_st.program == program)  ogl_st.program = OGL_UNKNOWN;
+  glDeleteProgram(program);
+}
+
+/* glBindBuffer, array and element array buffers are shadowed */
+void
+ogl_bind_buffer( const GLenum target, const GLuint buffer )
+{
+  GLuint *cached = NULL;
+
+  if(target == GL_ARRAY_BUFFER)  cached = &ogl_st.array_buffer;
+  if(target == GL_ELEMENT_ARRAY_BUFFER)  cached = &ogl_st.element_buffer;
+
+  if(!cached) {
+    ogl_st.issued++;
+    glBindBuffer(target, buffer);
+  }
+  else if(ogl_state_changed(cached, buffer))
+    glBindBuffer(target, buffer);
+}
+
+/* glDeleteBuffers */
+void
+ogl_delete_buffers( const GLsizei n, const GLuint *buffers )
+{
+  int i;
+
+  /* deleting a bound buffer binds 0, and the name can be reused */
+  for(i = 0; i < n; i++) {
+    if(ogl_st.array_buffer == buffers[i])  ogl_st.array_buffer = 0;
+    if(ogl_st.element_buffer == buffers[i])  ogl_st.element_buffer = 0;
+  }
+  glDeleteBuffers(n, buffers);
+}
+
+/* glActiveTexture + glBindTexture(GL_TEXTURE_2D) */
+void
+ogl_bind_texture( const GLuint unit, const GLuint tex )
+{
+  ogl_bind_texture_target(unit, GL_TEXTURE_2D, tex);
+}
+
+/* glActiveTexture + glBindTexture, e.g. GL_TEXTURE_2D_ARRAY, texture names are
+   never shared between targets so one cache entry per unit is enough */
+void
+ogl_bind_texture_target( const GLuint unit, const GLenum target, const GLuint tex )
+{
+  if(unit >= OGL_MAX_TEX_UNITS) {
+    ogl_st.active_unit = unit;
+    ogl_st.issued += 2;
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(target, tex);
+    return;
+  }
+
+  if(ogl_st.textures[unit] == tex) {
+    ogl_st.skipped += 2;
+    return;
+  }
+
+  if(ogl_state_changed(&ogl_st.active_unit, unit))
+    glActiveTexture(GL_TEXTURE0 + unit);
+
+  ogl_st.textures[unit] = tex;
+  ogl_st.issued++;
+  glBindTexture(target, tex);
+}
+
+/* bind a texture on unit 0 and make unit 0 active, for the calls that upload
+   to or set up the bound texture. a cached bind leaves another unit active */
+void
+ogl_bind_texture_for_upload( const GLenum target, const GLuint tex )
+{
+  if(ogl_state_changed(&ogl_st.active_unit, 0))
+    glActiveTexture(GL_TEXTURE0);
+
+  ogl_bind_texture_target(0, target, tex);
+}
+
+/* glDeleteTextures */
+void
+ogl_delete_textures( const GLsizei n, const GLuint *textures )
+{
+  int i, j;
+
+  /* deleting a bound texture binds 0, and the name can be reused */
+  for(i = 0; i < n; i++) {
+    for(j = 0; j < OGL_MAX_TEX_UNITS; j++) {
+      if(ogl_st.textures[j] == textures[i])  ogl_st.textures[j] = 0;
+    }
+  }
+  glDeleteTextures(n, textures);
+}
+
+/* enable exactly the vertex attribute arrays in mask (OGL_ATTRIB bits) */
+void
+ogl_attrib_arrays( const unsigned int mask )
+{
+  unsigned int i;
+  unsigned int diff = ogl_st.attribs_known ? (ogl_st.attribs ^ mask) : 0xffffffffu;
+
+  for(i = 0; i < OGL_MAX_ATTRIBS; i++) {
+    if(diff & OGL_ATTRIB(i)) {
+      ogl_st.issued++;
+      if(mask & OGL_ATTRIB(i))
+        glEnableVertexAttribArray(i);
+      else
+        glDisableVertexAttribArray(i);
+    }
+    else
+      ogl_st.skipped++;
+  }
+
+  ogl_st.attribs = mask;
+  ogl_st.attribs_known = 1;
+}
+
+/* glEnable, GL_BLEND, GL_DEPTH_TEST and GL_CULL_FACE are shadowed */
+void
+ogl_enable( const GLenum cap )
+{
+  GLuint *cached = ogl_state_cap(cap);
+
+  if(!cached) {
+    ogl_st.issued++;
+    glEnable(cap);
+  }
+  else if(ogl_state_changed(cached, GL_TRUE))
+    glEnable(cap);
+}
+
+/* glDisable, GL_BLEND, GL_DEPTH_TEST and GL_CULL_FACE are shadowed */
+void
+ogl_disable( const GLenum cap )
+{
+  GLuint *cached = ogl_state_cap(cap);
+
+  if(!cached) {
+    ogl_st.issued++;
+    glDisable(cap);
+  }
+  else if(ogl_state_changed(cached, GL_FALSE))
+    glDisable(cap);
+}
+
+/* glBlendFunc */
+void
+ogl_blend_func( const GLenum sfactor, const GLenum dfactor )
+{
+  if(ogl_st.blend_src == sfactor && ogl_st.blend_dst == dfactor) {
+    ogl_st.skipped++;
+    return;
+  }
+
+  ogl_st.blend_src = sfactor;
+  ogl_st.blend_dst = dfactor;
+  ogl_st.issued++;
+  glBlendFunc(sfactor, dfactor);
+}
+
+/* glDepthMask */
+void
+ogl_depth_mask( const GLboolean flag )
+{
+  if(ogl_state_changed(&ogl_st.depth_mask, flag))
+    glDepthMask(flag);
+}
+
+/* glCullFace */
+void
+ogl_cull_face( const GLenum mode )
+{
+  if(ogl_state_changed(&ogl_st.cull_mode, mode))
+    glCullFace(mode);
 }
\ No newline at end of file
@@ -0,0 +1,175 @@
+/*----- t3d_overlay.c --------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <t3d_ogl.h>
+#include <t3d_math.h>
+#include <t3d_shader.h>
+#include <t3d_overlay.h>
+
+
+/* create an overlay in memory */
+overlay *
+ovl_new( const int screen_w, const int screen_h )
+{
+  overlay *ovl = (overlay *)malloc(sizeof(overlay));
+
+  ovl->vertices_capacity = 4096;
+  ovl->vertices = (ovlvertex *)malloc(sizeof(ovlvertex)*ovl->vertices_capacity);
+  ovl->n_vertices = 0;
+
+  ovl->batches_capacity = 16;
+  ovl->batches = (ovlbatch *)malloc(sizeof(ovlbatch)*ovl->batches_capacity);
+  ovl->n_batches = 0;
+
+  if(!ovl->vertices || !ovl->batches) {
+    fprintf(stderr, "line %d: Can not allocate memory\n", __LINE__);
+    exit(EXIT_FAILURE);
+  }
+
+  mat4_set_ortho(&ovl->mat_proj, 0.0, (float)screen_w, 0.0, (float)screen_h, -10.0, 10.0);
+
+  return ovl;
+}
+
+/* delete an overlay from memory */
+void
+ovl_del( overlay *ovl )
+{
+  if(!ovl)  return;
+
+  free(ovl->vertices);
+  free(ovl->batches);
+  free(ovl);
+}
+
+/* pack a color into vertex bytes */
+void
+ovl_color( GLubyte *o, const vec4 *color )
+{
+  int i;
+  for(i = 0; i < 4; i++) {
+    float c = color->v[i];
+    if(c < 0.0)  c = 0.0;
+    if(c > 1.0)  c = 1.0;
+    o[i] = (GLubyte)(c*255.0 + 0.5);
+  }
+}
+
+/* reserve n vertices (triangles) with a texture and a mode, return where to write them */
+ovlvertex *
+ovl_add( overlay *ovl, const int n, const GLuint tex_id, const int mode )
+{
+  if(ovl->n_vertices + n > ovl->vertices_capacity) {
+    while(ovl->n_vertices + n > ovl->vertices_capacity)
+      ovl->vertices_capacity *= 2;
+    ovl->vertices = (ovlvertex *)realloc(ovl->vertices, sizeof(ovlvertex)*ovl->vertices_capacity);
+  }
+
+  /* continue the last batch if nothing changes */
+  ovlbatch *b = ovl->n_batches ? &ovl->batches[ovl->n_batches - 1] : NULL;
+  if(!b || b->tex_id != tex_id || b->mode != mode) {
+    if(ovl->n_batches == ovl->batches_capacity) {
+      ovl->batches_capacity *= 2;
+      ovl->batches = (ovlbatch *)realloc(ovl->batches, sizeof(ovlbatch)*ovl->batches_capacity);
+    }
+    b = &ovl->batches[ovl->n_batches++];
+    b->tex_id = tex_id;
+    b->mode = mode;
+    b->first = ovl->n_vertices;
+    b->count = 0;
+  }
+
+  ovlvertex *v = &ovl->vertices[ovl->n_vertices];
+  ovl->n_vertices += n;
+  b->count += n;
+
+  return v;
+}
+
+/* set one vertex */
+static void
+ovl_set_vertex( ovlvertex *v,
+                const float x, const float y,
+                const float s, const float t,
+                const GLubyte *color )
+{
+  v->x = x;
+  v->y = y;
+  v->s = s;
+  v->t = t;
+  v->color[0] = color[0];
+  v->color[1] = color[1];
+  v->color[2] = color[2];
+  v->color[3] = color[3];
+}
+
+/* add a rectangle */
+void
+ovl_quad( overlay *ovl,
+          const float x0, const float y0, const float x1, const float y1,
+          const float s0, const float t0, const float s1, const float t1,
+          const GLuint tex_id, const int mode,
+          const vec4 *color )
+{
+  GLubyte c[4];
+  ovl_color(c, color);
+
+  /* 2 triangles */
+  ovlvertex *v = ovl_add(ovl, 6, tex_id, mode);
+  ovl_set_vertex(&v[0], x1, y0, s1, t0, c);
+  ovl_set_vertex(&v[1], x0, y0, s0, t0, c);
+  ovl_set_vertex(&v[2], x1, y1, s1, t1, c);
+  ovl_set_vertex(&v[3], x0, y1, s0, t1, c);
+  v[4] = v[2];
+  v[5] = v[1];
+}
+
+/* draw everything added since the last flush */
+void
+ovl_flush( overlay *ovl, shader *glsl )
+{
+  int i;
+
+  if(ovl->n_vertices == 0)  return;
+
+  /* all the vertices of the frame in one upload */
+  GLintptr offset = ogl_stream_upload(ovl->vertices, sizeof(ovlvertex)*ovl->n_vertices);
+
+  if(offset >= 0) {
+    shd_set(glsl, glsl->prog_overlay);
+    shd_uniform_matrix4(glsl, SHD_MVP, ovl->mat_proj.m);
+    shd_uniform_1i(glsl, SHD_DIFFMAP, /*GL_TEXTURE*/0);
+
+    ogl_attrib_arrays(OGL_ATTRIB(glsl->attri_v_coord)|OGL_ATTRIB(glsl->attri_v_color));
+    ogl_bind_buffer(GL_ARRAY_BUFFER, ogl_stream_buffer());
+    glVertexAttribPointer(glsl->attri_v_coord,   /* attribute */
+                          4,                     /* (x, y, s, t) */
+                          GL_FLOAT,
+                          GL_FALSE,
+                          sizeof(ovlvertex),
+                          (void *)offset);
+    glVertexAttribPointer(glsl->attri_v_color,   /* attribute */
+                          4,                     /* (r, g, b, a) */
+                          GL_UNSIGNED_BYTE,
+                          GL_TRUE,
+                          sizeof(ovlvertex),
+                          (void *)(offset + 4*sizeof(float)));
+
+    for(i = 0; i < ovl->n_batches; i++) {
+      const ovlbatch *b = &ovl->batches[i];
+
+      shd_uniform_1i(glsl, SHD_MODE, b->mode);
+      if(b->mode != OVL_SOLID)
+        ogl_bind_texture(0, b->tex_id);
+
+      glDrawArrays(GL_TRIANGLES, b->first, b->count);
+    }
+  }
+
+  ovl->n_vertices = 0;
+  ovl->n_batches = 0;
+}
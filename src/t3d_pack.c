@@ -0,0 +1,124 @@
+/*----- t3d_pack.c -----------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <t3d_util.h>
+#include <t3d_pack.h>
+
+
+/* map an asset pack, NULL if it can not be opened or is not valid */
+pak *
+pak_open( const char *file )
+{
+  size_t size;
+  unsigned int i;
+
+  const unsigned char *data = (const unsigned char *)util_map_file(file, &size);
+  if(!data)  return NULL;
+
+  const pakheader *hdr = (const pakheader *)data;
+  size_t index_end = sizeof(pakheader);
+  if(size >= sizeof(pakheader))
+    index_end += (size_t)hdr->n_entries*sizeof(pakentry) + hdr->names_size;
+
+  if(size < sizeof(pakheader) || memcmp(hdr->magic, "T3DP", 4) != 0 ||
+     hdr->version != PAK_VERSION || index_end > size ||
+     (hdr->names_size > 0 && data[index_end - 1] != '\0')) {
+    fprintf(stderr, "Not a valid asset pack: %s\n", file);
+    util_unmap_file(data, size);
+    return NULL;
+  }
+
+  pak *p = (pak *)malloc(sizeof(pak));
+  p->data = data;
+  p->size = size;
+  p->header = hdr;
+  p->entries = (const pakentry *)(data + sizeof(pakheader));
+  p->names = (const char *)(p->entries + hdr->n_entries);
+
+  /* a truncated pack */
+  for(i = 0; i < hdr->n_entries; i++) {
+    const pakentry *e = &p->entries[i];
+    if(e->name >= hdr->names_size || e->offset < index_end || e->offset + e->size >= size) {
+      fprintf(stderr, "Not a valid asset pack: %s\n", file);
+      pak_close(p);
+      return NULL;
+    }
+  }
+
+  return p;
+}
+
+/* unmap an asset pack, the views into it become invalid */
+void
+pak_close( pak *p )
+{
+  if(!p)  return;
+
+  util_unmap_file(p->data, p->size);
+  free(p);
+}
+
+/* the entry name of a path, '/' separated without a leading "./" */
+void
+pak_name( char *name, const size_t name_sz, const char *path )
+{
+  size_t i;
+
+  while(path[0] == '.' && (path[1] == '/' || path[1] == '\\'))
+    path += 2;
+
+  for(i = 0; i + 1 < name_sz && path[i]; i++)
+    name[i] = path[i] == '\\' ? '/' : path[i];
+  name[i] = '\0';
+}
+
+/* hash of an entry name */
+unsigned long long
+pak_hash( const char *name )
+{
+  return util_fnv1a(name, strlen(name), UTIL_FNV1A_SEED);
+}
+
+/* zero-copy view of a packed file, NULL if the pack does not have it */
+const void *
+pak_find( const pak *p, const char *path, size_t *size )
+{
+  char name[512];
+
+  if(!p)  return NULL;
+
+  pak_name(name, sizeof(name), path);
+  unsigned long long hash = pak_hash(name);
+
+  /* the first entry of the hash, the index is sorted */
+  int lo = 0;
+  int hi = (int)p->header->n_entries;
+  while(lo < hi) {
+    int mid = (lo + hi)/2;
+    if(p->entries[mid].hash < hash)  lo = mid + 1;
+    else  hi = mid;
+  }
+
+  for(; lo < (int)p->header->n_entries && p->entries[lo].hash == hash; lo++) {
+    const pakentry *e = &p->entries[lo];
+    if(strcmp(p->names + e->name, name) == 0) {
+      if(size)  *size = (size_t)e->size;
+      return p->data + e->offset;
+    }
+  }
+
+  return NULL;
+}
+
+/* 1 if data points into the pack */
+int
+pak_contains( const pak *p, const void *data )
+{
+  const unsigned char *d = (const unsigned char *)data;
+  return p && d >= p->data && d < p->data + p->size;
+}
@@ -46,6 +46,11 @@ pchmap_load_patches( patchmap *pm, const hashtable *texdb )
   vec3 *normals = (vec3 *)malloc(sizeof(vec3)*pm->n_total_pch_vertices);
   vec3 *tangents = (vec3 *)malloc(sizeof(vec3)*pm->n_total_pch_vertices);
 
+  /* the texture names are looked up once, not for each patch */
+  unsigned int diffuse = hash_find(texdb, "floor_diffuse.jpg");
+  unsigned int normalmap = hash_find(texdb, "floor_normalmap.png");
+  unsigned int specular = hash_find(texdb, "floor_spec.jpg");
+
   int x, z, i, j;
   for(j = 0; j < pm->h_pchs; j++) {
     for(i = 0; i < pm->w_pchs; i++) {
@@ -82,9 +87,9 @@ pchmap_load_patches( patchmap *pm, const hashtable *texdb )
       pch->half_y_len = pch->center.y;
 
       /* load the textures */
-      pch->tex_diffuse = hash_get(texdb, "floor_diffuse.jpg");
-      pch->tex_normalmap = hash_get(texdb, "floor_normalmap.png");
-      pch->tex_specular = hash_get(texdb, "floor_spec.jpg");
+      pch->tex_diffuse = hash_at(texdb, diffuse);
+      pch->tex_normalmap = hash_at(texdb, normalmap);
+      pch->tex_specular = hash_at(texdb, specular);
       tex_set_flags(*pch->tex_diffuse, TEX_USE_MIPMAPS|TEX_TO_EDGE);
       tex_set_flags(*pch->tex_normalmap, TEX_USE_LINEAR|TEX_TO_EDGE);
       tex_set_flags(*pch->tex_specular, TEX_USE_MIPMAPS|TEX_TO_EDGE);
@@ -102,13 +107,13 @@ pchmap_load_patches( patchmap *pm, const hashtable *texdb )
 static void
 pchmap_upload( const patchmap *pm )
 {
-  glBindBuffer(GL_ARRAY_BUFFER, pm->vbo_texcoords);
+  ogl_bind_buffer(GL_ARRAY_BUFFER, pm->vbo_texcoords);
   glBufferData(GL_ARRAY_BUFFER,
                pm->n_total_pch_vertices*sizeof(vec2),
                pm->pch_texcoords,
                GL_STATIC_DRAW);
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pm->ibo_elements);
+  ogl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, pm->ibo_elements);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER,
                pm->n_total_pch_indices*sizeof(unsigned int),
                pm->pch_indices,
@@ -213,8 +218,8 @@ pchmap_del( patchmap *pm )
 {
   if(!pm) return;
 
-  glDeleteBuffers(1, &pm->vbo_texcoords);
-  glDeleteBuffers(1, &pm->ibo_elements);
+  ogl_delete_buffers(1, &pm->vbo_texcoords);
+  ogl_delete_buffers(1, &pm->ibo_elements);
 
   int i;
   for(i = 0; i < pm->n_total_pchs; i++) {
@@ -271,76 +276,72 @@ pchmap_update_visi( patchmap *pm, const camera *cam, const light *lit )
 }
 */
 
+/* draw one patch with normalmap, its textures must be bound */
+void
+pchmap_patch_normalmap_draw( const patchmap *pm, const int i, const shader *glsl )
+{
+  geopatch *pch = pm->pchs[i];
+
+  ogl_attrib_arrays(OGL_ATTRIB(glsl->attri_v_coord)|
+                    OGL_ATTRIB(glsl->attri_v_normal)|
+                    OGL_ATTRIB(glsl->attri_v_tangent)|
+                    OGL_ATTRIB(glsl->attri_v_texcoord));
+
+  ogl_bind_buffer(GL_ARRAY_BUFFER, pch->vbo_coords);
+  glVertexAttribPointer(glsl->attri_v_coord,   /* attribute */
+                        3,                     /* (x, y, z) */
+                        GL_FLOAT,
+                        GL_FALSE,
+                        0,
+                        0);
+
+  ogl_bind_buffer(GL_ARRAY_BUFFER, pch->vbo_normals);
+  glVertexAttribPointer(glsl->attri_v_normal,   /* attribute */
+                        3,                      /* (x, y, z) */
+                        GL_FLOAT,
+                        GL_FALSE,
+                        0,
+                        0);
+
+  ogl_bind_buffer(GL_ARRAY_BUFFER, pch->vbo_tangents);
+  glVertexAttribPointer(glsl->attri_v_tangent,  /* attribute */
+                        3,                      /* (x, y, z) */
+                        GL_FLOAT,
+                        GL_FALSE,
+                        0,
+                        0);
+
+  ogl_bind_buffer(GL_ARRAY_BUFFER, pm->vbo_texcoords);
+  glVertexAttribPointer(glsl->attri_v_texcoord,  /* attribute */
+                        2,                       /* (x, y) */
+                        GL_FLOAT,
+                        GL_FALSE,
+                        0,
+                        0);
+
+  /* push each element to the vertex shader */
+  ogl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, pm->ibo_elements);
+  glDrawElements(GL_TRIANGLE_STRIP, pm->n_total_pch_indices, GL_UNSIGNED_INT, 0);
+}
+
 /* draw the patchmap with normalmap */
 void
 pchmap_normalmap_draw( const patchmap *pm, const light *lit, const shader *glsl )
 {
   int i;
 
-  glEnableVertexAttribArray(glsl->attri_v_coord);
-  glEnableVertexAttribArray(glsl->attri_v_normal);
-  glEnableVertexAttribArray(glsl->attri_v_tangent);
-  glEnableVertexAttribArray(glsl->attri_v_texcoord);
-
   for(i = 0; i < pm->n_total_pchs; i++) {
     geopatch *pch = pm->pchs[i];
 
     if(pch->visible) {
-      glActiveTexture(GL_TEXTURE0);
-      glBindTexture(GL_TEXTURE_2D, *pch->tex_diffuse);
-
-      glActiveTexture(GL_TEXTURE1);
-      glBindTexture(GL_TEXTURE_2D, *pch->tex_normalmap);
-
-      glActiveTexture(GL_TEXTURE2);
-      glBindTexture(GL_TEXTURE_2D, *pch->tex_specular);
-
-      glActiveTexture(GL_TEXTURE3);
-      glBindTexture(GL_TEXTURE_2D, lit->tex_shadow);
-
-
-      glBindBuffer(GL_ARRAY_BUFFER, pch->vbo_coords);
-      glVertexAttribPointer(glsl->attri_v_coord,   /* attribute */
-                            3,                     /* (x, y, z) */
-                            GL_FLOAT,
-                            GL_FALSE,
-                            0,
-                            0);
-
-      glBindBuffer(GL_ARRAY_BUFFER, pch->vbo_normals);
-      glVertexAttribPointer(glsl->attri_v_normal,   /* attribute */
-                            3,                      /* (x, y, z) */
-                            GL_FLOAT,
-                            GL_FALSE,
-                            0,
-                            0);
-
-      glBindBuffer(GL_ARRAY_BUFFER, pch->vbo_tangents);
-      glVertexAttribPointer(glsl->attri_v_tangent,  /* attribute */
-                            3,                      /* (x, y, z) */
-                            GL_FLOAT,
-                            GL_FALSE,
-                            0,
-                            0);
+      ogl_bind_texture(0, *pch->tex_diffuse);
+      ogl_bind_texture(1, *pch->tex_normalmap);
+      ogl_bind_texture(2, *pch->tex_specular);
+      ogl_bind_texture(3, lit->tex_shadow);
 
-      glBindBuffer(GL_ARRAY_BUFFER, pm->vbo_texcoords);
-      glVertexAttribPointer(glsl->attri_v_texcoord,  /* attribute */
-                            2,                       /* (x, y) */
-                            GL_FLOAT,
-                            GL_FALSE,
-                            0,
-                            0);
-
-      /* push each element to the vertex shader */
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pm->ibo_elements);
-      glDrawElements(GL_TRIANGLE_STRIP, pm->n_total_pch_indices, GL_UNSIGNED_INT, 0);
+      pchmap_patch_normalmap_draw(pm, i, glsl);
     }
   }
-
-  glDisableVertexAttribArray(glsl->attri_v_texcoord);
-  glDisableVertexAttribArray(glsl->attri_v_tangent);
-  glDisableVertexAttribArray(glsl->attri_v_normal);
-  glDisableVertexAttribArray(glsl->attri_v_coord);
 }
 
 /* draw the patchmap with one vertex coordinates */
@@ -349,13 +350,13 @@ pchmap_vertex_draw( const patchmap *pm, const shader *glsl )
 {
   int i;
 
-  glEnableVertexAttribArray(glsl->attri_v_coord);
+  ogl_attrib_arrays(OGL_ATTRIB(glsl->attri_v_coord));
 
   for(i = 0; i < pm->n_total_pchs; i++) {
     geopatch *pch = pm->pchs[i];
 
     if(pch->visible) {
-      glBindBuffer(GL_ARRAY_BUFFER, pch->vbo_coords);
+      ogl_bind_buffer(GL_ARRAY_BUFFER, pch->vbo_coords);
       glVertexAttribPointer(glsl->attri_v_coord,   /* attribute */
                             3,                     /* (x, y, z) */
                             GL_FLOAT,
@@ -364,10 +365,8 @@ pchmap_vertex_draw( const patchmap *pm, const shader *glsl )
                             0);
 
       /* push each element to the vertex shader */
-      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pm->ibo_elements);
+      ogl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, pm->ibo_elements);
       glDrawElements(GL_TRIANGLE_STRIP, pm->n_total_pch_indices, GL_UNSIGNED_INT, 0);
     }
   }
-
-  glDisableVertexAttribArray(glsl->attri_v_coord);
 }
\ No newline at end of file
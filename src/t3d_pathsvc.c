@@ -0,0 +1,430 @@
+/*----- t3d_pathsvc.c --------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <t3d_timer.h>
+#include <t3d_math.h>
+#include <t3d_thpool.h>
+#include <t3d_patchmap.h>
+#include <t3d_hpa.h>
+#include <t3d_unit.h>
+#include <t3d_flowfield.h>
+#include <t3d_pathsvc.h>
+
+
+/* create a path service over the abstract graph of a patchmap in memory */
+pathsvc *
+psv_new( hpa *g, patchmap *pm )
+{
+  pathsvc *svc = (pathsvc *)calloc(1, sizeof(pathsvc));
+
+  svc->queue_capacity = 16;
+  svc->queue = (psvreq *)malloc(sizeof(psvreq)*svc->queue_capacity);
+  svc->results_capacity = 16;
+  svc->results = (psvreq *)malloc(sizeof(psvreq)*svc->results_capacity);
+
+  if(!svc->queue || !svc->results) {
+    fprintf(stderr, "line %d: Can not allocate memory\n", __LINE__);
+    exit(EXIT_FAILURE);
+  }
+
+  svc->budget = PSV_BUDGET;
+  svc->max_expanded = PSV_EXPANSIONS;
+
+  svc->g = g;
+  svc->pm = pm;
+  svc->pool = NULL;
+
+  pthread_mutex_init(&svc->lock, NULL);
+  pthread_mutex_init(&svc->graph_lock, NULL);
+  pthread_cond_init(&svc->notify, NULL);
+
+  return svc;
+}
+
+static void
+psv_cache_clear( pathsvc *svc )
+{
+  int i;
+
+  for(i = 0; i < PSV_CACHE_SIZE; i++) {
+    free(svc->cache[i].waypoints);
+    svc->cache[i].waypoints = NULL;
+    svc->cache[i].last_used = 0;
+  }
+}
+
+/* delete a path service from memory, waits for the batch a worker holds */
+void
+psv_del( pathsvc *svc )
+{
+  int i;
+
+  if(!svc)  return;
+
+  pthread_mutex_lock(&svc->lock);
+  while(svc->searching)
+    pthread_cond_wait(&svc->notify, &svc->lock);
+  pthread_mutex_unlock(&svc->lock);
+
+  for(i = 0; i < svc->n_results; i++) {
+    free(svc->results[i].waypoints);
+    free(svc->results[i].path);
+  }
+  psv_cache_clear(svc);
+  ff_release(svc->flow);
+
+  pthread_cond_destroy(&svc->notify);
+  pthread_mutex_destroy(&svc->graph_lock);
+  pthread_mutex_destroy(&svc->lock);
+  free(svc->queue);
+  free(svc->results);
+  free(svc);
+}
+
+/* search on a thread pool */
+void
+psv_set_thpool( pathsvc *svc, thpool *pool )
+{
+  if(svc)  svc->pool = pool;
+}
+
+/* post a path request of a unit, it replaces the one still queued */
+void
+psv_request( pathsvc *svc, unit *u, const ivec2 *start, const ivec2 *goal, const int priority )
+{
+  int i;
+
+  pthread_mutex_lock(&svc->lock);
+
+  /* 0 is never a ticket */
+  if(++svc->ticket == 0)  svc->ticket = 1;
+  u->path_ticket = svc->ticket;
+
+  psvreq *req = NULL;
+  for(i = 0; i < svc->n_queue; i++) {
+    if(svc->queue[i].u == u) {
+      req = &svc->queue[i];
+      break;
+    }
+  }
+  if(!req) {
+    if(svc->n_queue == svc->queue_capacity) {
+      svc->queue_capacity *= 2;
+      svc->queue = (psvreq *)realloc(svc->queue, sizeof(psvreq)*svc->queue_capacity);
+    }
+    req = &svc->queue[svc->n_queue++];
+  }
+
+  memset(req, 0, sizeof(psvreq));
+  req->u = u;
+  req->ticket = svc->ticket;
+  ivec2_cpy(&req->start, start);
+  ivec2_cpy(&req->goal, goal);
+  req->priority = priority;
+
+  pthread_mutex_unlock(&svc->lock);
+}
+
+/* the flow field to a goal, built on the thread pool if the last one went elsewhere.
+   the caller holds a reference */
+flowfield *
+psv_flow( pathsvc *svc, const ivec2 *goal )
+{
+  if(!svc->flow || !ivec2_eq(&svc->flow->goal, goal)) {
+    ff_release(svc->flow);
+    svc->flow = ff_new(svc->pm, goal, svc->pool);
+  }
+
+  return ff_ref(svc->flow);
+}
+
+/* drop the cached paths with a leg in a patch to rebuild, a leg stays in
+   the patch of one of its waypoints */
+static void
+psv_cache_drop_dirty( pathsvc *svc )
+{
+  int i, k;
+
+  for(i = 0; i < PSV_CACHE_SIZE; i++) {
+    psventry *e = &svc->cache[i];
+    if(!e->last_used)  continue;
+
+    for(k = 0; k < e->n_waypoints; k++) {
+      if(svc->g->pchs[hpa_patch(svc->g, e->waypoints[k].x, e->waypoints[k].y)].dirty)
+        break;
+    }
+    if(k < e->n_waypoints) {
+      free(e->waypoints);
+      e->waypoints = NULL;
+      e->last_used = 0;
+    }
+  }
+}
+
+/* set the status of a cell, the graph, the cache and the flow field follow.
+   every status change of the map after the graph is built goes through here */
+void
+psv_set_status( pathsvc *svc, const int x, const int y, const int status )
+{
+  patchmap *pm = svc->pm;
+
+  pthread_mutex_lock(&pm->lock);
+  int same = pm->cells[y*pm->w_cells + x].status == status;
+  pthread_mutex_unlock(&pm->lock);
+  if(same)  return;
+
+  pthread_mutex_lock(&svc->graph_lock);
+  hpa_set_status(svc->g, pm, x, y, status);
+  /* the paths crossing the patches of the cell, a shorter path opened
+     elsewhere is found once the entry is evicted */
+  psv_cache_drop_dirty(svc);
+  pthread_mutex_unlock(&svc->graph_lock);
+
+  /* the units following it keep it, the next order builds another */
+  ff_release(svc->flow);
+  svc->flow = NULL;
+}
+
+/* take the request searched next, the higher priority, then the older */
+static int
+psv_pop( pathsvc *svc, psvreq *req )
+{
+  int i, best = -1;
+
+  pthread_mutex_lock(&svc->lock);
+  for(i = 0; i < svc->n_queue; i++) {
+    const psvreq *r = &svc->queue[i];
+    if(best < 0 || r->priority > svc->queue[best].priority ||
+       (r->priority == svc->queue[best].priority && (int)(r->ticket - svc->queue[best].ticket) < 0))
+      best = i;
+  }
+  if(best >= 0) {
+    *req = svc->queue[best];
+    svc->queue[best] = svc->queue[--svc->n_queue];
+  }
+  pthread_mutex_unlock(&svc->lock);
+
+  return best >= 0;
+}
+
+/* the cached path of a region to a goal, or NULL */
+static psventry *
+psv_cache_find( pathsvc *svc, const int region, const int goal )
+{
+  int i;
+
+  for(i = 0; i < PSV_CACHE_SIZE; i++) {
+    psventry *e = &svc->cache[i];
+    if(e->last_used && e->region == region && e->goal == goal) {
+      e->last_used = ++svc->cache_clock;
+      return e;
+    }
+  }
+
+  return NULL;
+}
+
+/* keep a path, in place of the one of the same key or the least recently used */
+static void
+psv_cache_add( pathsvc *svc, const int region, const int goal, const ivec2 *waypoints, const int n )
+{
+  psventry *e = NULL;
+  int i;
+
+  for(i = 0; i < PSV_CACHE_SIZE; i++) {
+    psventry *c = &svc->cache[i];
+    if(c->last_used && c->region == region && c->goal == goal) {
+      e = c;
+      break;
+    }
+    if(!e || c->last_used < e->last_used)  e = c;
+  }
+
+  free(e->waypoints);
+  e->waypoints = (ivec2 *)malloc(sizeof(ivec2)*n);
+  memcpy(e->waypoints, waypoints, sizeof(ivec2)*n);
+  e->n_waypoints = n;
+  e->region = region;
+  e->goal = goal;
+  e->last_used = ++svc->cache_clock;
+}
+
+/* the path of a request from the cache, the start takes the place of the
+   first waypoint. return 0 if it is not cached or the first leg is blocked */
+static int
+psv_search_cached( pathsvc *svc, psvreq *req, const int region, const int goal )
+{
+  psventry *e = psv_cache_find(svc, region, goal);
+  if(!e)  return 0;
+
+  const ivec2 *cached = e->waypoints;
+  int n = e->n_waypoints;
+  ivec2 *wps;
+
+  if(n > 2 && ivec2_eq(&cached[1], &req->start)) {
+    /* the start is on the first portal */
+    n--;
+    wps = (ivec2 *)malloc(sizeof(ivec2)*n);
+    memcpy(wps, &cached[1], sizeof(ivec2)*n);
+  }
+  else if(hpa_patch(svc->g, cached[1].x, cached[1].y) != region &&
+          !ivec2_eq(&cached[0], &req->start)) {
+    /* the path was found from the exit portal, the search merged it with
+       the start. the start walks to it, then across the border */
+    n++;
+    wps = (ivec2 *)malloc(sizeof(ivec2)*n);
+    memcpy(&wps[1], cached, sizeof(ivec2)*(n - 1));
+  }
+  else {
+    wps = (ivec2 *)malloc(sizeof(ivec2)*n);
+    memcpy(wps, cached, sizeof(ivec2)*n);
+  }
+  ivec2_cpy(&wps[0], &req->start);
+
+  /* a patch may hold parts not joined inside it */
+  req->n_steps = hpa_refine(svc->g, &req->path, &wps[0], &wps[1], svc->pm);
+  if(!req->n_steps) {
+    free(wps);
+    return 0;
+  }
+
+  req->waypoints = wps;
+  req->n_waypoints = n;
+  return 1;
+}
+
+/* search a request, return the cells and portals expanded */
+static int
+psv_search( pathsvc *svc, psvreq *req )
+{
+  int w = svc->pm->w_cells;
+  int h = svc->pm->h_cells;
+  int expanded = 0;
+
+  if(req->start.x < 0 || req->start.y < 0 || req->start.x >= w || req->start.y >= h ||
+     req->goal.x < 0 || req->goal.y < 0 || req->goal.x >= w || req->goal.y >= h ||
+     ivec2_eq(&req->start, &req->goal))
+    return 0;
+
+  int region = hpa_patch(svc->g, req->start.x, req->start.y);
+  int goal = req->goal.y*w + req->goal.x;
+
+  pthread_mutex_lock(&svc->graph_lock);
+
+  if(psv_search_cached(svc, req, region, goal)) {
+    svc->n_hits++;
+  }
+  else {
+    svc->n_misses++;
+    req->n_waypoints = hpa_search(svc->g, &req->waypoints, &req->start, &req->goal, svc->pm);
+    expanded = svc->g->n_expanded;
+
+    if(req->n_waypoints)
+      req->n_steps = hpa_refine(svc->g, &req->path, &req->waypoints[0], &req->waypoints[1], svc->pm);
+
+    if(req->n_steps) {
+      psv_cache_add(svc, region, goal, req->waypoints, req->n_waypoints);
+    }
+    else {
+      free(req->waypoints);
+      req->waypoints = NULL;
+      req->n_waypoints = 0;
+    }
+  }
+
+  pthread_mutex_unlock(&svc->graph_lock);
+
+  return expanded;
+}
+
+/* worker - search the queue in priority order until the budget is spent */
+static void
+psv_batch_job( void *arg )
+{
+  pathsvc *svc = (pathsvc *)arg;
+  psvreq req;
+  int expanded = 0;
+  int n = 0;
+
+  double start = tmr_getmsecs();
+
+  /* at least one a batch, a long search is not cut */
+  while((n == 0 || ((svc->budget <= 0.0 || tmr_getmsecs() - start < svc->budget) &&
+                    (svc->max_expanded <= 0 || expanded < svc->max_expanded))) &&
+        psv_pop(svc, &req)) {
+    expanded += psv_search(svc, &req);
+    n++;
+
+    pthread_mutex_lock(&svc->lock);
+    if(svc->n_results == svc->results_capacity) {
+      svc->results_capacity *= 2;
+      svc->results = (psvreq *)realloc(svc->results, sizeof(psvreq)*svc->results_capacity);
+    }
+    svc->results[svc->n_results++] = req;
+    pthread_mutex_unlock(&svc->lock);
+  }
+
+  pthread_mutex_lock(&svc->lock);
+  svc->searching = 0;
+  pthread_cond_signal(&svc->notify);
+  pthread_mutex_unlock(&svc->lock);
+}
+
+/* hand a result to its unit, unless the unit asked again since */
+static void
+psv_deliver( psvreq *req )
+{
+  unit *u = req->u;
+
+  if(u->path_ticket != req->ticket) {
+    free(req->waypoints);
+    free(req->path);
+    return;
+  }
+
+  free(u->waypoints);
+  free(u->path);
+  u->waypoints = req->waypoints;
+  u->n_waypoints = req->n_waypoints;
+  u->waypoint = 1;
+  u->path = req->path;
+  u->n_steps = req->n_steps;
+  /* the first cell is the start */
+  u->step = 1;
+
+  u->path_ticket = 0;
+  u->new_path = 1;
+}
+
+/* once a frame on the GL thread, not while the units update - deliver the
+   paths found and start the next batch, return the requests still pending */
+int
+psv_update( pathsvc *svc )
+{
+  int i;
+
+  if(!svc)  return 0;
+
+  pthread_mutex_lock(&svc->lock);
+  for(i = 0; i < svc->n_results; i++)
+    psv_deliver(&svc->results[i]);
+  svc->n_results = 0;
+
+  int start = !svc->searching && svc->n_queue > 0;
+  if(start)  svc->searching = 1;
+  int pending = svc->n_queue;
+  pthread_mutex_unlock(&svc->lock);
+
+  /* one batch at a time, the graph is searched by one thread */
+  if(start) {
+    if(!svc->pool || thpool_add_job(svc->pool, &psv_batch_job, svc, 0) != 0)
+      psv_batch_job(svc);
+  }
+
+  return pending;
+}
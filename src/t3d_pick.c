@@ -4,6 +4,7 @@
  +----------------------------------------------------------------------------*/
 
 #include <stdlib.h>
+#include <string.h>
 #include <t3d_ogl.h>
 #include <t3d_math.h>
 #include <t3d_geomath.h>
@@ -16,33 +17,21 @@
 #include <t3d_ms3d.h>
 #include <t3d_unit.h>
 #include <t3d_astar.h>
+#include <t3d_pathsvc.h>
+#include <t3d_flowfield.h>
+#include <t3d_overlay.h>
 #include <t3d_pick.h>
 
 
-/* store vertices, normals and/or elements in graphic card buffers */
-static void
-pick_upload( const pickbox *pb )
-{
-  glBindBuffer(GL_ARRAY_BUFFER, pb->vbo_coord);
-  /* 10 vertices (vec2) of pickbox, check pick_draw_box2d */
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vec2)*10, NULL, GL_DYNAMIC_DRAW);
-}
-
 /* create a pickbox in memory */
 pickbox *
-pick_new( const int screen_w, const int screen_h )
+pick_new( void )
 {
   pickbox *pb = (pickbox *)malloc(sizeof(pickbox));
 
   pb->status = PICK_NULL;
   pb->type = PICK_NULL;
 
-  /* create the vertex buffer object for box (selection box) */
-  glGenBuffers(1, &pb->vbo_coord);
-  pick_upload(pb);
-
-  mat4_set_ortho(&pb->mat_proj, 0.0, (float)screen_w, 0.0, (float)screen_h, -10.0, 10.0);
-
   return pb;
 }
 
@@ -52,7 +41,6 @@ pick_del( pickbox *pb )
 {
   if(!pb)  return;
 
-  glDeleteBuffers(1, &pb->vbo_coord);
   free(pb);
 }
 
@@ -271,7 +259,8 @@ pick_check_left_picked( pickbox *pb, const list *units, const camera *cam )
 
 /* check right picked */
 void
-pick_check_right_picked( pickbox *pb, const patchmap *pm, const list *units, const camera *cam )
+pick_check_right_picked( pickbox *pb, const patchmap *pm, const list *units, const camera *cam,
+                         pathsvc *svc )
 {
   if(pb->status == PICK_RIGHT_PICKED) {
     vec3 ray_end, ray_dir;
@@ -329,43 +318,59 @@ pick_check_right_picked( pickbox *pb, const patchmap *pm, const list *units, con
       }
     }
 
+    ivec2 goal;
+    goal.x = (int)(target.x/pm->step);
+    goal.y = (int)(target.z/pm->step);
+
+    int n_picked = 0;
+    for(i = 0; i < units->size; i++) {
+      listnode *node = list_node_at(units, i);
+      if(((unit *)node->data)->picked)  n_picked++;
+    }
+    /* a group follows one flow field instead of a search each */
+    flowfield *flow = n_picked >= PSV_FLOW_UNITS ? psv_flow(svc, &goal) : NULL;
+
     for(i = 0; i < units->size; i++) {
       listnode *node = list_node_at(units, i);
       unit *u = (unit *)node->data;
 
       if(u->picked) {
-        u->itarget.x = (int)(target.x/pm->step);
-        u->itarget.y = (int)(target.z/pm->step);
+        ivec2_cpy(&u->itarget, &goal);
         vec3_cpy(&u->last_waypoint, &target);
-        /* need to calculate the A* path, 1 (TRUE) */
-        u->chk_path = 1;
+        /* the unit stands until the path is delivered or the flow field built */
+        u->n_steps = 0;
+        ff_release(u->flow);
+        u->flow = NULL;
+        ms3d_set_anim(u->ani, u->model, 'N');
+
+        if(flow) {
+          u->flow = ff_ref(flow);
+          /* a path still searched is dropped */
+          u->path_ticket = 0;
+          u->new_path = 1;
+        }
+        else
+          psv_request(svc, u, &u->ipos, &u->itarget, PSV_HIGH);
       }
     }
+    ff_release(flow);
 
     pb->status = PICK_NULL;
     pb->type = PICK_NULL;
   }
 }
 
-/* draw the pickbox */
+/* add the pickbox frame to the overlay */
 void
-pick_draw_box2d( const pickbox *pb,
-                 const vec2 *v0, const vec2 *v1,  /* in ortho projection coordinates */
-                 const vec4 *color,
-                 shader *glsl )
+pick_draw_box2d( const pickbox *pb, const vec4 *color, overlay *ovl )
 {
-  glUseProgram(glsl->prog_box2d);
-  shd_set(glsl, glsl->prog_box2d);
-
-  glUniformMatrix4fv(glsl->uniform_mvp, 1, GL_FALSE, pb->mat_proj.m);
-  glUniform4f(glsl->uniform_onecolor, color->r, color->g, color->b, color->a);
-
-  glBindBuffer(GL_ARRAY_BUFFER, pb->vbo_coord);
-  glEnableVertexAttribArray(glsl->attri_v_coord);
-
-  void *pb_data = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+  const vec2 *v0 = &pb->v0;
+  const vec2 *v1 = &pb->v1;
+  vec2 v[10];
+  GLubyte c[4];
+  int i, j;
 
-  vec2 *v = (vec2 *)pb_data;
+  /* the 2 pixels frame as a strip of 10 vertices */
   v[0].x = v0->x;        v[0].y = v0->y;
   v[1].x = v0->x + 2.0;  v[1].y = v0->y + 2.0;
   v[2].x = v1->x;        v[2].y = v0->y;
@@ -377,10 +382,18 @@ pick_draw_box2d( const pickbox *pb,
   v[8].x = v0->x;        v[8].y = v0->y;
   v[9].x = v0->x + 2.0;  v[9].y = v0->y + 2.0;
 
-  glUnmapBuffer(GL_ARRAY_BUFFER);
-
-  glVertexAttribPointer(glsl->attri_v_coord, 2, GL_FLOAT, GL_FALSE, 0, 0);
-  glDrawArrays(GL_TRIANGLE_STRIP, 0, 10);
-
-  glDisableVertexAttribArray(glsl->attri_v_coord);
-}
\ No newline at end of file
+  ovl_color(c, color);
+
+  /* the strip as 8 separate triangles */
+  ovlvertex *o = ovl_add(ovl, 24, 0, OVL_SOLID);
+  for(i = 0; i < 8; i++) {
+    for(j = 0; j < 3; j++) {
+      o->x = v[i + j].x;
+      o->y = v[i + j].y;
+      o->s = 0.0;
+      o->t = 0.0;
+      memcpy(o->color, c, 4);
+      o++;
+    }
+  }
+}
@@ -0,0 +1,165 @@
+/*----- t3d_rqueue.c ---------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <t3d_rqueue.h>
+
+
+/* create a render queue in memory */
+rqueue *
+rq_new( const int capacity )
+{
+  rqueue *rq = (rqueue *)malloc(sizeof(rqueue));
+
+  rq->capacity = capacity > 0 ? capacity : 64;
+  rq->packets = (rqpacket *)malloc(sizeof(rqpacket)*rq->capacity);
+  rq->sorted = (rqpacket *)malloc(sizeof(rqpacket)*rq->capacity);
+  rq->n_packets = 0;
+
+  rq->texsets_capacity = 16;
+  rq->texsets = malloc(sizeof(GLuint)*3*rq->texsets_capacity);
+  rq->n_texsets = 0;
+
+  if(!rq->packets || !rq->sorted || !rq->texsets) {
+    fprintf(stderr, "line %d: Can not allocate memory\n", __LINE__);
+    exit(EXIT_FAILURE);
+  }
+
+  return rq;
+}
+
+/* delete a render queue from memory */
+void
+rq_del( rqueue *rq )
+{
+  if(!rq)  return;
+
+  free(rq->packets);
+  free(rq->sorted);
+  free(rq->texsets);
+  free(rq);
+}
+
+/* empty the queue and forget the texture sets, ids are only good for a frame.
+   streamed and loaded textures come with new names, a table kept across
+   frames would only grow */
+void
+rq_clear( rqueue *rq )
+{
+  rq->n_packets = 0;
+  rq->n_texsets = 0;
+}
+
+/* id of a texture set in this frame, registered on first use */
+unsigned int
+rq_texset( rqueue *rq, const GLuint diffuse, const GLuint normalmap, const GLuint specular )
+{
+  int i;
+
+  /* a scene has a handful of texture sets, a linear search is enough */
+  for(i = 0; i < rq->n_texsets; i++) {
+    if(rq->texsets[i][0] == diffuse &&
+       rq->texsets[i][1] == normalmap &&
+       rq->texsets[i][2] == specular)  return i;
+  }
+
+  if(rq->n_texsets == RQ_NO_TEXSET) {
+    fprintf(stderr, "line %d: Too many texture sets\n", __LINE__);
+    exit(EXIT_FAILURE);
+  }
+
+  if(rq->n_texsets == rq->texsets_capacity) {
+    rq->texsets_capacity *= 2;
+    rq->texsets = realloc(rq->texsets, sizeof(GLuint)*3*rq->texsets_capacity);
+  }
+
+  rq->texsets[i][0] = diffuse;
+  rq->texsets[i][1] = normalmap;
+  rq->texsets[i][2] = specular;
+  rq->n_texsets++;
+
+  return i;
+}
+
+/* build a sort key, a blended pass should pass back_to_front */
+unsigned long long
+rq_key( const unsigned int pass,
+        const unsigned int program,
+        const unsigned int texset,
+        const float distsq,
+        const int back_to_front )
+{
+  /* the bits of a non negative float sort like the float */
+  union { float f; unsigned int u; } depth;
+  depth.f = distsq > 0.0 ? distsq : 0.0;
+  if(back_to_front)  depth.u = ~depth.u;
+
+  return ((unsigned long long)(pass & 0xf) << 60) |
+         ((unsigned long long)(program & 0xf) << 56) |
+         ((unsigned long long)(texset & 0xffffff) << 32) |
+         (unsigned long long)depth.u;
+}
+
+/* add a draw */
+void
+rq_push( rqueue *rq, const unsigned long long key, const int kind, const void *obj, const int sub )
+{
+  if(rq->n_packets == rq->capacity) {
+    rq->capacity *= 2;
+    rq->packets = (rqpacket *)realloc(rq->packets, sizeof(rqpacket)*rq->capacity);
+    rq->sorted = (rqpacket *)realloc(rq->sorted, sizeof(rqpacket)*rq->capacity);
+  }
+
+  rqpacket *p = &rq->packets[rq->n_packets++];
+  p->key = key;
+  p->kind = kind;
+  p->obj = obj;
+  p->sub = sub;
+}
+
+/* sort the draws by key, LSD radix sort on bytes (stable) */
+void
+rq_sort( rqueue *rq )
+{
+  unsigned int counts[8][256];
+  int i, b;
+  int n = rq->n_packets;
+
+  if(n < 2)  return;
+
+  /* all 8 histograms in one walk */
+  memset(counts, 0, sizeof(counts));
+  for(i = 0; i < n; i++) {
+    unsigned long long key = rq->packets[i].key;
+    for(b = 0; b < 8; b++)
+      counts[b][(key >> (8*b)) & 0xff]++;
+  }
+
+  for(b = 0; b < 8; b++) {
+    unsigned int *count = counts[b];
+    unsigned int sum = 0;
+    int shift = 8*b;
+
+    /* every key has the same byte here, nothing to move */
+    if(count[(rq->packets[0].key >> shift) & 0xff] == (unsigned int)n)  continue;
+
+    for(i = 0; i < 256; i++) {
+      unsigned int c = count[i];
+      count[i] = sum;
+      sum += c;
+    }
+
+    for(i = 0; i < n; i++) {
+      const rqpacket *p = &rq->packets[i];
+      rq->sorted[count[(p->key >> shift) & 0xff]++] = *p;
+    }
+
+    rqpacket *tmp = rq->packets;
+    rq->packets = rq->sorted;
+    rq->sorted = tmp;
+  }
+}
@@ -19,15 +19,43 @@
 #include <t3d_geopatch.h>
 #include <t3d_patchmap.h>
 #include <t3d_ms3d.h>
+#include <t3d_mesh.h>
 #include <t3d_unit.h>
 #include <t3d_light.h>
 #include <t3d_sys.h>
 #include <t3d_decal.h>
 #include <t3d_aamesh.h>
 #include <t3d_astar.h>
+#include <t3d_hpa.h>
+#include <t3d_pathsvc.h>
+#include <t3d_flowfield.h>
+#include <t3d_rqueue.h>
+#include <t3d_texstream.h>
 #include <t3d_scene.h>
 
 
+/* render queue passes, programs and draw kinds of the camera pass */
+enum {
+  SCN_PASS_OPAQUE = 0,
+  SCN_PASS_BLEND = 1
+};
+
+enum {
+  SCN_PROG_NORMAL = 0,
+  SCN_PROG_NORMAL_INST = 1,
+  SCN_PROG_NORMAL_ARRAY = 2,
+  SCN_PROG_NORMAL_INST_ARRAY = 3,
+  SCN_PROG_AAMESH = 4
+};
+
+enum {
+  SCN_DRAW_PATCH = 0,       /* obj: patchmap, sub: patch index */
+  SCN_DRAW_UNIT_MESH = 1,   /* obj: unit, sub: mesh index */
+  SCN_DRAW_UNIT_INST = 2,   /* obj: instance group leader, sub: mesh index */
+  SCN_DRAW_AAMESH = 3       /* obj: unit */
+};
+
+
 /* create a scene in memory */
 scene *
 scn_new( t3dsys *sys, camera *cam, light *lit, control *ctrl, pickbox *pickb )
@@ -44,6 +72,17 @@ scn_new( t3dsys *sys, camera *cam, light *lit, control *ctrl, pickbox *pickb )
   scn->unit_count = 0;
 
   scn->batch_count = 3;
+  scn->frame_count = 0;
+  scn->unit_fused = 1;
+
+  scn->rq = rq_new(256);
+
+  scn->unit_instanced = ogl_has_instancing();
+  scn->inst_pose_rate = 15.0;
+  scn->insts = NULL;
+  scn->n_insts_capacity = 0;
+
+  scn_set_unit_lod(scn, 12.0, 24.0);
 
   return scn;
 }
@@ -54,9 +93,35 @@ scn_del( scene *scn )
 {
   if(!scn) return;
 
+  rq_del(scn->rq);
+  free(scn->insts);
   free(scn);
 }
 
+/* set the unit update LOD bands, camera distances in model radii */
+void
+scn_set_unit_lod( scene *scn, const float near_dist, const float far_dist )
+{
+  scn->lod_near_distsq = near_dist*near_dist;
+  scn->lod_far_distsq = far_dist*far_dist;
+}
+
+/* find the unit update interval (1, 2, 4 frames) by its size on the screen */
+static int
+scn_unit_lod_interval( const scene *scn, const unit *u, const float cam_distsq )
+{
+  /* distance in model radii, grows as the unit gets smaller on the screen */
+  float radius = u->model->radius;
+  float distsq = cam_distsq/(radius*radius);
+
+  if(distsq < scn->lod_near_distsq)
+    return 1;
+  if(distsq < scn->lod_far_distsq)
+    return 2;
+
+  return 4;
+}
+
 /* update camera and light */
 void
 scn_update_cam_lit( void *arg_scn )
@@ -85,6 +150,7 @@ scn_update_cam_lit( void *arg_scn )
   mat4_mul(&lit->mat_bias_vp, &lit->mat_bias, &lit->mat_vp);
   frustum_set_clip_planes(lit->clips, &lit->mat_vp);
 
+  scn->frame_count++;
   scn->batch_count++;
 }
 
@@ -137,6 +203,72 @@ scn_update_geopatch( void *arg_scn )
   }
 }
 
+/* walk the unit toward the center of a cell, the picked point if it is the last */
+static void
+scn_unit_walk_to( unit *u, const ivec2 *next, const int last, t3dsys *sys )
+{
+  patchmap *pchmap = sys->pchmap;
+  vec3 to;
+
+  if(last)
+    vec3_cpy(&to, &u->last_waypoint);
+  else
+    vec3_cpy(&to, &pchmap->cells[next->y*pchmap->w_cells + next->x].center);
+  to.y = u->pos.y;
+
+  /* find unit's forward direction */
+  obj_find_f_axis(&u->f, &u->pos, &to);
+  /* move the unit */
+  float dist = u->move_speed*sys->time_passed;
+  obj_move(&u->pos, &u->target, &u->f, dist, OBJ_ON_GROUND);
+  /* set unit's postion, the cell it stands on can be walked */
+  unit_set_pos(u, &u->pos, pchmap);
+  psv_set_status(sys->pathsvc, u->ipos.x, u->ipos.y, ASTAR_AVAIL);
+  /* set unit's up and right directions */
+  unit_set_dir(u, &u->f);
+}
+
+/* the unit is at the target, or can not get there */
+static void
+scn_unit_stop( unit *u, t3dsys *sys )
+{
+  /* set unit's direction */
+  unit_set_pos(u, &u->pos, sys->pchmap);
+  psv_set_status(sys->pathsvc, u->ipos.x, u->ipos.y, ASTAR_AVAIL);
+  unit_set_dir(u, &u->target_f);
+  ms3d_set_anim(u->ani, u->model, 'N');
+}
+
+/* the unit walked the last cell of a leg, refine the next one or stop at the end */
+static void
+scn_unit_next_leg( unit *u, t3dsys *sys )
+{
+  free(u->path);
+  u->path = NULL;
+  u->n_steps = 0;
+
+  if(u->waypoint < u->n_waypoints - 1) {
+    int n = hpa_refine(sys->pathgraph, &u->path, &u->waypoints[u->waypoint],
+                       &u->waypoints[u->waypoint + 1], sys->pchmap);
+    u->waypoint++;
+    if(n) {
+      u->n_steps = n;
+      u->step = 1;
+      return;
+    }
+
+    /* blocked since it was planned, the unit stands until a new path comes */
+    psv_request(sys->pathsvc, u, &u->ipos, &u->itarget, PSV_NORMAL);
+    ms3d_set_anim(u->ani, u->model, 'N');
+    return;
+  }
+
+  free(u->waypoints);
+  u->waypoints = NULL;
+  u->n_waypoints = 0;
+  scn_unit_stop(u, sys);
+}
+
 /* update units */
 void
 scn_update_unit( void *arg_scn )
@@ -144,13 +276,13 @@ scn_update_unit( void *arg_scn )
   scene *scn = (scene *)arg_scn;
 
   t3dsys *sys = scn->sys;
-  patchmap *pchmap = sys->pchmap;
   camera *cam = scn->cam;
   light *lit = scn->lit;
 
   /* update units */
   listnode *node = list_node_at(sys->units, scn->unit_count);
   unit *u = (unit *)node->data;
+  int was_visible = u->visible;
 
   /* quick check if unit is in the frustum */
   vec3 unit_to_cam_ws;
@@ -185,29 +317,57 @@ scn_update_unit( void *arg_scn )
           aamesh_get_mesh(u->aamsh, u->model->o_aamsh, u->ipos.x, u->ipos.y, sys->pchmap);
         }
 
-        /* update animation, model vertices */
-        ms3d_calc_anim_time(u->ani, u->model, sys->time_passed);
-        ms3d_animate(u->mat_joint_finals, u->ani, u->model);
-        unit_update_vertices(u);
-
-        /* find the object space view vector first */
-        vec3 unit_to_lit_ws;
-        vec3 unit_to_cam_os;
-        vec3 unit_to_lit_os;
-        mat4 mat_model_transp;
-
-        vec3_sub(&unit_to_lit_ws, &lit->pos, &u->pos);
-        mat4_transpose(&mat_model_transp, &u->mat_model);
-        mat4_r_mul_t_vec3(&unit_to_cam_os, &mat_model_transp, &unit_to_cam_ws);
-        mat4_r_mul_t_vec3(&unit_to_lit_os, &mat_model_transp, &unit_to_lit_ws);
-
-        /* update units' HSR visibility */
-        /* prepare the faces (planes) for HSR */
-        unit_calc_faces(u);
-        /* update visibility HSR (hidden surface removal) to light */
-        unit_calc_lit_hsr(u, &unit_to_lit_os, PLANE_BACK);
-        /* update visibility HSR (hidden surface removal) to camera */
-        unit_calc_cam_hsr(u, &unit_to_cam_os, PLANE_FRONT);
+        /* update LOD - near units every frame, mid units every 2nd, far units every 4th */
+        float cam_distsq = vec3_lensq(&unit_to_cam_ws);
+        u->lod_interval = scn_unit_lod_interval(scn, u, cam_distsq);
+        u->lod_time += sys->time_passed;
+
+        /* staggered by the unit index to spread the updates evenly over the frames,
+           a unit just became visible or no longer following is always updated,
+           its buffers are stale */
+        if(!was_visible || (u->skin_stale && !u->inst_leader) ||
+           ((scn->frame_count + scn->unit_count) & (u->lod_interval - 1)) == 0) {
+          /* update animation */
+          ms3d_calc_anim_time(u->ani, u->model, u->lod_time);
+          ms3d_animate(u->mat_joint_finals, u->ani, u->model);
+          u->lod_time = 0.0;
+
+          /* a follower is drawn with the leader's vertices, the animation
+             goes on for its pose bucket, the skin and HSR wait */
+          if(u->inst_leader) {
+            u->skin_stale = 1;
+          }
+          else {
+            /* find the object space view vector first */
+            vec3 unit_to_lit_ws;
+            vec3 unit_to_cam_os;
+            vec3 unit_to_lit_os;
+            mat4 mat_model_transp;
+
+            vec3_sub(&unit_to_lit_ws, &lit->pos, &u->pos);
+            mat4_transpose(&mat_model_transp, &u->mat_model);
+            mat4_r_mul_t_vec3(&unit_to_cam_os, &mat_model_transp, &unit_to_cam_ws);
+            mat4_r_mul_t_vec3(&unit_to_lit_os, &mat_model_transp, &unit_to_lit_ws);
+
+            if(scn->unit_fused) {
+              /* model vertices, faces (planes) and HSR visibility to light
+                 and camera, triangle block by triangle block */
+              unit_update_fused(u, &unit_to_cam_os, PLANE_FRONT,
+                                   &unit_to_lit_os, PLANE_BACK);
+            }
+            else {
+              /* reference path, one pass over the mesh for each step */
+              unit_update_vertices(u);
+              /* prepare the faces (planes) for HSR */
+              unit_calc_faces(u);
+              /* update visibility HSR (hidden surface removal) to light */
+              unit_calc_lit_hsr(u, &unit_to_lit_os, PLANE_BACK);
+              /* update visibility HSR (hidden surface removal) to camera */
+              unit_calc_cam_hsr(u, &unit_to_cam_os, PLANE_FRONT);
+            }
+            u->skin_stale = 0;
+          }
+        }
       }
       else
         u->visible = 0;
@@ -218,38 +378,37 @@ scn_update_unit( void *arg_scn )
   else
     u->visible = 0;
 
-  /* trigger to calulate the A* path */
-  if(u->chk_path) {
-    if(u->path) free(u->path);
-
-    /*u->n_steps = astar_search(&u->path, &u->ipos, &u->itarget, pchmap);*/
-    u->n_steps = 1;  /* 1 (TRUE) */
-    obj_find_f_axis(&u->target_f, &u->pos, &u->last_waypoint);
-    /* reset to 0 (FALSE) after finding the path */
-    u->chk_path = 0;
-    ms3d_set_anim(u->ani, u->model, 'A');
+  /* the path service delivered a path (0 steps if there is none), or the flow
+     field of a group order is built */
+  if(u->new_path && (!u->flow || ff_ready(u->flow))) {
+    u->new_path = 0;
+    if(u->n_steps || u->flow) {
+      obj_find_f_axis(&u->target_f, &u->pos, &u->last_waypoint);
+      ms3d_set_anim(u->ani, u->model, 'A');
+    }
+    else
+      ms3d_set_anim(u->ani, u->model, 'N');
   }
 
   /* let's finish walking the path */
   if(u->n_steps) {
-    /* move the unit */
-    float dist = u->move_speed*sys->time_passed;
-    obj_move(&u->pos, &u->target, &u->f, dist, OBJ_ON_GROUND);
-    /* set unit's postion */
-    unit_set_pos(u, &u->pos, pchmap);
-    /* find unit's forward direction */
-    obj_find_f_axis(&u->f, &u->pos, &u->last_waypoint);
-    /* set unit's up and right directions */
-    unit_set_dir(u, &u->f);
-
-    if(ivec2_eq(&u->ipos, &u->itarget)) {
-      free(u->path);
-      u->n_steps = 0;
-
-      /* set unit's direction */
-      unit_set_pos(u, &u->pos, sys->pchmap);
-      unit_set_dir(u, &u->target_f);
-      ms3d_set_anim(u->ani, u->model, 'N');
+    scn_unit_walk_to(u, &u->path[u->step],
+                     u->step == u->n_steps - 1 && u->waypoint == u->n_waypoints - 1, sys);
+
+    if(ivec2_eq(&u->ipos, &u->path[u->step]) && ++u->step == u->n_steps)
+      scn_unit_next_leg(u, sys);
+  }
+  /* or step along the flow field once it is built */
+  else if(u->flow && ff_ready(u->flow)) {
+    ivec2 next;
+
+    if(ff_step(u->flow, &next, &u->ipos)) {
+      scn_unit_walk_to(u, &next, ivec2_eq(&next, &u->flow->goal), sys);
+    }
+    else {
+      ff_release(u->flow);
+      u->flow = NULL;
+      scn_unit_stop(u, sys);
     }
   }
 
@@ -261,21 +420,118 @@ scn_update_unit( void *arg_scn )
   }
 }
 
-/* update vbo, ibos in the scene */
+/* compare the instance group keys */
+static int
+scn_inst_key_cmp( const void *a, const void *b )
+{
+  const scninst *ia = (const scninst *)a;
+  const scninst *ib = (const scninst *)b;
+
+  if(ia->model != ib->model)  return ia->model < ib->model ? -1 : 1;
+  if(ia->cmd != ib->cmd)  return ia->cmd - ib->cmd;
+  if(ia->skin != ib->skin)  return ia->skin - ib->skin;
+  return ia->pose - ib->pose;
+}
+
+/* order of the instance groups, in a group the units skinned last come first */
+static int
+scn_inst_cmp( const void *a, const void *b )
+{
+  int key = scn_inst_key_cmp(a, b);
+  if(key)  return key;
+
+  return ((const scninst *)a)->u->skin_stale - ((const scninst *)b)->u->skin_stale;
+}
+
+/* gather the visible units of the same model, pose bucket and skin, the first
+   unit of a group (the leader) draws them all with its skinned vertices */
+static void
+scn_group_instances( scene *scn )
+{
+  const t3dsys *sys = scn->sys;
+  int i, j, n = 0;
+
+  if(scn->n_insts_capacity < sys->units->size) {
+    scn->n_insts_capacity = sys->units->size;
+    scn->insts = (scninst *)realloc(scn->insts, sizeof(scninst)*scn->n_insts_capacity);
+  }
+
+  for(i = 0; i < sys->units->size; i++) {
+    listnode *node = list_node_at(sys->units, i);
+    unit *u = (unit *)node->data;
+
+    u->inst_count = 0;
+    u->inst_leader = NULL;
+
+    if(u->visible && scn->unit_instanced) {
+      scninst *inst = &scn->insts[n++];
+      inst->u = u;
+      inst->model = u->model;
+      inst->cmd = u->ani->cur_cmd;
+      inst->pose = (int)(u->ani->cur_time*scn->inst_pose_rate);
+      /* the leader's textures are drawn unless each instance has its layer */
+      inst->skin = u->skin_layer >= 0 ? -1 : u->skin_set;
+    }
+  }
+
+  qsort(scn->insts, n, sizeof(scninst), scn_inst_cmp);
+
+  for(i = 0; i < n; i = j) {
+    for(j = i + 1; j < n && scn_inst_key_cmp(&scn->insts[i], &scn->insts[j]) == 0; j++);
+
+    /* a group of one is drawn on its own */
+    if(j - i < 2)  continue;
+
+    unit *leader = scn->insts[i].u;
+    int k;
+
+    mat4 *models = (mat4 *)ogl_stream_map(sizeof(mat4)*(j - i), &leader->stm_inst_models);
+    if(!models)  continue;
+
+    for(k = i; k < j; k++)
+      mat4_cpy(&models[k - i], &scn->insts[k].u->mat_model);
+    ogl_stream_unmap();
+
+    if(scn->insts[i].skin < 0) {
+      float *layers = (float *)ogl_stream_map(sizeof(float)*(j - i), &leader->stm_inst_layers);
+      if(!layers)  continue;
+
+      for(k = i; k < j; k++)
+        layers[k - i] = (float)scn->insts[k].u->skin_layer;
+      ogl_stream_unmap();
+    }
+
+    for(k = i + 1; k < j; k++)
+      scn->insts[k].u->inst_leader = leader;
+
+    leader->inst_count = j - i;
+  }
+}
+
+/* group the instanced units, update vbo, ibos in the scene */
 void
-scn_update_vbo_ibo( const t3dsys *sys )
+scn_update_vbo_ibo( scene *scn )
 {
+  const t3dsys *sys = scn->sys;
   int i;
+
+  scn_group_instances(scn);
+
   for(i = 0; i < sys->units->size; i++) {
     listnode *node = list_node_at(sys->units, i);
     unit *u = (unit *)node->data;
 
-    if(u->visible) {
+    /* stream data only lives for a frame, units skipped by the update LOD
+       stream their last skinned vertices again */
+    if(u->visible && !u->inst_leader) {
       /* must update vbo, ibo in main thread, so do it in light pass */
       /* update vbo, ibo */
       unit_update_vbo(u);
-      unit_update_hsr_lit_ibo(u);
-      unit_update_hsr_cam_ibo(u);
+      /* instance groups draw all their triangles, no hsr lists */
+      if(!u->inst_count) {
+        unit_update_hsr_lit_ibo(u);
+        unit_update_hsr_cam_ibo(u);
+      }
     }
   }
 }
@@ -286,23 +542,25 @@ scn_map_to_light_shader( shader *glsl,
                          const float *lit_mat_vp,
                          const float *unit_mat_model )
 {
-  glUniformMatrix4fv(glsl->uniform_lvp, 1, GL_FALSE, lit_mat_vp);
-  glUniformMatrix4fv(glsl->uniform_m, 1, GL_FALSE, unit_mat_model);
+  shd_uniform_matrix4(glsl, SHD_LVP, lit_mat_vp);
+  shd_uniform_matrix4(glsl, SHD_M, unit_mat_model);
 }
 
 /* the light pass to generate shadowmap */
 void
-scn_light_pass( const t3dsys *sys, const light *lit, shader *glsl )
+scn_light_pass( const scene *scn, shader *glsl )
 {
+  const t3dsys *sys = scn->sys;
+  const light *lit = scn->lit;
+
   /* draw the shadowmap to framebuffer */
   glBindFramebuffer(GL_FRAMEBUFFER, lit->fbo_shadow);
 
   glViewport(0, 0, lit->shadow_size, lit->shadow_size);
   glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
   glClear(GL_DEPTH_BUFFER_BIT);
-  glCullFace(GL_FRONT);
+  ogl_cull_face(GL_FRONT);
 
-  glUseProgram(glsl->prog_light_pass);
   shd_set(glsl, glsl->prog_light_pass);
 /*
   patchmap *pchmap = sys->pchmap;
@@ -311,16 +569,35 @@ scn_light_pass( const t3dsys *sys, const light *lit, shader *glsl )
 */
 
   int i;
+  int n_leaders = 0;
   for(i = 0; i < sys->units->size; i++) {
     listnode *node = list_node_at(sys->units, i);
     unit *u = (unit *)node->data;
 
-   if(u->visible) {
+    if(u->visible && !u->inst_leader) {
+      if(u->inst_count) {
+        n_leaders++;
+        continue;
+      }
       /* vs */
       scn_map_to_light_shader(glsl, lit->mat_vp.m, u->mat_model.m);
       unit_vertex_draw(u, glsl);
     }
   }
+
+  /* instance groups, the model matrices are attributes */
+  if(n_leaders) {
+    shd_set(glsl, glsl->prog_light_inst);
+    shd_uniform_matrix4(glsl, SHD_LVP, lit->mat_vp.m);
+
+    for(i = 0; i < sys->units->size; i++) {
+      listnode *node = list_node_at(sys->units, i);
+      unit *u = (unit *)node->data;
+
+      if(u->visible && u->inst_count)
+        unit_vertex_draw_inst(u, glsl);
+    }
+  }
 }
 
 /* prepare normalmap pass shader */
@@ -334,29 +611,137 @@ scn_map_to_normalmap_shader( shader *glsl,
                              const vec4 *light_pos )
 {
   /* vs */
-  glUniformMatrix4fv(glsl->uniform_vp, 1, GL_FALSE, cam_mat_vp);
-  glUniformMatrix4fv(glsl->uniform_m, 1, GL_FALSE, obj_mat_model);
+  shd_uniform_matrix4(glsl, SHD_VP, cam_mat_vp);
+  shd_uniform_matrix4(glsl, SHD_M, obj_mat_model);
   /*---------------------------------------------------------------------------+
     If you don't have non-uniform scaling as part of your model matrix,
     the upper 3x3 of the model matrix is just as good as the "normal matrix"
     (which is the transpose of the inverse of the model matrix) for 
     transforming normals
    +--------------------------------------------------------------------------*/
-  glUniformMatrix3fv(glsl->uniform_m3x3_inv_transp, 1, GL_FALSE, obj_m3x3_inv_transp);
-  glUniformMatrix4fv(glsl->uniform_bias_lvp, 1, GL_FALSE, lit_mat_bias_vp);
+  shd_uniform_matrix3(glsl, SHD_M3X3_INV_TRANSP, obj_m3x3_inv_transp);
+  shd_uniform_matrix4(glsl, SHD_BIAS_LVP, lit_mat_bias_vp);
   /* fs */
-  glUniformMatrix4fv(glsl->uniform_v_inv, 1, GL_FALSE, cam_mat_view_inv);
-  glUniform1i(glsl->uniform_diffmap, /*GL_TEXTURE*/0);
-  glUniform1i(glsl->uniform_normmap, /*GL_TEXTURE*/1);
-  glUniform1i(glsl->uniform_specmap, /*GL_TEXTURE*/2);
-  glUniform1i(glsl->uniform_shadmap, /*GL_TEXTURE*/3);
-  glUniform4f(glsl->uniform_light_coord, light_pos->x, light_pos->y, light_pos->z, light_pos->w);
+  shd_uniform_matrix4(glsl, SHD_V_INV, cam_mat_view_inv);
+  shd_uniform_1i(glsl, SHD_DIFFMAP, /*GL_TEXTURE*/0);
+  shd_uniform_1i(glsl, SHD_NORMMAP, /*GL_TEXTURE*/1);
+  shd_uniform_1i(glsl, SHD_SPECMAP, /*GL_TEXTURE*/2);
+  shd_uniform_1i(glsl, SHD_SHADMAP, /*GL_TEXTURE*/3);
+  shd_uniform_4f(glsl, SHD_LIGHT_COORD, light_pos->x, light_pos->y, light_pos->z, light_pos->w);
+}
+
+/* pixels on screen of a world size at a distance, for the texture stream */
+static float
+scn_screen_px( const camera *cam, const float world_size, const float distsq )
+{
+  float dist = sqrtf(distsq);
+  if(dist < 1.0)  dist = 1.0;
+
+  /* mat_proj[5] is cot(fov/2) */
+  return world_size*cam->mat_proj.m[5]*0.5*cam->screen_h/dist;
+}
+
+/* ask the texture stream for the levels of a texture set */
+static void
+scn_request_textures( texstream *texstm, const float screen_px,
+                      const GLuint diffuse, const GLuint normalmap, const GLuint specular )
+{
+  tex_stream_request(texstm, diffuse, screen_px);
+  tex_stream_request(texstm, normalmap, screen_px);
+  tex_stream_request(texstm, specular, screen_px);
+}
+
+/* queue the draws of the camera pass */
+static void
+scn_camera_submit( scene *scn )
+{
+  const t3dsys *sys = scn->sys;
+  const camera *cam = scn->cam;
+  rqueue *rq = scn->rq;
+  int i, j;
+
+  rq_clear(rq);
+
+  patchmap *pchmap = sys->pchmap;
+  for(i = 0; i < pchmap->n_total_pchs; i++) {
+    geopatch *pch = pchmap->pchs[i];
+
+    if(pch->visible) {
+      unsigned int texset = rq_texset(rq, *pch->tex_diffuse, *pch->tex_normalmap, *pch->tex_specular);
+      vec3 to_cam;
+      vec3_sub(&to_cam, &cam->pos, &pch->center);
+      float distsq = vec3_lensq(&to_cam);
+      rq_push(rq, rq_key(SCN_PASS_OPAQUE, SCN_PROG_NORMAL, texset, distsq, 0),
+              SCN_DRAW_PATCH, pchmap, i);
+
+      /* a patch texture spans the patch */
+      if(sys->texstm)
+        scn_request_textures(sys->texstm, scn_screen_px(cam, 2.0*pch->half_x_len, distsq),
+                             *pch->tex_diffuse, *pch->tex_normalmap, *pch->tex_specular);
+    }
+  }
+
+  for(i = 0; i < sys->units->size; i++) {
+    listnode *node = list_node_at(sys->units, i);
+    unit *u = (unit *)node->data;
+
+    if(!u->visible)  continue;
+
+    vec3 to_cam;
+    vec3_sub(&to_cam, &cam->pos, &u->pos);
+    float distsq = vec3_lensq(&to_cam);
+    /* a skin spans the model */
+    float screen_px = sys->texstm ? scn_screen_px(cam, 2.0*u->model->radius, distsq) : 0.0;
+
+    /* followers are drawn by their instance group leader */
+    for(j = 0; j < u->model->n_mshs && !u->inst_leader; j++) {
+      mesh *msh = u->mshs[j];
+      unsigned int texset, prog, prog_inst;
+
+      if(u->skin_layer >= 0) {
+        /* every skin of the model in the same arrays, always resident */
+        const unsigned int *arrays = &u->model->skin_arrays[j*3];
+        texset = rq_texset(rq, arrays[0], arrays[1], arrays[2]);
+        prog = SCN_PROG_NORMAL_ARRAY;
+        prog_inst = SCN_PROG_NORMAL_INST_ARRAY;
+      }
+      else {
+        texset = rq_texset(rq, *msh->tex_diffuse, *msh->tex_normalmap, *msh->tex_specular);
+        prog = SCN_PROG_NORMAL;
+        prog_inst = SCN_PROG_NORMAL_INST;
+
+        if(sys->texstm)
+          scn_request_textures(sys->texstm, screen_px,
+                               *msh->tex_diffuse, *msh->tex_normalmap, *msh->tex_specular);
+      }
+
+      if(u->inst_count)
+        rq_push(rq, rq_key(SCN_PASS_OPAQUE, prog_inst, texset, distsq, 0),
+                SCN_DRAW_UNIT_INST, u, j);
+      else if(msh->cam_hsr_count > 0)
+        rq_push(rq, rq_key(SCN_PASS_OPAQUE, prog, texset, distsq, 0),
+                SCN_DRAW_UNIT_MESH, u, j);
+    }
+
+    /* transparent, binds its own texture */
+    if(u->picked && aamesh_update_vbo(u->aamsh)) {
+      rq_push(rq, rq_key(SCN_PASS_BLEND, SCN_PROG_AAMESH, RQ_NO_TEXSET, distsq, 1),
+              SCN_DRAW_AAMESH, u, 0);
+      tex_stream_request(sys->texstm, *u->aamsh->tex_id, screen_px);
+    }
+  }
+
+  rq_sort(rq);
 }
 
 /* the camera pass */
 void
-scn_camera_pass( const t3dsys *sys, const camera *cam, const light *lit, shader *glsl )
+scn_camera_pass( scene *scn, shader *glsl )
 {
+  const t3dsys *sys = scn->sys;
+  const camera *cam = scn->cam;
+  const light *lit = scn->lit;
+  rqueue *rq = scn->rq;
   int i;
   /* light position */
   vec4 light_pos;
@@ -369,57 +754,100 @@ scn_camera_pass( const t3dsys *sys, const camera *cam, const light *lit, shader
   glViewport(0, 0, cam->screen_w, cam->screen_h);
   glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
   glClear(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT);
-  glCullFace(GL_BACK);
+  ogl_cull_face(GL_BACK);
 
-  /* draw normalmap patchmap */
-  glUseProgram(glsl->prog_normal_pass);
-  shd_set(glsl, glsl->prog_normal_pass);
-
-  patchmap *pchmap = sys->pchmap;
-  scn_map_to_normalmap_shader(glsl,
-                              cam->mat_vp.m,
-                              pchmap->mat_model.m, pchmap->mat_m3x3.m,
-                              lit->mat_bias_vp.m,
-                              cam->mat_view_inv.m,
-                              &light_pos);
-  pchmap_normalmap_draw(pchmap, lit, glsl);
+  scn_camera_submit(scn);
 
+  /* the shadowmap is the same for every draw */
+  ogl_bind_texture(3, lit->tex_shadow);
 
-  /* draw aamesh - transparent */
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  /* state changes only where the key fields change */
+  unsigned int cur_pass = SCN_PASS_OPAQUE;
+  unsigned int cur_prog = ~0u;
+  unsigned int cur_texset = RQ_NO_TEXSET;
 
-  glUseProgram(glsl->prog_aamesh);
-  shd_set(glsl, glsl->prog_aamesh);
-
-  for(i = 0; i < sys->units->size; i++) {
-    listnode *node = list_node_at(sys->units, i);
-    unit *u = (unit *)node->data;
+  for(i = 0; i < rq->n_packets; i++) {
+    const rqpacket *p = &rq->packets[i];
+    unsigned int pass = RQ_KEY_PASS(p->key);
+    unsigned int prog = RQ_KEY_PROGRAM(p->key);
+    unsigned int texset = RQ_KEY_TEXSET(p->key);
 
-    if(u->visible && u->picked) {
-      aamesh_update_vbo(u->aamsh);
-      aamesh_draw(u->aamsh, u->model->o_aamsh, cam, &sys->colors[u->color], glsl);
+    if(pass != cur_pass) {
+      if(pass == SCN_PASS_BLEND) {
+        ogl_enable(GL_BLEND);
+        ogl_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+      }
+      else
+        ogl_disable(GL_BLEND);
+      cur_pass = pass;
     }
-  }
-  glDisable(GL_BLEND);
-
-
-  /* draw normalmap units */
-  glUseProgram(glsl->prog_normal_pass);
-  shd_set(glsl, glsl->prog_normal_pass);
 
-  for(i = 0; i < sys->units->size; i++) {
-    listnode *node = list_node_at(sys->units, i);
-    unit *u = (unit *)node->data;
+    if(prog != cur_prog) {
+      if(prog == SCN_PROG_AAMESH)
+        shd_set(glsl, glsl->prog_aamesh);
+      else if(prog == SCN_PROG_NORMAL_INST)
+        shd_set(glsl, glsl->prog_normal_inst);
+      else if(prog == SCN_PROG_NORMAL_ARRAY)
+        shd_set(glsl, glsl->prog_normal_array);
+      else if(prog == SCN_PROG_NORMAL_INST_ARRAY)
+        shd_set(glsl, glsl->prog_normal_inst_array);
+      else
+        shd_set(glsl, glsl->prog_normal_pass);
+      cur_prog = prog;
+    }
 
-    if(u->visible) {
-      scn_map_to_normalmap_shader(glsl,
-                                  cam->mat_vp.m,
-                                  u->mat_model.m, u->mat_m3x3.m,
-                                  lit->mat_bias_vp.m,
-                                  cam->mat_view_inv.m,
-                                  &light_pos);
-      unit_normalmap_draw(u, lit, glsl);
+    if(texset != cur_texset && texset != RQ_NO_TEXSET) {
+      GLenum target = prog == SCN_PROG_NORMAL_ARRAY || prog == SCN_PROG_NORMAL_INST_ARRAY ?
+                      GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+      ogl_bind_texture_target(0, target, rq->texsets[texset][0]);
+      ogl_bind_texture_target(1, target, rq->texsets[texset][1]);
+      ogl_bind_texture_target(2, target, rq->texsets[texset][2]);
+    }
+    cur_texset = texset;
+
+    switch(p->kind) {
+      case SCN_DRAW_PATCH: {
+        const patchmap *pchmap = (const patchmap *)p->obj;
+        scn_map_to_normalmap_shader(glsl,
+                                    cam->mat_vp.m,
+                                    pchmap->mat_model.m, pchmap->mat_m3x3.m,
+                                    lit->mat_bias_vp.m,
+                                    cam->mat_view_inv.m,
+                                    &light_pos);
+        pchmap_patch_normalmap_draw(pchmap, p->sub, glsl);
+        break;
+      }
+      case SCN_DRAW_UNIT_MESH: {
+        const unit *u = (const unit *)p->obj;
+        scn_map_to_normalmap_shader(glsl,
+                                    cam->mat_vp.m,
+                                    u->mat_model.m, u->mat_m3x3.m,
+                                    lit->mat_bias_vp.m,
+                                    cam->mat_view_inv.m,
+                                    &light_pos);
+        unit_mesh_normalmap_draw(u, p->sub, glsl);
+        break;
+      }
+      case SCN_DRAW_UNIT_INST: {
+        /* the model matrices come from the instance attributes */
+        const unit *u = (const unit *)p->obj;
+        scn_map_to_normalmap_shader(glsl,
+                                    cam->mat_vp.m,
+                                    u->mat_model.m, u->mat_m3x3.m,
+                                    lit->mat_bias_vp.m,
+                                    cam->mat_view_inv.m,
+                                    &light_pos);
+        unit_mesh_normalmap_draw_inst(u, p->sub, glsl);
+        break;
+      }
+      case SCN_DRAW_AAMESH: {
+        const unit *u = (const unit *)p->obj;
+        aamesh_draw(u->aamsh, u->model->o_aamsh, cam, &sys->colors[u->color], glsl);
+        break;
+      }
     }
   }
-}
\ No newline at end of file
+
+  if(cur_pass == SCN_PASS_BLEND)
+    ogl_disable(GL_BLEND);
+}
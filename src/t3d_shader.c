@@ -5,6 +5,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <t3d_ogl.h>
 #include <t3d_util.h>
 #include <t3d_math.h>
@@ -21,20 +22,42 @@ shd_new( void )
   s->attri_v_normal = 1;
   s->attri_v_tangent = 2;
   s->attri_v_texcoord = 3;
+  s->attri_i_model = 4;
+  s->attri_v_color = 9;
+  s->attri_i_layer = 8;
+
+  s->prog_normal_inst = NULL;
+  s->prog_light_inst = NULL;
+  s->prog_normal_array = NULL;
+  s->prog_normal_inst_array = NULL;
+
+  s->current = NULL;
 
   return s;
 }
 
+/* delete a glsl program */
+static void
+shd_prog_del( shdprog *prog )
+{
+  if(!prog)  return;
+
+  ogl_delete_program(prog->handle);
+  free(prog);
+}
+
 /* delete a shader from memory */
 void
 shd_del( shader *s )
 {
-  glDeleteProgram(s->prog_normal_pass);
-  glDeleteProgram(s->prog_light_pass);
-  glDeleteProgram(s->prog_font);
-  glDeleteProgram(s->prog_box2d);
-  glDeleteProgram(s->prog_aamesh);
-  glDeleteProgram(s->prog_minimap);
+  shd_prog_del(s->prog_normal_pass);
+  shd_prog_del(s->prog_light_pass);
+  shd_prog_del(s->prog_aamesh);
+  shd_prog_del(s->prog_overlay);
+  shd_prog_del(s->prog_normal_inst);
+  shd_prog_del(s->prog_light_inst);
+  shd_prog_del(s->prog_normal_array);
+  shd_prog_del(s->prog_normal_inst_array);
   free(s);
 }
 
@@ -58,30 +81,52 @@ shd_compile( const char* source, const GLenum type )
   return handle;
 }
 
-/* load the vertex and fragment shaders */
-GLuint
+/* uniform names, in the order of the SHD_* enum */
+static const char *shd_uniform_names[SHD_N_UNIFORMS] = {
+  "vp",
+  "m",
+  "m3x3_inv_transp",
+  "lvp",
+  "bias_lvp",
+  "mvp",
+  "tex_offset",
+  "v_inv",
+  "diffmap",
+  "normmap",
+  "specmap",
+  "shadmap",
+  "light_pos",
+  "onecolor",
+  "mode"
+};
+
+/* load the vertex and fragment shaders, link and resolve the uniform locations */
+shdprog *
 shd_load( const char *vert_file, const char *frag_file )
 {
   GLuint handle = glCreateProgram();
   GLint link_status;
 
   if(vert_file && strlen(vert_file)) {
-    char *vert_src = util_file_to_mem(vert_file);
+    const char *vert_src = util_file_view(vert_file, NULL);
     GLuint vert_shader = shd_compile(vert_src, GL_VERTEX_SHADER);
     glAttachShader(handle, vert_shader);
-    free(vert_src);
+    util_file_release(vert_src);
   }
   if(frag_file && strlen(frag_file)) {
-    char *frag_src = util_file_to_mem(frag_file);
+    const char *frag_src = util_file_view(frag_file, NULL);
     GLuint frag_shader = shd_compile(frag_src, GL_FRAGMENT_SHADER);
     glAttachShader(handle, frag_shader);
-    free(frag_src);
+    util_file_release(frag_src);
   }
 
   glBindAttribLocation(handle, 0, "v_coord");
   glBindAttribLocation(handle, 1, "v_normal");
   glBindAttribLocation(handle, 2, "v_tangent");
   glBindAttribLocation(handle, 3, "v_texcoord");
+  glBindAttribLocation(handle, 4, "i_m");  /* mat4, takes 4 to 7 */
+  glBindAttribLocation(handle, 8, "i_layer");
+  glBindAttribLocation(handle, 9, "v_color");  /* apart from i_m, the divisors are global */
 
   glLinkProgram(handle);
   glGetProgramiv(handle, GL_LINK_STATUS, &link_status);
@@ -92,34 +137,80 @@ shd_load( const char *vert_file, const char *frag_file )
     exit(EXIT_FAILURE);
   }
 
-  return handle;
+  shdprog *prog = (shdprog *)malloc(sizeof(shdprog));
+  prog->handle = handle;
+
+  int i;
+  for(i = 0; i < SHD_N_UNIFORMS; i++) {
+    prog->locations[i] = glGetUniformLocation(handle, shd_uniform_names[i]);
+    prog->known[i] = 0;
+  }
+
+  return prog;
+}
+
+/* make program current, the shd_uniform_* calls go to it */
+void
+shd_set( shader *s, shdprog *prog )
+{
+  ogl_use_program(prog->handle);
+  s->current = prog;
+}
+
+/* return 1 if the uniform exists and v differs from its last upload,
+   which then becomes v */
+static int
+shd_uniform_changed( shdprog *prog, const int uniform, const GLfloat *v, const int n )
+{
+  if(prog->locations[uniform] < 0)  return 0;
+
+  if(prog->known[uniform] &&
+     memcmp(prog->values[uniform], v, sizeof(GLfloat)*n) == 0)  return 0;
+
+  memcpy(prog->values[uniform], v, sizeof(GLfloat)*n);
+  prog->known[uniform] = 1;
+  return 1;
 }
 
-/* map to glsl attributes, uniforms for normalmap shader */
+/* set uniforms of the current program, unchanged values are not uploaded */
 void
-shd_set( shader *s, const GLuint program )
+shd_uniform_1i( shader *s, const int uniform, const GLint v )
 {
-  /*----------------------- vertex shader -----------------------------------*/
-  s->uniform_vp = glGetUniformLocation(program, "vp");
-  //s->uniform_v = glGetUniformLocation(program, "v");
-  s->uniform_m = glGetUniformLocation(program, "m");
-  s->uniform_m3x3_inv_transp = glGetUniformLocation(program, "m3x3_inv_transp");
+  GLfloat f = (GLfloat)v;   /* texture unit numbers, exact as float */
+
+  if(shd_uniform_changed(s->current, uniform, &f, 1))
+    glUniform1i(s->current->locations[uniform], v);
+}
 
-  s->uniform_lvp = glGetUniformLocation(program, "lvp");
-  s->uniform_bias_lvp = glGetUniformLocation(program, "bias_lvp");
+void
+shd_uniform_2f( shader *s, const int uniform, const GLfloat x, const GLfloat y )
+{
+  GLfloat v[2] = { x, y };
 
-  s->uniform_mvp = glGetUniformLocation(program, "mvp");
+  if(shd_uniform_changed(s->current, uniform, v, 2))
+    glUniform2f(s->current->locations[uniform], x, y);
+}
 
-  s->uniform_tex_offset = glGetUniformLocation(program, "tex_offset");
+void
+shd_uniform_4f( shader *s, const int uniform,
+                const GLfloat x, const GLfloat y, const GLfloat z, const GLfloat w )
+{
+  GLfloat v[4] = { x, y, z, w };
 
-  /*----------------------- fragment shader ----------------------------------*/
-  s->uniform_v_inv = glGetUniformLocation(program, "v_inv");
+  if(shd_uniform_changed(s->current, uniform, v, 4))
+    glUniform4f(s->current->locations[uniform], x, y, z, w);
+}
 
-  s->uniform_diffmap = glGetUniformLocation(program, "diffmap");
-  s->uniform_normmap = glGetUniformLocation(program, "normmap");
-  s->uniform_specmap = glGetUniformLocation(program, "specmap");
-  s->uniform_shadmap = glGetUniformLocation(program, "shadmap");
+void
+shd_uniform_matrix3( shader *s, const int uniform, const GLfloat *m )
+{
+  if(shd_uniform_changed(s->current, uniform, m, 9))
+    glUniformMatrix3fv(s->current->locations[uniform], 1, GL_FALSE, m);
+}
 
-  s->uniform_light_coord = glGetUniformLocation(program, "light_pos");
-  s->uniform_onecolor = glGetUniformLocation(program, "onecolor");
+void
+shd_uniform_matrix4( shader *s, const int uniform, const GLfloat *m )
+{
+  if(shd_uniform_changed(s->current, uniform, m, 16))
+    glUniformMatrix4fv(s->current->locations[uniform], 1, GL_FALSE, m);
 }
\ No newline at end of file
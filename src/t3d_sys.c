@@ -5,6 +5,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 #include <t3d_ogl.h>
 #include <t3d_util.h>
 #include <t3d_timer.h>
@@ -13,42 +15,113 @@
 #include <t3d_hashtable.h>
 #include <t3d_slist.h>
 #include <t3d_texture.h>
+#include <t3d_thpool.h>
+#include <t3d_texstream.h>
+#include <t3d_loader.h>
 #include <t3d_object.h>
 #include <t3d_camera.h>
 #include <t3d_ms3d.h>
+#include <t3d_ms3dmesh.h>
 #include <t3d_decal.h>
 #include <t3d_aamesh.h>
 #include <t3d_unit.h>
 #include <t3d_heightmap.h>
 #include <t3d_patchmap.h>
+#include <t3d_astar.h>
+#include <t3d_hpa.h>
+#include <t3d_pathsvc.h>
 #include <t3d_pick.h>
 #include <t3d_sys.h>
 
 
-/* load textures from a file which contains all the texture names */
+/* a texture of the list, decoded by a worker */
+typedef struct __sys_texjob {
+  char path[256];
+  int s3tc_compressed;
+  teximage *img;
+  int decoded;
+
+  pthread_mutex_t *lock;
+  pthread_cond_t *notify;
+} sys_texjob;
+
+/* worker - the CPU half of tex_load */
+static void
+sys_tex_decode_job( void *arg )
+{
+  sys_texjob *job = (sys_texjob *)arg;
+  teximage *img = tex_decode(job->path, job->s3tc_compressed);
+
+  pthread_mutex_lock(job->lock);
+  job->img = img;
+  job->decoded = 1;
+  pthread_cond_signal(job->notify);
+  pthread_mutex_unlock(job->lock);
+}
+
+/* load textures from a file which contains all the texture names, with a
+   texture stream only their coarse levels are uploaded */
 static hashtable *
-sys_texdb_new( const char *listfile )
+sys_texdb_new( const char *listfile, texstream *texstm )
 {
   int i;
   char line[256];
+  pthread_mutex_t lock;
+  pthread_cond_t notify;
 
   vector *v = vector_new(sizeof(line));
   util_file_to_vector(v, listfile);
 
   hashtable *texdb = hash_new(v->size);
   GLuint *tex_ids = (GLuint *)malloc(sizeof(GLuint)*v->size);
+  sys_texjob *jobs = (sys_texjob *)malloc(sizeof(sys_texjob)*v->size);
+
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&notify, NULL);
+
+  /* decoding, mipmapping and DXT compression run on every core,
+     the GL uploads stay on this thread */
+  thpool *pool = thpool_new(util_cpu_count(), v->size > 0 ? v->size : 1);
 
   for(i = 0; i < v->size; i++) {
     char *texinfo = vector_at(v, i);    /* texinfo has the directory information */
+    sys_texjob *job = &jobs[i];
 
-    char path[256];
-    int s3tc_compressed;
-    sscanf(texinfo, "%s %d", path, &s3tc_compressed);
-    tex_ids[i] = tex_load(path, s3tc_compressed);
+    sscanf(texinfo, "%s %d", job->path, &job->s3tc_compressed);
+    job->img = NULL;
+    job->decoded = 0;
+    job->lock = &lock;
+    job->notify = &notify;
+
+    if(!pool || thpool_add_job(pool, &sys_tex_decode_job, job, 0) != 0)
+      sys_tex_decode_job(job);
+  }
 
-    util_add_basename_to_hash(texdb, path, &tex_ids[i], sizeof(GLuint));
+  /* upload in list order while the rest is still decoding */
+  for(i = 0; i < v->size; i++) {
+    sys_texjob *job = &jobs[i];
+
+    pthread_mutex_lock(&lock);
+    while(!job->decoded)
+      pthread_cond_wait(&notify, &lock);
+    pthread_mutex_unlock(&lock);
+
+    if(texstm) {
+      tex_ids[i] = tex_stream_add(texstm, job->img);
+    }
+    else {
+      tex_ids[i] = tex_upload(job->img);
+      tex_image_del(job->img);
+    }
+
+    util_add_basename_to_hash(texdb, job->path, &tex_ids[i], sizeof(GLuint));
   }
 
+  if(pool)  thpool_del(pool, THPOOL_GRACEFUL);
+  pthread_cond_destroy(&notify);
+  pthread_mutex_destroy(&lock);
+
+  free(jobs);
   free(tex_ids);
   vector_del(v);
   return texdb;
@@ -58,20 +131,139 @@ sys_texdb_new( const char *listfile )
 static void
 sys_texdb_del( hashtable *texdb )
 {
-  GLuint tex_id = 1;
+  unsigned int handle;
 
-  int i;
-  for(i = 0; i < texdb->nchains; i++) {
-    glDeleteTextures(1, &tex_id);
-    tex_id++;
+  /* the ids stored, the runtime loads are not numbered after the list */
+  for(handle = 1; handle <= hash_count(texdb); handle++) {
+    const GLuint *tex_id = hash_at(texdb, handle);
+    if(tex_id)  ogl_delete_textures(1, tex_id);
   }
 
   hash_del(texdb);
 }
 
+/* add a 1 x 1 texture to texture db */
+static void
+sys_texdb_add_solid( hashtable *texdb, const char *name, const unsigned char *rgba )
+{
+  GLuint tex_id = tex_gen_solid(rgba);
+  hash_add(texdb, name, &tex_id, sizeof(GLuint));
+}
+
+/* a texture list entry, to decode the texture again */
+typedef struct __sys_texpath {
+  char path[256];
+  int s3tc_compressed;
+} sys_texpath;
+
+/* load the texture list entries by texture name */
+static hashtable *
+sys_texpathdb_new( const char *listfile )
+{
+  int i;
+  char line[256];
+
+  vector *v = vector_new(sizeof(line));
+  util_file_to_vector(v, listfile);
+
+  hashtable *texpathdb = hash_new(v->size);
+
+  for(i = 0; i < v->size; i++) {
+    char *texinfo = vector_at(v, i);
+    sys_texpath tp;
+
+    sscanf(texinfo, "%s %d", tp.path, &tp.s3tc_compressed);
+    util_add_basename_to_hash(texpathdb, tp.path, &tp, sizeof(sys_texpath));
+  }
+
+  vector_del(v);
+  return texpathdb;
+}
+
+/* pack the first n_layers skin variants of a model into a diffuse, normalmap and
+   specular texture array per mesh, the layer of a variant is its skin index.
+   the images come from the texture stream, decoded again only without it */
+static void
+sys_skin_arrays_new( ms3d *m, const int skin_stride, const int n_layers,
+                     const hashtable *texdb, const texstream *texstm, const hashtable *texpathdb )
+{
+  int i, k, v;
+
+  if(skin_stride < 1 || n_layers < 1 || n_layers > SYS_MAX_SKIN_LAYERS)  return;
+
+  /* every variant needs the 3 maps of each mesh material */
+  for(i = 0; i < m->n_mshs; i++) {
+    int material = (int)m->o_mshs[i]->material_index;
+    if(material < 0 || (n_layers - 1)*skin_stride + material + 2 >= m->n_skins)  return;
+  }
+
+  GLuint *arrays = (GLuint *)calloc(m->n_mshs*3, sizeof(GLuint));
+
+  for(i = 0; i < m->n_mshs; i++) {
+    int material = (int)m->o_mshs[i]->material_index;
+
+    for(k = 0; k < 3; k++) {
+      const teximage *imgs[SYS_MAX_SKIN_LAYERS];
+      const char *first = m->o_skins[material + k].texture;
+      int n = 1;
+
+      /* a map shared by every variant is packed once, the layer is clamped to it */
+      for(v = 1; v < n_layers; v++) {
+        if(strcmp(m->o_skins[v*skin_stride + material + k].texture, first) != 0) {
+          n = n_layers;
+          break;
+        }
+      }
+
+      for(v = 0; v < n; v++) {
+        const char *texture = m->o_skins[v*skin_stride + material + k].texture;
+        const GLuint *id = hash_get(texdb, texture);
+        const sys_texpath *tp = texpathdb ? hash_get(texpathdb, texture) : NULL;
+
+        if(texstm)
+          imgs[v] = id ? tex_stream_image(texstm, *id) : NULL;
+        else
+          imgs[v] = tp ? tex_decode(tp->path, tp->s3tc_compressed) : NULL;
+      }
+
+      /* the skins must be the same size, else the units keep their texture sets */
+      GLuint tex_id = tex_array_upload(imgs, n);
+      if(!texstm) {
+        for(v = 0; v < n; v++)
+          tex_image_del((teximage *)imgs[v]);
+      }
+
+      if(!tex_id) {
+        ogl_delete_textures(m->n_mshs*3, arrays);
+        free(arrays);
+        return;
+      }
+
+      tex_set_array_flags(tex_id, k == 1 ? TEX_USE_LINEAR|TEX_TO_BORDER : TEX_USE_MIPMAPS|TEX_TO_BORDER);
+      arrays[i*3 + k] = tex_id;
+    }
+  }
+
+  m->skin_arrays = arrays;
+  m->skin_stride = skin_stride;
+  m->n_skin_layers = n_layers;
+}
+
+/* set the AABBox of a model and the radius of its footprint */
+static void
+sys_model_set_bounds( ms3d *m, const vec3 *aabb_min, const vec3 *aabb_max )
+{
+  vec3_cpy(&m->aabb_min, aabb_min);
+  vec3_cpy(&m->aabb_max, aabb_max);
+
+  float len_x = aabb_max->x - aabb_min->x;
+  float len_y = aabb_max->z - aabb_min->z;
+  m->radius = sqrtf(len_x*len_x + len_y*len_y)*0.5;
+}
+
 /* load models from a file which contains all the model names */
 static ms3d **
-sys_models_new( unsigned int *n_models, const hashtable *texdb, const char *listfile )
+sys_models_new( unsigned int *n_models, const char *listfile )
 {
   int i;
   char line[512];
@@ -85,27 +277,14 @@ sys_models_new( unsigned int *n_models, const hashtable *texdb, const char *list
     char *modelinfo = vector_at(v, i);     /* modelinfo has the directory information */
 
     char path[256];
-    float min_x, min_y, min_z;
-    float max_x, max_y, max_z;
-    sscanf(modelinfo, "%s %f %f %f %f %f %f", path, &min_x, &min_y, &min_z, &max_x, &max_y, &max_z);
-
-    unsigned char *buf = (unsigned char *)util_file_to_mem(path);
-    models[i] = ms3d_new(buf, texdb);
-    vec3_set(&models[i]->aabb_min, min_x, min_y, min_z);
-    vec3_set(&models[i]->aabb_max, max_x, max_y, max_z);
-
-    float len_x = max_x - min_x;
-    float len_y = max_z - min_z;
-    models[i]->radius = sqrtf(len_x*len_x + len_y*len_y)*0.5;
-
-    free(buf);
-
-    /* load ms3d animation */
-    strcat(path, ".anim");
-    vector *anicmd_strs = vector_new(sizeof(line));
-    util_file_to_vector(anicmd_strs, path);
-    models[i]->anim_cmds = ms3d_animcmd_new(&models[i]->n_cmds, anicmd_strs);
-    vector_del(anicmd_strs);
+    vec3 aabb_min, aabb_max;
+    sscanf(modelinfo, "%s %f %f %f %f %f %f", path,
+           &aabb_min.x, &aabb_min.y, &aabb_min.z, &aabb_max.x, &aabb_max.y, &aabb_max.z);
+
+    /* the cooked model (see tools/t3dcook) needs no parsing, only its upload */
+    models[i] = ms3d_load(path);
+    ms3d_upload(models[i]);
+    sys_model_set_bounds(models[i], &aabb_min, &aabb_max);
   }
 
   *n_models = v->size;
@@ -160,6 +339,96 @@ sys_modeldb_del( hashtable *modeldb )
   hash_del(modeldb);
 }
 
+/* a texture of texture db, or loaded in the background showing rgba till then */
+static GLuint
+sys_request_texture_as( t3dsys *sys, const char *path, const int s3tc_compressed,
+                        const unsigned char *rgba )
+{
+  char name[128];
+
+  util_get_fname(name, path);
+  const GLuint *tex_id = hash_get(sys->texdb, name);
+  if(tex_id)  return *tex_id;
+
+  GLuint new_id = ldr_texture(sys->ldr, path, s3tc_compressed, rgba);
+  hash_add(sys->texdb, name, &new_id, sizeof(GLuint));
+
+  return new_id;
+}
+
+/* loader - a requested model is uploaded, swap it in for its box */
+static void
+sys_model_ready( ldrjob *job )
+{
+  /* the placeholder colors of the diffuse, normalmap and specular skins */
+  static const unsigned char placeholders[3][4] = {
+    { 128, 128, 128, 255 }, { 128, 128, 255, 255 }, { 0, 0, 0, 255 }
+  };
+  t3dsys *sys = (t3dsys *)job->data;
+  unsigned int model_id = (unsigned int)job->key;
+  ms3d *proxy = sys->models[model_id];
+  ms3d *m = job->model;
+  int i;
+
+  /* the box stays if the model failed, or its first skin misses a map */
+  if(!m)  return;
+  for(i = 0; i < m->n_mshs; i++) {
+    int material = (int)m->o_mshs[i]->material_index;
+    if(material < 0 || material + 2 >= m->n_skins) {
+      fprintf(stderr, "Model %s has no skin for each mesh\n", job->path);
+      return;
+    }
+  }
+  job->model = NULL;
+
+  vec3_cpy(&m->aabb_min, &proxy->aabb_min);
+  vec3_cpy(&m->aabb_max, &proxy->aabb_max);
+  m->radius = proxy->radius;
+  m->o_aamsh = proxy->o_aamsh;
+  proxy->o_aamsh = NULL;
+
+  /* the skins not in texture db come from textures/ */
+  for(i = 0; i < m->n_skins; i++) {
+    char path[256];
+    snprintf(path, sizeof(path), "textures/%s", m->o_skins[i].texture);
+    sys_request_texture_as(sys, path, 1, placeholders[i%3]);
+  }
+
+  sys->models[model_id] = m;
+  sys->model_loading[model_id] = 0;
+
+  /* the units spawned as boxes take the model and their skins */
+  patchmap *pchmap = sys->pchmap;
+  int n = 0;
+  for(i = 0; i < sys->n_spawns; i++) {
+    sysspawn *sp = &sys->spawns[i];
+    if(sp->model_id != model_id) {
+      sys->spawns[n++] = *sp;
+      continue;
+    }
+
+    unit *u = sp->u;
+    unit_set_model(u, sys->models, model_id);
+
+    /* a skin past the model skins falls back to the first */
+    int skin_index = sp->skin_index;
+    int j;
+    for(j = 0; j < m->n_mshs; j++) {
+      int material = (int)m->o_mshs[j]->material_index;
+      if(material < 0 || skin_index*sp->skin_stride + material + 2 >= m->n_skins)
+        skin_index = 0;
+    }
+    unit_set_skin(u, skin_index, sp->skin_stride, sys->texdb);
+
+    aamesh_set_tex(u->aamsh, sys->texdb);
+    aamesh_get_mesh(u->aamsh, m->o_aamsh, u->ipos.x, u->ipos.y, pchmap);
+    aamesh_tex_offset(u->aamsh, m->o_aamsh, u->pos.x, u->pos.z, pchmap->step);
+  }
+  sys->n_spawns = n;
+
+  ms3d_del(proxy);
+}
+
 /* create a new system struct in memory */
 t3dsys *
 sys_new( void )
@@ -176,14 +445,33 @@ sys_new( void )
   vec4_set(&sys->colors[7], 1.0, 0.0, 1.0, 1.0);  /* pink */
 
   /* create texture database */
-  sys->texdb = sys_texdb_new("texture_list.txt");
+  sys->texstm = SYS_TEX_BUDGET > 0 ? tex_stream_new(SYS_TEX_BUDGET) : NULL;
+  sys->texdb = sys_texdb_new("texture_list.txt", sys->texstm);
+
+  /* what the models still loading show */
+  static const unsigned char proxy_diffuse[4] = { 128, 128, 128, 255 };
+  static const unsigned char proxy_normalmap[4] = { 128, 128, 255, 255 };
+  static const unsigned char proxy_specular[4] = { 0, 0, 0, 255 };
+  sys_texdb_add_solid(sys->texdb, SYS_PROXY_DIFFUSE, proxy_diffuse);
+  sys_texdb_add_solid(sys->texdb, SYS_PROXY_NORMALMAP, proxy_normalmap);
+  sys_texdb_add_solid(sys->texdb, SYS_PROXY_SPECULAR, proxy_specular);
+  sys->ldr = ldr_new(sys->texstm);
 
   /* create patchmap */
   sys->pchmap = pchmap_new("maps/terrain.png", 9, 9, 25.0, 1.0, sys->texdb);
+  /* built over the geopatches, a patch is rebuilt when one of its cells changes */
+  sys->pathgraph = hpa_new(sys->pchmap);
+  hpa_update(sys->pathgraph, sys->pchmap);
+  sys->pathsvc = psv_new(sys->pathgraph, sys->pchmap);
 
   /* create ms3d models */
-  sys->models = sys_models_new(&sys->n_models, sys->texdb, "model_list.txt");
+  sys->models = sys_models_new(&sys->n_models, "model_list.txt");
   sys->modeldb = sys_modeldb_new("model_list.txt");
+  sys->model_loading = (unsigned char *)calloc(sys->n_models + 1, sizeof(unsigned char));
+
+  sys->spawns_capacity = 8;
+  sys->spawns = (sysspawn *)malloc(sizeof(sysspawn)*sys->spawns_capacity);
+  sys->n_spawns = 0;
 
 
   patchmap *pchmap = sys->pchmap;
@@ -194,78 +482,59 @@ sys_new( void )
     model->o_aamsh = decal_new(model->radius, pchmap->step);
   }
 
+  /* the units on the map at start */
+  static const struct {
+    const char *model;
+    int skin_index;
+    int skin_stride;
+    int color;
+    float x, z;
+    float lookat_x, lookat_z;
+    float move_speed;
+  } spawns[] = {
+    { "beast.ms3d", 2, 3, CLR_RED, 358.0, 358.0, 158.0, 588.0, 0.118 },
+    { "dwarf.ms3d", 0, 6, CLR_GREEN, 280.0, 518.0, 58.0, 280.0, 0.08 },
+    { "beast.ms3d", 3, 3, CLR_BLUE, 378.0, 758.0, 180.0, 388.0, 0.118 },
+    { "dwarf.ms3d", 1, 6, CLR_YELLOW, 278.0, 638.0, 380.0, 380.0, 0.08 }
+  };
+  int n_spawns = (int)(sizeof(spawns)/sizeof(spawns[0]));
+  int j;
+
+  /* pack the skins of each model up to the last one its units wear, with the
+     skin stride of its first unit. the 2d textures stay in the texdb for the
+     skins past the layers, with the stream only their coarse levels are resident */
+  if(SYS_SKIN_ARRAYS && ogl_has_texture_arrays()) {
+    hashtable *texpathdb = sys->texstm ? NULL : sys_texpathdb_new("texture_list.txt");
+
+    for(i = 0; i < n_spawns; i++) {
+      const unsigned int *id = hash_get(sys->modeldb, spawns[i].model);
+      if(!id || sys->models[*id]->skin_arrays)  continue;
+
+      int n_layers = 0;
+      for(j = 0; j < n_spawns; j++) {
+        if(strcmp(spawns[j].model, spawns[i].model) == 0 &&
+           spawns[j].skin_stride == spawns[i].skin_stride && spawns[j].skin_index >= n_layers)
+          n_layers = spawns[j].skin_index + 1;
+      }
+
+      sys_skin_arrays_new(sys->models[*id], spawns[i].skin_stride, n_layers,
+                          sys->texdb, sys->texstm, texpathdb);
+    }
+
+    if(texpathdb)  hash_del(texpathdb);
+  }
+
   /* create units */
   sys->units = list_new();
-  const unsigned int *model_id;
-  vec3 u_pos, u_lookat, forward;
-
-  vec3_set(&u_pos, 358.0, 0.0, 358.0);
-  vec3_set(&u_lookat, 158.0, 0.0, 588.0);
-  model_id = hash_get(sys->modeldb, "beast.ms3d");
-  unit *u0 = unit_new(sys->models, *model_id);
-  ms3d_set_anim(u0->ani, u0->model, 'N');
-  unit_set_skin(u0, 2, 3, sys->texdb);
-  u0->color = CLR_RED;
-  unit_set_pos(u0, &u_pos, pchmap);
-  obj_find_f_axis(&forward, &u_pos, &u_lookat);
-  unit_set_dir(u0, &forward);
-  ivec2_cpy(&u0->itarget, &u0->ipos);
-  aamesh_set_tex(u0->aamsh, sys->texdb);
-  aamesh_get_mesh(u0->aamsh, u0->model->o_aamsh, u0->ipos.x, u0->ipos.y, pchmap);
-  aamesh_tex_offset(u0->aamsh, u0->model->o_aamsh, u0->pos.x, u0->pos.z, pchmap->step);
-  u0->move_speed = 0.118;
-  list_push_back(sys->units, list_node_new(u0));
-
-  vec3_set(&u_pos, 280.0, 0.0, 518.0);
-  vec3_set(&u_lookat, 58.0, 0.0, 280.0);
-  model_id = hash_get(sys->modeldb, "dwarf.ms3d");
-  unit *u1 = unit_new(sys->models, *model_id);
-  ms3d_set_anim(u1->ani, u1->model, 'N');
-  unit_set_skin(u1, 0, 6, sys->texdb);
-  u1->color = CLR_GREEN;
-  unit_set_pos(u1, &u_pos, pchmap);
-  obj_find_f_axis(&forward, &u_pos, &u_lookat);
-  unit_set_dir(u1, &forward);
-  ivec2_cpy(&u1->itarget, &u1->ipos);
-  aamesh_set_tex(u1->aamsh, sys->texdb);
-  aamesh_get_mesh(u1->aamsh, u1->model->o_aamsh, u1->ipos.x, u1->ipos.y, pchmap);
-  aamesh_tex_offset(u1->aamsh, u1->model->o_aamsh, u1->pos.x, u1->pos.z, pchmap->step);
-  u1->move_speed = 0.08;
-  list_push_back(sys->units, list_node_new(u1));
-
-  vec3_set(&u_pos, 378.0, 0.0, 758.0);
-  vec3_set(&u_lookat, 180.0, 0.0, 388.0);
-  model_id = hash_get(sys->modeldb, "beast.ms3d");
-  unit *u2 = unit_new(sys->models, *model_id);
-  ms3d_set_anim(u2->ani, u2->model, 'N');
-  unit_set_skin(u2, 3, 3, sys->texdb);
-  u2->color = CLR_BLUE;
-  unit_set_pos(u2, &u_pos, pchmap);
-  obj_find_f_axis(&forward, &u_pos, &u_lookat);
-  unit_set_dir(u2, &forward);
-  ivec2_cpy(&u2->itarget, &u2->ipos);
-  aamesh_set_tex(u2->aamsh, sys->texdb);
-  aamesh_get_mesh(u2->aamsh, u2->model->o_aamsh, u2->ipos.x, u2->ipos.y, pchmap);
-  aamesh_tex_offset(u2->aamsh, u2->model->o_aamsh, u2->pos.x, u2->pos.z, pchmap->step);
-  u2->move_speed = 0.118;
-  list_push_back(sys->units, list_node_new(u2));
-
-  vec3_set(&u_pos, 278.0, 0.0, 638.0);
-  vec3_set(&u_lookat, 380.0, 0.0, 380.0);
-  model_id = hash_get(sys->modeldb, "dwarf.ms3d");
-  unit *u3 = unit_new(sys->models, *model_id);
-  ms3d_set_anim(u3->ani, u3->model, 'N');
-  unit_set_skin(u3, 1, 6, sys->texdb);
-  u3->color = CLR_YELLOW;
-  unit_set_pos(u3, &u_pos, pchmap);
-  obj_find_f_axis(&forward, &u_pos, &u_lookat);
-  unit_set_dir(u3, &forward);
-  ivec2_cpy(&u3->itarget, &u3->ipos);
-  aamesh_set_tex(u3->aamsh, sys->texdb);
-  aamesh_get_mesh(u3->aamsh, u3->model->o_aamsh, u3->ipos.x, u3->ipos.y, pchmap);
-  aamesh_tex_offset(u3->aamsh, u3->model->o_aamsh, u3->pos.x, u3->pos.z, pchmap->step);
-  u3->move_speed = 0.08;
-  list_push_back(sys->units, list_node_new(u3));
+  for(i = 0; i < n_spawns; i++) {
+    vec3 u_pos, u_lookat;
+
+    vec3_set(&u_pos, spawns[i].x, 0.0, spawns[i].z);
+    vec3_set(&u_lookat, spawns[i].lookat_x, 0.0, spawns[i].lookat_z);
+    sys_spawn_unit(sys, *(const unsigned int *)hash_get(sys->modeldb, spawns[i].model),
+                   spawns[i].skin_index, spawns[i].skin_stride, spawns[i].color,
+                   &u_pos, &u_lookat, spawns[i].move_speed);
+  }
   /* end of create units */
 
   sys->timer.start = (float)tmr_gettime();
@@ -273,6 +542,107 @@ sys_new( void )
   return sys;
 }
 
+/* decode the runtime loads, stream the textures and search the paths on a thread pool */
+void
+sys_set_thpool( t3dsys *sys, thpool *pool )
+{
+  tex_stream_set_thpool(sys->texstm, pool);
+  ldr_set_thpool(sys->ldr, pool);
+  psv_set_thpool(sys->pathsvc, pool);
+}
+
+/* the id of a texture, loaded in the background if it is new, a placeholder shows till then */
+GLuint
+sys_request_texture( t3dsys *sys, const char *path, const int s3tc_compressed )
+{
+  static const unsigned char gray[4] = { 128, 128, 128, 255 };
+  return sys_request_texture_as(sys, path, s3tc_compressed, gray);
+}
+
+/* add a unit of a model on the map, a model still loading swaps in when it is ready */
+unit *
+sys_spawn_unit( t3dsys *sys, const unsigned int model_id,
+                const int skin_index, const int skin_stride, const int color,
+                const vec3 *pos, const vec3 *lookat, const float move_speed )
+{
+  patchmap *pchmap = sys->pchmap;
+  vec3 forward;
+
+  unit *u = unit_new(sys->models, model_id);
+  ms3d_set_anim(u->ani, u->model, 'N');
+
+  if(sys->model_loading[model_id]) {
+    /* the box has the placeholder skin, the real one is set once loaded */
+    unit_set_skin(u, 0, 0, sys->texdb);
+
+    if(sys->n_spawns == sys->spawns_capacity) {
+      sys->spawns_capacity *= 2;
+      sys->spawns = (sysspawn *)realloc(sys->spawns, sizeof(sysspawn)*sys->spawns_capacity);
+    }
+    sysspawn *sp = &sys->spawns[sys->n_spawns++];
+    sp->u = u;
+    sp->model_id = model_id;
+    sp->skin_index = skin_index;
+    sp->skin_stride = skin_stride;
+  }
+  else {
+    unit_set_skin(u, skin_index, skin_stride, sys->texdb);
+  }
+
+  u->color = color;
+  unit_set_pos(u, pos, pchmap);
+  psv_set_status(sys->pathsvc, u->ipos.x, u->ipos.y, ASTAR_AVAIL);
+  obj_find_f_axis(&forward, pos, lookat);
+  unit_set_dir(u, &forward);
+  ivec2_cpy(&u->itarget, &u->ipos);
+  aamesh_set_tex(u->aamsh, sys->texdb);
+  aamesh_get_mesh(u->aamsh, u->model->o_aamsh, u->ipos.x, u->ipos.y, pchmap);
+  aamesh_tex_offset(u->aamsh, u->model->o_aamsh, u->pos.x, u->pos.z, pchmap->step);
+  u->move_speed = move_speed;
+  list_push_back(sys->units, list_node_new(u));
+
+  return u;
+}
+
+/* the id of a model, loaded in the background if it is new, a box of its AABBox
+   stands in till then */
+unsigned int
+sys_request_model( t3dsys *sys, const char *path,
+                   const vec3 *aabb_min, const vec3 *aabb_max )
+{
+  char name[128];
+
+  util_get_fname(name, path);
+  const unsigned int *id = hash_get(sys->modeldb, name);
+  if(id)  return *id;
+
+  unsigned int model_id = sys->n_models++;
+  sys->models = (ms3d **)realloc(sys->models, sizeof(ms3d *)*sys->n_models);
+  sys->model_loading = (unsigned char *)realloc(sys->model_loading, sys->n_models);
+
+  ms3d *proxy = ms3d_proxy_new(aabb_min, aabb_max,
+                               SYS_PROXY_DIFFUSE, SYS_PROXY_NORMALMAP, SYS_PROXY_SPECULAR);
+  sys_model_set_bounds(proxy, aabb_min, aabb_max);
+  ms3d_upload(proxy);
+  proxy->o_aamsh = decal_new(proxy->radius, sys->pchmap->step);
+
+  sys->models[model_id] = proxy;
+  sys->model_loading[model_id] = 1;
+  hash_add(sys->modeldb, name, &model_id, sizeof(unsigned int));
+
+  ldr_model(sys->ldr, path, sys_model_ready, sys, (int)model_id);
+
+  return model_id;
+}
+
+/* once a frame on the GL thread, not while the units update - upload the
+   runtime loads within the loader budget */
+void
+sys_update_loads( t3dsys *sys )
+{
+  ldr_update(sys->ldr);
+}
+
 static void
 sys_listnode_unit_del( listnode *node )
 {
@@ -285,6 +655,13 @@ sys_del( t3dsys *sys )
 {
   if(!sys) return;
 
+  /* the workers may still hold a load */
+  ldr_del(sys->ldr);
+  free(sys->spawns);
+  free(sys->model_loading);
+
+  psv_del(sys->pathsvc);
+  hpa_del(sys->pathgraph);
   pchmap_del(sys->pchmap);
 
   list_del(sys->units, sys_listnode_unit_del);
@@ -293,6 +670,7 @@ sys_del( t3dsys *sys )
   sys_modeldb_del(sys->modeldb);
 
   sys_texdb_del(sys->texdb);
+  tex_stream_del(sys->texstm);
 
   free(sys);
 }
\ No newline at end of file
@@ -0,0 +1,339 @@
+/*----- t3d_texstream.c ------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <t3d_ogl.h>
+#include <t3d_thpool.h>
+#include <t3d_texture.h>
+#include <t3d_texstream.h>
+
+
+/* create a texture stream in memory */
+texstream *
+tex_stream_new( const size_t budget )
+{
+  texstream *ts = (texstream *)malloc(sizeof(texstream));
+
+  ts->capacity = 64;
+  ts->textures = (streamtex **)malloc(sizeof(streamtex *)*ts->capacity);
+  ts->n_textures = 0;
+
+  ts->n_slots = 256;
+  ts->slots = (int *)calloc(ts->n_slots, sizeof(int));
+
+  if(!ts->textures || !ts->slots) {
+    fprintf(stderr, "line %d: Can not allocate memory\n", __LINE__);
+    exit(EXIT_FAILURE);
+  }
+
+  ts->budget = budget;
+  ts->resident = 0;
+  ts->reserved = 0;
+
+  /* 0 is never requested */
+  ts->frame = 1;
+  ts->max_uploads = 4;
+
+  ts->pool = NULL;
+  pthread_mutex_init(&ts->lock, NULL);
+
+  return ts;
+}
+
+/* delete a texture stream and its images from memory, not the GL textures */
+void
+tex_stream_del( texstream *ts )
+{
+  int i, j;
+
+  if(!ts)  return;
+
+  for(i = 0; i < ts->n_textures; i++) {
+    streamtex *st = ts->textures[i];
+    for(j = 0; j < TEX_MAX_LEVELS; j++)
+      free(st->staged[j]);
+    tex_image_del(st->img);
+    free(st);
+  }
+
+  pthread_mutex_destroy(&ts->lock);
+  free(ts->textures);
+  free(ts->slots);
+  free(ts);
+}
+
+/* fetch the higher levels on a thread pool */
+void
+tex_stream_set_thpool( texstream *ts, thpool *pool )
+{
+  if(ts)  ts->pool = pool;
+}
+
+/* the streamed texture of a GL id, NULL if it is not streamed */
+static streamtex *
+tex_stream_find( const texstream *ts, const GLuint tex_id )
+{
+  if(!ts || tex_id >= (GLuint)ts->n_slots || !ts->slots[tex_id])  return NULL;
+  return ts->textures[ts->slots[tex_id] - 1];
+}
+
+/* bytes of the levels [first, last) */
+static size_t
+tex_stream_bytes( const streamtex *st, const int first, const int last )
+{
+  size_t bytes = 0;
+  int i;
+
+  for(i = first; i < last; i++)
+    bytes += st->img->levels[i].size;
+
+  return bytes;
+}
+
+/* stream an image into a texture made before (e.g. a placeholder), only
+   its coarse levels are uploaded. the stream owns the image */
+GLuint
+tex_stream_attach( texstream *ts, const GLuint tex_id, teximage *img )
+{
+  int i;
+
+  if(!img)  return 0;
+
+  streamtex *st = (streamtex *)calloc(1, sizeof(streamtex));
+  st->tex_id = tex_id;
+  st->img = img;
+  st->ts = ts;
+
+  /* the first level small enough to stay */
+  st->coarse_base = img->n_levels - 1;
+  for(i = 0; i < img->n_levels; i++) {
+    const texlevel *lv = &img->levels[i];
+    if(lv->w <= TEX_STREAM_RESIDENT && lv->h <= TEX_STREAM_RESIDENT) {
+      st->coarse_base = i;
+      break;
+    }
+  }
+  st->base = st->coarse_base;
+  st->want = st->coarse_base;
+
+  ogl_bind_texture_for_upload(GL_TEXTURE_2D, tex_id);
+  /* whatever the texture held below the base goes */
+  for(i = 0; i < st->base; i++)
+    glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  for(i = st->base; i < img->n_levels; i++)
+    tex_upload_level(img, i, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, st->base);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, img->n_levels - 1);
+  ts->resident += tex_stream_bytes(st, st->base, img->n_levels);
+
+  if(ts->n_textures == ts->capacity) {
+    ts->capacity *= 2;
+    ts->textures = (streamtex **)realloc(ts->textures, sizeof(streamtex *)*ts->capacity);
+  }
+  ts->textures[ts->n_textures++] = st;
+
+  if(tex_id >= (GLuint)ts->n_slots) {
+    int n = ts->n_slots;
+    while(tex_id >= (GLuint)ts->n_slots)
+      ts->n_slots *= 2;
+    ts->slots = (int *)realloc(ts->slots, sizeof(int)*ts->n_slots);
+    memset(&ts->slots[n], 0, sizeof(int)*(ts->n_slots - n));
+  }
+  ts->slots[tex_id] = ts->n_textures;
+
+  return tex_id;
+}
+
+/* create a GL texture with the coarse levels of an image, the stream owns the image */
+GLuint
+tex_stream_add( texstream *ts, teximage *img )
+{
+  GLuint tex_id = 0;
+
+  if(!img)  return 0;
+
+  glGenTextures(1, &tex_id);
+  if(!tex_id) {
+    tex_image_del(img);
+    return 0;
+  }
+
+  return tex_stream_attach(ts, tex_id, img);
+}
+
+/* the draw code shows a texture screen_px pixels wide this frame */
+void
+tex_stream_request( texstream *ts, const GLuint tex_id, const float screen_px )
+{
+  streamtex *st = tex_stream_find(ts, tex_id);
+  if(!st || st->pinned)  return;
+
+  /* the coarsest level still at least as big as the screen footprint */
+  const texlevel *lv = &st->img->levels[0];
+  int size = lv->w > lv->h ? lv->w : lv->h;
+  int level = 0;
+  while(level < st->coarse_base && (float)(size >> (level + 1)) >= screen_px)
+    level++;
+
+  if(st->last_used != ts->frame || level < st->want)
+    st->want = level;
+  st->last_used = ts->frame;
+}
+
+/* keep every level of a texture resident (e.g. 2d overlays) */
+void
+tex_stream_pin( texstream *ts, const GLuint tex_id )
+{
+  streamtex *st = tex_stream_find(ts, tex_id);
+  if(!st)  return;
+
+  st->pinned = 1;
+  st->want = 0;
+}
+
+/* the image of a streamed texture, every level (mapped or in memory), NULL if it is not streamed */
+const teximage *
+tex_stream_image( const texstream *ts, const GLuint tex_id )
+{
+  const streamtex *st = tex_stream_find(ts, tex_id);
+  return st ? st->img : NULL;
+}
+
+/* worker - copy the mapped levels, the page faults happen here */
+static void
+tex_stream_fetch_job( void *arg )
+{
+  streamtex *st = (streamtex *)arg;
+  texstream *ts = st->ts;
+  int i;
+
+  for(i = st->fetch_base; i < st->base; i++) {
+    const texlevel *lv = &st->img->levels[i];
+    st->staged[i] = (unsigned char *)malloc(lv->size);
+    memcpy(st->staged[i], lv->data, lv->size);
+  }
+
+  pthread_mutex_lock(&ts->lock);
+  st->fetch_done = 1;
+  pthread_mutex_unlock(&ts->lock);
+}
+
+/* upload a finished fetch and lower the base level, return the levels uploaded */
+static int
+tex_stream_finish( texstream *ts, streamtex *st )
+{
+  int i;
+  int n = st->base - st->fetch_base;
+  size_t bytes = tex_stream_bytes(st, st->fetch_base, st->base);
+
+  ogl_bind_texture_for_upload(GL_TEXTURE_2D, st->tex_id);
+  for(i = st->fetch_base; i < st->base; i++) {
+    tex_upload_level(st->img, i, st->staged[i]);
+    free(st->staged[i]);
+    st->staged[i] = NULL;
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, st->fetch_base);
+
+  st->base = st->fetch_base;
+  st->fetching = 0;
+  st->fetch_done = 0;
+  ts->reserved -= bytes;
+  ts->resident += bytes;
+
+  return n;
+}
+
+/* drop the finest resident level of the least useful texture not drawn in
+   the frame keep_frame, return 0 if there is none */
+static int
+tex_stream_evict_one( texstream *ts, const unsigned int keep_frame )
+{
+  streamtex *victim = NULL;
+  int i;
+
+  for(i = 0; i < ts->n_textures; i++) {
+    streamtex *st = ts->textures[i];
+    if(st->pinned || st->fetching || st->base >= st->coarse_base)  continue;
+    if(st->last_used == keep_frame)  continue;
+
+    /* least recently used first, then the one holding the most unneeded levels */
+    if(!victim || st->last_used < victim->last_used ||
+       (st->last_used == victim->last_used && st->want - st->base > victim->want - victim->base))
+      victim = st;
+  }
+  if(!victim)  return 0;
+
+  ogl_bind_texture_for_upload(GL_TEXTURE_2D, victim->tex_id);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, victim->base + 1);
+  /* a 0 x 0 level gives its memory back */
+  glTexImage2D(GL_TEXTURE_2D, victim->base, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+  ts->resident -= victim->img->levels[victim->base].size;
+  victim->base++;
+
+  return 1;
+}
+
+/* once a frame on the GL thread - upload fetched levels, evict, start fetches */
+void
+tex_stream_update( texstream *ts )
+{
+  int i;
+
+  if(!ts)  return;
+
+  /* the requests of the frame just drawn */
+  unsigned int frame = ts->frame;
+  int uploads = 0;
+
+  /* upload what the workers fetched, a few levels a frame */
+  for(i = 0; i < ts->n_textures && uploads < ts->max_uploads; i++) {
+    streamtex *st = ts->textures[i];
+    if(!st->fetching)  continue;
+
+    pthread_mutex_lock(&ts->lock);
+    int done = st->fetch_done;
+    pthread_mutex_unlock(&ts->lock);
+
+    if(done)  uploads += tex_stream_finish(ts, st);
+  }
+
+  /* over budget (e.g. lowered at run time), drop what was not drawn */
+  while(ts->resident + ts->reserved > ts->budget && tex_stream_evict_one(ts, frame));
+
+  /* start the fetches of the textures drawn closer than their levels allow */
+  for(i = 0; i < ts->n_textures; i++) {
+    streamtex *st = ts->textures[i];
+    if(st->fetching)  continue;
+
+    int want = st->pinned ? 0 : st->want;
+    if(!st->pinned && st->last_used != frame)  continue;
+    if(want >= st->base)  continue;
+
+    /* make room from the textures not drawn, else fetch as much as fits */
+    size_t need = tex_stream_bytes(st, want, st->base);
+    while(ts->resident + ts->reserved + need > ts->budget && tex_stream_evict_one(ts, frame));
+    while(want < st->base && ts->resident + ts->reserved + need > ts->budget) {
+      need -= st->img->levels[want].size;
+      want++;
+    }
+    if(want >= st->base)  continue;
+
+    st->fetching = 1;
+    st->fetch_done = 0;
+    st->fetch_base = want;
+    ts->reserved += need;
+
+    /* levels in memory need no copy, mapped ones are paged in by a worker */
+    if(!st->img->mapping)
+      st->fetch_done = 1;
+    else if(!ts->pool || thpool_add_job(ts->pool, &tex_stream_fetch_job, st, 0) != 0)
+      tex_stream_fetch_job(st);
+  }
+
+  ts->frame++;
+}
@@ -3,458 +3,41 @@
     Revised date: 18th Jan, 2014
  +----------------------------------------------------------------------------*/
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <sys/stat.h>
 #include <stb_image.h>
 #include <t3d_ogl.h>
+#include <t3d_util.h>
+#include <t3d_dxt.h>
 #include <t3d_texture.h>
 
 
-static int
-convert_bit_range( const int c, const int from_bits, const int to_bits )
-{
-  int b = (1 << (from_bits - 1)) + c*((1 << to_bits) - 1);
-  return (b + (b >> from_bits)) >> from_bits;
-}
-
-static int
-rgb_to_565( const int r, const int g, const int b )
-{
-  return (convert_bit_range(r, 8, 5) << 11) |
-         (convert_bit_range(g, 8, 6) << 05) |
-         (convert_bit_range(b, 8, 5) << 00);
-}
-
-static void rgb_888_from_565( const unsigned int c, int *r, int *g, int *b )
-{
-	*r = convert_bit_range((c >> 11) & 31, 5, 8);
-	*g = convert_bit_range((c >> 05) & 63, 6, 8);
-	*b = convert_bit_range((c >> 00) & 31, 5, 8);
-}
-
-static void
-compute_color_line_STDEV( const unsigned char *const uncompressed,
-                          const int channels,
-                          float point[3], float direction[3] )
-{
-  const float inv_16 = 1.0/16.0;
-  int i;
-  float sum_r  = 0.0, sum_g  = 0.0, sum_b  = 0.0;
-  float sum_rr = 0.0, sum_gg = 0.0, sum_bb = 0.0;
-  float sum_rg = 0.0, sum_rb = 0.0, sum_gb = 0.0;
-  /* calculate all data needed for the covariance matrix (to compare with _rygdxt code) */
-  for(i = 0; i < 16*channels; i += channels) {
-    sum_r  += uncompressed[i + 0];
-    sum_rr += uncompressed[i + 0]*uncompressed[i + 0];
-    sum_g  += uncompressed[i + 1];
-    sum_gg += uncompressed[i + 1]*uncompressed[i + 1];
-    sum_b  += uncompressed[i + 2];
-    sum_bb += uncompressed[i + 2]*uncompressed[i + 2];
-    sum_rg += uncompressed[i + 0]*uncompressed[i + 1];
-    sum_rb += uncompressed[i + 0]*uncompressed[i + 2];
-    sum_gb += uncompressed[i + 1]*uncompressed[i + 2];
-  }
-  /* convert the sums to averages */
-  sum_r *= inv_16;
-  sum_g *= inv_16;
-  sum_b *= inv_16;
-  /* and convert the squares to the squares of the value - avg_value	*/
-  sum_rr -= 16.0*sum_r*sum_r;
-  sum_gg -= 16.0*sum_g*sum_g;
-  sum_bb -= 16.0*sum_b*sum_b;
-  sum_rg -= 16.0*sum_r*sum_g;
-  sum_rb -= 16.0*sum_r*sum_b;
-  sum_gb -= 16.0*sum_g*sum_b;
-  /* the point on the color line is the average */
-  point[0] = sum_r;
-  point[1] = sum_g;
-  point[2] = sum_b;
-  #if USE_COV_MAT
-  /*
-    The following idea was from ryg.
-    (https://mollyrocket.com/forums/viewtopic.php?t=392)
-    The method worked great (less RMSE than mine) most of
-    the time, but had some issues handling some simple
-    boundary cases, like full green next to full red,
-    which would generate a covariance matrix like this:
-
-    |  1  -1  0 |
-    | -1   1  0 |
-    |  0   0  0 |
-
-    For a given starting vector, the power method can
-    generate all zeros!  So no starting with {1,1,1}
-    as I was doing!  This kind of error is still a
-    slight posibillity, but will be very rare.
-  */
-  /* use the covariance matrix directly (1st iteration, don't use all 1.0 values!) */
-  sum_r = 1.0;
-  sum_g = 2.718281828;
-  sum_b = 3.141592654;
-  direction[0] = sum_r*sum_rr + sum_g*sum_rg + sum_b*sum_rb;
-  direction[1] = sum_r*sum_rg + sum_g*sum_gg + sum_b*sum_gb;
-  direction[2] = sum_r*sum_rb + sum_g*sum_gb + sum_b*sum_bb;
-  /* 2nd iteration, use results from the 1st guy */
-  sum_r = direction[0];
-  sum_g = direction[1];
-  sum_b = direction[2];
-  direction[0] = sum_r*sum_rr + sum_g*sum_rg + sum_b*sum_rb;
-  direction[1] = sum_r*sum_rg + sum_g*sum_gg + sum_b*sum_gb;
-  direction[2] = sum_r*sum_rb + sum_g*sum_gb + sum_b*sum_bb;
-  /* 3rd iteration, use results from the 2nd guy */
-  sum_r = direction[0];
-  sum_g = direction[1];
-  sum_b = direction[2];
-  direction[0] = sum_r*sum_rr + sum_g*sum_rg + sum_b*sum_rb;
-  direction[1] = sum_r*sum_rg + sum_g*sum_gg + sum_b*sum_gb;
-  direction[2] = sum_r*sum_rb + sum_g*sum_gb + sum_b*sum_bb;
-	#else
-  /* use my standard deviation method (very robust, a tiny bit slower and less accurate) */
-  direction[0] = sqrtf(sum_rr);
-  direction[1] = sqrtf(sum_gg);
-  direction[2] = sqrtf(sum_bb);
-  /* which has a greater component */
-  if(sum_gg > sum_rr) {
-    /* green has greater component, so base the other signs off of green */
-    if(sum_rg < 0.0)  direction[0] = -direction[0];
-    if(sum_gb < 0.0)  direction[2] = -direction[2];
-  }
-  else {
-    /* red has a greater component */
-    if(sum_rg < 0.0)  direction[1] = -direction[1];
-		if(sum_rb < 0.0)  direction[2] = -direction[2];
-  }
-  #endif
-}
-
-static void
-LSE_master_colors_max_min( int *cmax, int *cmin,
-                           const int channels,
-                           const unsigned char *const uncompressed )
-{
-  int i, j;
-  /* the master colors */
-  int c0[3], c1[3];
-  /* used for fitting the line */
-  float sum_x[] = {0.0, 0.0, 0.0};
-  float sum_x2[] = {0.0, 0.0, 0.0};
-  float dot_max = 1.0, dot_min = -1.0;
-  float vec_len2 = 0.0;
-  float dot;
-  /* error check */
-  if((channels < 3) || (channels > 4))
-    return;
-
-  compute_color_line_STDEV(uncompressed, channels, sum_x, sum_x2);
-  vec_len2 = 1.0/(0.00001 + sum_x2[0]*sum_x2[0] + sum_x2[1]*sum_x2[1] + sum_x2[2]*sum_x2[2]);
-  /* finding the max and min vector values */
-  dot_max = sum_x2[0]*uncompressed[0] +
-            sum_x2[1]*uncompressed[1] +
-            sum_x2[2]*uncompressed[2];
-  dot_min = dot_max;
-  for(i = 1; i < 16; ++i) {
-    dot = sum_x2[0]*uncompressed[i*channels + 0] +
-          sum_x2[1]*uncompressed[i*channels + 1] +
-          sum_x2[2]*uncompressed[i*channels + 2];
-    if(dot < dot_min) {
-      dot_min = dot;
-    }
-    else if(dot > dot_max) {
-      dot_max = dot;
-    }
-  }
-  /* and the offset (from the average location) */
-  dot = sum_x2[0]*sum_x[0] + sum_x2[1]*sum_x[1] + sum_x2[2]*sum_x[2];
-  dot_min -= dot;
-  dot_max -= dot;
-  /* post multiply by the scaling factor */
-  dot_min *= vec_len2;
-  dot_max *= vec_len2;
-  /* OK, build the master colors */
-  for(i = 0; i < 3; ++i) {
-    /* color 0 */
-    c0[i] = (int)(0.5 + sum_x[i] + dot_max*sum_x2[i]);
-    if(c0[i] < 0) {
-      c0[i] = 0;
-    }
-    else if(c0[i] > 255) {
-      c0[i] = 255;
-    }
-    /* color 1 */
-    c1[i] = (int)(0.5 + sum_x[i] + dot_min*sum_x2[i]);
-    if(c1[i] < 0) {
-      c1[i] = 0;
-    }
-    else if(c1[i] > 255) {
-      c1[i] = 255;
-    }
-  }
-  /* down_sample (with rounding?) */
-  i = rgb_to_565(c0[0], c0[1], c0[2]);
-  j = rgb_to_565(c1[0], c1[1], c1[2]);
-  if(i > j) {
-    *cmax = i;
-    *cmin = j;
-  }
-  else {
-    *cmax = j;
-    *cmin = i;
-  }
-}
+#define TEX_CACHE_VERSION  2
 
-static void
-compress_DDS_color_block( const int channels,
-                          const unsigned char *const uncompressed,
-                          unsigned char compressed[8] )
-{
-  /* variables */
-  int i;
-  int next_bit;
-  int enc_c0 = 0, enc_c1 = 0;
-  int c0[4], c1[4];
-  float color_line[] = {0.0, 0.0, 0.0, 0.0};
-  float vec_len2 = 0.0, dot_offset = 0.0;
-  /* stupid order */
-  int swizzle4[] = {0, 2, 3, 1};
-  /* get the master colors */
-  LSE_master_colors_max_min(&enc_c0, &enc_c1, channels, uncompressed);
-  /* store the 565 color 0 and color 1 */
-  compressed[0] = (enc_c0 >> 0) & 255;
-  compressed[1] = (enc_c0 >> 8) & 255;
-  compressed[2] = (enc_c1 >> 0) & 255;
-  compressed[3] = (enc_c1 >> 8) & 255;
-  /* zero out the compressed data */
-  compressed[4] = 0;
-  compressed[5] = 0;
-  compressed[6] = 0;
-  compressed[7] = 0;
-  /* reconstitute the master color vectors */
-  rgb_888_from_565(enc_c0, &c0[0], &c0[1], &c0[2]);
-  rgb_888_from_565(enc_c1, &c1[0], &c1[1], &c1[2]);
-  /* the new vector */
-  vec_len2 = 0.0;
-  for(i = 0; i < 3; ++i) {
-    color_line[i] = (float)(c1[i] - c0[i]);
-    vec_len2 += color_line[i] * color_line[i];
-  }
-	if(vec_len2 > 0.0) {
-    vec_len2 = 1.0/vec_len2;
-  }
-  /* pre-proform the scaling */
-  color_line[0] *= vec_len2;
-  color_line[1] *= vec_len2;
-  color_line[2] *= vec_len2;
-  /* compute the offset (constant) portion of the dot product	*/
-  dot_offset = color_line[0]*c0[0] + color_line[1]*c0[1] + color_line[2]*c0[2];
-  /* store the rest of the bits	*/
-  next_bit = 8*4;
-  for(i = 0; i < 16; ++i) {
-    /* find the dot product of this color, place it on the line (should be [-1,1])	*/
-    int next_value = 0;
-    float dot_product = color_line[0]*uncompressed[i*channels + 0] +
-                        color_line[1]*uncompressed[i*channels + 1] +
-                        color_line[2]*uncompressed[i*channels + 2] - dot_offset;
-    /* map to [0,3] */
-    next_value = (int)(dot_product*3.0 + 0.5);
-    if(next_value > 3) {
-      next_value = 3;
-    }
-    else if(next_value < 0) {
-      next_value = 0;
-    }
-    /* OK, store this value */
-    compressed[next_bit >> 3] |= swizzle4[next_value] << (next_bit & 7);
-    next_bit += 2;
-  }
-}
 
-static void
-compress_DDS_alpha_block( const unsigned char *const uncompressed,
-                          unsigned char compressed[8] )
-{
-  /* variables */
-  int i;
-  int next_bit;
-  int a0, a1;
-  float scale_me;
-  /* stupid order */
-  int swizzle8[] = { 1, 7, 6, 5, 4, 3, 2, 0 };
-  /* get the alpha limits (a0 > a1) */
-  a0 = a1 = uncompressed[3];
-  for(i = 4+3; i < 16*4; i += 4) {
-    if(uncompressed[i] > a0) {
-      a0 = uncompressed[i];
-    }
-    else if(uncompressed[i] < a1) {
-      a1 = uncompressed[i];
-    }
-  }
-  /* store those limits, and zero the rest of the compressed dataset */
-  compressed[0] = a0;
-  compressed[1] = a1;
-  /* zero out the compressed data */
-  compressed[2] = 0;
-  compressed[3] = 0;
-  compressed[4] = 0;
-  compressed[5] = 0;
-  compressed[6] = 0;
-  compressed[7] = 0;
-  /* store the all of the alpha values */
-  next_bit = 8*2;
-  scale_me = 7.9999/(a0 - a1);
-  for(i = 3; i < 16*4; i += 4) {
-    /* convert this alpha value to a 3 bit number */
-    int svalue;
-    int value = (int)((uncompressed[i] - a1)*scale_me);
-    svalue = swizzle8[value&7];
-    /* OK, store this value, start with the 1st byte */
-    compressed[next_bit >> 3] |= svalue << (next_bit & 7);
-    if((next_bit & 7) > 5) {
-      /* spans 2 bytes, fill in the start of the 2nd byte */
-      compressed[1 + (next_bit >> 3)] |= svalue >> (8 - (next_bit & 7));
-    }
-    next_bit += 3;
-  }
-}
+/* one level in a cache file */
+typedef struct __texcache_level {
+  int w, h;
+  int size;
+  int offset;               /* from the start of the file */
+} texcache_level;
 
-static unsigned char * 
-convert_img_to_DXT1( const unsigned char *const uncompressed,
-                     const int width, const int height, const int channels,
-                     int *out_size )
-{
-  unsigned char *compressed;
-  int i, j, x, y;
-  unsigned char ublock[16*3];
-  unsigned char cblock[8];
-  int index = 0, chan_step = 1;
-  int block_count = 0;
-  /* error check */
-  *out_size = 0;
-  if((width < 1) || (height < 1)|| (NULL == uncompressed) ||
-     (channels < 1) || (channels > 4)) {
-		return NULL;
-  }
-  /* for channels == 1 or 2, I do not step forward for R,G,B values	*/
-  if(channels < 3) {
-    chan_step = 0;
-  }
-  /* get the RAM for the compressed image (8 bytes per 4x4 pixel block) */
-  *out_size = ((width + 3) >> 2)*((height + 3) >> 2)*8;
-  compressed = (unsigned char *)malloc(*out_size);
-  /* go through each block */
-  for(j = 0; j < height; j += 4) {
-    for(i = 0; i < width; i += 4) {
-      /* copy this block into a new one */
-      int idx = 0;
-      int mx = 4, my = 4;
-      if(j + 4 >= height)  my = height - j;
-      if(i + 4 >= width)   mx = width - i;
-
-      for(y = 0; y < my; ++y) {
-        for(x = 0; x < mx; ++x) {
-          ublock[idx++] = uncompressed[(j + y)*width*channels + (i +x )*channels];
-          ublock[idx++] = uncompressed[(j + y)*width*channels + (i +x )*channels + chan_step];
-          ublock[idx++] = uncompressed[(j + y)*width*channels + (i +x )*channels + chan_step + chan_step];
-        }
-        for(x = mx; x < 4; ++x) {
-          ublock[idx++] = ublock[0];
-          ublock[idx++] = ublock[1];
-          ublock[idx++] = ublock[2];
-        }
-      }
-      for(y = my; y < 4; ++y) {
-        for(x = 0; x < 4; ++x) {
-          ublock[idx++] = ublock[0];
-          ublock[idx++] = ublock[1];
-          ublock[idx++] = ublock[2];
-        }
-      }
-      /* compress the block */
-      ++block_count;
-      compress_DDS_color_block(3, ublock, cblock);
-      /* copy the data from the block into the main block */
-      for(x = 0; x < 8; ++x) {
-        compressed[index++] = cblock[x];
-      }
-    }
-  }
-  return compressed;
-}
+/* head of a cache file, the level data follows */
+typedef struct __texcache_header {
+  char magic[4];            /* "T3DT" */
+  int version;
+  long long src_mtime;      /* the source image the chain was made from */
+  long long src_size;
+  unsigned long long src_hash;
+  int dxt_speed;            /* made with DXT_SPEED */
+  int channels;
+  int n_levels;
+  texcache_level levels[TEX_MAX_LEVELS];
+} texcache_header;
 
-static unsigned char *
-convert_img_to_DXT5( const unsigned char *const uncompressed,
-                     const int width, const int height, const int channels,
-                     int *out_size )
-{
-  unsigned char *compressed;
-  int i, j, x, y;
-  unsigned char ublock[16*4];
-  unsigned char cblock[8];
-  int index = 0, chan_step = 1;
-  int block_count = 0, has_alpha;
-  /* error check */
-	*out_size = 0;
-  if((width < 1) || (height < 1) || (NULL == uncompressed) ||
-     (channels < 1) || ( channels > 4)) {
-    return NULL;
-  }
-  /* for channels == 1 or 2, I do not step forward for R,G,B vales */
-  if(channels < 3) {
-    chan_step = 0;
-  }
-  /* # channels = 1 or 3 have no alpha, 2 & 4 do have alpha */
-  has_alpha = 1 - (channels & 1);
-  /* get the RAM for the compressed image (16 bytes per 4x4 pixel block) */
-  *out_size = ((width + 3) >> 2)*((height + 3) >> 2)*16;
-  compressed = (unsigned char *)malloc(*out_size);
-  /* go through each block */
-  for(j = 0; j < height; j += 4) {
-    for(i = 0; i < width; i += 4) {
-      /* local variables, and my block counter */
-      int idx = 0;
-      int mx = 4, my = 4;
-      if(j + 4 >= height)  my = height - j;
-			if(i + 4 >= width)   mx = width - i;
-
-      for(y = 0; y < my; ++y) {
-        for(x = 0; x < mx; ++x) {
-          ublock[idx++] = uncompressed[(j + y)*width*channels + (i + x)*channels];
-          ublock[idx++] = uncompressed[(j + y)*width*channels + (i + x)*channels + chan_step];
-          ublock[idx++] = uncompressed[(j + y)*width*channels + (i + x)*channels + chan_step + chan_step];
-          ublock[idx++] = uncompressed[(j + y)*width*channels + (i + x)*channels + channels - 1]*has_alpha + (1 - has_alpha)*255;
-        }
-        for(x = mx; x < 4; ++x) {
-          ublock[idx++] = ublock[0];
-          ublock[idx++] = ublock[1];
-          ublock[idx++] = ublock[2];
-          ublock[idx++] = ublock[3];
-        }
-      }
-      for(y = my; y < 4; ++y) {
-        for(x = 0; x < 4; ++x) {
-          ublock[idx++] = ublock[0];
-          ublock[idx++] = ublock[1];
-          ublock[idx++] = ublock[2];
-          ublock[idx++] = ublock[3];
-        }
-      }
-      /* now compress the alpha block */
-      compress_DDS_alpha_block(ublock, cblock);
-      /* copy the data from the compressed alpha block into the main buffer */
-      for(x = 0; x < 8; ++x) {
-        compressed[index++] = cblock[x];
-      }
-      /* then compress the color block */
-      ++block_count;
-      compress_DDS_color_block(4, ublock, cblock);
-      /* copy the data from the compressed color block into the main buffer */
-      for(x = 0; x < 8; ++x) {
-        compressed[index++] = cblock[x];
-      }
-    }
-  }
-  return compressed;
-}
 
 /*	Upscaling the image uses simple bilinear interpolation	*/
 static void
@@ -510,132 +93,287 @@ upscale_img( const unsigned char* const orig,
   }
 }
 
-static void
-mipmap_img( const unsigned char* const orig,
-            const int width, const int height, const int channels,
-            unsigned char* resampled,
-            const int block_size_x, const int block_size_y )
-{
-  int mip_w, mip_h;
-  int i, j, c;
-
-  /* error check */
-  if((width < 1) || (height < 1) ||
-     (channels < 1) || (orig == NULL) ||
-     (resampled == NULL) ||
-     (block_size_x < 1) || (block_size_y < 1) ) {
-    /* nothing to do */
-		return;
-  }
-  mip_w = width/block_size_x;
-  mip_h = height/block_size_y;
-  if(mip_w < 1)  mip_w = 1;
-	if(mip_h < 1)  mip_h = 1;
-
-  for(j = 0; j < mip_h; ++j) {
-    for(i = 0; i < mip_w; ++i) {
-      for(c = 0; c < channels; ++c) {
-        const int index = (j*block_size_y)*width*channels + (i*block_size_x)*channels + c;
-        int sum_value;
-        int u, v;
-        int u_block = block_size_x;
-        int v_block = block_size_y;
-        int block_area;
-        /* check so we don't over-run the boundaries (necessary for non-square textures!)	*/
-        if(block_size_x*(i + 1) > width) {
-          u_block = width - i*block_size_y;
-        }
-        if(block_size_y*(j + 1) > height) {
-          v_block = height - j*block_size_y;
-        }
-        block_area = u_block*v_block;
-        /* for this pixel, see what the average of all the values in the block are */
-        /* note: start the sum at the rounding value, not at 0 */
-        sum_value = block_area >> 1;
-        for(v = 0; v < v_block; ++v) {
-          for(u = 0; u < u_block; ++u) {
-            sum_value += orig[index + v*width*channels + u*channels];
-          }
-        }
-        resampled[j*mip_w*channels + i*channels + c] = sum_value / block_area;
-      }
-    }
-  }
-}
-
 #define GL_TEXTURE_MAX_ANISOTROPY_EXT 0x84FE
 #define GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT 0x84FF
-/* set texture flags */
-void
-tex_set_flags( const GLuint tex_id, const GLuint flags )
+/* set the flags of the texture bound to target */
+static void
+tex_set_target_flags( const GLenum target, const GLuint flags )
 {
-  /* bind an OpenGL texture ID */
-  glBindTexture(GL_TEXTURE_2D, tex_id);
-
   if(flags & TEX_USE_NEAREST) {
     /* always use NEAREST for shadow maps for GL_TEXTURE_MIN_FILTER */
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
   }
 
   if(flags & TEX_USE_LINEAR) {
     /* instruct OpenGL _NOT_ to use the MIPmaps */
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   }
 
   if(flags & TEX_USE_MIPMAPS) {
     /* instruct OpenGL to use the MIPmaps */
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
   }
 
   /* does the user want clamping, or wrapping? */
   if(flags & TEX_REPEATS) {
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
   }
 
   if(flags & TEX_TO_EDGE) {
     /* GL_CLAMP, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_BORDER */
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   }
 
   if(flags & TEX_TO_BORDER) {
     /* GL_CLAMP, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_BORDER */
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
   }
 
   float maxAnisotropy;
   glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
-  glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, maxAnisotropy);
+  glTexParameterf(target, GL_TEXTURE_MAX_ANISOTROPY_EXT, maxAnisotropy);
 }
 
-/* not in glcorearb.h, in gl.h */
-#define GL_CLAMP                          0x2900
-#define GL_LUMINANCE                      0x1909
-#define GL_LUMINANCE_ALPHA                0x190A
-/* not in glcorearb.h, in glext.h */
-#define GL_COMPRESSED_LUMINANCE           0x84EA
-#define GL_COMPRESSED_LUMINANCE_ALPHA     0x84EB
-/* not in glcorearb.h, in glext.h */
-#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT   0x83F0
-#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT  0x83F3
-/* Loads an image from disk into an OpenGL texture */
-GLuint
-tex_load( const char *file, const int s3tc_compressed )
+/* set texture flags */
+void
+tex_set_flags( const GLuint tex_id, const GLuint flags )
+{
+  /* bind an OpenGL texture ID */
+  ogl_bind_texture_for_upload(GL_TEXTURE_2D, tex_id);
+  tex_set_target_flags(GL_TEXTURE_2D, flags);
+}
+
+/* set texture array flags */
+void
+tex_set_array_flags( const GLuint tex_id, const GLuint flags )
+{
+  ogl_bind_texture_for_upload(GL_TEXTURE_2D_ARRAY, tex_id);
+  tex_set_target_flags(GL_TEXTURE_2D_ARRAY, flags);
+}
+
+/* compress one level to DXT1 (RGB) or DXT5 (RGBA) */
+static void
+tex_compress_level( texlevel *lv, const unsigned char *texels, const int channels )
+{
+  lv->data = dxt_compress(texels, lv->w, lv->h, channels, &lv->size);
+}
+
+/* FNV-1a hash of a whole file, 0 if it can not be read */
+static unsigned long long
+tex_cache_hash_file( const char *file )
+{
+  size_t size;
+  const void *data = util_map_file(file, &size);
+  if(!data)  return 0;
+
+  unsigned long long hash = util_fnv1a(data, size, UTIL_FNV1A_SEED);
+  util_unmap_file(data, size);
+
+  return hash;
+}
+
+/* 1 if a cache header is of this version and DXT mode */
+static int
+tex_cache_header_ok( const texcache_header *hdr )
+{
+  return memcmp(hdr->magic, "T3DT", 4) == 0 && hdr->version == TEX_CACHE_VERSION &&
+         hdr->n_levels >= 1 && hdr->n_levels <= TEX_MAX_LEVELS &&
+         hdr->dxt_speed == (dxt_get_mode() & DXT_SPEED);
+}
+
+/* an image with its levels in a cache file in memory, NULL if it is truncated.
+   mapping_size 0 borrows the data (e.g. from the asset pack) */
+static teximage *
+tex_cache_image( const void *data, const size_t size, const size_t mapping_size )
+{
+  texcache_header hdr;
+  int i;
+
+  if(size < sizeof(hdr))  return NULL;
+  memcpy(&hdr, data, sizeof(hdr));
+  if(!tex_cache_header_ok(&hdr))  return NULL;
+
+  teximage *ti = (teximage *)malloc(sizeof(teximage));
+  ti->channels = hdr.channels;
+  ti->s3tc_compressed = 1;
+  ti->n_levels = hdr.n_levels;
+  ti->mapping = data;
+  ti->mapping_size = mapping_size;
+
+  for(i = 0; i < hdr.n_levels; i++) {
+    const texcache_level *cl = &hdr.levels[i];
+
+    /* a truncated file */
+    if(cl->offset < (int)sizeof(hdr) || cl->size < 0 || (size_t)cl->offset + cl->size > size) {
+      free(ti);
+      return NULL;
+    }
+
+    ti->levels[i].w = cl->w;
+    ti->levels[i].h = cl->h;
+    ti->levels[i].size = cl->size;
+    ti->levels[i].data = (unsigned char *)data + cl->offset;
+  }
+
+  return ti;
+}
+
+/* the cached chain of an image, NULL if there is none or the image changed */
+static teximage *
+tex_cache_load( const char *cachefile, const char *file, const struct stat *src )
+{
+  texcache_header hdr;
+
+  FILE *fp = fopen(cachefile, "rb");
+  if(!fp)  return NULL;
+  size_t n = fread(&hdr, sizeof(hdr), 1, fp);
+  fclose(fp);
+
+  if(n != 1 || !tex_cache_header_ok(&hdr))  return NULL;
+
+  if(hdr.src_size != (long long)src->st_size)  return NULL;
+
+  /* touched but maybe not changed, trust the content */
+  if(hdr.src_mtime != (long long)src->st_mtime) {
+    if(tex_cache_hash_file(file) != hdr.src_hash)  return NULL;
+
+    hdr.src_mtime = (long long)src->st_mtime;
+    fp = fopen(cachefile, "r+b");
+    if(fp) {
+      fwrite(&hdr, sizeof(hdr), 1, fp);
+      fclose(fp);
+    }
+  }
+
+  size_t size;
+  const void *data = util_map_file(cachefile, &size);
+  if(!data)  return NULL;
+
+  teximage *ti = tex_cache_image(data, size, size);
+  if(!ti)  util_unmap_file(data, size);
+
+  return ti;
+}
+
+/* the packed chain of a packed image, the pack builder only packs chains
+   that are up to date, the image size is checked against a stale pack */
+static teximage *
+tex_cache_find_packed( const char *cachefile, const char *file )
+{
+  texcache_header hdr;
+  size_t size, src_size;
+
+  const void *data = util_pack_find(cachefile, &size);
+  if(!data || !util_pack_find(file, &src_size) || size < sizeof(hdr))  return NULL;
+
+  memcpy(&hdr, data, sizeof(hdr));
+  if(hdr.src_size != (long long)src_size)  return NULL;
+
+  return tex_cache_image(data, size, 0);
+}
+
+/* write the chain of an image to its cache file, failures only cost the next launch */
+static void
+tex_cache_save( const char *cachefile, const char *file, const struct stat *src, const teximage *ti )
+{
+  texcache_header hdr;
+  char tmpfile[520];
+  int i, offset;
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, "T3DT", 4);
+  hdr.version = TEX_CACHE_VERSION;
+  hdr.src_mtime = (long long)src->st_mtime;
+  hdr.src_size = (long long)src->st_size;
+  hdr.src_hash = tex_cache_hash_file(file);
+  hdr.dxt_speed = dxt_get_mode() & DXT_SPEED;
+  hdr.channels = ti->channels;
+  hdr.n_levels = ti->n_levels;
+
+  offset = sizeof(hdr);
+  for(i = 0; i < ti->n_levels; i++) {
+    hdr.levels[i].w = ti->levels[i].w;
+    hdr.levels[i].h = ti->levels[i].h;
+    hdr.levels[i].size = ti->levels[i].data ? ti->levels[i].size : 0;
+    hdr.levels[i].offset = offset;
+    offset += hdr.levels[i].size;
+  }
+
+  /* written aside then renamed, a reader never sees half a file */
+  snprintf(tmpfile, sizeof(tmpfile), "%s.tmp", cachefile);
+  FILE *fp = fopen(tmpfile, "wb");
+  if(!fp)  return;
+
+  int ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1;
+  for(i = 0; ok && i < ti->n_levels; i++) {
+    if(hdr.levels[i].size)
+      ok = fwrite(ti->levels[i].data, hdr.levels[i].size, 1, fp) == 1;
+  }
+  ok = (fclose(fp) == 0) && ok;
+
+#ifdef _WIN32
+  if(ok)  remove(cachefile);
+#endif
+  if(!ok || rename(tmpfile, cachefile) != 0)
+    remove(tmpfile);
+}
+
+/* 1 if <file>.t3dtex holds the chain of the image as it is now */
+int
+tex_cache_is_current( const char *file )
+{
+  char cachefile[512];
+  struct stat src;
+
+  if(stat(file, &src) != 0)  return 0;
+
+  snprintf(cachefile, sizeof(cachefile), "%s.t3dtex", file);
+  teximage *ti = tex_cache_load(cachefile, file, &src);
+  int current = ti != NULL;
+  tex_image_del(ti);
+
+  return current;
+}
+
+/* decode, resample, mip and compress an image file, safe to call from any thread */
+teximage *
+tex_decode( const char *file, const int s3tc_compressed )
 {
-  /* variables	*/
   unsigned char *img;
-  GLuint tex_id = 0;
-  GLuint internal_format = 0, original_format = 0;
   int w, h;    /* width, height */
   int channels;
+  char cachefile[512];
+  struct stat src;
+
+  /* only the compressed chains are worth a cache, they cost the most to make */
+  snprintf(cachefile, sizeof(cachefile), "%s.t3dtex", file);
+  if(s3tc_compressed) {
+    teximage *ti = tex_cache_find_packed(cachefile, file);
+    if(ti)  return ti;
+  }
+
+  /* packed images have no file to stat, nor a cache to write next to it */
+  int cached = s3tc_compressed && !util_pack_find(file, NULL) && stat(file, &src) == 0;
+  if(cached) {
+    teximage *ti = tex_cache_load(cachefile, file, &src);
+    if(ti)  return ti;
+  }
 
   /* create a copy the image data */
-  img = stbi_load(file, &w, &h, &channels, 0);
+  size_t size;
+  const char *view = util_file_view(file, &size);
+  img = view ? stbi_load_from_memory((const unsigned char *)view, (int)size, &w, &h, &channels, 0) : NULL;
+  util_file_release(view);
+  if(!img) {
+    fprintf(stderr, "Can not load image: %s\n", file);
+    return NULL;
+  }
 
   int new_w = 1;
   int new_h = 1;
@@ -657,108 +395,229 @@ tex_load( const char *file, const int s3tc_compressed )
     h = new_h;
   }
 
-  /* create the OpenGL texture ID handle */
-  glGenTextures(1, &tex_id);
-  /* Note: sometimes glGenTextures fails (usually no OpenGL context)	*/
-  if(tex_id) {
-    /* use opengl standard compression by default */
-    switch(channels) {
-      case 1:
-        original_format = GL_RED;
-        internal_format = GL_RED;
-        break;
-      case 2:
-        original_format = GL_LUMINANCE_ALPHA;
-        internal_format = GL_COMPRESSED_LUMINANCE_ALPHA;
-        break;
-      case 3:
-        original_format = GL_RGB;
-        internal_format = GL_COMPRESSED_RGB;
-        break;
-      case 4:
-        original_format = GL_RGBA;
-        internal_format = GL_COMPRESSED_RGBA;
-        break;
+  teximage *ti = (teximage *)malloc(sizeof(teximage));
+  ti->channels = channels;
+  ti->s3tc_compressed = s3tc_compressed;
+  ti->n_levels = 0;
+  ti->mapping = NULL;
+  ti->mapping_size = 0;
+
+  /* default: TEX_USE_MIPMAPS, each level is boxed down from the one above */
+  unsigned char *texels = img;
+  int mip_w = w;
+  int mip_h = h;
+  for(;;) {
+    texlevel *lv = &ti->levels[ti->n_levels++];
+    lv->w = mip_w;
+    lv->h = mip_h;
+
+    int last = (mip_w == 1 && mip_h == 1) || ti->n_levels == TEX_MAX_LEVELS;
+
+    unsigned char *next = NULL;
+    int next_w = (mip_w + 1)/2;
+    int next_h = (mip_h + 1)/2;
+    if(!last) {
+      next = (unsigned char *)malloc(channels*next_w*next_h);
+      dxt_downsample(next, texels, mip_w, mip_h, channels);
     }
-    /* bind an OpenGL texture ID */
-    glBindTexture(GL_TEXTURE_2D, tex_id);
-    /* does the user want to use DXT? */
+
     if(s3tc_compressed) {
-      int DDS_size;
-      unsigned char *DDS_data = NULL;
-      if((channels & 1) == 1) {
-        /* RGB, use DXT1 */
-        internal_format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
-        DDS_data = convert_img_to_DXT1(img, w, h, channels, &DDS_size);
-      }
-      else {
-        /* RGBA, use DXT5 */
-        internal_format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
-        DDS_data = convert_img_to_DXT5(img, w, h, channels, &DDS_size);
-      }
-      if(DDS_data) {
-        /* printf("Internal DXT compressor\n"); */
-        glCompressedTexImage2D(GL_TEXTURE_2D, 0,
-                               internal_format, w, h, 0,
-                               DDS_size, DDS_data);
-        free(DDS_data);
-      }
+      tex_compress_level(lv, texels, channels);
+      free(texels);
     }
     else {
-      /* user want OpenGL to do all the work! */
-      glTexImage2D(GL_TEXTURE_2D, 0,
-                   internal_format, w, h, 0,
-                   original_format, GL_UNSIGNED_BYTE, img);
+      /* the texels themselves go to OpenGL */
+      lv->data = texels;
+      lv->size = channels*mip_w*mip_h;
     }
 
-    /* default: TEX_USE_MIPMAPS */
-    int miplevel = 1;
-    int mip_w = (w + 1)/2;
-    int mip_h = (h + 1)/2;
-    unsigned char *resampled = (unsigned char *)malloc(channels*mip_w*mip_h);
-    while(((1<<miplevel) <= w) || ((1<<miplevel) <= h)) {
-      /* do this MIPmap level */
-      mipmap_img(img, w, h, channels, resampled, (1 << miplevel), (1 << miplevel));
-
-		  if(s3tc_compressed) {
-        int DDS_size;
-        unsigned char *DDS_data = NULL;
-        if((channels & 1) == 1) {
-          /* RGB, use DXT1 */
-          DDS_data = convert_img_to_DXT1(resampled, mip_w, mip_h, channels, &DDS_size);
-        }
-        else {
-          /* RGBA, use DXT5 */
-          DDS_data = convert_img_to_DXT5(resampled, mip_w, mip_h, channels, &DDS_size);
-        }
-        if(DDS_data) {
-          glCompressedTexImage2D(GL_TEXTURE_2D, miplevel,
-                                 internal_format, mip_w, mip_h, 0,
-                                 DDS_size, DDS_data);
-          free(DDS_data);
-        }
-      }
-      else {
-        /* user want OpenGL to do all the work! */
-        glTexImage2D(GL_TEXTURE_2D, miplevel,
-                     internal_format, mip_w, mip_h, 0,
-                     original_format, GL_UNSIGNED_BYTE, resampled);
-      }
-      /* prep for the next level */
-      ++miplevel;
-      mip_w = (mip_w + 1)/2;
-      mip_h = (mip_h + 1)/2;
-    }
-    free(resampled);
-    /* instruct OpenGL to use the MIPmaps */
-    /* glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); */
-    /* glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); */
+    if(last)  break;
+
+    /* prep for the next level */
+    texels = next;
+    mip_w = next_w;
+    mip_h = next_h;
+  }
+
+  if(cached)  tex_cache_save(cachefile, file, &src, ti);
+
+  return ti;
+}
+
+/* delete a decoded image from memory */
+void
+tex_image_del( teximage *img )
+{
+  int i;
+
+  if(!img)  return;
+
+  if(img->mapping) {
+    if(img->mapping_size)  util_unmap_file(img->mapping, img->mapping_size);
+  }
+  else {
+    for(i = 0; i < img->n_levels; i++)
+      free(img->levels[i].data);
+  }
+  free(img);
+}
+
+/* not in glcorearb.h, in gl.h */
+#define GL_CLAMP                          0x2900
+#define GL_LUMINANCE                      0x1909
+#define GL_LUMINANCE_ALPHA                0x190A
+/* not in glcorearb.h, in glext.h */
+#define GL_COMPRESSED_LUMINANCE           0x84EA
+#define GL_COMPRESSED_LUMINANCE_ALPHA     0x84EB
+/* not in glcorearb.h, in glext.h */
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT   0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT  0x83F3
+/* the GL internal and pixel formats of a decoded image */
+static void
+tex_image_formats( const teximage *img, GLuint *internal_format, GLuint *original_format )
+{
+  *internal_format = 0;
+  *original_format = 0;
+
+  /* use opengl standard compression by default */
+  switch(img->channels) {
+    case 1:
+      *original_format = GL_RED;
+      *internal_format = GL_RED;
+      break;
+    case 2:
+      *original_format = GL_LUMINANCE_ALPHA;
+      *internal_format = GL_COMPRESSED_LUMINANCE_ALPHA;
+      break;
+    case 3:
+      *original_format = GL_RGB;
+      *internal_format = GL_COMPRESSED_RGB;
+      break;
+    case 4:
+      *original_format = GL_RGBA;
+      *internal_format = GL_COMPRESSED_RGBA;
+      break;
+  }
+
+  /* RGB uses DXT1, RGBA uses DXT5 */
+  if(img->s3tc_compressed)
+    *internal_format = (img->channels & 1) == 1 ?
+                       GL_COMPRESSED_RGB_S3TC_DXT1_EXT :
+                       GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+/* upload one level of a decoded image to the bound texture, data overrides
+   the level texels (e.g. a copy made by a worker) when not NULL */
+void
+tex_upload_level( const teximage *img, const int level, const unsigned char *data )
+{
+  GLuint internal_format, original_format;
+  const texlevel *lv = &img->levels[level];
+
+  if(!data)  data = lv->data;
+  if(!data)  return;
+
+  tex_image_formats(img, &internal_format, &original_format);
+
+  if(img->s3tc_compressed) {
+    glCompressedTexImage2D(GL_TEXTURE_2D, level,
+                           internal_format, lv->w, lv->h, 0,
+                           lv->size, data);
+  }
+  else {
+    /* user want OpenGL to do all the work! */
+    glTexImage2D(GL_TEXTURE_2D, level,
+                 internal_format, lv->w, lv->h, 0,
+                 original_format, GL_UNSIGNED_BYTE, data);
+  }
+}
+
+/* replace the levels of a texture with a decoded image (e.g. a placeholder's), main thread only */
+void
+tex_upload_to( const GLuint tex_id, const teximage *img )
+{
+  int i;
+
+  /* bind an OpenGL texture ID */
+  ogl_bind_texture_for_upload(GL_TEXTURE_2D, tex_id);
+
+  for(i = 0; i < img->n_levels; i++)
+    tex_upload_level(img, i, NULL);
+}
+
+/* create an OpenGL texture from a decoded image, main thread only */
+GLuint
+tex_upload( const teximage *img )
+{
+  GLuint tex_id = 0;
+
+  if(!img)  return 0;
+
+  /* create the OpenGL texture ID handle */
+  glGenTextures(1, &tex_id);
+  /* Note: sometimes glGenTextures fails (usually no OpenGL context)	*/
+  if(!tex_id)  return 0;
+
+  tex_upload_to(tex_id, img);
 
-    /* default: TEX_REPEATS */
-    /* glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); */
-    /* glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT); */
+  return tex_id;
+}
+
+/* create a GL_TEXTURE_2D_ARRAY with one layer per image, the images must have
+   the same size, channels and compression, 0 if they do not */
+GLuint
+tex_array_upload( const teximage **imgs, const int n_layers )
+{
+  GLuint tex_id = 0;
+  GLuint internal_format, original_format;
+  int i, j;
+
+  if(n_layers < 1 || !imgs[0])  return 0;
+
+  const teximage *img = imgs[0];
+  for(j = 1; j < n_layers; j++) {
+    const teximage *o = imgs[j];
+    if(!o || o->channels != img->channels || o->s3tc_compressed != img->s3tc_compressed ||
+       o->n_levels != img->n_levels ||
+       o->levels[0].w != img->levels[0].w || o->levels[0].h != img->levels[0].h)  return 0;
+  }
+
+  glGenTextures(1, &tex_id);
+  if(!tex_id)  return 0;
+
+  ogl_bind_texture_for_upload(GL_TEXTURE_2D_ARRAY, tex_id);
+  tex_image_formats(img, &internal_format, &original_format);
+
+  /* allocate each level for every layer, then fill the layers in */
+  for(i = 0; i < img->n_levels; i++) {
+    const texlevel *lv = &img->levels[i];
+
+    if(img->s3tc_compressed) {
+      glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, i, internal_format,
+                             lv->w, lv->h, n_layers, 0, lv->size*n_layers, NULL);
+      for(j = 0; j < n_layers; j++)
+        glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, j, lv->w, lv->h, 1,
+                                  internal_format, lv->size, imgs[j]->levels[i].data);
+    }
+    else {
+      glTexImage3D(GL_TEXTURE_2D_ARRAY, i, internal_format,
+                   lv->w, lv->h, n_layers, 0, original_format, GL_UNSIGNED_BYTE, NULL);
+      for(j = 0; j < n_layers; j++)
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, j, lv->w, lv->h, 1,
+                        original_format, GL_UNSIGNED_BYTE, imgs[j]->levels[i].data);
+    }
   }
-  stbi_image_free(img);
+
+  return tex_id;
+}
+
+/* Loads an image from disk into an OpenGL texture */
+GLuint
+tex_load( const char *file, const int s3tc_compressed )
+{
+  teximage *img = tex_decode(file, s3tc_compressed);
+  GLuint tex_id = tex_upload(img);
+  tex_image_del(img);
 
   return tex_id;
 }
@@ -770,8 +629,20 @@ tex_gen_red_tex( const unsigned char *texels, const int tex_w, const int tex_h )
   GLuint tex_id;
 
   glGenTextures(1, &tex_id);
-  glBindTexture(GL_TEXTURE_2D, tex_id);
+  ogl_bind_texture_for_upload(GL_TEXTURE_2D, tex_id);
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, tex_w, tex_h, 0, GL_RED, GL_UNSIGNED_BYTE, texels);
 
   return tex_id;
-}
\ No newline at end of file
+}
+/* generate a 1 x 1 RGBA texture of one color (e.g. a placeholder) */
+GLuint
+tex_gen_solid( const unsigned char *rgba )
+{
+  GLuint tex_id;
+
+  glGenTextures(1, &tex_id);
+  ogl_bind_texture_for_upload(GL_TEXTURE_2D, tex_id);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+
+  return tex_id;
+}
@@ -8,6 +8,7 @@
 #include <mmsystem.h>
 #else
 #include <sys/time.h>
+#include <time.h>
 #endif
 #include <t3d_math.h>
 #include <t3d_timer.h>
@@ -38,4 +39,22 @@ tmr_time_passed( vec2 *timer )
   timer->start = timer->end;
 
   return time_passed;
-}
\ No newline at end of file
+}
+
+/* a fine clock in milliseconds, to time short spans (e.g. a frame budget) */
+double
+tmr_getmsecs( void )
+{
+#ifdef WIN32
+  LARGE_INTEGER freq, now;
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&now);
+
+  return (double)now.QuadPart*1000.0/(double)freq.QuadPart;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (double)now.tv_sec*1000.0 + (double)now.tv_nsec/1000000.0;
+#endif
+}
@@ -8,7 +8,9 @@
 #include <t3d_math.h>
 #include <t3d_shader.h>
 #include <t3d_util.h>
+#include <t3d_mpool.h>
 #include <t3d_geomath.h>
+#include <t3d_hsr.h>
 #include <t3d_hashtable.h>
 #include <t3d_texture.h>
 #include <t3d_ms3d.h>
@@ -20,73 +22,105 @@
 #include <t3d_heightmap.h>
 #include <t3d_patchmap.h>
 #include <t3d_aamesh.h>
-#include <t3d_astar.h>
+#include <t3d_flowfield.h>
 #include <t3d_unit.h>
 
 
-/* load the model data */
+/* the unit structs, shared by all models */
+static mpool *unit_structs = NULL;
+
+
+/* bytes of the per unit block of a model - the mesh pointers, the meshes,
+   the animation, the joint matrices and the decal mesh */
+static size_t
+unit_block_size( const ms3d *model )
+{
+  size_t size = mpool_align(sizeof(mesh *)*model->n_mshs);
+
+  int i;
+  for(i = 0; i < model->n_mshs; i++) {
+    const ms3dmesh *o_msh = model->o_mshs[i];
+    size += mesh_size(o_msh->n_vertices, o_msh->n_faces);
+  }
+
+  size += ms3d_anim_size(model);
+  size += mpool_align(sizeof(mat4)*model->n_joints);
+  size += aamesh_size(model->o_aamsh);
+
+  return size;
+}
+
+/* load the model data, everything sized by the model is in one block of the
+   model's unit pool, so a unit is walked in address order */
 static void
 unit_load_ms3d( unit *u, ms3d **models, const unsigned int model_id )
 {
   u->model = models[model_id];
   ms3d *model = u->model;
 
-  u->mshs = (mesh **)malloc(sizeof(mesh *)*model->n_mshs);
+  if(!model->unit_pool)
+    model->unit_pool = mpool_new(unit_block_size(model), UNIT_POOL_SLAB);
+
+  char *p = (char *)mpool_alloc(model->unit_pool);
+  u->block = p;
+
+  u->mshs = (mesh **)p;
+  p += mpool_align(sizeof(mesh *)*model->n_mshs);
 
   int i;
   for(i = 0; i < model->n_mshs; i++) {
     ms3dmesh *o_msh = model->o_mshs[i];
 
-    u->mshs[i] = mesh_new(o_msh->n_vertices);
+    u->mshs[i] = mesh_init(p, o_msh->n_vertices, o_msh->n_faces);
+    p += mesh_size(o_msh->n_vertices, o_msh->n_faces);
     mesh *msh = u->mshs[i];
 
     msh->v_data_size = o_msh->n_vertices*sizeof(vec3);
   }
-}
 
-/* store vertices, normals and/or elements in graphic card buffers */
-void
-unit_upload( const unit *u )
-{
-  int i, data_size;
+  u->ani = ms3d_anim_init(p, model);
+  p += ms3d_anim_size(model);
 
-  for(i = 0; i < u->model->n_mshs; i++) {
-    mesh *msh = u->mshs[i];
-
-    /* vertices, normals, tangents */
-    glBindBuffer(GL_ARRAY_BUFFER, msh->vbo_coords);
-    glBufferData(GL_ARRAY_BUFFER, msh->v_data_size, NULL, GL_DYNAMIC_DRAW);
-
-    glBindBuffer(GL_ARRAY_BUFFER, msh->vbo_normals);
-    glBufferData(GL_ARRAY_BUFFER, msh->v_data_size, NULL, GL_DYNAMIC_DRAW);
+  u->mat_joint_finals = (mat4 *)p;
+  p += mpool_align(sizeof(mat4)*model->n_joints);
 
-    glBindBuffer(GL_ARRAY_BUFFER, msh->vbo_tangents);
-    glBufferData(GL_ARRAY_BUFFER, msh->v_data_size, NULL, GL_DYNAMIC_DRAW);
-
-    /* hsr indices for camera */
-    data_size = sizeof(unsigned short)*msh->n_faces*3;
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, msh->ibo_hsr_cam_elements);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, data_size, NULL, GL_DYNAMIC_DRAW);
+  u->aamsh = aamesh_init(p, model->o_aamsh);
+}
 
-    /* hsr indices for light */
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, msh->ibo_hsr_lit_elements);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, data_size, NULL, GL_DYNAMIC_DRAW);
-  }
+/* give the model block back to the model's unit pool */
+static void
+unit_unload_ms3d( unit *u )
+{
+  mpool_free(u->model->unit_pool, u->block);
+  u->block = NULL;
 }
 
 /* create unit struct in memory */
 unit *
 unit_new( ms3d **models, const unsigned int model_id )
 {
-  unit *u = (unit *)malloc(sizeof(unit));
-  if(!u)  return NULL;
+  if(!unit_structs)
+    unit_structs = mpool_new(sizeof(unit), UNIT_POOL_SLAB);
+
+  unit *u = (unit *)mpool_alloc(unit_structs);
 
   unit_load_ms3d(u, models, model_id);
-  u->mat_joint_finals = (mat4 *)malloc(sizeof(mat4)*u->model->n_joints);
-  u->ani = ms3d_anim_new(u->model);
 
+  u->visible = 0;
   u->picked = 0;
 
+  u->lod_interval = 1;
+  u->lod_time = 0.0;
+
+  u->inst_count = 0;
+  u->inst_leader = NULL;
+  u->skin_stale = 0;
+  u->stm_inst_models = -1;
+  u->stm_inst_layers = -1;
+
+  u->skin_set = 0;
+  u->skin_layer = -1;
+
   aabb_calc_size(&u->center,
                  &u->half_x_len,
                  &u->half_y_len,
@@ -94,13 +128,15 @@ unit_new( ms3d **models, const unsigned int model_id )
                  &u->model->aabb_min,
                  &u->model->aabb_max);
 
-  u->aamsh = aamesh_new(u->model->o_aamsh);
-
+  u->waypoints = NULL;
+  u->n_waypoints = 0;
+  u->waypoint = 0;
   u->path = NULL;
-  u->chk_path = 0;
   u->n_steps = 0;
-
-  unit_upload(u);
+  u->step = 0;
+  u->path_ticket = 0;
+  u->flow = NULL;
+  u->new_path = 0;
 
   return u;
 }
@@ -111,19 +147,46 @@ unit_del( unit *u )
 {
   if(!u) return;
 
-  free(u->mat_joint_finals);
-  ms3d_anim_del(u->ani);
+  free(u->waypoints);
+  free(u->path);
+  ff_release(u->flow);
+  unit_unload_ms3d(u);
+  mpool_free(unit_structs, u);
 
-  int i;
-  for(i = 0; i < u->model->n_mshs; i++) {
-    mesh *msh = u->mshs[i];
-    mesh_del(msh);
+  /* the last unit takes the struct pool with it */
+  if(unit_structs->n_used == 0) {
+    mpool_del(unit_structs);
+    unit_structs = NULL;
   }
-  free(u->mshs);
+}
+
+/* switch the unit to another model (e.g. the loaded one after its stand-in),
+   the skin and the decal mesh must be set again */
+void
+unit_set_model( unit *u, ms3d **models, const unsigned int model_id )
+{
+  char cmd = u->ani->cur_cmd;
+
+  unit_unload_ms3d(u);
+  unit_load_ms3d(u, models, model_id);
+
+  /* carry on with the same command, from its start */
+  ms3d_set_anim(u->ani, u->model, cmd);
+  u->lod_time = 0.0;
 
-  aamesh_del(u->aamsh);
+  u->inst_count = 0;
+  u->inst_leader = NULL;
+  /* its vertices are of the last model */
+  u->skin_stale = 1;
+  u->skin_set = 0;
+  u->skin_layer = -1;
 
-  free(u);
+  aabb_calc_size(&u->center,
+                 &u->half_x_len,
+                 &u->half_y_len,
+                 &u->half_z_len,
+                 &u->model->aabb_min,
+                 &u->model->aabb_max);
 }
 
 /* set unit's position and target */
@@ -135,10 +198,6 @@ unit_set_pos( unit *u, const vec3 *pos, patchmap *pm )
   u->ipos.y = (int)(pos->z/pm->step);
   c_index = u->ipos.y*pm->w_cells + u->ipos.x;
 
-  pthread_mutex_lock(&pm->lock);
-  pm->cells[c_index].status = ASTAR_AVAIL;
-  pthread_mutex_unlock(&pm->lock);
-
   /* let's find out the vertex indice of a block(2 triangles) the unit is in */
   int i0 = pm->w*u->ipos.y + u->ipos.x;
   int i1 = pm->w*(u->ipos.y + 1) + u->ipos.x;
@@ -204,6 +263,38 @@ unit_set_skin( unit *u, const int skin_index, const int skin_stride, const hasht
     tex_set_flags(*msh->tex_normalmap, TEX_USE_LINEAR|TEX_TO_BORDER);
     tex_set_flags(*msh->tex_specular, TEX_USE_MIPMAPS|TEX_TO_BORDER);
   }
+
+  /* packed skins are told apart by layer, so every skin of the model can share a draw */
+  u->skin_set = skin_index*skin_stride;
+  u->skin_layer = -1;
+  if(model->skin_arrays && model->skin_stride == skin_stride && skin_index < model->n_skin_layers)
+    u->skin_layer = skin_index;
+}
+
+/* skin vertex j of a mesh with the final joint matrices */
+static void
+unit_skin_vertex( const unit *u, const ms3dmesh *o_msh, mesh *msh, const int j )
+{
+  int bone_id = (int)o_msh->o_jnt_indices[j];
+  const vec3 *o_v = &o_msh->o_vcoords[j];
+  const vec3 *o_n = &o_msh->o_normals[j];
+  const vec3 *o_t = &o_msh->o_tangents[j];
+  vec3 *v = &msh->vcoords[j];
+  vec3 *n = &msh->normals[j];
+  vec3 *t = &msh->tangents[j];
+
+  if(bone_id == -1) {
+    vec3_cpy(v, o_v);
+    vec3_cpy(n, o_n);
+    vec3_cpy(t, o_t);
+  }
+  else {
+    /* mat_joint_finals are joint related(mapped) final matrices */
+    const mat4 *mat_joint_final = &u->mat_joint_finals[bone_id];
+    mat4_r_mul_t_vec3(v, mat_joint_final, o_v);
+    mat4_r_mul_vec3(n, mat_joint_final, o_n);
+    mat4_r_mul_vec3(t, mat_joint_final, o_t);
+  }
 }
 
 /* update unit model vertices */
@@ -219,26 +310,7 @@ unit_update_vertices( unit *u )
     ms3dmesh *o_msh = model->o_mshs[i];
 
     for(j = 0; j < o_msh->n_vertices; j++) {
-      int bone_id = (int)o_msh->o_jnt_indices[j];
-      const vec3 *o_v = &o_msh->o_vcoords[j];
-      const vec3 *o_n = &o_msh->o_normals[j];
-      const vec3 *o_t = &o_msh->o_tangents[j];
-      vec3 *v = &msh->vcoords[j];
-      vec3 *n = &msh->normals[j];
-      vec3 *t = &msh->tangents[j];
-
-      if(bone_id == -1) {
-        vec3_cpy(v, o_v);
-        vec3_cpy(n, o_n);
-        vec3_cpy(t, o_t);
-      }
-      else {
-        /* mat_joint_finals are joint related(mapped) final matrices */
-        const mat4 *mat_joint_final = &u->mat_joint_finals[bone_id];
-        mat4_r_mul_t_vec3(v, mat_joint_final, o_v);
-        mat4_r_mul_vec3(n, mat_joint_final, o_n);
-        mat4_r_mul_vec3(t, mat_joint_final, o_t);
-      }
+      unit_skin_vertex(u, o_msh, msh, j);
 
       /* find the min, max of dynamic AABBox, flag == 0 (first time use)
       if(flag == 0) {
@@ -253,7 +325,6 @@ unit_update_vertices( unit *u )
   }      /* i */
 }
 
-
 /* calculate the unit triangle faces */
 void
 unit_calc_faces( unit *u )
@@ -264,14 +335,13 @@ unit_calc_faces( unit *u )
 
   for(i = 0; i < model->n_mshs; i++) {
     mesh *msh = u->mshs[i];
+    const unsigned short *indices = model->o_mshs[i]->o_indices;
 
     for(j = 0; j < msh->n_faces; j++) {
-      int i0 = 3*j;
-      int i1 = i0 + 1;
-      int i2 = i0 + 2;
-      const vec3 *v0 = &msh->vcoords[i0];
-      const vec3 *v1 = &msh->vcoords[i1];
-      const vec3 *v2 = &msh->vcoords[i2];
+      const unsigned short *tri = &indices[3*j];
+      const vec3 *v0 = &msh->vcoords[tri[0]];
+      const vec3 *v1 = &msh->vcoords[tri[1]];
+      const vec3 *v2 = &msh->vcoords[tri[2]];
 
       /* save the plane equation for this triangle */
       vec4 *plane = &msh->faces[j];
@@ -287,20 +357,19 @@ unit_calc_cam_hsr( unit *u, const vec3 *object_space_unit_to_cam, const int flag
   int i, j;
   for(i = 0; i < u->model->n_mshs; i++) {
     mesh *msh = u->mshs[i];
+    const unsigned short *indices = u->model->o_mshs[i]->o_indices;
 
     msh->cam_hsr_count = 0;
     for(j = 0; j < msh->n_faces; j++) {
       const vec4 *plane = &msh->faces[j];
 
       if(gmth_plane_classify_point(plane, object_space_unit_to_cam) == flag) {
-        unsigned short i0 = 3*j;
-        unsigned short i1 = i0 + 1;
-        unsigned short i2 = i0 + 2;
-        msh->hsr_cam_v_indices[msh->cam_hsr_count] = i0;
+        const unsigned short *tri = &indices[3*j];
+        msh->hsr_cam_v_indices[msh->cam_hsr_count] = tri[0];
         msh->cam_hsr_count++;      
-        msh->hsr_cam_v_indices[msh->cam_hsr_count] = i1;
+        msh->hsr_cam_v_indices[msh->cam_hsr_count] = tri[1];
         msh->cam_hsr_count++;
-        msh->hsr_cam_v_indices[msh->cam_hsr_count] = i2;
+        msh->hsr_cam_v_indices[msh->cam_hsr_count] = tri[2];
         msh->cam_hsr_count++;
       }
     }
@@ -314,26 +383,73 @@ unit_calc_lit_hsr( unit *u, const vec3 *object_space_unit_to_lit, const int flag
   int i, j;
   for(i = 0; i < u->model->n_mshs; i++) {
     mesh *msh = u->mshs[i];
+    const unsigned short *indices = u->model->o_mshs[i]->o_indices;
 
     msh->lit_hsr_count = 0;
     for(j = 0; j < msh->n_faces; j++) {
       const vec4 *plane = &msh->faces[j];
 
       if(gmth_plane_classify_point(plane, object_space_unit_to_lit) == flag) {
-        unsigned short i0 = 3*j;
-        unsigned short i1 = i0 + 1;
-        unsigned short i2 = i0 + 2;
-        msh->hsr_lit_v_indices[msh->lit_hsr_count] = i0;
+        const unsigned short *tri = &indices[3*j];
+        msh->hsr_lit_v_indices[msh->lit_hsr_count] = tri[0];
         msh->lit_hsr_count++;
-        msh->hsr_lit_v_indices[msh->lit_hsr_count] = i1;
+        msh->hsr_lit_v_indices[msh->lit_hsr_count] = tri[1];
         msh->lit_hsr_count++;
-        msh->hsr_lit_v_indices[msh->lit_hsr_count] = i2;
+        msh->hsr_lit_v_indices[msh->lit_hsr_count] = tri[2];
         msh->lit_hsr_count++;
       }
     }
   }
 }
 
+/* skin the vertices, calculate the faces and both HSR lists in one pass.
+   triangles go in blocks of 32 (one mask word): the block's vertices are
+   skinned (once, tracked by stamp), then classified and compacted while
+   they are still in cache */
+void
+unit_update_fused( unit *u, const vec3 *object_space_unit_to_cam, const int cam_flag,
+                            const vec3 *object_space_unit_to_lit, const int lit_flag )
+{
+  int i, j, base;
+  ms3d *model = u->model;
+
+  for(i = 0; i < model->n_mshs; i++) {
+    mesh *msh = u->mshs[i];
+    ms3dmesh *o_msh = model->o_mshs[i];
+
+    msh->skin_stamp++;
+    if(msh->skin_stamp == 0) {
+      memset(msh->skin_stamps, 0, sizeof(unsigned int)*o_msh->n_vertices);
+      msh->skin_stamp = 1;
+    }
+
+    msh->cam_hsr_count = 0;
+    msh->lit_hsr_count = 0;
+
+    for(base = 0; base < msh->n_faces; base += 32) {
+      int n = msh->n_faces - base < 32 ? msh->n_faces - base : 32;
+      const unsigned short *tri = &o_msh->o_indices[3*base];
+      unsigned int *cam_mask = &msh->hsr_cam_mask[base >> 5];
+      unsigned int *lit_mask = &msh->hsr_lit_mask[base >> 5];
+
+      for(j = 0; j < 3*n; j++) {
+        int index = tri[j];
+        if(msh->skin_stamps[index] != msh->skin_stamp) {
+          unit_skin_vertex(u, o_msh, msh, index);
+          msh->skin_stamps[index] = msh->skin_stamp;
+        }
+      }
+
+      hsr_classify_faces(&msh->faces[base], cam_mask, lit_mask,
+                         msh->vcoords, tri, n,
+                         object_space_unit_to_cam, cam_flag,
+                         object_space_unit_to_lit, lit_flag);
+      msh->cam_hsr_count += hsr_compact(&msh->hsr_cam_v_indices[msh->cam_hsr_count], cam_mask, tri, n);
+      msh->lit_hsr_count += hsr_compact(&msh->hsr_lit_v_indices[msh->lit_hsr_count], lit_mask, tri, n);
+    }
+  }
+}
+
 /* update VBO */
 void
 unit_update_vbo( const unit *u )
@@ -344,25 +460,15 @@ unit_update_vbo( const unit *u )
     mesh *msh = u->mshs[i];
 
     /* vertices, normals, tangents */
-    glBindBuffer(GL_ARRAY_BUFFER, msh->vbo_coords);
-    void *v_data = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-
-    glBindBuffer(GL_ARRAY_BUFFER, msh->vbo_normals);
-    void *n_data = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-
-    glBindBuffer(GL_ARRAY_BUFFER, msh->vbo_tangents);
-    void *t_data = glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
-
-    memcpy(v_data, msh->vcoords, msh->v_data_size);
-    memcpy(n_data, msh->normals, msh->v_data_size);
-    memcpy(t_data, msh->tangents, msh->v_data_size);
-
-    glBindBuffer(GL_ARRAY_BUFFER, msh->vbo_coords);
-    glUnmapBuffer(GL_ARRAY_BUFFER);
-    glBindBuffer(GL_ARRAY_BUFFER, msh->vbo_normals);
-    glUnmapBuffer(GL_ARRAY_BUFFER);
-    glBindBuffer(GL_ARRAY_BUFFER, msh->vbo_tangents);
-    glUnmapBuffer(GL_ARRAY_BUFFER);
+    msh->stm_coords = ogl_stream_upload(msh->vcoords, msh->v_data_size);
+    msh->stm_normals = ogl_stream_upload(msh->normals, msh->v_data_size);
+    msh->stm_tangents = ogl_stream_upload(msh->tangents, msh->v_data_size);
+
+    /* out of stream space, skip the mesh this frame */
+    if(msh->stm_coords < 0 || msh->stm_normals < 0 || msh->stm_tangents < 0) {
+      msh->cam_hsr_count = 0;
+      msh->lit_hsr_count = 0;
+    }
   }
 }
 
@@ -374,10 +480,9 @@ unit_update_hsr_cam_ibo( const unit *u )
   for(i = 0; i < u->model->n_mshs; i++) {
     mesh *msh = u->mshs[i];
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, msh->ibo_hsr_cam_elements);
-    void *hsr_cam_data = glMapBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_WRITE_ONLY);
-    memcpy(hsr_cam_data, msh->hsr_cam_v_indices, msh->cam_hsr_count*sizeof(unsigned short));
-    glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+    msh->stm_hsr_cam_elements = ogl_stream_upload(msh->hsr_cam_v_indices,
+                                                  msh->cam_hsr_count*sizeof(unsigned short));
+    if(msh->stm_hsr_cam_elements < 0)  msh->cam_hsr_count = 0;
   }
 }
 
@@ -389,108 +494,246 @@ unit_update_hsr_lit_ibo( const unit *u )
   for(i = 0; i < u->model->n_mshs; i++) {
     mesh *msh = u->mshs[i];
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, msh->ibo_hsr_lit_elements);
-    void *hsr_lit_data = glMapBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_WRITE_ONLY);
-    memcpy(hsr_lit_data, msh->hsr_lit_v_indices, msh->lit_hsr_count*sizeof(unsigned short));
-    glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+    msh->stm_hsr_lit_elements = ogl_stream_upload(msh->hsr_lit_v_indices,
+                                                  msh->lit_hsr_count*sizeof(unsigned short));
+    if(msh->stm_hsr_lit_elements < 0)  msh->lit_hsr_count = 0;
   }
 }
 
+/* draw one mesh of the unit with normalmap, its textures must be bound */
+void
+unit_mesh_normalmap_draw( const unit *u, const int i, const shader *glsl )
+{
+  mesh *msh = u->mshs[i];
+  ms3dmesh *o_msh = u->model->o_mshs[i];
+
+  ogl_attrib_arrays(OGL_ATTRIB(glsl->attri_v_coord)|
+                    OGL_ATTRIB(glsl->attri_v_normal)|
+                    OGL_ATTRIB(glsl->attri_v_tangent)|
+                    OGL_ATTRIB(glsl->attri_v_texcoord));
+
+  /* the skin layer is a constant attribute while its array is off */
+  if(u->skin_layer >= 0)
+    glVertexAttrib1f(glsl->attri_i_layer, (float)u->skin_layer);
+
+  ogl_bind_buffer(GL_ARRAY_BUFFER, ogl_stream_buffer());
+  glVertexAttribPointer(glsl->attri_v_coord,   /* attribute */
+                        3,                     /* (x, y, z) */
+                        GL_FLOAT,
+                        GL_FALSE,
+                        0,
+                        (void *)msh->stm_coords);
+
+  ogl_bind_buffer(GL_ARRAY_BUFFER, ogl_stream_buffer());
+  glVertexAttribPointer(glsl->attri_v_normal,  /* attribute */
+                        3,                     /* (x, y, z) */
+                        GL_FLOAT,
+                        GL_FALSE,
+                        0,
+                        (void *)msh->stm_normals);
+
+  ogl_bind_buffer(GL_ARRAY_BUFFER, o_msh->vbo_o_texcoords);
+  glVertexAttribPointer(glsl->attri_v_texcoord,  /* attribute */
+                        2,                       /* (x, y) */
+                        GL_FLOAT,
+                        GL_FALSE,
+                        0,
+                        0);
+
+  ogl_bind_buffer(GL_ARRAY_BUFFER, ogl_stream_buffer());
+  glVertexAttribPointer(glsl->attri_v_tangent,  /* attribute */
+                        3,                      /* (x, y, z) */
+                        GL_FLOAT,
+                        GL_FALSE,
+                        0,
+                        (void *)msh->stm_tangents);
+
+  /* push each element to the vertex shader */
+  ogl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ogl_stream_buffer());
+  glDrawElements(GL_TRIANGLES, msh->cam_hsr_count, GL_UNSIGNED_SHORT,
+                 (void *)msh->stm_hsr_cam_elements);
+}
+
 /* draw the unit model with normalmap */
 void
 unit_normalmap_draw( const unit *u, const light *lit, const shader *glsl )
 {
   int i;
-  ms3d *model = u->model;
-
-  glEnableVertexAttribArray(glsl->attri_v_coord);
-  glEnableVertexAttribArray(glsl->attri_v_normal);
-  glEnableVertexAttribArray(glsl->attri_v_tangent);
-  glEnableVertexAttribArray(glsl->attri_v_texcoord);
 
-  for(i = 0; i < model->n_mshs; i++) {
+  for(i = 0; i < u->model->n_mshs; i++) {
     mesh *msh = u->mshs[i];
-    ms3dmesh *o_msh = model->o_mshs[i];
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, *msh->tex_diffuse);
+    ogl_bind_texture(0, *msh->tex_diffuse);
+    ogl_bind_texture(1, *msh->tex_normalmap);
+    ogl_bind_texture(2, *msh->tex_specular);
+    ogl_bind_texture(3, lit->tex_shadow);
 
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, *msh->tex_normalmap);
+    unit_mesh_normalmap_draw(u, i, glsl);
+  }
+}
 
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, *msh->tex_specular);
+/* draw the unit model with only vertex coordinates */
+void
+unit_vertex_draw( const unit *u, const shader *glsl )
+{
+  int i;
 
-    glActiveTexture(GL_TEXTURE3);
-    glBindTexture(GL_TEXTURE_2D, lit->tex_shadow);
+  ogl_attrib_arrays(OGL_ATTRIB(glsl->attri_v_coord));
 
+  for(i = 0; i < u->model->n_mshs; i++) {
+    mesh *msh = u->mshs[i];
 
-    glBindBuffer(GL_ARRAY_BUFFER, msh->vbo_coords);
+    ogl_bind_buffer(GL_ARRAY_BUFFER, ogl_stream_buffer());
     glVertexAttribPointer(glsl->attri_v_coord,   /* attribute */
                           3,                     /* (x, y, z) */
                           GL_FLOAT,
                           GL_FALSE,
                           0,
-                          0);
+                          (void *)msh->stm_coords);
 
-    glBindBuffer(GL_ARRAY_BUFFER, msh->vbo_normals);
-    glVertexAttribPointer(glsl->attri_v_normal,  /* attribute */
-                          3,                     /* (x, y, z) */
-                          GL_FLOAT,
-                          GL_FALSE,
-                          0,
-                          0);
+    /* push each element to the vertex shader */
+    ogl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ogl_stream_buffer());
+    glDrawElements(GL_TRIANGLES, msh->lit_hsr_count, GL_UNSIGNED_SHORT,
+                   (void *)msh->stm_hsr_lit_elements);
+  }
+}
+
+/* point the instance model matrix attributes (a mat4 is 4 vec4 columns) at
+   the group's matrices */
+static void
+unit_inst_attribs( const unit *u, const shader *glsl )
+{
+  int c;
 
-    glBindBuffer(GL_ARRAY_BUFFER, o_msh->vbo_o_texcoords);
-    glVertexAttribPointer(glsl->attri_v_texcoord,  /* attribute */
-                          2,                       /* (x, y) */
+  ogl_bind_buffer(GL_ARRAY_BUFFER, ogl_stream_buffer());
+  for(c = 0; c < 4; c++) {
+    glVertexAttribPointer(glsl->attri_i_model + c,  /* attribute */
+                          4,                        /* one column */
                           GL_FLOAT,
                           GL_FALSE,
-                          0,
-                          0);
+                          sizeof(mat4),
+                          (void *)(u->stm_inst_models + c*4*sizeof(float)));
+    glVertexAttribDivisor(glsl->attri_i_model + c, 1);
+  }
+}
+
+/* back to one value a vertex, the divisors are global state without vertex array objects */
+static void
+unit_inst_attribs_reset( const shader *glsl, const int layers )
+{
+  int c;
+
+  for(c = 0; c < 4; c++)
+    glVertexAttribDivisor(glsl->attri_i_model + c, 0);
+  if(layers)
+    glVertexAttribDivisor(glsl->attri_i_layer, 0);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, msh->vbo_tangents);
-    glVertexAttribPointer(glsl->attri_v_tangent,  /* attribute */
-                          3,                      /* (x, y, z) */
+/* all the instance model matrix attribute bits */
+#define UNIT_INST_ATTRIBS(glsl) (OGL_ATTRIB((glsl)->attri_i_model)|     \
+                                 OGL_ATTRIB((glsl)->attri_i_model + 1)| \
+                                 OGL_ATTRIB((glsl)->attri_i_model + 2)| \
+                                 OGL_ATTRIB((glsl)->attri_i_model + 3))
+
+/* draw mesh i of an instance group leader for the whole group, its textures must be bound */
+void
+unit_mesh_normalmap_draw_inst( const unit *u, const int i, const shader *glsl )
+{
+  mesh *msh = u->mshs[i];
+  ms3dmesh *o_msh = u->model->o_mshs[i];
+
+  /* out of stream space this frame */
+  if(msh->stm_coords < 0 || msh->stm_normals < 0 || msh->stm_tangents < 0)  return;
+
+  /* the skin layers of the group, one per instance */
+  int layers = u->skin_layer >= 0 && u->stm_inst_layers >= 0;
+
+  ogl_attrib_arrays(OGL_ATTRIB(glsl->attri_v_coord)|
+                    OGL_ATTRIB(glsl->attri_v_normal)|
+                    OGL_ATTRIB(glsl->attri_v_tangent)|
+                    OGL_ATTRIB(glsl->attri_v_texcoord)|
+                    UNIT_INST_ATTRIBS(glsl)|
+                    (layers ? OGL_ATTRIB(glsl->attri_i_layer) : 0));
+
+  ogl_bind_buffer(GL_ARRAY_BUFFER, ogl_stream_buffer());
+  glVertexAttribPointer(glsl->attri_v_coord,   /* attribute */
+                        3,                     /* (x, y, z) */
+                        GL_FLOAT,
+                        GL_FALSE,
+                        0,
+                        (void *)msh->stm_coords);
+
+  glVertexAttribPointer(glsl->attri_v_normal,  /* attribute */
+                        3,                     /* (x, y, z) */
+                        GL_FLOAT,
+                        GL_FALSE,
+                        0,
+                        (void *)msh->stm_normals);
+
+  glVertexAttribPointer(glsl->attri_v_tangent,  /* attribute */
+                        3,                      /* (x, y, z) */
+                        GL_FLOAT,
+                        GL_FALSE,
+                        0,
+                        (void *)msh->stm_tangents);
+
+  ogl_bind_buffer(GL_ARRAY_BUFFER, o_msh->vbo_o_texcoords);
+  glVertexAttribPointer(glsl->attri_v_texcoord,  /* attribute */
+                        2,                       /* (x, y) */
+                        GL_FLOAT,
+                        GL_FALSE,
+                        0,
+                        0);
+
+  unit_inst_attribs(u, glsl);
+  if(layers) {
+    ogl_bind_buffer(GL_ARRAY_BUFFER, ogl_stream_buffer());
+    glVertexAttribPointer(glsl->attri_i_layer,   /* attribute */
+                          1,                     /* layer */
                           GL_FLOAT,
                           GL_FALSE,
                           0,
-                          0);
-
-    /* push each element to the vertex shader */
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, msh->ibo_hsr_cam_elements);
-    glDrawElements(GL_TRIANGLES, msh->cam_hsr_count, GL_UNSIGNED_SHORT, 0);
+                          (void *)u->stm_inst_layers);
+    glVertexAttribDivisor(glsl->attri_i_layer, 1);
   }
+  else if(u->skin_layer >= 0)
+    glVertexAttrib1f(glsl->attri_i_layer, (float)u->skin_layer);
+
+  /* every triangle, the instances look from different sides so the
+     per unit HSR lists do not apply, back faces are culled by GL */
+  ogl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, o_msh->ibo_o_elements);
+  glDrawElementsInstanced(GL_TRIANGLES, o_msh->n_faces*3, GL_UNSIGNED_SHORT, 0, u->inst_count);
 
-  glDisableVertexAttribArray(glsl->attri_v_texcoord);
-  glDisableVertexAttribArray(glsl->attri_v_tangent);
-  glDisableVertexAttribArray(glsl->attri_v_normal);
-  glDisableVertexAttribArray(glsl->attri_v_coord);
+  unit_inst_attribs_reset(glsl, layers);
 }
 
-/* draw the unit model with only vertex coordinates */
+/* draw an instance group leader for the whole group with only vertex coordinates */
 void
-unit_vertex_draw( const unit *u, const shader *glsl )
+unit_vertex_draw_inst( const unit *u, const shader *glsl )
 {
   int i;
 
-  glEnableVertexAttribArray(glsl->attri_v_coord);
+  ogl_attrib_arrays(OGL_ATTRIB(glsl->attri_v_coord)|UNIT_INST_ATTRIBS(glsl));
+
+  unit_inst_attribs(u, glsl);
 
   for(i = 0; i < u->model->n_mshs; i++) {
     mesh *msh = u->mshs[i];
+    ms3dmesh *o_msh = u->model->o_mshs[i];
+
+    if(msh->stm_coords < 0)  continue;
 
-    glBindBuffer(GL_ARRAY_BUFFER, msh->vbo_coords);
+    ogl_bind_buffer(GL_ARRAY_BUFFER, ogl_stream_buffer());
     glVertexAttribPointer(glsl->attri_v_coord,   /* attribute */
                           3,                     /* (x, y, z) */
                           GL_FLOAT,
                           GL_FALSE,
                           0,
-                          0);
+                          (void *)msh->stm_coords);
 
-    /* push each element to the vertex shader */
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, msh->ibo_hsr_lit_elements);
-    glDrawElements(GL_TRIANGLES, msh->lit_hsr_count, GL_UNSIGNED_SHORT, 0);
+    ogl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, o_msh->ibo_o_elements);
+    glDrawElementsInstanced(GL_TRIANGLES, o_msh->n_faces*3, GL_UNSIGNED_SHORT, 0, u->inst_count);
   }
 
-  glDisableVertexAttribArray(glsl->attri_v_coord);
-}
\ No newline at end of file
+  unit_inst_attribs_reset(glsl, 0);
+}
@@ -6,8 +6,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <unistd.h>
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
 #include <t3d_vector.h>
 #include <t3d_hashtable.h>
+#include <t3d_pack.h>
+#include <t3d_util.h>
+
+
+/* the asset pack the file views come from */
+static const pak *util_pak = NULL;
 
 
 /* read file to a buffer in memory */
@@ -69,20 +83,80 @@ util_get_fname( char *fname, const char *path )
   strcpy(fname, path);
 }
 
+/* serve the file views from an asset pack, NULL for loose files only */
+void
+util_mount_pack( const pak *p )
+{
+  util_pak = p;
+}
+
+/* zero-copy view of a file in the mounted pack, NULL if it is not packed */
+const void *
+util_pack_find( const char *filename, size_t *size )
+{
+  return pak_find(util_pak, filename, size);
+}
+
+/* view a whole file, in place from the mounted pack or read from disk,
+   0 terminated, NULL if it can not be read. release it with util_file_release */
+const char *
+util_file_view( const char *filename, size_t *size )
+{
+  size_t n;
+  const char *data = (const char *)pak_find(util_pak, filename, &n);
+
+  if(!data) {
+    FILE *file = fopen(filename, "rb");
+    if(!file) {
+      fprintf(stderr, "Unable to open file \"%s\".\n", filename);
+      return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    n = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *buffer = (char *)malloc(n + 1);
+    n = fread(buffer, 1, n, file);
+    buffer[n] = 0;
+    fclose(file);
+
+    data = buffer;
+  }
+
+  if(size)  *size = n;
+  return data;
+}
+
+/* release a view of util_file_view */
+void
+util_file_release( const char *data )
+{
+  if(!pak_contains(util_pak, data))
+    free((void *)data);
+}
+
 /* read list of strings into a vector */
 void
 util_file_to_vector( vector *v, const char *fname )
 {
   char line[512];
-  FILE *fp;
+  size_t size, i = 0;
 
+  const char *data = util_file_view(fname, &size);
+  if(!data)  return;
 
-  fp = fopen(fname, "rt");
-
-  while(fgets(line, 512, fp) != NULL) {
+  /* the lines as fgets splits them, the new lines are kept */
+  while(i < size) {
+    size_t n = 0;
+    while(i < size && n < sizeof(line) - 1) {
+      line[n++] = data[i];
+      if(data[i++] == '\n')  break;
+    }
+    line[n] = '\0';
     vector_push(v, line);
   }
-  fclose(fp);
+
+  util_file_release(data);
 }
 
 /* add file basename(strip off the directory name) to a hashtable paired with a value */
@@ -97,4 +171,86 @@ util_add_basename_to_hash( hashtable *ht, const char *str, const void *value, co
 
   hash_add(ht, key_str, value, value_sz);
   free(key_str);
-}
\ No newline at end of file
+}
+
+/* number of online processors, at least 1 */
+int
+util_cpu_count( void )
+{
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  int n = (int)info.dwNumberOfProcessors;
+#else
+  int n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  return n > 0 ? n : 1;
+}
+
+/* map a whole file read only, NULL if it can not be opened or is empty */
+const void *
+util_map_file( const char *filename, size_t *size )
+{
+  void *data = NULL;
+  *size = 0;
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if(file == INVALID_HANDLE_VALUE)  return NULL;
+
+  LARGE_INTEGER file_size;
+  if(GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if(mapping) {
+      data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      /* the view keeps the mapping alive */
+      CloseHandle(mapping);
+      if(data)  *size = (size_t)file_size.QuadPart;
+    }
+  }
+  CloseHandle(file);
+#else
+  struct stat st;
+  int fd = open(filename, O_RDONLY);
+  if(fd < 0)  return NULL;
+
+  if(fstat(fd, &st) == 0 && st.st_size > 0) {
+    data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED)  data = NULL;
+    else  *size = st.st_size;
+  }
+  /* the mapping keeps the file alive */
+  close(fd);
+#endif
+
+  return data;
+}
+
+/* unmap a file mapped by util_map_file */
+void
+util_unmap_file( const void *data, const size_t size )
+{
+  if(!data)  return;
+
+#ifdef _WIN32
+  UnmapViewOfFile(data);
+#else
+  munmap((void *)data, size);
+#endif
+}
+
+/* 64 bits FNV-1a hash of a buffer, chain calls by passing the last hash as seed */
+unsigned long long
+util_fnv1a( const void *data, const size_t size, unsigned long long seed )
+{
+  const unsigned char *p = (const unsigned char *)data;
+  size_t i;
+
+  for(i = 0; i < size; i++) {
+    seed ^= p[i];
+    seed *= 0x100000001b3ULL;
+  }
+
+  return seed;
+}
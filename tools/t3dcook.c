@@ -0,0 +1,91 @@
+/*----- t3dcook.c ------------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+/* model cooker:  t3dcook <model.ms3d | @listfile>...
+   writes <model>.t3dm next to each model with its <model>.anim commands,
+   a @listfile (e.g. model_list.txt) cooks the first path of each line.
+   the engine loads a cooked model in place, with no parsing */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <t3d_math.h>
+#include <t3d_vector.h>
+#include <t3d_util.h>
+#include <t3d_ms3d.h>
+
+
+/* cook one model, return 0 on failure */
+static int
+cook_model( const char *path )
+{
+  char line[512], animfile[512];
+
+  const unsigned char *buf = (const unsigned char *)util_file_view(path, NULL);
+  ms3d *m = ms3d_parse(buf);
+  util_file_release((const char *)buf);
+
+  if(!m) {
+    fprintf(stderr, "%s is not a ms3d model\n", path);
+    return 0;
+  }
+
+  snprintf(animfile, sizeof(animfile), "%s.anim", path);
+  vector *anicmd_strs = vector_new(sizeof(line));
+  util_file_to_vector(anicmd_strs, animfile);
+  m->anim_cmds = ms3d_animcmd_new(&m->n_cmds, anicmd_strs);
+  vector_del(anicmd_strs);
+
+  int ok = ms3d_cook(m, path);
+  if(ok)
+    printf("%s.t3dm: %d meshes, %d joints, %d commands\n", path, m->n_mshs, m->n_joints, m->n_cmds);
+  else
+    fprintf(stderr, "Can not write %s.t3dm\n", path);
+
+  ms3d_del(m);
+  return ok;
+}
+
+/* cook the models of a list file */
+static int
+cook_list( const char *listfile )
+{
+  char line[512], path[512];
+
+  FILE *fp = fopen(listfile, "rt");
+  if(!fp) {
+    fprintf(stderr, "Can not read %s\n", listfile);
+    return 0;
+  }
+
+  int ok = 1;
+  while(ok && fgets(line, sizeof(line), fp)) {
+    if(sscanf(line, "%511s", path) == 1)
+      ok = cook_model(path);
+  }
+  fclose(fp);
+
+  return ok;
+}
+
+int
+main( int argc, char *argv[] )
+{
+  int i, ok = 1;
+
+  if(argc < 2) {
+    fprintf(stderr, "usage: t3dcook <model.ms3d | @listfile>...\n");
+    return EXIT_FAILURE;
+  }
+
+  for(i = 1; ok && i < argc; i++) {
+    if(argv[i][0] == '@')
+      ok = cook_list(argv[i] + 1);
+    else
+      ok = cook_model(argv[i]);
+  }
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,243 @@
+/*----- t3dpak.c -------------------------------------------------------------+
+    Developped by: Edward Lei
+    Revised date: 18th Jan, 2014
+ +----------------------------------------------------------------------------*/
+
+/* asset pack builder:  t3dpak <pack> <file | @listfile>...
+   a @listfile is packed with the first path of each of its lines (e.g.
+   texture_list.txt, model_list.txt), lines of a list may be @lists too.
+   next to each file, <file>.anim and an up to date <file>.t3dtex or
+   <file>.t3dm are packed as well. run it from the directory the engine loads from, the entries
+   are named by the paths as given */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <t3d_math.h>
+#include <t3d_util.h>
+#include <t3d_texture.h>
+#include <t3d_ms3d.h>
+#include <t3d_pack.h>
+
+
+typedef struct {
+  char name[512];
+  unsigned long long hash;
+  const void *data;
+  size_t size;
+} packfile;
+
+static packfile *files = NULL;
+static int n_files = 0;
+static int files_capacity = 0;
+
+
+/* add a file once, return 0 if it can not be read */
+static int
+pack_add( const char *path )
+{
+  char name[512];
+  int i;
+
+  pak_name(name, sizeof(name), path);
+  for(i = 0; i < n_files; i++)
+    if(strcmp(files[i].name, name) == 0)  return 1;
+
+  if(n_files == files_capacity) {
+    files_capacity = files_capacity ? files_capacity*2 : 64;
+    files = (packfile *)realloc(files, sizeof(packfile)*files_capacity);
+  }
+
+  packfile *f = &files[n_files];
+  strcpy(f->name, name);
+  f->hash = pak_hash(name);
+  f->size = 0;
+  f->data = util_map_file(path, &f->size);
+
+  /* an empty file maps to nothing */
+  struct stat st;
+  if(!f->data && (stat(path, &st) != 0 || st.st_size != 0)) {
+    fprintf(stderr, "Can not read %s\n", path);
+    return 0;
+  }
+
+  n_files++;
+  return 1;
+}
+
+/* add a file with its companions */
+static int
+pack_add_file( const char *path )
+{
+  char companion[520];
+  struct stat st;
+
+  if(!pack_add(path))  return 0;
+
+  snprintf(companion, sizeof(companion), "%s.anim", path);
+  if(stat(companion, &st) == 0 && !pack_add(companion))  return 0;
+
+  /* a stale chain would be rebuilt at every launch, the pack has no image
+     time to check it against */
+  snprintf(companion, sizeof(companion), "%s.t3dtex", path);
+  if(stat(companion, &st) == 0) {
+    if(tex_cache_is_current(path)) {
+      if(!pack_add(companion))  return 0;
+    }
+    else
+      fprintf(stderr, "Skipped the stale %s, run the engine once to refresh it\n", companion);
+  }
+
+  snprintf(companion, sizeof(companion), "%s.t3dm", path);
+  if(stat(companion, &st) == 0) {
+    if(ms3d_cooked_is_current(path)) {
+      if(!pack_add(companion))  return 0;
+    }
+    else
+      fprintf(stderr, "Skipped the stale %s, run t3dcook to refresh it\n", companion);
+  }
+
+  return 1;
+}
+
+/* add a list file and the files it lists */
+static int
+pack_add_list( const char *listfile, const int depth )
+{
+  char line[512], path[512];
+
+  if(depth > 8) {
+    fprintf(stderr, "Lists nested too deep at %s\n", listfile);
+    return 0;
+  }
+
+  FILE *fp = fopen(listfile, "rt");
+  if(!fp) {
+    fprintf(stderr, "Can not read %s\n", listfile);
+    return 0;
+  }
+
+  int ok = pack_add(listfile);
+  while(ok && fgets(line, sizeof(line), fp)) {
+    if(sscanf(line, "%511s", path) != 1)  continue;
+
+    if(path[0] == '@')
+      ok = pack_add_list(path + 1, depth + 1);
+    else
+      ok = pack_add_file(path);
+  }
+  fclose(fp);
+
+  return ok;
+}
+
+/* index order, by hash then name */
+static int
+pack_cmp( const void *a, const void *b )
+{
+  const packfile *fa = (const packfile *)a;
+  const packfile *fb = (const packfile *)b;
+
+  if(fa->hash != fb->hash)  return fa->hash < fb->hash ? -1 : 1;
+  return strcmp(fa->name, fb->name);
+}
+
+/* write the pack aside, then rename it over the old one */
+static int
+pack_write( const char *packfile_name )
+{
+  static const unsigned char zeros[PAK_ALIGN] = { 0 };
+  char tmpfile[520];
+  int i;
+
+  qsort(files, n_files, sizeof(packfile), pack_cmp);
+
+  pakheader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, "T3DP", 4);
+  hdr.version = PAK_VERSION;
+  hdr.n_entries = n_files;
+  for(i = 0; i < n_files; i++)
+    hdr.names_size += strlen(files[i].name) + 1;
+
+  pakentry *entries = (pakentry *)calloc((unsigned int)n_files + 1, sizeof(pakentry));
+  unsigned long long offset = sizeof(hdr) + sizeof(pakentry)*n_files + hdr.names_size;
+  unsigned int name = 0;
+
+  for(i = 0; i < n_files; i++) {
+    offset = (offset + PAK_ALIGN - 1) & ~(unsigned long long)(PAK_ALIGN - 1);
+
+    entries[i].hash = files[i].hash;
+    entries[i].offset = offset;
+    entries[i].size = files[i].size;
+    entries[i].name = name;
+
+    name += strlen(files[i].name) + 1;
+    /* the 0 byte after each blob */
+    offset += files[i].size + 1;
+  }
+
+  snprintf(tmpfile, sizeof(tmpfile), "%s.tmp", packfile_name);
+  FILE *fp = fopen(tmpfile, "wb");
+  if(!fp) {
+    fprintf(stderr, "Can not write %s\n", tmpfile);
+    free(entries);
+    return 0;
+  }
+
+  int ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1;
+  if(ok && n_files)
+    ok = fwrite(entries, sizeof(pakentry), n_files, fp) == (size_t)n_files;
+  for(i = 0; ok && i < n_files; i++)
+    ok = fwrite(files[i].name, strlen(files[i].name) + 1, 1, fp) == 1;
+
+  unsigned long long pos = sizeof(hdr) + sizeof(pakentry)*n_files + hdr.names_size;
+  for(i = 0; ok && i < n_files; i++) {
+    size_t pad = (size_t)(entries[i].offset - pos);
+    if(pad)  ok = fwrite(zeros, pad, 1, fp) == 1;
+    if(ok && files[i].size)  ok = fwrite(files[i].data, files[i].size, 1, fp) == 1;
+    if(ok)  ok = fwrite(zeros, 1, 1, fp) == 1;
+    pos = entries[i].offset + files[i].size + 1;
+  }
+  ok = (fclose(fp) == 0) && ok;
+  free(entries);
+
+#ifdef _WIN32
+  if(ok)  remove(packfile_name);
+#endif
+  if(!ok || rename(tmpfile, packfile_name) != 0) {
+    fprintf(stderr, "Can not write %s\n", packfile_name);
+    remove(tmpfile);
+    return 0;
+  }
+
+  printf("%s: %d files, %llu bytes\n", packfile_name, n_files, pos);
+  return 1;
+}
+
+int
+main( int argc, char *argv[] )
+{
+  int i, ok = 1;
+
+  if(argc < 3) {
+    fprintf(stderr, "usage: t3dpak <pack> <file | @listfile>...\n");
+    return EXIT_FAILURE;
+  }
+
+  for(i = 2; ok && i < argc; i++) {
+    if(argv[i][0] == '@')
+      ok = pack_add_list(argv[i] + 1, 0);
+    else
+      ok = pack_add_file(argv[i]);
+  }
+
+  if(ok)  ok = pack_write(argv[1]);
+
+  for(i = 0; i < n_files; i++)
+    util_unmap_file(files[i].data, files[i].size);
+  free(files);
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}